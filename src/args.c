@@ -14,6 +14,13 @@ static int arg_track_modification_time = 0;
 static int arg_show_total = 0;
 static int arg_dereference_symlinks = 0;
 static int arg_dereference_only_arg_symlinks = 0;
+static int arg_output_order = -1; // Default depends on the output format
+static int arg_top_files = 0;
+static int arg_top_dirs = 0;
+
+static bool try_parse_time_str(char* time_str, char default_unit, time_t* seconds);
+
+static const char* short_options = ":hsaTcd:LDB:j:C::u::t:";
 
 /**
  * Parse mdu command line arguments
@@ -24,8 +31,12 @@ Options parse_arguments(int argc, char* argv[]) {
     Options options = { 0 };
     options.min_display_size_percent = 0;
     options.files = NULL;
-    options.thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    options.thread_count = available_cpu_count();
+    options.auto_threads = false;
     options.block_size = 1024;
+    options.max_depth = -1;
+    options.scan_time = time(NULL);
+    options.patterns = pattern_matcher_new();
     opterr = 0;
 
     int option_index = 0;
@@ -43,29 +54,67 @@ Options parse_arguments(int argc, char* argv[]) {
         { "create-cache", optional_argument, 0, 'C' },
         { "use-cache", optional_argument, 0, 'u' },
         { "threshold", required_argument, 0, 't' },
+        { "format", required_argument, 0, ARG_FORMAT },
+        { "order", required_argument, 0, ARG_ORDER },
+        { "top", required_argument, 0, ARG_TOP },
+        { "files", no_argument, 0, ARG_TOP_FILES },
+        { "dirs", no_argument, 0, ARG_TOP_DIRS },
+        { "apparent-size", no_argument, 0, ARG_APPARENT_SIZE },
+        { "slack", no_argument, 0, ARG_SLACK },
+        { "inodes", no_argument, 0, ARG_INODES },
+        { "by-user", no_argument, 0, ARG_BY_USER },
+        { "by-group", no_argument, 0, ARG_BY_GROUP },
+        { "by-ext", optional_argument, 0, ARG_BY_EXT },
+        { "older-than", required_argument, 0, ARG_OLDER_THAN },
+        { "newer-than", required_argument, 0, ARG_NEWER_THAN },
+        { "age-histogram", no_argument, 0, ARG_AGE_HISTOGRAM },
+        { "size-histogram", no_argument, 0, ARG_SIZE_HISTOGRAM },
+        { "exclude", required_argument, 0, ARG_EXCLUDE },
+        { "exclude-from", required_argument, 0, ARG_EXCLUDE_FROM },
+        { "include", required_argument, 0, ARG_INCLUDE },
+        { "estimate", optional_argument, 0, ARG_ESTIMATE },
+        { "deadline", required_argument, 0, ARG_DEADLINE },
+        { "progress", optional_argument, 0, ARG_PROGRESS },
+        { "gentle", optional_argument, 0, ARG_GENTLE },
+        { "inode-order", optional_argument, 0, ARG_INODE_ORDER },
+        { "daemon", no_argument, 0, ARG_DAEMON },
+        { "socket", required_argument, 0, ARG_SOCKET },
+        { "query", required_argument, 0, ARG_QUERY },
+        { "refresh", required_argument, 0, ARG_REFRESH },
+        { "watch", no_argument, 0, ARG_WATCH },
         { 0, 0, 0, 0 }
     };
 
     // Parse flags
-    int arg_c = getopt_long(argc, argv, ":hsaTcd:LDB:j:C::u::t:", long_options,
-                            &option_index);
+    int arg_c = getopt_long(argc, argv, short_options, long_options, &option_index);
     while (arg_c != -1) {
         switch (arg_c) {
             case 'j':
                 // Thread count
+                if (strcmp(optarg, "auto") == 0) {
+                    options.auto_threads = true;
+                    options.thread_count = thread_tuner_max_threads(available_cpu_count());
+                    break;
+                }
+                options.auto_threads = false;
                 options.thread_count = checked_unsigned_atoi(
-                    optarg, "Invalid thread count, must be integer over 0");
+                    optarg, "Invalid thread count, must be integer over 0 or auto");
                 break;
             case 'B':
                 // Block size
                 options.block_size = checked_unsigned_atoi(
                     optarg, "Invalid block size, must be integer over 0");
                 break;
-            case 'd':
-                // Max depth
-                options.max_depth = checked_unsigned_atoi(
-                    optarg, "Invalid max depth option, must be integer over 0");
+            case 'd': {
+                // Max depth, 0 is the same as summarize
+                char* depth_end;
+                long depth = strtol(optarg, &depth_end, 10);
+                if (*optarg == '\0' || *depth_end != '\0' || depth < 0 || depth > INT_MAX) {
+                    stderr_and_exit("Invalid max depth option, must be integer 0 or over");
+                }
+                options.max_depth = depth;
                 break;
+            }
             case 'C':
                 // Create cache
                 if (optarg) {
@@ -92,6 +141,176 @@ Options parse_arguments(int argc, char* argv[]) {
                         "Invalid threshold size option, must be valid number (below 2^64) or percentage (0-100%)");
                 }
                 break;
+            case ARG_FORMAT:
+                // Machine-readable output format
+                if (!try_parse_output_format(optarg, &options.output_format)) {
+                    stderr_and_exit("Invalid format option, must be text, ndjson, csv or tsv0");
+                }
+                break;
+            case ARG_ORDER:
+                // du-compatible order, or print every entry as soon as it is final
+                if (strcmp(optarg, "du") == 0) {
+                    arg_output_order = true;
+                }
+                else if (strcmp(optarg, "unordered") == 0) {
+                    arg_output_order = false;
+                }
+                else {
+                    stderr_and_exit("Invalid order option, must be du or unordered");
+                }
+                break;
+            case ARG_TOP:
+                // Only print the largest entries
+                options.top_count = checked_unsigned_atoi(
+                    optarg, "Invalid top option, must be integer over 0");
+                break;
+            case ARG_TOP_FILES:
+                arg_top_files = true;
+                break;
+            case ARG_TOP_DIRS:
+                arg_top_dirs = true;
+                break;
+            case ARG_APPARENT_SIZE:
+                options.apparent_size = true;
+                break;
+            case ARG_SLACK:
+                options.show_slack = true;
+                break;
+            case ARG_INODES:
+                options.count_inodes = true;
+                break;
+            case ARG_BY_USER:
+                options.by_user = true;
+                break;
+            case ARG_BY_GROUP:
+                options.by_group = true;
+                break;
+            case ARG_BY_EXT:
+                // Optionally only the listed extensions, ex --by-ext=log,tar.gz
+                options.by_ext = true;
+                options.ext_list = optarg;
+                break;
+            case ARG_OLDER_THAN:
+            case ARG_NEWER_THAN: {
+                // Only count entries by their modification age
+                time_t age;
+                if (!try_parse_age_str(optarg, &age)) {
+                    stderr_and_exit(
+                        "Invalid age option, must be integer with an optional s, m, h, d, w or y suffix");
+                }
+                if (arg_c == ARG_OLDER_THAN) {
+                    options.older_than = options.scan_time - age;
+                }
+                else {
+                    options.newer_than = options.scan_time - age;
+                }
+                break;
+            }
+            case ARG_AGE_HISTOGRAM:
+                options.age_histogram = true;
+                break;
+            case ARG_SIZE_HISTOGRAM:
+                options.size_histogram = true;
+                break;
+            case ARG_EXCLUDE:
+                if (!pattern_matcher_is_valid_pattern(optarg)) {
+                    stderr_and_exit("Invalid exclude pattern, patterns match names and "
+                                    "cannot contain '/'");
+                }
+                pattern_matcher_add(&options.patterns, optarg, false);
+                break;
+            case ARG_EXCLUDE_FROM:
+                if (!pattern_matcher_add_file(&options.patterns, optarg)) {
+                    if (errno == EINVAL) {
+                        stderr_and_exit("Invalid pattern in exclude file, patterns match "
+                                        "names and cannot contain '/'");
+                    }
+                    perror_and_exit(optarg);
+                }
+                break;
+            case ARG_INCLUDE:
+                if (!pattern_matcher_is_valid_pattern(optarg)) {
+                    stderr_and_exit("Invalid include pattern, patterns match names and "
+                                    "cannot contain '/'");
+                }
+                pattern_matcher_add(&options.patterns, optarg, true);
+                break;
+            case ARG_ESTIMATE:
+                // Amount of directories to scan fully before sampling, ex --estimate=50000
+                options.estimate_budget = ESTIMATE_DEFAULT_BUDGET;
+                if (optarg) {
+                    options.estimate_budget = checked_unsigned_atoi(
+                        optarg, "Invalid estimate option, must be integer over 0");
+                }
+                break;
+            case ARG_DEADLINE:
+                // Stop scanning and print the partial totals after this long
+                if (!try_parse_duration_str(optarg, &options.deadline) ||
+                    options.deadline == 0) {
+                    stderr_and_exit(
+                        "Invalid deadline option, must be integer over 0 with an optional s, m, h, d, w or y suffix");
+                }
+                break;
+            case ARG_PROGRESS:
+                // An updating line by default, or JSON events for scripts
+                if (optarg == NULL || strcmp(optarg, "text") == 0) {
+                    options.progress = PROGRESS_TEXT;
+                }
+                else if (strcmp(optarg, "ndjson") == 0) {
+                    options.progress = PROGRESS_NDJSON;
+                }
+                else {
+                    stderr_and_exit("Invalid progress option, must be text or ndjson");
+                }
+                break;
+            case ARG_GENTLE:
+                // Idle IO priority and at most this many stat calls per second
+                options.gentle_ops = GENTLE_DEFAULT_OPS;
+                if (optarg) {
+                    options.gentle_ops = checked_unsigned_atoi(
+                        optarg, "Invalid gentle option, must be integer over 0");
+                }
+                break;
+            case ARG_INODE_ORDER:
+                // Automatically on spinning disks by default
+                if (optarg == NULL || strcmp(optarg, "always") == 0) {
+                    options.inode_order = INODE_ORDER_ALWAYS;
+                }
+                else if (strcmp(optarg, "never") == 0) {
+                    options.inode_order = INODE_ORDER_NEVER;
+                }
+                else if (strcmp(optarg, "auto") == 0) {
+                    options.inode_order = INODE_ORDER_AUTO;
+                }
+                else {
+                    stderr_and_exit("Invalid inode order option, must be auto, always or never");
+                }
+                break;
+            case ARG_DAEMON:
+                options.daemon = true;
+                break;
+            case ARG_WATCH:
+                // A daemon which applies the changes as they happen
+                options.daemon = true;
+                options.watch = true;
+                break;
+            case ARG_SOCKET:
+                options.socket_path = optarg;
+                break;
+            case ARG_QUERY:
+                // Answered by a running --daemon instead of scanning
+                if (strcmp(optarg, "size") != 0 && strcmp(optarg, "children") != 0 &&
+                    strcmp(optarg, "top") != 0) {
+                    stderr_and_exit("Invalid query option, must be size, children or top");
+                }
+                options.query = optarg;
+                break;
+            case ARG_REFRESH:
+                if (!try_parse_duration_str(optarg, &options.refresh_interval) ||
+                    options.refresh_interval == 0) {
+                    stderr_and_exit("Invalid refresh option, must be a duration over 0, ex 30s or 5m");
+                }
+                break;
             case 'h':
                 arg_human_readable = true;
                 break;
@@ -122,8 +341,7 @@ Options parse_arguments(int argc, char* argv[]) {
                 exit(EXIT_FAILURE);
                 break;
         }
-        arg_c = getopt_long(argc, argv, "-:hsatcd:LDB:j:C::u::m:", long_options,
-                            &option_index);
+        arg_c = getopt_long(argc, argv, short_options, long_options, &option_index);
     }
 
     // Parse required and optional arguments
@@ -151,15 +369,56 @@ Options parse_arguments(int argc, char* argv[]) {
     if (arg_summarize) {
         options.max_depth = 0;
     }
-    else {
-        options.max_depth = -1;
-    }
     options.human_readable = arg_human_readable;
     options.show_regular_files = arg_show_every_file;
     options.track_modification_time = arg_track_modification_time;
     options.show_total = arg_show_total;
+    if (options.count_inodes && (options.apparent_size || options.show_slack)) {
+        stderr_and_exit("Cannot combine --inodes with --apparent-size or --slack");
+    }
+    // The reports are printed instead of the entries, and have their own CSV headers
+    int report_count = (options.top_count > 0) + options.size_histogram +
+                       (options.estimate_budget > 0) +
+                       (options.by_user || options.by_group || options.by_ext);
+    if (report_count > 1) {
+        stderr_and_exit(
+            "Only one of --top, --size-histogram, --estimate and --by-user, --by-group or --by-ext can be used");
+    }
+    if ((arg_top_files || arg_top_dirs) && options.top_count == 0) {
+        stderr_and_exit("--files and --dirs require --top");
+    }
+    // Only the entries below the arguments within the print depth are ranked
+    if (options.top_count > 0 && options.max_depth == 0 && !options.query) {
+        stderr_and_exit("Cannot combine --top with --summarize or --max-depth=0");
+    }
+    // Rank directories by default
+    options.top_dirs = arg_top_dirs || !arg_top_files;
+    options.top_files = arg_top_files;
+    if (arg_output_order == -1) {
+        // Text is printed like du, records are streamed out as fast as possible.
+        // Every argument is scanned at once, so several arguments are ordered
+        // to keep their records apart
+        options.ordered_output = options.output_format == FORMAT_TEXT ||
+                                 options.files[1] != NULL;
+    }
+    else {
+        options.ordered_output = arg_output_order;
+    }
     options.dereference_symlinks = arg_dereference_symlinks;
     options.dereference_only_arg_symlinks = arg_dereference_only_arg_symlinks;
+    if (options.daemon && options.query) {
+        stderr_and_exit("Cannot both run a daemon and query one");
+    }
+    // --top is the count of top queries, the daemon itself keeps every directory
+    if (options.daemon && report_count > 0) {
+        stderr_and_exit("--daemon cannot be combined with --top, --size-histogram, --estimate or --by-*");
+    }
+    if ((options.daemon || options.query) && options.socket_path == NULL) {
+        options.socket_path = daemon_default_socket_path();
+    }
+    if (options.refresh_interval == 0) {
+        options.refresh_interval = DAEMON_DEFAULT_REFRESH;
+    }
 
     return options;
 }
@@ -256,4 +515,94 @@ bool try_parse_min_size_str(char* min_size, size_t* min_size_bytes,
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+/**
+ * Try parsing an output format name, ex ndjson or csv
+ * @param format_str format name
+ * @param format output format
+ * @return true if parsing successful, false otherwise
+ */
+bool try_parse_output_format(char* format_str, OutputFormat* format) {
+    if (strcmp(format_str, "text") == 0) {
+        *format = FORMAT_TEXT;
+    }
+    else if (strcmp(format_str, "ndjson") == 0) {
+        *format = FORMAT_NDJSON;
+    }
+    else if (strcmp(format_str, "csv") == 0) {
+        *format = FORMAT_CSV;
+    }
+    else if (strcmp(format_str, "tsv0") == 0) {
+        *format = FORMAT_TSV0;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Try parsing an age, ex 90d or 12h
+ * @param age_str age str
+ * @param seconds output age in seconds
+ * @return true if parsing successful, false otherwise
+ *
+ * Valid inputs:
+ *      Integer with no suffix (days) or following suffix:
+ *          s, m, h, d, w, y (365 days)
+ */
+bool try_parse_age_str(char* age_str, time_t* seconds) {
+    return try_parse_time_str(age_str, 'd', seconds);
+}
+
+/**
+ * Try parsing a duration, ex 30s or 5m
+ * @param duration_str duration str
+ * @param seconds output duration in seconds
+ * @return true if parsing successful, false otherwise
+ *
+ * Valid inputs:
+ *      Integer with no suffix (seconds) or following suffix:
+ *          s, m, h, d, w, y (365 days)
+ */
+bool try_parse_duration_str(char* duration_str, time_t* seconds) {
+    return try_parse_time_str(duration_str, 's', seconds);
+}
+
+// Parse an integer with a time unit suffix, using default_unit if there is none
+static bool try_parse_time_str(char* time_str, char default_unit, time_t* seconds) {
+    char* time_end;
+    long value = strtol(time_str, &time_end, 10);
+    if (time_end == time_str || value < 0) {
+        return false;
+    }
+    long unit;
+    switch (*time_end != '\0' ? *time_end : default_unit) {
+        case 's':
+            unit = 1;
+            break;
+        case 'm':
+            unit = 60;
+            break;
+        case 'h':
+            unit = 60 * 60;
+            break;
+        case 'd':
+            unit = 24 * 60 * 60;
+            break;
+        case 'w':
+            unit = 7 * 24 * 60 * 60;
+            break;
+        case 'y':
+            unit = 365 * 24 * 60 * 60;
+            break;
+        default:
+            return false;
+    }
+    if ((*time_end != '\0' && time_end[1] != '\0') || value > LONG_MAX / unit) {
+        return false;
+    }
+    *seconds = value * unit;
+    return true;
+}
@@ -14,10 +14,64 @@
 #include <getopt.h>
 #include <math.h>
 #include <limits.h>
+#include <time.h>
 
 #include "util/helpers.h"
+#include "pattern_matcher.h"
+#include "estimate.h"
+#include "progress.h"
+#include "gentle.h"
+#include "thread_tuner.h"
+#include "dirent_batch.h"
+#include "daemon.h"
+#include "scan_pool.h"
+#include "visitor.h"
 
 typedef struct Options Options;
+// Told about an entry which could not be read, with the errno of the failure
+typedef void (*ScanErrorHandler)(void* context, const char* path, int error);
+
+// Output formats selectable with --format
+enum OutputFormat {
+    FORMAT_TEXT, // du-style plain text, the default
+    FORMAT_NDJSON, // One JSON object per line
+    FORMAT_CSV, // RFC 4180 CSV with a header line
+    FORMAT_TSV0, // Tab separated fields, records terminated by NUL
+};
+
+typedef enum OutputFormat OutputFormat;
+
+// Long options without a short equivalent
+enum LongOnlyOption {
+    ARG_FORMAT = 256,
+    ARG_ORDER,
+    ARG_TOP,
+    ARG_TOP_FILES,
+    ARG_TOP_DIRS,
+    ARG_APPARENT_SIZE,
+    ARG_SLACK,
+    ARG_INODES,
+    ARG_BY_USER,
+    ARG_BY_GROUP,
+    ARG_BY_EXT,
+    ARG_OLDER_THAN,
+    ARG_NEWER_THAN,
+    ARG_AGE_HISTOGRAM,
+    ARG_SIZE_HISTOGRAM,
+    ARG_EXCLUDE,
+    ARG_EXCLUDE_FROM,
+    ARG_INCLUDE,
+    ARG_ESTIMATE,
+    ARG_DEADLINE,
+    ARG_PROGRESS,
+    ARG_GENTLE,
+    ARG_INODE_ORDER,
+    ARG_DAEMON,
+    ARG_SOCKET,
+    ARG_QUERY,
+    ARG_REFRESH,
+    ARG_WATCH,
+};
 
 // Represents all Make arguments options
 struct Options {
@@ -26,19 +80,59 @@ struct Options {
     // Display options
     size_t block_size;
     bool human_readable;
+    bool apparent_size; // Print and rank by apparent size instead of disk usage
+    bool show_slack; // Print the allocated, apparent, sparse and slack size in text
+    bool count_inodes; // Print and rank by entry count, skips stat where possible
     bool show_total;
     bool show_regular_files; // Show every file, not only just the default of folders
     size_t min_display_size; // Only display files of a certain size
     double min_display_size_percent; // Only display files of a certain percentage of total
     int max_depth; // Only display up to a certain depth
+    OutputFormat output_format; // Format of the printed records
+    bool ordered_output; // Print in du order, otherwise as soon as a directory is final
+    size_t top_count; // Only print the largest entries, 0 otherwise
+    bool top_files; // Rank files for top_count
+    bool top_dirs; // Rank directories for top_count
+    bool by_user; // Only print the total of every user
+    bool by_group; // Only print the total of every group
+    bool by_ext; // Only print the total of every file extension
+    char* ext_list; // Comma separated extensions for by_ext, NULL for every extension
+    bool age_histogram; // Print the size per modification age of every entry
+    bool size_histogram; // Only print the file size distribution of every argument
+    size_t estimate_budget; // Only print an estimate, sampling after this many directories
+
+    // Filter options
+    time_t scan_time; // Start of the scan, ages are relative to this
+    time_t older_than; // Only count entries modified before this time, 0 to count all
+    time_t newer_than; // Only count entries modified after this time, 0 to count all
+    PatternMatcher patterns; // Compiled --exclude and --include patterns
 
     // Search options
-    size_t thread_count;
+    size_t thread_count; // Amount of worker threads, the most that scan at once with -j auto
+    bool auto_threads; // Tune the amount of scanning workers during the scan, -j auto
+    time_t deadline; // Stop taking new directories after this many seconds, 0 for no limit
+    ProgressFormat progress; // Print the progress of the scan to stderr
+    size_t gentle_ops; // Stat calls per second with --gentle, 0 to scan at full speed
+    InodeOrder inode_order; // Stat the entries of a directory in inode order
     bool dereference_symlinks; // Dereference all symlinks
     bool dereference_only_arg_symlinks; // Dereference only symlinks in arguments
     bool track_modification_time; // Track total
     char* use_cache_location; // Use file cache, NULL otherwise
     char* create_cache_location; // Save cache to file, NULL otherwise
+
+    // Daemon options
+    bool daemon; // Keep the trees in memory and answer queries on socket_path
+    bool watch; // Keep the trees of the daemon up to date with inotify instead of rescans
+    char* query; // Ask a daemon on socket_path, size, children or top, NULL otherwise
+    char* socket_path; // Unix socket of the daemon
+    time_t refresh_interval; // Seconds between two rescans by the daemon
+
+    // Embedding options, set by librdu instead of arguments
+    ScanErrorHandler error_handler; // NULL to print the entries which could not be read
+    void* error_context; // Passed to error_handler
+    const bool* cancelled; // Stop taking new directories once set, NULL if never cancelled
+    ScanPool* pool; // Threads reused for every scan, NULL to start threads per scan
+    const RduVisitor* visitor; // Told about every entry and final directory, NULL for none
 };
 
 /**
@@ -62,4 +156,36 @@ Options parse_arguments(int argc, char* argv[]);
  *      Suffix is case insensitive
  */
 bool try_parse_min_size_str(char* min_size, size_t* min_size_bytes,
-                            double* min_size_percent);
\ No newline at end of file
+                            double* min_size_percent);
+
+/**
+ * Try parsing an output format name, ex ndjson or csv
+ * @param format_str format name
+ * @param format output format
+ * @return true if parsing successful, false otherwise
+ */
+bool try_parse_output_format(char* format_str, OutputFormat* format);
+
+/**
+ * Try parsing an age, ex 90d or 12h
+ * @param age_str age str
+ * @param seconds output age in seconds
+ * @return true if parsing successful, false otherwise
+ *
+ * Valid inputs:
+ *      Integer with no suffix (days) or following suffix:
+ *          s, m, h, d, w, y (365 days)
+ */
+bool try_parse_age_str(char* age_str, time_t* seconds);
+
+/**
+ * Try parsing a duration, ex 30s or 5m
+ * @param duration_str duration str
+ * @param seconds output duration in seconds
+ * @return true if parsing successful, false otherwise
+ *
+ * Valid inputs:
+ *      Integer with no suffix (seconds) or following suffix:
+ *          s, m, h, d, w, y (365 days)
+ */
+bool try_parse_duration_str(char* duration_str, time_t* seconds);
@@ -0,0 +1,97 @@
+/**
+ * Lookup of directories in the tree of a previous scan, loaded from
+ * the cache. The children of one cache node at a time are indexed
+ * by name, so that a directory with many subdirectories finds each
+ * of them without walking the sibling list
+ *
+ * @file cache_index.c
+ * @author William Sandström
+ */
+#include "cache_index.h"
+
+static void cache_index_build(CacheIndex* index, FileNode* parent);
+static uint64_t name_hash(const char* name);
+
+/**
+ * Create a new index without any allocations
+ */
+CacheIndex cache_index_new() {
+    CacheIndex index = { 0 };
+    return index;
+}
+
+/**
+ * Free the slots of an index
+ */
+void cache_index_free(CacheIndex* index) {
+    free(index->slots);
+    *index = cache_index_new();
+}
+
+/**
+ * Find the child of a cache node with a specific name. The children
+ * are indexed on the first lookup below a new parent
+ *
+ * @param index index of the calling thread
+ * @param parent node of the parent directory in the cache tree
+ * @param name name of the child directory
+ *
+ * @return the child node, NULL if it was not in the previous scan
+ */
+FileNode* cache_index_find_child(CacheIndex* index, FileNode* parent, const char* name) {
+    if (index->parent != parent) {
+        cache_index_build(index, parent);
+    }
+    if (index->linear) {
+        return file_node_find_child(parent, name);
+    }
+    size_t slot = name_hash(name) & (index->capacity - 1);
+    while (index->slots[slot]) {
+        if (strcmp(index->slots[slot]->name, name) == 0) {
+            return index->slots[slot];
+        }
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    return NULL;
+}
+
+// Index the children of a cache node, at most half of the slots are used
+static void cache_index_build(CacheIndex* index, FileNode* parent) {
+    index->parent = parent;
+    size_t child_count = 0;
+    for (FileNode* child = parent->first_child; child; child = child->next_sibling) {
+        child_count++;
+    }
+    index->linear = child_count <= CACHE_INDEX_LINEAR_CHILDREN;
+    if (index->linear) {
+        return;
+    }
+    size_t capacity = 64;
+    while (capacity < child_count * 2) {
+        capacity *= 2;
+    }
+    // Shrunk as well, so that clearing the slots stays in proportion to the children
+    if (index->capacity < capacity || index->capacity > capacity * 4) {
+        index->capacity = capacity;
+        free(index->slots);
+        index->slots = checked_malloc(index->capacity, sizeof(FileNode*));
+    }
+    memset(index->slots, 0, index->capacity * sizeof(FileNode*));
+    for (FileNode* child = parent->first_child; child; child = child->next_sibling) {
+        size_t slot = name_hash(child->name) & (index->capacity - 1);
+        while (index->slots[slot]) {
+            slot = (slot + 1) & (index->capacity - 1);
+        }
+        index->slots[slot] = child;
+    }
+}
+
+// FNV-1a, file names are short so this is cheap
+static uint64_t name_hash(const char* name) {
+    uint64_t hash = 14695981039346656037ull;
+    for (; *name; name++) {
+        hash ^= (unsigned char) *name;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
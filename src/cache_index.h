@@ -0,0 +1,53 @@
+/**
+ * Lookup of directories in the tree of a previous scan, loaded from
+ * the cache. The children of one cache node at a time are indexed
+ * by name, so that a directory with many subdirectories finds each
+ * of them without walking the sibling list
+ *
+ * @file cache_index.h
+ * @author William Sandström
+ */
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file_node.h"
+#include "util/helpers.h"
+
+// Nodes with at most this many children are searched linearly instead
+#define CACHE_INDEX_LINEAR_CHILDREN 16
+
+// Reused between directories, one index per thread
+struct CacheIndex {
+    FileNode* parent; // Node whose children are indexed, NULL before the first lookup
+    bool linear; // The parent has few children, the slots are not used
+    FileNode** slots; // Open addressing on the child names, NULL for free slots
+    size_t capacity; // Power of two
+};
+
+typedef struct CacheIndex CacheIndex;
+
+/**
+ * Create a new index without any allocations
+ */
+CacheIndex cache_index_new();
+
+/**
+ * Free the slots of an index
+ */
+void cache_index_free(CacheIndex* index);
+
+/**
+ * Find the child of a cache node with a specific name. The children
+ * are indexed on the first lookup below a new parent
+ *
+ * @param index index of the calling thread
+ * @param parent node of the parent directory in the cache tree
+ * @param name name of the child directory
+ *
+ * @return the child node, NULL if it was not in the previous scan
+ */
+FileNode* cache_index_find_child(CacheIndex* index, FileNode* parent, const char* name);
@@ -0,0 +1,767 @@
+/**
+ * Resident mode for --daemon, which keeps the scanned trees of the
+ * arguments in memory and answers queries about them over a Unix
+ * socket, and the --query client
+ *
+ * @file daemon.c
+ * @author William Sandström
+ */
+#include "daemon.h"
+#include "disk_usage.h"
+#include "output.h"
+#include "watch.h"
+
+static volatile sig_atomic_t stop_requested = 0;
+static volatile sig_atomic_t print_requested = 0;
+
+static void request_stop(int signal_number);
+static void request_print(int signal_number);
+static void* run_refresh_thread(void* arg_ptr);
+static bool serve_request(Daemon* server, int client_fd);
+static void accept_client(int listen_fd, DaemonClient* clients, size_t* client_count);
+static time_t monotonic_seconds();
+static bool bind_socket(const char* path, int* listen_fd);
+static bool connect_socket(const char* path, int* socket_fd);
+static FileNode* find_node(Daemon* server, const char* path, DaemonTree** found_tree);
+static FileNode* next_in_subtree(FileNode* node, FileNode* subtree_root);
+static void print_node(FILE* out, FileNode* node, DaemonTree* tree, char** path_buffer,
+                       size_t* path_buffer_size);
+static void print_children(FILE* out, FileNode* node, DaemonTree* tree);
+static void print_top(FILE* out, FileNode* node, DaemonTree* tree, size_t count);
+static int compare_sizes_descending(const void* a, const void* b);
+static bool read_all(int fd, void* data, size_t size);
+static bool write_all(int fd, const void* data, size_t size);
+
+/**
+ * Resolve the arguments and scan each of them once
+ *
+ * @param server daemon to initialize
+ * @param options options with the arguments to keep
+ * @return false if none of the arguments could be resolved
+ */
+bool daemon_init(Daemon* server, Options* options) {
+    size_t file_count = 0;
+    while (options->files[file_count]) {
+        file_count++;
+    }
+    server->options = options;
+    server->trees = checked_calloc(file_count, sizeof(DaemonTree));
+    server->tree_count = 0;
+    for (size_t i = 0; i < file_count; i++) {
+        // The queries are resolved by the clients as well, so they find the same path
+        char* path = realpath(options->files[i], NULL);
+        if (path == NULL) {
+            perror(options->files[i]);
+            continue;
+        }
+        server->trees[server->tree_count].path = path;
+        server->trees[server->tree_count].node = NULL;
+        server->tree_count++;
+    }
+    if (server->tree_count == 0) {
+        free(server->trees);
+        return false;
+    }
+    pthread_rwlock_init(&server->lock, NULL);
+    pthread_mutex_init(&server->refresh_mutex, NULL);
+    pthread_cond_init(&server->refresh_cond, NULL);
+    server->stopping = false;
+    server->watcher = NULL;
+    // Every argument is scanned on its own, so nested arguments have complete totals
+    for (size_t i = 0; i < server->tree_count; i++) {
+        daemon_refresh(server, i);
+    }
+    return true;
+}
+
+/**
+ * Free the trees of the daemon
+ */
+void daemon_free(Daemon* server) {
+    for (size_t i = 0; i < server->tree_count; i++) {
+        free(server->trees[i].path);
+        if (server->trees[i].node) {
+            file_node_free_all(server->trees[i].node);
+        }
+    }
+    free(server->trees);
+    pthread_rwlock_destroy(&server->lock);
+    pthread_mutex_destroy(&server->refresh_mutex);
+    pthread_cond_destroy(&server->refresh_cond);
+}
+
+/**
+ * Scan a directory into a tree of its own
+ *
+ * @param options options of the scan
+ * @param path path of the directory
+ * @return the root of the tree without a parent, NULL if it could not be scanned
+ */
+FileNode* daemon_scan_tree(Options* options, char* path) {
+    Options scan_options = *options;
+    char* files[] = { path, NULL };
+    scan_options.files = files;
+    FileNode* root = disk_usage_tree(scan_options, NULL);
+
+    // The tree of the argument is taken out of the root of the scan
+    FileNode* node = root->first_child;
+    if (node) {
+        file_tree_detach_child(node);
+    }
+    file_node_free_all(root);
+    return node;
+}
+
+/**
+ * Rescan the tree of one argument, and swap it in once it is complete.
+ * Queries are answered from the previous tree during the scan
+ *
+ * @param server daemon of the tree
+ * @param index index of the tree in server->trees
+ */
+void daemon_refresh(Daemon* server, size_t index) {
+    DaemonTree* tree = &server->trees[index];
+    FileNode* node = daemon_scan_tree(server->options, tree->path);
+
+    // The watches belong to the nodes of the previous tree
+    if (server->watcher) {
+        watcher_remove_tree(server->watcher, index);
+    }
+    pthread_rwlock_wrlock(&server->lock);
+    FileNode* previous_node = tree->node;
+    tree->node = node;
+    pthread_rwlock_unlock(&server->lock);
+    if (previous_node) {
+        file_node_free_all(previous_node);
+    }
+    if (server->watcher && node) {
+        watcher_add_subtree(server->watcher, index, node, false);
+    }
+}
+
+/**
+ * Answer a request from the trees of the daemon
+ *
+ * @param server daemon to answer from
+ * @param request request message, not NUL terminated
+ * @param request_size size of the request
+ * @param response_size set to the size of the response
+ * @return the response message, freed by the caller
+ */
+char* daemon_answer(Daemon* server, const char* request, size_t request_size,
+                    size_t* response_size) {
+    char* response = NULL;
+    FILE* out = open_memstream(&response, response_size);
+    if (out == NULL) {
+        perror_and_exit("open_memstream");
+    }
+    // The fields are the query, the count of top and the path
+    char* query = strndup(request, request_size);
+    char* path = strchr(query, '\t');
+    size_t top_count = 0;
+    bool valid = path != NULL;
+    if (valid) {
+        *path++ = '\0';
+        if (strcmp(query, "top") == 0) {
+            char* count_end;
+            top_count = strtoul(path, &count_end, 10);
+            valid = count_end != path && *count_end == '\t' && top_count > 0;
+            path = count_end + 1;
+        }
+        else {
+            valid = strcmp(query, "size") == 0 || strcmp(query, "children") == 0;
+        }
+    }
+
+    if (!valid) {
+        fprintf(out, "error\tinvalid request, must be size, children or top N and a path\n");
+    }
+    else {
+        pthread_rwlock_rdlock(&server->lock);
+        DaemonTree* tree;
+        FileNode* node = find_node(server, path, &tree);
+        if (node == NULL) {
+            fprintf(out, "error\t%s: not found in the scanned directories\n", path);
+        }
+        else if (top_count > 0) {
+            fprintf(out, "ok\n");
+            print_top(out, node, tree, top_count);
+        }
+        else if (strcmp(query, "children") == 0) {
+            fprintf(out, "ok\n");
+            print_children(out, node, tree);
+        }
+        else {
+            char* path_buffer = NULL;
+            size_t path_buffer_size = 0;
+            fprintf(out, "ok\n");
+            print_node(out, node, tree, &path_buffer, &path_buffer_size);
+            free(path_buffer);
+        }
+        pthread_rwlock_unlock(&server->lock);
+    }
+    free(query);
+    fclose(out);
+    return response;
+}
+
+/**
+ * Print the totals of every argument to stdout, in the format of the options
+ */
+void daemon_print_totals(Daemon* server) {
+    // Records are printed as they are added, there is no tree to order
+    Options options = *server->options;
+    options.ordered_output = false;
+    Output output;
+    output_init(&output, STDOUT_FILENO, &options);
+    OutputBuffer buffer = output_buffer_new(&output);
+    output_buffer_add_header(&buffer);
+    pthread_rwlock_rdlock(&server->lock);
+    for (size_t i = 0; i < server->tree_count; i++) {
+        FileNode* node = server->trees[i].node;
+        if (node == NULL) {
+            continue;
+        }
+        OutputRecord record = { 0 };
+        record.path = server->trees[i].path;
+        record.path_length = strlen(record.path);
+        record.is_dir = true;
+        record.size = node->complete_size;
+        record.apparent_size = node->complete_apparent_size;
+        record.sparse_size = node->complete_sparse_size;
+        record.slack_size = node->complete_slack_size;
+        record.entry_count = node->complete_entry_count;
+        record.modification_time = node->last_modification_time;
+        record.age_sizes = node->complete_age_sizes;
+        output_buffer_add_record(&buffer, &record);
+    }
+    pthread_rwlock_unlock(&server->lock);
+    output_buffer_free(&buffer);
+    output_destroy(&output);
+}
+
+/**
+ * Write a length-prefixed message
+ *
+ * @return false if the message could not be written
+ */
+bool daemon_write_message(int fd, const char* data, size_t size) {
+    uint32_t length = htonl(size);
+    return size <= DAEMON_MAX_MESSAGE_SIZE && write_all(fd, &length, sizeof(length)) &&
+           write_all(fd, data, size);
+}
+
+/**
+ * Read a length-prefixed message
+ *
+ * @param fd socket to read from
+ * @param size set to the size of the message
+ * @return the message with a NUL added after it, NULL at the end of the
+ * connection, on errors or if it is larger than DAEMON_MAX_MESSAGE_SIZE
+ */
+char* daemon_read_message(int fd, size_t* size) {
+    uint32_t length;
+    if (!read_all(fd, &length, sizeof(length))) {
+        return NULL;
+    }
+    *size = ntohl(length);
+    if (*size > DAEMON_MAX_MESSAGE_SIZE) {
+        return NULL;
+    }
+    char* message = checked_malloc(*size + 1, sizeof(char));
+    if (!read_all(fd, message, *size)) {
+        free(message);
+        return NULL;
+    }
+    message[*size] = '\0';
+    return message;
+}
+
+/**
+ * Socket of --daemon and --query if --socket is not given, in XDG_RUNTIME_DIR
+ * if it is set, otherwise DAEMON_FALLBACK_SOCKET
+ *
+ * @return the allocated path
+ */
+char* daemon_default_socket_path() {
+    // A shared directory like /tmp would let other users take the name first
+    const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir == NULL || runtime_dir[0] == '\0') {
+        char* path = checked_malloc(strlen(DAEMON_FALLBACK_SOCKET) + 1, sizeof(char));
+        strcpy(path, DAEMON_FALLBACK_SOCKET);
+        return path;
+    }
+    size_t length = strlen(runtime_dir) + strlen(DAEMON_SOCKET_NAME) + 1;
+    char* path = checked_malloc(length + 1, sizeof(char));
+    snprintf(path, length + 1, "%s/%s", runtime_dir, DAEMON_SOCKET_NAME);
+    return path;
+}
+
+/**
+ * Scan the arguments and answer queries on the socket of the options
+ * until SIGINT or SIGTERM. The trees are rescanned every refresh interval,
+ * or kept up to date with --watch. SIGUSR1 prints the totals
+ *
+ * @return exit status of the program
+ */
+int daemon_run(Options* options) {
+    // The wait for clients is interrupted to stop, so the handlers do not restart it.
+    // Installed before the socket exists, so nothing can find the daemon without them
+    struct sigaction action = { 0 };
+    action.sa_handler = request_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    action.sa_handler = request_print;
+    sigaction(SIGUSR1, &action, NULL);
+    int listen_fd;
+    if (!bind_socket(options->socket_path, &listen_fd)) {
+        return EXIT_FAILURE;
+    }
+
+    // Clients connecting during the first scan wait until it is done
+    Daemon server;
+    if (!daemon_init(&server, options)) {
+        close(listen_fd);
+        unlink(options->socket_path);
+        return EXIT_FAILURE;
+    }
+    // Without inotify, the trees are rescanned on the schedule instead
+    Watcher watcher;
+    if (options->watch) {
+        if (watcher_init(&watcher, &server)) {
+            server.watcher = &watcher;
+        }
+        else {
+            perror("rdu: inotify_init1");
+        }
+    }
+
+    // The signals are handled by this thread, not by the refresh thread or its workers
+    sigset_t handled_signals;
+    sigset_t wait_signals;
+    sigemptyset(&handled_signals);
+    sigaddset(&handled_signals, SIGINT);
+    sigaddset(&handled_signals, SIGTERM);
+    sigaddset(&handled_signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &handled_signals, &wait_signals);
+    pthread_t refresh_thread;
+    pthread_create(&refresh_thread, NULL, run_refresh_thread, &server);
+
+    // Between the waits the signals stay blocked, and ppoll unblocks them
+    // atomically. A signal after the checks of the flags still wakes the wait,
+    // instead of being handled just before a blocking call
+    DaemonClient clients[DAEMON_MAX_CLIENTS];
+    size_t client_count = 0;
+    struct pollfd poll_fds[DAEMON_MAX_CLIENTS + 1];
+    int status = EXIT_SUCCESS;
+    while (!stop_requested) {
+        if (print_requested) {
+            print_requested = 0;
+            daemon_print_totals(&server);
+        }
+        // New connections wait in the backlog while every slot is taken
+        poll_fds[0].fd = listen_fd;
+        poll_fds[0].events = client_count < DAEMON_MAX_CLIENTS ? POLLIN : 0;
+        time_t now = monotonic_seconds();
+        time_t idle_deadline = now + DAEMON_CLIENT_TIMEOUT_SECS;
+        for (size_t i = 0; i < client_count; i++) {
+            poll_fds[i + 1].fd = clients[i].fd;
+            poll_fds[i + 1].events = POLLIN;
+            if (clients[i].last_request + DAEMON_CLIENT_TIMEOUT_SECS < idle_deadline) {
+                idle_deadline = clients[i].last_request + DAEMON_CLIENT_TIMEOUT_SECS;
+            }
+        }
+        // Woken after the first idle deadline to disconnect the client. A second
+        // later, as the deadlines are in whole seconds
+        struct timespec timeout = { idle_deadline > now ? idle_deadline - now : 0, 0 };
+        timeout.tv_sec++;
+        if (ppoll(poll_fds, client_count + 1, client_count > 0 ? &timeout : NULL,
+                  &wait_signals) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("rdu: poll");
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        // One request per ready client, so a client sending requests all the
+        // time cannot starve the others. Backwards, as closed clients are
+        // replaced by the last one
+        now = monotonic_seconds();
+        for (size_t i = client_count; i-- > 0;) {
+            bool keep;
+            if (poll_fds[i + 1].revents != 0) {
+                keep = serve_request(&server, clients[i].fd);
+                clients[i].last_request = now;
+            }
+            else {
+                keep = now - clients[i].last_request < DAEMON_CLIENT_TIMEOUT_SECS;
+            }
+            if (!keep) {
+                close(clients[i].fd);
+                clients[i] = clients[--client_count];
+            }
+        }
+        if (poll_fds[0].revents & POLLIN) {
+            accept_client(listen_fd, clients, &client_count);
+        }
+    }
+    for (size_t i = 0; i < client_count; i++) {
+        close(clients[i].fd);
+    }
+    pthread_sigmask(SIG_SETMASK, &wait_signals, NULL);
+
+    pthread_mutex_lock(&server.refresh_mutex);
+    __atomic_store_n(&server.stopping, true, __ATOMIC_RELAXED);
+    pthread_cond_signal(&server.refresh_cond);
+    pthread_mutex_unlock(&server.refresh_mutex);
+    if (server.watcher) {
+        watcher_stop(server.watcher);
+    }
+    pthread_join(refresh_thread, NULL);
+    if (server.watcher) {
+        watcher_free(server.watcher);
+    }
+    close(listen_fd);
+    unlink(options->socket_path);
+    daemon_free(&server);
+    return status;
+}
+
+/**
+ * Send the query of the options for every argument to a running
+ * daemon, and print the directories of the answers
+ *
+ * @return exit status of the program
+ */
+int daemon_query(Options* options) {
+    int socket_fd;
+    if (!connect_socket(options->socket_path, &socket_fd)) {
+        return EXIT_FAILURE;
+    }
+    size_t top_count = options->top_count > 0 ? options->top_count : DAEMON_DEFAULT_TOP_COUNT;
+    int status = EXIT_SUCCESS;
+    for (char** file = options->files; *file; file++) {
+        // The daemon looks up absolute paths without symlinks
+        char* path = realpath(*file, NULL);
+        char* request;
+        int request_size;
+        if (strcmp(options->query, "top") == 0) {
+            request_size = asprintf(&request, "top\t%zu\t%s", top_count, path ? path : *file);
+        }
+        else {
+            request_size = asprintf(&request, "%s\t%s", options->query, path ? path : *file);
+        }
+        free(path);
+        if (request_size == -1) {
+            perror_and_exit("asprintf");
+        }
+        size_t response_size;
+        char* response = NULL;
+        if (daemon_write_message(socket_fd, request, request_size)) {
+            response = daemon_read_message(socket_fd, &response_size);
+        }
+        free(request);
+        if (response == NULL) {
+            fprintf(stderr, "rdu: %s: no answer from the daemon\n", options->socket_path);
+            status = EXIT_FAILURE;
+            break;
+        }
+        if (strncmp(response, "ok\n", 3) == 0) {
+            fwrite(response + 3, sizeof(char), response_size - 3, stdout);
+        }
+        else {
+            const char* message = strchr(response, '\t');
+            fprintf(stderr, "rdu: %s", message ? message + 1 : response);
+            status = EXIT_FAILURE;
+        }
+        free(response);
+    }
+    close(socket_fd);
+    return status;
+}
+
+static void request_stop(int signal_number) {
+    (void) signal_number;
+    stop_requested = 1;
+}
+
+static void request_print(int signal_number) {
+    (void) signal_number;
+    print_requested = 1;
+}
+
+// Rescan every tree once per refresh interval, until the daemon stops.
+// With --watch, the events are applied instead
+static void* run_refresh_thread(void* arg_ptr) {
+    Daemon* server = (Daemon*) arg_ptr;
+    if (server->watcher) {
+        watcher_run(server->watcher);
+        return NULL;
+    }
+    pthread_mutex_lock(&server->refresh_mutex);
+    while (!server->stopping) {
+        struct timespec wake_time;
+        clock_gettime(CLOCK_REALTIME, &wake_time);
+        wake_time.tv_sec += server->options->refresh_interval;
+        while (!server->stopping &&
+               pthread_cond_timedwait(&server->refresh_cond, &server->refresh_mutex,
+                                      &wake_time) != ETIMEDOUT) {
+        }
+        pthread_mutex_unlock(&server->refresh_mutex);
+        for (size_t i = 0; i < server->tree_count; i++) {
+            if (__atomic_load_n(&server->stopping, __ATOMIC_RELAXED)) {
+                break;
+            }
+            daemon_refresh(server, i);
+        }
+        pthread_mutex_lock(&server->refresh_mutex);
+    }
+    pthread_mutex_unlock(&server->refresh_mutex);
+    return NULL;
+}
+
+// Answer the next request of a client. A request which is only partly sent
+// blocks until the rest arrives or the client times out.
+// Returns false if the client disconnected or failed
+static bool serve_request(Daemon* server, int client_fd) {
+    size_t request_size;
+    char* request = daemon_read_message(client_fd, &request_size);
+    if (request == NULL) {
+        return false;
+    }
+    size_t response_size;
+    char* response = daemon_answer(server, request, request_size, &response_size);
+    bool written = daemon_write_message(client_fd, response, response_size);
+    free(response);
+    free(request);
+    return written;
+}
+
+// Accept a waiting client into the served clients, if one is still waiting
+static void accept_client(int listen_fd, DaemonClient* clients, size_t* client_count) {
+    // The socket does not block, in case the client is gone again
+    int client_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (client_fd == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED &&
+            errno != EINTR) {
+            perror("rdu: accept");
+        }
+        return;
+    }
+    struct timeval timeout = { DAEMON_CLIENT_TIMEOUT_SECS, 0 };
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    clients[*client_count].fd = client_fd;
+    clients[*client_count].last_request = monotonic_seconds();
+    (*client_count)++;
+}
+
+// Seconds of a clock which does not jump with the time of day
+static time_t monotonic_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+// Listen on a Unix socket, replacing the socket of a previous daemon
+static bool bind_socket(const char* path, int* listen_fd) {
+    struct sockaddr_un address = { 0 };
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "rdu: %s: socket path is too long\n", path);
+        return false;
+    }
+    strcpy(address.sun_path, path);
+    struct stat st_info;
+    if (lstat(path, &st_info) == 0 && S_ISSOCK(st_info.st_mode)) {
+        unlink(path);
+    }
+    // Accepted sockets do not inherit SOCK_NONBLOCK, the clients are read blocking
+    *listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (*listen_fd == -1 ||
+        bind(*listen_fd, (struct sockaddr*) &address, sizeof(address)) == -1 ||
+        listen(*listen_fd, SOMAXCONN) == -1) {
+        perror(path);
+        if (*listen_fd != -1) {
+            close(*listen_fd);
+        }
+        return false;
+    }
+    return true;
+}
+
+// Connect to the Unix socket of a daemon
+static bool connect_socket(const char* path, int* socket_fd) {
+    struct sockaddr_un address = { 0 };
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "rdu: %s: socket path is too long\n", path);
+        return false;
+    }
+    strcpy(address.sun_path, path);
+    *socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (*socket_fd == -1 ||
+        connect(*socket_fd, (struct sockaddr*) &address, sizeof(address)) == -1) {
+        perror(path);
+        if (*socket_fd != -1) {
+            close(*socket_fd);
+        }
+        return false;
+    }
+    return true;
+}
+
+// Find the node of an absolute path. Nested arguments are scanned on their own,
+// so the deepest argument containing the path is used
+static FileNode* find_node(Daemon* server, const char* path, DaemonTree** found_tree) {
+    DaemonTree* tree = NULL;
+    size_t tree_path_length = 0;
+    for (size_t i = 0; i < server->tree_count; i++) {
+        DaemonTree* candidate = &server->trees[i];
+        size_t length = strlen(candidate->path);
+        bool contains = strncmp(path, candidate->path, length) == 0 &&
+                        (path[length] == '\0' || path[length] == '/' || length == 1);
+        if (candidate->node && contains && (tree == NULL || length > tree_path_length)) {
+            tree = candidate;
+            tree_path_length = length;
+        }
+    }
+    if (tree == NULL) {
+        return NULL;
+    }
+
+    FileNode* node = tree->node;
+    const char* remaining = path + tree_path_length;
+    char name[sizeof(node->name)];
+    while (node) {
+        remaining += strspn(remaining, "/");
+        size_t name_length = strcspn(remaining, "/");
+        if (name_length == 0) {
+            break;
+        }
+        if (name_length >= sizeof(name)) {
+            return NULL;
+        }
+        memcpy(name, remaining, name_length);
+        name[name_length] = '\0';
+        node = file_node_find_child(node, name);
+        remaining += name_length;
+    }
+    *found_tree = tree;
+    return node;
+}
+
+// Walk every node below subtree_root in depth-first order, NULL after the last
+static FileNode* next_in_subtree(FileNode* node, FileNode* subtree_root) {
+    if (node->first_child) {
+        return node->first_child;
+    }
+    while (node != subtree_root) {
+        if (node->next_sibling) {
+            return node->next_sibling;
+        }
+        node = node->parent;
+    }
+    return NULL;
+}
+
+// Print the line of a directory in a response
+static void print_node(FILE* out, FileNode* node, DaemonTree* tree, char** path_buffer,
+                       size_t* path_buffer_size) {
+    file_node_get_path(node, tree->path, path_buffer, path_buffer_size);
+    fprintf(out, "%zu\t%zu\t%zu\t%s\n", node->complete_size, node->complete_apparent_size,
+            node->complete_entry_count, *path_buffer);
+}
+
+// Print the directories in a directory, largest first
+static void print_children(FILE* out, FileNode* node, DaemonTree* tree) {
+    size_t child_count = 0;
+    for (FileNode* child = node->first_child; child; child = child->next_sibling) {
+        child_count++;
+    }
+    FileNode** children = checked_malloc(child_count + 1, sizeof(FileNode*));
+    child_count = 0;
+    for (FileNode* child = node->first_child; child; child = child->next_sibling) {
+        children[child_count++] = child;
+    }
+    qsort(children, child_count, sizeof(FileNode*), compare_sizes_descending);
+    char* path_buffer = NULL;
+    size_t path_buffer_size = 0;
+    for (size_t i = 0; i < child_count; i++) {
+        print_node(out, children[i], tree, &path_buffer, &path_buffer_size);
+    }
+    free(path_buffer);
+    free(children);
+}
+
+// Print the largest directories below a directory, largest first
+static void print_top(FILE* out, FileNode* node, DaemonTree* tree, size_t count) {
+    TopHeap heap = top_heap_new(count, TOP_KEY_SIZE);
+    char* path_buffer = NULL;
+    size_t path_buffer_size = 0;
+    for (FileNode* current = next_in_subtree(node, node); current;
+         current = next_in_subtree(current, node)) {
+        if (!top_heap_accepts(&heap, current->complete_size)) {
+            continue;
+        }
+        OutputRecord record = { 0 };
+        record.path_length = file_node_get_path(current, tree->path, &path_buffer,
+                                                &path_buffer_size);
+        record.path = path_buffer;
+        record.is_dir = true;
+        record.size = current->complete_size;
+        record.apparent_size = current->complete_apparent_size;
+        record.entry_count = current->complete_entry_count;
+        top_heap_push(&heap, &record);
+    }
+    top_heap_sort(&heap);
+    for (size_t i = 0; i < heap.size; i++) {
+        fprintf(out, "%zu\t%zu\t%zu\t%s\n", heap.records[i].size,
+                heap.records[i].apparent_size, heap.records[i].entry_count,
+                heap.records[i].path);
+    }
+    free(path_buffer);
+    top_heap_free(&heap);
+}
+
+// Order nodes by their size, largest first, with the name as a tiebreaker
+static int compare_sizes_descending(const void* a, const void* b) {
+    FileNode* node_a = *(FileNode**) a;
+    FileNode* node_b = *(FileNode**) b;
+    if (node_a->complete_size != node_b->complete_size) {
+        return node_a->complete_size < node_b->complete_size ? 1 : -1;
+    }
+    return strcmp(node_a->name, node_b->name);
+}
+
+// Read exactly size bytes, false at the end of the connection or on errors
+static bool read_all(int fd, void* data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t result = read(fd, (char*) data + done, size - done);
+        if (result == 0 || (result == -1 && errno != EINTR)) {
+            return false;
+        }
+        if (result > 0) {
+            done += result;
+        }
+    }
+    return true;
+}
+
+// Write every byte, without SIGPIPE if the client disconnected
+static bool write_all(int fd, const void* data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t result = send(fd, (const char*) data + done, size - done, MSG_NOSIGNAL);
+        if (result == -1 && errno != EINTR) {
+            return false;
+        }
+        if (result > 0) {
+            done += result;
+        }
+    }
+    return true;
+}
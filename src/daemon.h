@@ -0,0 +1,177 @@
+/**
+ * Resident mode for --daemon, which keeps the scanned trees of the
+ * arguments in memory and answers queries about them over a Unix
+ * socket, and the --query client. The trees are rescanned in the
+ * background on a schedule and swapped in once complete.
+ *
+ * Every message is a 4 byte length in network byte order followed by
+ * that many bytes. Requests are tab separated fields:
+ *      size PATH           totals of PATH
+ *      children PATH       totals of the directories in PATH, largest first
+ *      top N PATH          the N largest directories below PATH, largest first
+ * A response is "ok" or "error" with a message on the first line. After
+ * "ok" follows one line per directory: size, apparent size, entry count
+ * and path, tab separated. Sizes are in bytes
+ *
+ * @file daemon.h
+ * @author William Sandström
+ */
+#pragma once
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "file_node.h"
+#include "util/helpers.h"
+
+// Socket of --daemon and --query in $XDG_RUNTIME_DIR if --socket is not given,
+// a directory only its user can access
+#define DAEMON_SOCKET_NAME "rdu.sock"
+// Socket if --socket is not given and XDG_RUNTIME_DIR is not set, only root can create it
+#define DAEMON_FALLBACK_SOCKET "/run/rdu.sock"
+// Seconds between two rescans of every tree if --refresh is not given
+#define DAEMON_DEFAULT_REFRESH 300
+// Directories answered by a top query without a count
+#define DAEMON_DEFAULT_TOP_COUNT 10
+// Larger messages are rejected, and the connection is closed
+#define DAEMON_MAX_MESSAGE_SIZE (16 * 1024 * 1024)
+// A client which does not send a request for this long is disconnected
+#define DAEMON_CLIENT_TIMEOUT_SECS 5
+// Connections served at once, more clients wait to be accepted
+#define DAEMON_MAX_CLIENTS 64
+
+typedef struct Options Options;
+typedef struct Watcher Watcher;
+typedef struct DaemonTree DaemonTree;
+typedef struct Daemon Daemon;
+typedef struct DaemonClient DaemonClient;
+
+// The scanned tree of one argument
+struct DaemonTree {
+    char* path; // Absolute path of the argument, the queries are looked up by it
+    FileNode* node; // Tree of the argument without a parent, NULL if it could not be scanned
+};
+
+struct Daemon {
+    Options* options; // Options of every scan
+    DaemonTree* trees;
+    size_t tree_count;
+    pthread_rwlock_t lock; // Queries read the trees, a finished rescan swaps one
+    pthread_mutex_t refresh_mutex;
+    pthread_cond_t refresh_cond; // Wakes the refresh thread early to stop it
+    bool stopping;
+    Watcher* watcher; // Keeps the trees up to date with --watch, NULL otherwise
+};
+
+// Connection of a client, answered one request at a time between the other clients
+struct DaemonClient {
+    int fd;
+    time_t last_request; // Monotonic seconds of the last request, or of the connection
+};
+
+/**
+ * Resolve the arguments and scan each of them once
+ *
+ * @param server daemon to initialize
+ * @param options options with the arguments to keep
+ * @return false if none of the arguments could be resolved
+ */
+bool daemon_init(Daemon* server, Options* options);
+
+/**
+ * Free the trees of the daemon
+ */
+void daemon_free(Daemon* server);
+
+/**
+ * Scan a directory into a tree of its own
+ *
+ * @param options options of the scan
+ * @param path path of the directory
+ * @return the root of the tree without a parent, NULL if it could not be scanned
+ */
+FileNode* daemon_scan_tree(Options* options, char* path);
+
+/**
+ * Rescan the tree of one argument, and swap it in once it is complete.
+ * Queries are answered from the previous tree during the scan
+ *
+ * @param server daemon of the tree
+ * @param index index of the tree in server->trees
+ */
+void daemon_refresh(Daemon* server, size_t index);
+
+/**
+ * Answer a request from the trees of the daemon
+ *
+ * @param server daemon to answer from
+ * @param request request message, not NUL terminated
+ * @param request_size size of the request
+ * @param response_size set to the size of the response
+ * @return the response message, freed by the caller
+ */
+char* daemon_answer(Daemon* server, const char* request, size_t request_size,
+                    size_t* response_size);
+
+/**
+ * Print the totals of every argument to stdout, in the format of the options
+ */
+void daemon_print_totals(Daemon* server);
+
+/**
+ * Write a length-prefixed message
+ *
+ * @return false if the message could not be written
+ */
+bool daemon_write_message(int fd, const char* data, size_t size);
+
+/**
+ * Read a length-prefixed message
+ *
+ * @param fd socket to read from
+ * @param size set to the size of the message
+ * @return the message with a NUL added after it, NULL at the end of the
+ * connection, on errors or if it is larger than DAEMON_MAX_MESSAGE_SIZE
+ */
+char* daemon_read_message(int fd, size_t* size);
+
+/**
+ * Socket of --daemon and --query if --socket is not given, in XDG_RUNTIME_DIR
+ * if it is set, otherwise DAEMON_FALLBACK_SOCKET
+ *
+ * @return the allocated path
+ */
+char* daemon_default_socket_path();
+
+/**
+ * Scan the arguments and answer queries on the socket of the options
+ * until SIGINT or SIGTERM. The trees are rescanned every refresh interval,
+ * or kept up to date with --watch. SIGUSR1 prints the totals
+ *
+ * @return exit status of the program
+ */
+int daemon_run(Options* options);
+
+/**
+ * Send the query of the options for every argument to a running
+ * daemon, and print the directories of the answers
+ *
+ * @return exit status of the program
+ */
+int daemon_query(Options* options);
@@ -0,0 +1,188 @@
+/**
+ * Directory entries read with getdents64, and batches of every
+ * entry of a directory sorted by inode number. Stat calls in inode
+ * order read the inode tables sequentially, instead of seeking for
+ * every entry on spinning disks and cold caches
+ *
+ * @file dirent_batch.c
+ * @author William Sandström
+ */
+#include "dirent_batch.h"
+
+static long read_all_entries(DirentBatch* batch, int dir_fd);
+static size_t sort_entries(DirentBatch* batch, size_t size);
+static int compare_inodes(const void* a, const void* b);
+
+/**
+ * Create a new batch without any allocations
+ */
+DirentBatch dirent_batch_new() {
+    DirentBatch batch = { 0 };
+    return batch;
+}
+
+/**
+ * Free the buffers of a batch
+ */
+void dirent_batch_free(DirentBatch* batch) {
+    free(batch->buffer);
+    free(batch->sorted);
+    free(batch->entries);
+    *batch = dirent_batch_new();
+}
+
+/**
+ * Read every entry of a directory, sorted by inode number.
+ * Like getdents64 the entries are returned in chunks until 0 is returned,
+ * but the first chunk is the whole directory
+ *
+ * @param batch batch of the calling thread
+ * @param dir_fd directory to read
+ * @param entries set to the sorted entries, valid until the next read
+ *
+ * @return size of the entries in bytes, 0 at the end of the directory or -1 on error
+ */
+long dirent_batch_read_sorted(DirentBatch* batch, int dir_fd, char** entries) {
+    if (batch->returned) {
+        batch->returned = false;
+        return 0;
+    }
+    long size = read_all_entries(batch, dir_fd);
+    if (size == -1) {
+        return -1;
+    }
+    size_t entry_count = sort_entries(batch, size);
+
+    // Copied in order, so that the entries are walked like a getdents64 buffer
+    if (batch->sorted_capacity < (size_t) size) {
+        batch->sorted_capacity = batch->capacity;
+        free(batch->sorted);
+        batch->sorted = checked_malloc(batch->sorted_capacity, sizeof(char));
+    }
+    size_t sorted_size = 0;
+    for (size_t i = 0; i < entry_count; i++) {
+        memcpy(batch->sorted + sorted_size, batch->entries[i], batch->entries[i]->d_reclen);
+        sorted_size += batch->entries[i]->d_reclen;
+    }
+    batch->returned = true;
+    *entries = batch->sorted;
+    return size;
+}
+
+/**
+ * Read every entry of a directory and stat them in inode order, which
+ * loads their inodes into the cache, but return them in getdents64 order.
+ * The stat calls of the caller are then cache hits, for output which has
+ * to keep the order of du. Chunked like dirent_batch_read_sorted
+ *
+ * @param batch batch of the calling thread
+ * @param dir_fd directory to read
+ * @param entries set to the entries in getdents64 order, valid until the next read
+ *
+ * @return size of the entries in bytes, 0 at the end of the directory or -1 on error
+ */
+long dirent_batch_read_prefetched(DirentBatch* batch, int dir_fd, char** entries) {
+    if (batch->returned) {
+        batch->returned = false;
+        return 0;
+    }
+    long size = read_all_entries(batch, dir_fd);
+    if (size == -1) {
+        return -1;
+    }
+    size_t entry_count = sort_entries(batch, size);
+    struct stat st_info;
+    for (size_t i = 0; i < entry_count; i++) {
+        // Errors are found again by the stat of the caller
+        fstatat(dir_fd, batch->entries[i]->d_name, &st_info, AT_SYMLINK_NOFOLLOW);
+    }
+    batch->returned = true;
+    *entries = batch->buffer;
+    return size;
+}
+
+/**
+ * Create a new buffer without any allocations
+ */
+DirentBuffer dirent_buffer_new() {
+    DirentBuffer buffer = { 0 };
+    return buffer;
+}
+
+/**
+ * Free the memory of a buffer
+ */
+void dirent_buffer_free(DirentBuffer* buffer) {
+    free(buffer->data);
+    *buffer = dirent_buffer_new();
+}
+
+/**
+ * Read the next entries of a directory with getdents64. If the entries
+ * fill the buffer, it is grown for the next read, up to DIRENT_BUFFER_MAX_SIZE
+ *
+ * @param buffer buffer of the calling thread
+ * @param dir_fd directory to read
+ * @param entries set to the entries, valid until the next read
+ *
+ * @return size of the entries in bytes, 0 at the end of the directory or -1 on error
+ */
+long dirent_buffer_read(DirentBuffer* buffer, int dir_fd, char** entries) {
+    if (buffer->data == NULL || buffer->filled) {
+        buffer->capacity = buffer->data ? buffer->capacity * 2 : DIRENT_BUFFER_MIN_SIZE;
+        // The entries of the previous read are no longer used, so they are not copied
+        free(buffer->data);
+        buffer->data = checked_malloc(buffer->capacity, sizeof(char));
+        buffer->filled = false;
+    }
+    long nread = syscall(SYS_getdents64, dir_fd, buffer->data, buffer->capacity);
+    *entries = buffer->data;
+    // The next entry might not have fit, so the directory is larger than the buffer
+    buffer->filled = nread > 0 && buffer->capacity < DIRENT_BUFFER_MAX_SIZE &&
+                     (size_t) nread + sizeof(ldirent) + NAME_MAX + 1 > buffer->capacity;
+    return nread;
+}
+
+// Read the whole directory into the buffer of the batch, returns its size or -1
+static long read_all_entries(DirentBatch* batch, int dir_fd) {
+    size_t size = 0;
+    long nread;
+    do {
+        if (batch->capacity - size < DIRENT_BATCH_READ_SIZE) {
+            batch->capacity = batch->capacity * 2 + DIRENT_BATCH_READ_SIZE;
+            batch->buffer = checked_realloc(batch->buffer, batch->capacity, sizeof(char));
+        }
+        nread = syscall(SYS_getdents64, dir_fd, batch->buffer + size,
+                        batch->capacity - size);
+        if (nread == -1) {
+            return -1;
+        }
+        size += nread;
+    } while (nread > 0);
+    return size;
+}
+
+// Point the entries of the batch at the entries of the buffer, sorted by
+// inode number. Returns the amount of entries
+static size_t sort_entries(DirentBatch* batch, size_t size) {
+    size_t entry_count = 0;
+    for (size_t bpos = 0; bpos < size; entry_count++) {
+        if (entry_count == batch->entries_capacity) {
+            batch->entries_capacity = batch->entries_capacity * 2 + 64;
+            batch->entries = checked_realloc(batch->entries, batch->entries_capacity,
+                                             sizeof(ldirent*));
+        }
+        ldirent* dir_entry = (ldirent*) (batch->buffer + bpos);
+        batch->entries[entry_count] = dir_entry;
+        bpos += dir_entry->d_reclen;
+    }
+    qsort(batch->entries, entry_count, sizeof(ldirent*), compare_inodes);
+    return entry_count;
+}
+
+// Order directory entries by ascending inode number
+static int compare_inodes(const void* a, const void* b) {
+    unsigned long inode_a = (*(ldirent**) a)->d_ino;
+    unsigned long inode_b = (*(ldirent**) b)->d_ino;
+    return (inode_a > inode_b) - (inode_a < inode_b);
+}
@@ -0,0 +1,135 @@
+/**
+ * Directory entries read with getdents64, and batches of every
+ * entry of a directory sorted by inode number. Stat calls in inode
+ * order read the inode tables sequentially, instead of seeking for
+ * every entry on spinning disks and cold caches
+ *
+ * @file dirent_batch.h
+ * @author William Sandström
+ */
+#pragma once
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "util/helpers.h"
+
+// Space kept free in the batch buffer for every getdents64 call
+#define DIRENT_BATCH_READ_SIZE 32768
+// Size of the getdents64 buffer of every thread. It starts small and is
+// doubled while directories keep filling it, so wide directories take fewer calls
+#ifndef DIRENT_BUFFER_MIN_SIZE
+    #define DIRENT_BUFFER_MIN_SIZE 32768
+#endif
+#ifndef DIRENT_BUFFER_MAX_SIZE
+    #define DIRENT_BUFFER_MAX_SIZE 1048576
+#endif
+
+struct linux_dirent64 {
+    unsigned long d_ino; /* 64-bit inode number */
+    long d_off; /* 64-bit offset to next structure */
+    unsigned short d_reclen; /* Size of this dirent */
+    unsigned char d_type; /* File type */
+    char d_name[]; /* Filename (null-terminated) */
+};
+
+typedef struct linux_dirent64 ldirent;
+
+// When the entries of a directory are stat:ed in inode order, for --inode-order
+enum InodeOrder {
+    INODE_ORDER_AUTO, // On spinning disks only
+    INODE_ORDER_ALWAYS,
+    INODE_ORDER_NEVER,
+};
+
+typedef enum InodeOrder InodeOrder;
+
+// The buffers are reused between directories, one batch per thread
+struct DirentBatch {
+    char* buffer; // Every entry of the directory, in getdents64 order
+    size_t capacity;
+    char* sorted; // The same entries, sorted by inode number
+    size_t sorted_capacity;
+    ldirent** entries; // Entries of buffer, sorted by inode number
+    size_t entries_capacity;
+    bool returned; // The entries of the directory were returned, the next read is the end
+};
+
+typedef struct DirentBatch DirentBatch;
+
+// A getdents64 buffer reused between directories, one per thread
+struct DirentBuffer {
+    char* data;
+    size_t capacity;
+    bool filled; // The last read filled the buffer, it is doubled for the next read
+};
+
+typedef struct DirentBuffer DirentBuffer;
+
+/**
+ * Create a new batch without any allocations
+ */
+DirentBatch dirent_batch_new();
+
+/**
+ * Free the buffers of a batch
+ */
+void dirent_batch_free(DirentBatch* batch);
+
+/**
+ * Read every entry of a directory, sorted by inode number.
+ * Like getdents64 the entries are returned in chunks until 0 is returned,
+ * but the first chunk is the whole directory
+ *
+ * @param batch batch of the calling thread
+ * @param dir_fd directory to read
+ * @param entries set to the sorted entries, valid until the next read
+ *
+ * @return size of the entries in bytes, 0 at the end of the directory or -1 on error
+ */
+long dirent_batch_read_sorted(DirentBatch* batch, int dir_fd, char** entries);
+
+/**
+ * Read every entry of a directory and stat them in inode order, which
+ * loads their inodes into the cache, but return them in getdents64 order.
+ * The stat calls of the caller are then cache hits, for output which has
+ * to keep the order of du. Chunked like dirent_batch_read_sorted
+ *
+ * @param batch batch of the calling thread
+ * @param dir_fd directory to read
+ * @param entries set to the entries in getdents64 order, valid until the next read
+ *
+ * @return size of the entries in bytes, 0 at the end of the directory or -1 on error
+ */
+long dirent_batch_read_prefetched(DirentBatch* batch, int dir_fd, char** entries);
+
+/**
+ * Create a new buffer without any allocations
+ */
+DirentBuffer dirent_buffer_new();
+
+/**
+ * Free the memory of a buffer
+ */
+void dirent_buffer_free(DirentBuffer* buffer);
+
+/**
+ * Read the next entries of a directory with getdents64. If the entries
+ * fill the buffer, it is grown for the next read, up to DIRENT_BUFFER_MAX_SIZE
+ *
+ * @param buffer buffer of the calling thread
+ * @param dir_fd directory to read
+ * @param entries set to the entries, valid until the next read
+ *
+ * @return size of the entries in bytes, 0 at the end of the directory or -1 on error
+ */
+long dirent_buffer_read(DirentBuffer* buffer, int dir_fd, char** entries);
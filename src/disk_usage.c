@@ -8,6 +8,52 @@
  */
 #include "disk_usage.h"
 
+static void file_node_init_from_stat(FileNode* node, struct stat* st_info);
+static void file_node_init_entry(FileNode* node, Options* options, struct stat* st_info,
+                                 bool counted);
+static inline bool matches_age_filter(Options* options, time_t modification_time);
+static size_t age_bucket(Options* options, time_t modification_time);
+static bool can_skip_stat(Options* options);
+static inline void add_allocation_gap(size_t allocated, size_t apparent,
+                                      size_t* sparse_size, size_t* slack_size);
+static void stat_from_dirent(struct stat* st_info, ldirent* dir_entry);
+static TopHeapKey top_heap_key_from_options(Options* options);
+static bool prints_entries(Options* options);
+static void owner_maps_add(Options* options, OwnerMap* user_map, OwnerMap* group_map,
+                           struct stat* st_info);
+static void ext_map_add_file(ThreadArgs* thread_args, const char* name, size_t size,
+                             size_t apparent_size);
+static void print_owner_summaries(Options* options, OutputBuffer* buffer, OwnerMap* map,
+                                  bool is_group);
+static void print_ext_summaries(Options* options, OutputBuffer* buffer, ExtMap* map);
+static void print_summaries(Options* options, OutputBuffer* buffer,
+                            OutputSummaryRecord* records, size_t count);
+static void print_estimate(Options* options, OutputBuffer* buffer, FileNode* node,
+                           ScanRoot* root);
+static double estimate_value(Options* options, FileNode* node);
+static size_t inclusion_factor(FileNode* node);
+static bool scan_stopped(ThreadArgs* thread_args);
+static void report_scan_error(Options* options, const char* path, int error);
+static void skip_disk_usage_task(StackEntry task, ThreadArgs* thread_args);
+static void set_uncached_priorities(StackEntry task, Stack* new_tasks, size_t first_new_task,
+                                    size_t known_entry_count, size_t uncached_dir_count);
+static long read_dir_entries(int dir_fd, DirentBatch* dirent_batch, DirentBuffer* buffer,
+                             bool keep_order, char** entries);
+static bool is_excluded_dir(ScanRoot* root, int dir_fd, const char* name,
+                            struct stat* st_info);
+static void switch_scan_root(ThreadArgs* thread_args, ScanRoot* root);
+static void enter_thread_limits(ThreadArgs* thread_args);
+static void leave_thread_limits(ThreadArgs* thread_args);
+static DiskUsageTask select_disk_usage_task(ScanRoot* root, Options* options, bool tree);
+static bool scan_arguments(Options options, int output_fd, FileNode** tree,
+                           FileNode** argument_trees);
+static void print_size_histogram(OutputBuffer* buffer, SizeHistogram* histogram,
+                                 const char* path);
+static int compare_summaries_descending(const void* a, const void* b, void* options);
+static bool is_within_print_depth(Options* options, size_t depth);
+static size_t build_file_path(ThreadArgs* thread_args, FileNode* node,
+                              ssize_t* dir_path_length, const char* name);
+
 /**
  * Is this dir a dot directory,
  * ie does it match "." or ".."
@@ -20,6 +66,34 @@ bool is_dot_dir(char* dir) {
             (dir[1] == '.' && dir[2] == '\0'));
 }
 
+// Read the next entries of a directory into entries. With a batch, the
+// whole directory is read at once, sorted by inode, or stat:ed in inode
+// order but kept in getdents64 order with keep_order
+static long read_dir_entries(int dir_fd, DirentBatch* dirent_batch, DirentBuffer* buffer,
+                             bool keep_order, char** entries) {
+    if (dirent_batch && keep_order) {
+        return dirent_batch_read_prefetched(dirent_batch, dir_fd, entries);
+    }
+    if (dirent_batch) {
+        return dirent_batch_read_sorted(dirent_batch, dir_fd, entries);
+    }
+    return dirent_buffer_read(buffer, dir_fd, entries);
+}
+
+// Is the subdirectory the argument of an earlier root, which counts it instead?
+// Stats the directory if st_info is NULL
+static bool is_excluded_dir(ScanRoot* root, int dir_fd, const char* name,
+                            struct stat* st_info) {
+    struct stat dir_info;
+    if (st_info == NULL) {
+        if (fstatat(dir_fd, name, &dir_info, AT_SYMLINK_NOFOLLOW) != 0) {
+            return false;
+        }
+        st_info = &dir_info;
+    }
+    return scan_root_excludes(root, st_info->st_dev, st_info->st_ino);
+}
+
 /**
  * Return the disk usage of a file 
  * Note: This is different from apparent file size
@@ -86,7 +160,7 @@ size_t total_disk_usage_task_st(int dir_fd) {
                                                           &file_is_dir);
                 if (file_is_dir) {
                     int new_dir_fd = openat(dir_fd, dir_entry->d_name,
-                                            O_RDONLY | O_DIRECTORY);
+                                            O_RDONLY | O_DIRECTORY | O_CLOEXEC);
                     if (new_dir_fd == -1) {
                         perror(dir_entry->d_name);
                     }
@@ -107,144 +181,998 @@ size_t total_disk_usage_task_st(int dir_fd) {
 // Every entry in the stack is the directory, then the corresponding file tree node. Add
 // children once encountered
 
-/**
- * Determine the disk usage of the files in directory
- * If a containing file is a directory, add the path to new_tasks
- * Sum up the time spent in the task
- * 
- * @param path path of directory
- * @param new_tasks stack of new files to be checked
- * @param time_spent sum of time of all tasks run on this thread
- * 
- * @return disk usage in bytes
- */
-size_t total_disk_usage_task_time(char* path, Stack* new_tasks, long int* time_spent) {
-    size_t disk_usage_size = 0;
-    StackEntry stack_entry;
-
+// The scan of a directory, written once and compiled into one function per
+// combination of the constant features, so unused features cost nothing per entry.
+// With TASK_TREE the totals are aggregated into the node of the task, which is
+// finalized once its children are
+static inline __attribute__((always_inline)) size_t
+disk_usage_task_kernel(StackEntry task, Stack* new_tasks, size_t* entry_count,
+                       ThreadArgs* thread_args, const unsigned features) {
     struct timespec before, after;
-    clock_gettime(CLOCK_REALTIME, &before);
+    if (features & TASK_TIME) {
+        clock_gettime(CLOCK_REALTIME, &before);
+    }
+    char* path = task.path;
+    FileNode* node = task.node;
+    Options* options = thread_args->options;
+    size_t disk_usage_size = 0;
+    StackEntry stack_entry = { 0 };
+    stack_entry.root = task.root;
 
-    int path_length;
+    size_t path_length = strlen(path);
     bool first_dir = true;
+    // Files are only printed if they are deep enough, the directory path is shared
+    bool files_within_depth = (features & TASK_TREE) &&
+                              is_within_print_depth(options, node->depth + 1);
+    bool print_files = options->show_regular_files && prints_entries(options) &&
+                       files_within_depth;
+    bool rank_files = options->top_count > 0 && options->top_files && files_within_depth;
+    bool skip_stat = (features & TASK_TREE) && can_skip_stat(options);
+    bool match_patterns = (features & TASK_FILTER) &&
+                          !pattern_matcher_is_empty(&options->patterns);
+    VisitorBatch* visitor_batch = (features & TASK_TREE) && thread_args->visitor_batch.visitor ?
+                                      &thread_args->visitor_batch :
+                                      NULL;
+    Gentle* gentle = (features & TASK_TREE) ? thread_args->gentle : NULL;
+    ssize_t dir_path_length = -1;
+    size_t dir_entry_count = 0;
+    // Stat latency of the directory, for --gentle
+    uint64_t stat_nsecs = 0;
+    size_t stat_count = 0;
+    // With --estimate, subdirectories are sampled once the budget is used up.
+    // The children of the argument are always scanned
+    size_t sample_factor = 1;
+    size_t node_inclusion_factor = 1;
+    size_t subdirectory_count = 0;
+    // With a cache, the new subdirectories share what the cached ones leave of the directory
+    size_t first_new_task = new_tasks->size;
+    size_t cached_entry_count = 0;
+    size_t uncached_dir_count = 0;
+    if ((features & TASK_TREE) && options->estimate_budget > 0) {
+        EstimateStrata* strata = &thread_args->scan_root->estimate_strata;
+        __atomic_add_fetch(thread_args->scanned_dirs, 1, __ATOMIC_RELAXED);
+        estimate_strata_add_scanned(strata, node->depth);
+        if (node->depth > 0) {
+            // Like a breadth-first scan, whichever order the threads take
+            size_t scanned_dirs = estimate_strata_scanned(strata, node->depth + 1);
+            node_inclusion_factor = inclusion_factor(node);
+            sample_factor = estimate_subdirectory_factor(
+                estimate_sample_factor(scanned_dirs, options->estimate_budget),
+                node_inclusion_factor);
+        }
+    }
 
-    bool file_is_dir = false;
-    int dir_fd = open(path, O_RDONLY | O_DIRECTORY);
+    int dir_fd = openat(task.root->dir_fd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
     if (dir_fd == -1) {
+        if (features & TASK_TREE) {
+            int error = errno;
+            file_node_get_path(node, thread_args->root_path, &thread_args->path_buffer,
+                               &thread_args->path_buffer_size);
+            report_scan_error(options, thread_args->path_buffer, error);
+            __atomic_store_n(&node->scanned, true, __ATOMIC_RELEASE);
+            file_node_finalize(node, thread_args);
+        }
+        free(path);
         return 0;
     }
     char* new_path;
+    struct stat st_info;
+    // A lone subdirectory has no siblings to stand in for it, so it is always
+    // scanned. File systems without subdirectory link counts report 1
+    if (sample_factor > 1 && fstat(dir_fd, &st_info) == 0 && st_info.st_nlink >= 2 &&
+        st_info.st_nlink <= 3) {
+        sample_factor = 1;
+    }
+    if (visitor_batch) {
+        file_node_get_path(node, thread_args->root_path, &visitor_batch->path,
+                           &visitor_batch->path_size);
+        visitor_batch->depth = node->depth;
+    }
 
-    char dirent_buffer[DIRENT_BUFFER_SIZE];
+    // Sorting by inode only pays off when every entry is stat:ed. The children
+    // of ordered output keep the order of du, so the inodes are only prefetched
+    // in inode order, which --gentle would not throttle
+    bool keep_order = (features & TASK_TREE) && options->ordered_output;
+    DirentBatch* dirent_batch = (features & TASK_INODE_ORDER) && !skip_stat ?
+                                    &thread_args->inode_batch :
+                                    NULL;
+    if (keep_order && gentle) {
+        dirent_batch = NULL;
+    }
+    char* entries;
     long nread;
-    do {
-        nread = syscall(SYS_getdents64, dir_fd, dirent_buffer, DIRENT_BUFFER_SIZE);
+    do { // Instead of using opendir and readdir, we manually get the directory contents using
+        // the getdents syscall, which doesn't perform any unnecessary allocations.
+        nread = read_dir_entries(dir_fd, dirent_batch, &thread_args->dirent_buffer,
+                                 keep_order, &entries);
 
         for (long bpos = 0; bpos < nread;) {
-            ldirent* dir_entry = (ldirent*) (dirent_buffer + bpos);
-            if (!is_dot_dir(dir_entry->d_name)) {
-                disk_usage_size += get_file_disk_usage_fd(dir_fd, dir_entry->d_name,
-                                                          &file_is_dir);
-                if (file_is_dir) {
-                    if (first_dir) {
-                        // Add path to start of path_buffer
-                        path_length = strlen(path);
-                        // Reuse path allocation
-                        new_path = path;
-                        first_dir = false;
+            ldirent* dir_entry = (ldirent*) (entries + bpos);
+            bpos += dir_entry->d_reclen;
+            if (is_dot_dir(dir_entry->d_name)) {
+                continue;
+            }
+            size_t name_length = 0;
+            if (match_patterns) {
+                name_length = strlen(dir_entry->d_name);
+                // Excluded directories are pruned here, before they are opened
+                if (pattern_matcher_excludes(&options->patterns, dir_entry->d_name,
+                                             name_length)) {
+                    continue;
+                }
+            }
+            bool from_dirent = skip_stat && dir_entry->d_type != DT_UNKNOWN;
+            if (from_dirent) {
+                stat_from_dirent(&st_info, dir_entry);
+            }
+            else {
+                uint64_t stat_start = 0;
+                if (gentle) {
+                    gentle_wait_for_op(gentle);
+                    stat_start = gentle_now();
+                }
+                int stat_result = fstatat(dir_fd, dir_entry->d_name, &st_info,
+                                          AT_SYMLINK_NOFOLLOW);
+                if (gentle) {
+                    stat_nsecs += gentle_now() - stat_start;
+                    stat_count++;
+                }
+                if (stat_result != 0) {
+                    if (features & TASK_TREE) {
+                        int error = errno;
+                        build_file_path(thread_args, node, &dir_path_length,
+                                        dir_entry->d_name);
+                        report_scan_error(options, thread_args->path_buffer, error);
                     }
                     else {
-                        new_path = malloc(512);
-                        memcpy(new_path, path, path_length);
+                        perror(dir_entry->d_name);
+                    }
+                    continue;
+                }
+            }
+            // The device is not known without stat
+            if ((features & TASK_EXCLUDES) && S_ISDIR(st_info.st_mode) &&
+                is_excluded_dir(task.root, dir_fd, dir_entry->d_name,
+                                from_dirent ? NULL : &st_info)) {
+                continue;
+            }
+            dir_entry_count++;
+            disk_usage_size += st_info.st_blocks * ST_NBLOCKSIZE;
+            // Include patterns only select files, like for the argument itself
+            bool counted = !(features & TASK_FILTER) ||
+                           (matches_age_filter(options, st_info.st_mtime) &&
+                            (!match_patterns || S_ISDIR(st_info.st_mode) ||
+                             pattern_matcher_includes(&options->patterns, dir_entry->d_name,
+                                                      name_length)));
+            if ((features & TASK_TREE) && counted) {
+                owner_maps_add(options, &thread_args->user_map, &thread_args->group_map,
+                               &st_info);
+            }
+            if (visitor_batch) {
+                visitor_batch_add(visitor_batch, dir_entry->d_name, dir_entry->d_type,
+                                  &st_info, counted);
+            }
+            if (S_ISDIR(st_info.st_mode)) {
+                FileNode* child = NULL;
+                if (features & TASK_TREE) {
+                    subdirectory_count++;
+                    if (sample_factor > 1 &&
+                        estimate_random_below(&thread_args->random_state, sample_factor) !=
+                            0) {
+                        // Skipped, the sampled siblings are scaled up to cover it
+                        continue;
+                    }
+                    child = file_tree_add_child(node);
+                    file_node_set_name(child, dir_entry->d_name);
+                    file_node_init_entry(child, options, &st_info, counted);
+                    child->depth = node->depth + 1;
+                    child->sample_factor = sample_factor;
+                    // The child tasks are only published once this task is done,
+                    // so the counter does not need to be atomic here
+                    node->pending_children++;
+                }
+
+                // The slash, the name and the terminator
+                size_t new_path_size = path_length + strlen(dir_entry->d_name) + 2;
+                if (first_dir) {
+                    // Reuse path allocation, only its first path_length bytes are read after
+                    path = checked_realloc(path, new_path_size, sizeof(char));
+                    new_path = path;
+                    first_dir = false;
+                }
+                else {
+                    new_path = checked_malloc(new_path_size, sizeof(char));
+                    memcpy(new_path, path, path_length);
+                }
+                new_path[path_length] = '/';
+                strcpy(new_path + path_length + 1, dir_entry->d_name);
+                stack_entry.path = new_path;
+                stack_entry.node = child;
+                // Large subtrees of the previous scan are started first.
+                // New directories get their priority once the directory is read
+                stack_entry.cache_node = NULL;
+                stack_entry.priority = 0;
+                if ((features & TASK_TREE) && thread_args->use_cache) {
+                    if (task.cache_node) {
+                        stack_entry.cache_node = cache_index_find_child(
+                            &thread_args->cache_index, task.cache_node, dir_entry->d_name);
+                    }
+                    if (stack_entry.cache_node) {
+                        stack_entry.priority = stack_entry.cache_node->complete_entry_count;
+                        cached_entry_count += stack_entry.priority;
+                    }
+                    else {
+                        uncached_dir_count++;
+                    }
+                }
+                stack_push(new_tasks, stack_entry);
+                if (keep_order) {
+                    // Files listed before the child are printed before its subtree
+                    output_buffer_move_to(&thread_args->output_buffer,
+                                          &child->preceding_output,
+                                          &child->preceding_output_size);
+                }
+            }
+            else if ((features & TASK_TREE) && counted) {
+                size_t file_size = st_info.st_blocks * ST_NBLOCKSIZE;
+                size_t sparse_size = 0;
+                size_t slack_size = 0;
+                if (S_ISREG(st_info.st_mode)) {
+                    add_allocation_gap(file_size, st_info.st_size, &sparse_size,
+                                       &slack_size);
+                }
+                node->complete_size += file_size;
+                node->complete_apparent_size += st_info.st_size;
+                node->complete_sparse_size += sparse_size;
+                node->complete_slack_size += slack_size;
+                node->complete_entry_count++;
+                if (options->by_ext) {
+                    ext_map_add_file(thread_args, dir_entry->d_name, file_size,
+                                     st_info.st_size);
+                }
+                if (options->size_histogram && S_ISREG(st_info.st_mode)) {
+                    size_histogram_add(&thread_args->size_histogram, file_size,
+                                       st_info.st_size);
+                }
+                if (st_info.st_mtime > node->last_modification_time) {
+                    node->last_modification_time = st_info.st_mtime;
+                }
+                size_t age_sizes[AGE_BUCKET_COUNT] = { 0 };
+                if (options->age_histogram) {
+                    size_t bucket = age_bucket(options, st_info.st_mtime);
+                    age_sizes[bucket] = options->apparent_size ? (size_t) st_info.st_size :
+                                                                 file_size;
+                    node->complete_age_sizes[bucket] += age_sizes[bucket];
+                }
+                if (print_files || rank_files) {
+                    OutputRecord record = { 0 };
+                    record.is_dir = false;
+                    record.size = file_size;
+                    record.apparent_size = st_info.st_size;
+                    record.sparse_size = sparse_size;
+                    record.slack_size = slack_size;
+                    record.entry_count = 1;
+                    record.depth = node->depth + 1;
+                    record.modification_time = st_info.st_mtime;
+                    record.age_sizes = age_sizes;
+                    bool rank_file = rank_files &&
+                                     top_heap_accepts(&thread_args->top_heap,
+                                                      top_heap_key(&thread_args->top_heap,
+                                                                   &record));
+                    if (!print_files && !rank_file) {
+                        continue;
+                    }
+                    // The path is only built for entries which are used
+                    record.path_length = build_file_path(thread_args, node,
+                                                         &dir_path_length,
+                                                         dir_entry->d_name);
+                    record.path = thread_args->path_buffer;
+                    if (rank_file) {
+                        top_heap_push(&thread_args->top_heap, &record);
+                    }
+                    if (print_files) {
+                        output_buffer_add_record(&thread_args->output_buffer, &record);
                     }
-                    new_path[path_length] = '/';
-                    strcpy(new_path + path_length + 1, dir_entry->d_name);
-                    stack_entry.path = new_path;
-                    stack_push(new_tasks, stack_entry);
                 }
             }
-            bpos += dir_entry->d_reclen;
+        }
+        // The names are only valid until the next read
+        if (visitor_batch) {
+            visitor_batch_flush(visitor_batch);
         }
     } while (nread > 0);
 
     close(dir_fd);
+    *entry_count += dir_entry_count;
+    if (gentle) {
+        gentle_add_latency(gentle, stat_nsecs, stat_count, gentle_now());
+    }
 
     if (first_dir) { // Found no directories, free path
         free(path);
     }
 
-    clock_gettime(CLOCK_REALTIME, &after);
+    if (features & TASK_TREE) {
+        if (uncached_dir_count > 0) {
+            set_uncached_priorities(task, new_tasks, first_new_task,
+                                    cached_entry_count + dir_entry_count, uncached_dir_count);
+        }
+        if (sample_factor > 1 && subdirectory_count > 0) {
+            estimate_strata_add_sampled(&thread_args->scan_root->estimate_strata,
+                                        node->depth + 1, node_inclusion_factor,
+                                        sample_factor, subdirectory_count);
+        }
+        if (keep_order) {
+            output_buffer_move_to(&thread_args->output_buffer, &node->trailing_output,
+                                  &node->trailing_output_size);
+        }
+        // Let the ordered output writer know that the children are complete
+        __atomic_store_n(&node->scanned, true, __ATOMIC_RELEASE);
 
-    *time_spent += (after.tv_sec - before.tv_sec) * 1000000000 +
-                   (after.tv_nsec - before.tv_nsec);
+        if (node->pending_children == 0) {
+            file_node_finalize(node, thread_args);
+        }
+    }
+
+    if (features & TASK_TIME) {
+        clock_gettime(CLOCK_REALTIME, &after);
+        thread_args->time_spent_in_task += (after.tv_sec - before.tv_sec) * 1000000000 +
+                                           (after.tv_nsec - before.tv_nsec);
+    }
     // Determine actual filesize, not apparant filesize in st_info.st_size
     return disk_usage_size;
 }
 
+#define DEFINE_DISK_USAGE_TASK(features)                                                  \
+    static size_t total_disk_usage_task_##features(StackEntry task, Stack* new_tasks,    \
+                                                   size_t* entry_count,                  \
+                                                   ThreadArgs* thread_args) {            \
+        return disk_usage_task_kernel(task, new_tasks, entry_count, thread_args,         \
+                                      features);                                         \
+    }
+
+DEFINE_DISK_USAGE_TASK(0)
+DEFINE_DISK_USAGE_TASK(1)
+DEFINE_DISK_USAGE_TASK(2)
+DEFINE_DISK_USAGE_TASK(3)
+DEFINE_DISK_USAGE_TASK(4)
+DEFINE_DISK_USAGE_TASK(5)
+DEFINE_DISK_USAGE_TASK(6)
+DEFINE_DISK_USAGE_TASK(7)
+DEFINE_DISK_USAGE_TASK(8)
+DEFINE_DISK_USAGE_TASK(9)
+DEFINE_DISK_USAGE_TASK(10)
+DEFINE_DISK_USAGE_TASK(11)
+DEFINE_DISK_USAGE_TASK(12)
+DEFINE_DISK_USAGE_TASK(13)
+DEFINE_DISK_USAGE_TASK(14)
+DEFINE_DISK_USAGE_TASK(15)
+DEFINE_DISK_USAGE_TASK(16)
+DEFINE_DISK_USAGE_TASK(17)
+DEFINE_DISK_USAGE_TASK(18)
+DEFINE_DISK_USAGE_TASK(19)
+DEFINE_DISK_USAGE_TASK(20)
+DEFINE_DISK_USAGE_TASK(21)
+DEFINE_DISK_USAGE_TASK(22)
+DEFINE_DISK_USAGE_TASK(23)
+DEFINE_DISK_USAGE_TASK(24)
+DEFINE_DISK_USAGE_TASK(25)
+DEFINE_DISK_USAGE_TASK(26)
+DEFINE_DISK_USAGE_TASK(27)
+DEFINE_DISK_USAGE_TASK(28)
+DEFINE_DISK_USAGE_TASK(29)
+DEFINE_DISK_USAGE_TASK(30)
+DEFINE_DISK_USAGE_TASK(31)
+
+// Indexed by the features of the argument and the options
+static const DiskUsageTask disk_usage_tasks[TASK_FEATURE_COMBINATIONS] = {
+    total_disk_usage_task_0,  total_disk_usage_task_1,  total_disk_usage_task_2,
+    total_disk_usage_task_3,  total_disk_usage_task_4,  total_disk_usage_task_5,
+    total_disk_usage_task_6,  total_disk_usage_task_7,  total_disk_usage_task_8,
+    total_disk_usage_task_9,  total_disk_usage_task_10, total_disk_usage_task_11,
+    total_disk_usage_task_12, total_disk_usage_task_13, total_disk_usage_task_14,
+    total_disk_usage_task_15, total_disk_usage_task_16, total_disk_usage_task_17,
+    total_disk_usage_task_18, total_disk_usage_task_19, total_disk_usage_task_20,
+    total_disk_usage_task_21, total_disk_usage_task_22, total_disk_usage_task_23,
+    total_disk_usage_task_24, total_disk_usage_task_25, total_disk_usage_task_26,
+    total_disk_usage_task_27, total_disk_usage_task_28, total_disk_usage_task_29,
+    total_disk_usage_task_30, total_disk_usage_task_31,
+};
+
+// Pick the scan without the features the argument and the options do not use
+static DiskUsageTask select_disk_usage_task(ScanRoot* root, Options* options, bool tree) {
+    unsigned features = 0;
+    if (root->inode_order) {
+        features |= TASK_INODE_ORDER;
+    }
+    if (root->excluded_count > 0) {
+        features |= TASK_EXCLUDES;
+    }
+#ifdef PROFILE_TIME
+    features |= TASK_TIME;
+#endif
+    if (tree) {
+        features |= TASK_TREE;
+    }
+    if (!pattern_matcher_is_empty(&options->patterns) || options->older_than != 0 ||
+        options->newer_than != 0) {
+        features |= TASK_FILTER;
+    }
+    return disk_usage_tasks[features];
+}
+
 /**
  * Determine the disk usage of the files in directory
  * If a containing file is a directory, add the path to new_tasks
  * 
- * @param path path of directory
+ * @param task path of directory relative to its argument, and the argument
  * @param new_tasks stack of new files to be checked
+ * @param entry_count incremented for every entry in the directory
+ * @param thread_args arguments of the running thread, with its buffers
  * 
  * @return disk usage in bytes
  */
-size_t total_disk_usage_task(char* path, Stack* new_tasks) {
-    size_t disk_usage_size = 0;
-    StackEntry stack_entry;
+size_t total_disk_usage_task(StackEntry task, Stack* new_tasks, size_t* entry_count,
+                             ThreadArgs* thread_args) {
+    return select_disk_usage_task(task.root, thread_args->options, false)(
+        task, new_tasks, entry_count, thread_args);
+}
 
-    int path_length;
-    bool first_dir = true;
+/**
+ * Determine the disk usage of the files in directory,
+ * aggregating the totals into the FileNode of the task.
+ * If a containing file is a directory, add a child node and
+ * add the path to new_tasks. Once every child directory of a node
+ * is complete, the node is final and its record is printed
+ * 
+ * @param task path relative to its argument, and node of directory
+ * @param new_tasks stack of new files to be checked
+ * @param entry_count incremented for every entry in the directory
+ * @param thread_args arguments of the running thread
+ * 
+ * @return disk usage of the entries in bytes, counted or not
+ */
+size_t total_disk_usage_task_tree(StackEntry task, Stack* new_tasks, size_t* entry_count,
+                                  ThreadArgs* thread_args) {
+    return select_disk_usage_task(task.root, thread_args->options, true)(
+        task, new_tasks, entry_count, thread_args);
+}
 
-    bool file_is_dir = false;
-    int dir_fd = open(path, O_RDONLY | O_DIRECTORY);
-    if (dir_fd == -1) {
-        return 0;
+// Set the sizes and times of a new node from its stat result
+static void file_node_init_from_stat(FileNode* node, struct stat* st_info) {
+    node->inode = st_info->st_ino;
+    node->file_size = st_info->st_blocks * ST_NBLOCKSIZE;
+    node->apparent_size = st_info->st_size;
+    node->complete_size = node->file_size;
+    node->complete_apparent_size = node->apparent_size;
+    node->complete_entry_count = 1;
+    node->last_modification_time = st_info->st_mtime;
+    if (S_ISREG(st_info->st_mode)) {
+        add_allocation_gap(node->file_size, node->apparent_size,
+                           &node->complete_sparse_size, &node->complete_slack_size);
     }
-    char* new_path;
+}
 
-    char dirent_buffer[DIRENT_BUFFER_SIZE];
-    long nread;
-    do { // Instead of using opendir and readdir, we manually get the directory contents using
-        // the getdents syscall, which doesn't perform any unnecessary allocations.
-        nread = syscall(SYS_getdents64, dir_fd, dirent_buffer, DIRENT_BUFFER_SIZE);
+// Set the totals of a new node from its stat result, counting
+// it only if it passes the age filters and include patterns
+static void file_node_init_entry(FileNode* node, Options* options, struct stat* st_info,
+                                 bool counted) {
+    file_node_init_from_stat(node, st_info);
+    if (!counted) {
+        // The children are still scanned, they might match
+        node->complete_size = 0;
+        node->complete_apparent_size = 0;
+        node->complete_sparse_size = 0;
+        node->complete_slack_size = 0;
+        node->complete_entry_count = 0;
+        node->last_modification_time = 0;
+    }
+    else if (options->age_histogram) {
+        node->complete_age_sizes[age_bucket(options, st_info->st_mtime)] =
+            options->apparent_size ? node->complete_apparent_size : node->complete_size;
+    }
+}
 
-        for (long bpos = 0; bpos < nread;) {
-            ldirent* dir_entry = (ldirent*) (dirent_buffer + bpos);
-            if (!is_dot_dir(dir_entry->d_name)) {
-                disk_usage_size += get_file_disk_usage_fd(dir_fd, dir_entry->d_name,
-                                                          &file_is_dir);
-                if (file_is_dir) {
-                    if (first_dir) {
-                        // Add path to start of path_buffer
-                        path_length = strlen(path);
-                        // Reuse path allocation
-                        new_path = path;
-                        first_dir = false;
-                    }
-                    else {
-                        new_path = malloc(512);
-                        memcpy(new_path, path, path_length);
-                    }
-                    new_path[path_length] = '/';
-                    strcpy(new_path + path_length + 1, dir_entry->d_name);
-                    stack_entry.path = new_path;
-                    stack_push(new_tasks, stack_entry);
-                }
-            }
-            bpos += dir_entry->d_reclen;
+// Does an entry pass --older-than and --newer-than?
+static inline bool matches_age_filter(Options* options, time_t modification_time) {
+    return (options->older_than == 0 || modification_time < options->older_than) &&
+           (options->newer_than == 0 || modification_time > options->newer_than);
+}
+
+// Index of the modification age bucket, relative to the start of the scan
+static size_t age_bucket(Options* options, time_t modification_time) {
+    static const time_t bucket_limits[AGE_BUCKET_COUNT - 1] = {
+        24 * 60 * 60, 7 * 24 * 60 * 60, 30 * 24 * 60 * 60, 365 * 24 * 60 * 60
+    };
+    time_t age = options->scan_time - modification_time;
+    for (size_t i = 0; i < AGE_BUCKET_COUNT - 1; i++) {
+        if (age < bucket_limits[i]) {
+            return i;
         }
-    } while (nread > 0);
+    }
+    return AGE_BUCKET_COUNT - 1;
+}
 
-    close(dir_fd);
+// Counting entries only needs the type, which getdents gives for most file systems.
+// Everything else needs the stat result
+static bool can_skip_stat(Options* options) {
+    return options->count_inodes && !options->track_modification_time &&
+           !options->by_user && !options->by_group && !options->age_histogram &&
+           !options->size_histogram &&
+           options->older_than == 0 && options->newer_than == 0;
+}
 
-    if (first_dir) { // Found no directories, free path
-        free(path);
+// Add the difference between the allocated and apparent size of a regular file,
+// which is either sparse (holes) or slack (unused space in the last block)
+static inline void add_allocation_gap(size_t allocated, size_t apparent,
+                                      size_t* sparse_size, size_t* slack_size) {
+    if (apparent > allocated) {
+        *sparse_size += apparent - allocated;
+    }
+    else {
+        *slack_size += allocated - apparent;
     }
+}
 
-    // Determine actual filesize, not apparant filesize in st_info.st_size
-    return disk_usage_size;
+// Fill in the fields of a stat result which getdents already gives, used
+// when only the entry count is needed. The sizes and times are zero
+static void stat_from_dirent(struct stat* st_info, ldirent* dir_entry) {
+    st_info->st_ino = dir_entry->d_ino;
+    st_info->st_mode = DTTOIF(dir_entry->d_type);
+    st_info->st_blocks = 0;
+    st_info->st_size = 0;
+    st_info->st_mtime = 0;
+}
+
+// The record field which --top ranks by
+static TopHeapKey top_heap_key_from_options(Options* options) {
+    if (options->count_inodes) {
+        return TOP_KEY_ENTRY_COUNT;
+    }
+    return options->apparent_size ? TOP_KEY_APPARENT_SIZE : TOP_KEY_SIZE;
+}
+
+// Are the entries printed, or only a report like --top at the end?
+static bool prints_entries(Options* options) {
+    return options->top_count == 0 && !options->by_user && !options->by_group &&
+           !options->by_ext && !options->size_histogram && options->estimate_budget == 0;
+}
+
+// Add an entry to the total of its owners
+static void owner_maps_add(Options* options, OwnerMap* user_map, OwnerMap* group_map,
+                           struct stat* st_info) {
+    size_t size = st_info->st_blocks * ST_NBLOCKSIZE;
+    if (options->by_user) {
+        owner_map_add(user_map, st_info->st_uid, size, st_info->st_size);
+    }
+    if (options->by_group) {
+        owner_map_add(group_map, st_info->st_gid, size, st_info->st_size);
+    }
+}
+
+// Add a file to the total of its extension
+static void ext_map_add_file(ThreadArgs* thread_args, const char* name, size_t size,
+                             size_t apparent_size) {
+    size_t ext_length;
+    const char* ext = ext_map_classify(name, thread_args->ext_filter, &ext_length);
+    if (ext == NULL) {
+        // Files without any of the listed extensions are grouped together
+        ext = thread_args->ext_filter ? "(other)" : "(none)";
+        ext_length = strlen(ext);
+    }
+    ext_map_add(&thread_args->ext_map, ext, ext_length, size, apparent_size);
+}
+
+// Print the totals of every user or group, largest first
+static void print_owner_summaries(Options* options, OutputBuffer* buffer, OwnerMap* map,
+                                  bool is_group) {
+    size_t count;
+    OwnerUsage* usages = owner_map_to_array(map, &count);
+    OutputSummaryRecord* records = checked_malloc(count + 1, sizeof(OutputSummaryRecord));
+    for (size_t i = 0; i < count; i++) {
+        OutputSummaryRecord* record = &records[i];
+        record->type = is_group ? "group" : "user";
+        record->has_id = true;
+        record->id = usages[i].id;
+        // Only looked up once per owner, so the lookups are not a bottleneck
+        const char* name = NULL;
+        if (is_group) {
+            struct group* group = getgrgid(usages[i].id);
+            name = group ? group->gr_name : NULL;
+        }
+        else {
+            struct passwd* passwd = getpwuid(usages[i].id);
+            name = passwd ? passwd->pw_name : NULL;
+        }
+        if (name) {
+            record->name = strdup(name);
+        }
+        else {
+            // Owners without a name are printed by id
+            char* id_name = checked_malloc(16, sizeof(char));
+            snprintf(id_name, 16, "%u", usages[i].id);
+            record->name = id_name;
+        }
+        record->size = usages[i].size;
+        record->apparent_size = usages[i].apparent_size;
+        record->entry_count = usages[i].entry_count;
+    }
+    print_summaries(options, buffer, records, count);
+    free(records);
+    free(usages);
+}
+
+// Print the totals of every extension, largest first
+static void print_ext_summaries(Options* options, OutputBuffer* buffer, ExtMap* map) {
+    OutputSummaryRecord* records = checked_malloc(map->size + 1,
+                                                  sizeof(OutputSummaryRecord));
+    size_t count = 0;
+    for (size_t i = 0; i < map->capacity; i++) {
+        ExtUsage* usage = &map->entries[i];
+        if (usage->ext == NULL) {
+            continue;
+        }
+        OutputSummaryRecord* record = &records[count++];
+        record->type = "ext";
+        record->has_id = false;
+        record->id = 0;
+        record->name = strdup(usage->ext);
+        record->size = usage->size;
+        record->apparent_size = usage->apparent_size;
+        record->entry_count = usage->entry_count;
+    }
+    print_summaries(options, buffer, records, count);
+    free(records);
+}
+
+// Print the summary records, largest first within every type, and free their names
+static void print_summaries(Options* options, OutputBuffer* buffer,
+                            OutputSummaryRecord* records, size_t count) {
+    qsort_r(records, count, sizeof(OutputSummaryRecord), compare_summaries_descending,
+            options);
+    for (size_t i = 0; i < count; i++) {
+        output_buffer_add_summary_record(buffer, &records[i]);
+        free((char*) records[i].name);
+    }
+}
+
+// Print every non-empty bucket of the size histogram of an argument, smallest first
+static void print_size_histogram(OutputBuffer* buffer, SizeHistogram* histogram,
+                                 const char* path) {
+    for (size_t i = 0; i < SIZE_HISTOGRAM_BUCKETS; i++) {
+        if (histogram->file_counts[i] == 0) {
+            continue;
+        }
+        OutputHistogramRecord record;
+        record.path = path;
+        record.path_length = strlen(path);
+        record.min_size = size_histogram_bucket_min(i);
+        record.max_size = size_histogram_bucket_max(i);
+        record.file_count = histogram->file_counts[i];
+        record.size = histogram->sizes[i];
+        record.apparent_size = histogram->apparent_sizes[i];
+        output_buffer_add_histogram_record(buffer, &record);
+    }
+}
+
+// Print the estimated total of an argument with its confidence interval
+static void print_estimate(Options* options, OutputBuffer* buffer, FileNode* node,
+                           ScanRoot* root) {
+    double value = estimate_value(options, node);
+    // The sampled siblings and the directories at the same depth both estimate
+    // the variance of the sampling, and both come out too small when the few
+    // huge subtrees were skipped, so the interval uses their sum
+    double variance = node->estimate_variance +
+                      estimate_pooled_variance(&root->estimate_strata);
+    double margin = estimate_margin(variance);
+    OutputEstimateRecord record;
+    record.path = root->path;
+    record.path_length = strlen(root->path);
+    record.size = value;
+    record.low = value > margin ? value - margin : 0;
+    record.high = value + margin;
+    record.scanned_dirs = root->scanned_dirs;
+    output_buffer_add_estimate_record(buffer, &record);
+}
+
+// The total which --estimate reports and computes the variance of
+static double estimate_value(Options* options, FileNode* node) {
+    switch (top_heap_key_from_options(options)) {
+        case TOP_KEY_ENTRY_COUNT:
+            return node->complete_entry_count;
+        case TOP_KEY_APPARENT_SIZE:
+            return node->complete_apparent_size;
+        default:
+            return node->complete_size;
+    }
+}
+
+// Inverse probability of scanning a node, the product of the sample factors
+// of it and its parents. The parents are not freed before the node is final
+static size_t inclusion_factor(FileNode* node) {
+    size_t factor = 1;
+    for (; node; node = node->parent) {
+        if (node->sample_factor > 1) {
+            factor *= node->sample_factor;
+        }
+    }
+    return factor;
+}
+
+// Has the --deadline passed, or was the scan cancelled? Only new directories
+// are skipped, started ones finish
+static bool scan_stopped(ThreadArgs* thread_args) {
+    const bool* cancelled = thread_args->options->cancelled;
+    if (cancelled && __atomic_load_n(cancelled, __ATOMIC_RELAXED)) {
+        return true;
+    }
+    if (thread_args->deadline == NULL) {
+        return false;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return now.tv_sec > thread_args->deadline->tv_sec ||
+           (now.tv_sec == thread_args->deadline->tv_sec &&
+            now.tv_nsec >= thread_args->deadline->tv_nsec);
+}
+
+// Report an entry which could not be read to the error handler, or print it
+static void report_scan_error(Options* options, const char* path, int error) {
+    if (options->error_handler) {
+        options->error_handler(options->error_context, path, error);
+    }
+    else {
+        fprintf(stderr, "%s: %s\n", path, strerror(error));
+    }
+}
+
+// Drop a directory task after the deadline. The directory keeps the totals
+// of its own entry, and is finalized so that the totals above it are printed
+static void skip_disk_usage_task(StackEntry task, ThreadArgs* thread_args) {
+    __atomic_add_fetch(thread_args->skipped_dirs, 1, __ATOMIC_RELAXED);
+    free(task.path);
+    task.node->incomplete = true;
+    __atomic_store_n(&task.node->scanned, true, __ATOMIC_RELEASE);
+    file_node_finalize(task.node, thread_args);
+}
+
+// Give the subdirectories of a task which are not in the cache an equal share of the
+// entries of the directory in the previous scan, less the entries already accounted for.
+// A directory which is not in the cache either passes its own share down
+static void set_uncached_priorities(StackEntry task, Stack* new_tasks, size_t first_new_task,
+                                    size_t known_entry_count, size_t uncached_dir_count) {
+    size_t entry_count = task.cache_node ? task.cache_node->complete_entry_count :
+                                           task.priority;
+    size_t priority = entry_count > known_entry_count ?
+                          (entry_count - known_entry_count) / uncached_dir_count :
+                          0;
+    for (size_t i = first_new_task; i < new_tasks->size; i++) {
+        if (new_tasks->elems[i].cache_node == NULL) {
+            new_tasks->elems[i].priority = priority;
+        }
+    }
+}
+
+// Point the per-argument state of the thread at the argument of a task,
+// handing the file sizes found so far to the previous argument
+static void switch_scan_root(ThreadArgs* thread_args, ScanRoot* root) {
+    if (thread_args->options->size_histogram && thread_args->scan_root) {
+        size_histogram_merge_atomic(&thread_args->scan_root->size_histogram,
+                                    &thread_args->size_histogram);
+    }
+    thread_args->scan_root = root;
+    thread_args->root_path = root->path;
+    thread_args->scanned_dirs = &root->scanned_dirs;
+    thread_args->disk_usage_task = select_disk_usage_task(root, thread_args->options,
+                                                          thread_args->build_file_nodes);
+}
+
+// Wait until the worker may scan under the limits of -j auto and --gentle
+static void enter_thread_limits(ThreadArgs* thread_args) {
+    if (thread_args->tuner) {
+        thread_limit_enter(&thread_args->tuner->threads);
+    }
+    if (thread_args->gentle) {
+        thread_limit_enter(&thread_args->gentle->threads);
+    }
+}
+
+// Leave the limits of enter_thread_limits, letting parked workers in
+static void leave_thread_limits(ThreadArgs* thread_args) {
+    if (thread_args->gentle) {
+        thread_limit_leave(&thread_args->gentle->threads);
+    }
+    if (thread_args->tuner) {
+        thread_limit_leave(&thread_args->tuner->threads);
+    }
+}
+
+// Order summaries by the printed value, largest first, with the name as a tiebreaker
+static int compare_summaries_descending(const void* a, const void* b, void* options) {
+    const OutputSummaryRecord* record_a = a;
+    const OutputSummaryRecord* record_b = b;
+    size_t key_a = record_a->size;
+    size_t key_b = record_b->size;
+    switch (top_heap_key_from_options(options)) {
+        case TOP_KEY_APPARENT_SIZE:
+            key_a = record_a->apparent_size;
+            key_b = record_b->apparent_size;
+            break;
+        case TOP_KEY_ENTRY_COUNT:
+            key_a = record_a->entry_count;
+            key_b = record_b->entry_count;
+            break;
+        default:
+            break;
+    }
+    if (key_a != key_b) {
+        return key_a < key_b ? 1 : -1;
+    }
+    return strcmp(record_a->name, record_b->name);
+}
+
+// Should an entry at this depth be printed?
+static bool is_within_print_depth(Options* options, size_t depth) {
+    return options->max_depth < 0 || depth <= (size_t) options->max_depth;
+}
+
+// Build the path of a file in the directory of node into the path buffer.
+// The directory path is only built once per task, dir_path_length is -1 until then
+static size_t build_file_path(ThreadArgs* thread_args, FileNode* node,
+                              ssize_t* dir_path_length, const char* name) {
+    if (*dir_path_length == -1) {
+        *dir_path_length = file_node_get_path(node, thread_args->root_path,
+                                              &thread_args->path_buffer,
+                                              &thread_args->path_buffer_size);
+    }
+    size_t name_length = strlen(name);
+    size_t file_path_length = *dir_path_length + name_length + 1;
+    if (file_path_length + 1 > thread_args->path_buffer_size) {
+        thread_args->path_buffer_size = (file_path_length + 1) * 2;
+        thread_args->path_buffer = checked_realloc(
+            thread_args->path_buffer, thread_args->path_buffer_size, sizeof(char));
+    }
+    char* file_path = thread_args->path_buffer;
+    size_t slash_index = *dir_path_length;
+    if (slash_index > 0 && file_path[slash_index - 1] == '/') {
+        // Root paths like '/' already end in a slash
+        slash_index--;
+        file_path_length--;
+    }
+    file_path[slash_index] = '/';
+    memcpy(file_path + slash_index + 1, name, name_length);
+    file_path[file_path_length] = '\0';
+    return file_path_length;
+}
+
+/**
+ * Mark the totals of a node as final, printing its record and adding
+ * the totals to the parent. If this was the last pending child of the
+ * parent, the parent is finalized as well
+ * 
+ * @param node node with final totals
+ * @param thread_args arguments of the running thread
+ */
+void file_node_finalize(FileNode* node, ThreadArgs* thread_args) {
+    Options* options = thread_args->options;
+    while (node) {
+        bool within_depth = is_within_print_depth(options, node->depth);
+        OutputRecord record = { 0 };
+        record.is_dir = true;
+        record.size = node->complete_size;
+        record.apparent_size = node->complete_apparent_size;
+        record.sparse_size = node->complete_sparse_size;
+        record.slack_size = node->complete_slack_size;
+        record.entry_count = node->complete_entry_count;
+        record.depth = node->depth;
+        record.modification_time = node->last_modification_time;
+        record.age_sizes = node->complete_age_sizes;
+        // The argument itself is not ranked, only the directories below it
+        bool rank_dir = options->top_count > 0 && options->top_dirs && node->parent &&
+                        within_depth &&
+                        top_heap_accepts(&thread_args->top_heap,
+                                         top_heap_key(&thread_args->top_heap, &record));
+        if ((within_depth && prints_entries(options)) || rank_dir) {
+            record.path_length = file_node_get_path(node, thread_args->root_path,
+                                                    &thread_args->path_buffer,
+                                                    &thread_args->path_buffer_size);
+            record.path = thread_args->path_buffer;
+            if (rank_dir) {
+                top_heap_push(&thread_args->top_heap, &record);
+            }
+            else {
+                output_buffer_add_record(&thread_args->output_buffer, &record);
+            }
+            if (options->ordered_output) {
+                output_buffer_move_to(&thread_args->output_buffer, &node->trailing_output,
+                                      &node->trailing_output_size);
+            }
+        }
+        // Every child is final and printed, so they are not needed anymore.
+        // In ordered mode, the output writer frees them once printed
+        if (!thread_args->keep_file_tree && !options->ordered_output) {
+            file_node_free_children(node);
+        }
+
+        const RduVisitor* visitor = options->visitor;
+        if (visitor && visitor->directory) {
+            RduDirectory directory = { 0 };
+            file_node_get_path(node, thread_args->root_path, &thread_args->path_buffer,
+                               &thread_args->path_buffer_size);
+            directory.path = thread_args->path_buffer;
+            directory.depth = node->depth;
+            directory.size = node->complete_size;
+            directory.apparent_size = node->complete_apparent_size;
+            directory.entry_count = node->complete_entry_count;
+            directory.modification_time = node->last_modification_time;
+            directory.incomplete = node->incomplete;
+            visitor->directory(visitor->context, thread_args->visitor_batch.thread_index,
+                               &directory);
+        }
+
+        if (node->incomplete && node->depth <= 1 && thread_args->deadline) {
+            // Name the argument and its subtrees which are missing directories
+            file_node_get_path(node, thread_args->root_path, &thread_args->path_buffer,
+                               &thread_args->path_buffer_size);
+            fprintf(stderr, "rdu: %s: incomplete, the deadline expired\n",
+                    thread_args->path_buffer);
+        }
+
+        FileNode* parent = node->parent;
+        if (node->incomplete && parent) {
+            __atomic_store_n(&parent->incomplete, true, __ATOMIC_RELAXED);
+        }
+        if (parent == NULL) {
+            // The root node is read and freed by disk_usage
+            __atomic_store_n(&node->finalized, true, __ATOMIC_RELEASE);
+            return;
+        }
+        // A sampled subtree stands in for the skipped siblings as well
+        size_t factor = node->sample_factor > 1 ? node->sample_factor : 1;
+        __atomic_add_fetch(&parent->complete_size, node->complete_size * factor,
+                           __ATOMIC_RELAXED);
+        __atomic_add_fetch(&parent->complete_apparent_size,
+                           node->complete_apparent_size * factor, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&parent->complete_sparse_size, node->complete_sparse_size * factor,
+                           __ATOMIC_RELAXED);
+        __atomic_add_fetch(&parent->complete_slack_size, node->complete_slack_size * factor,
+                           __ATOMIC_RELAXED);
+        __atomic_add_fetch(&parent->complete_entry_count,
+                           node->complete_entry_count * factor, __ATOMIC_RELAXED);
+        if (options->age_histogram) {
+            for (size_t i = 0; i < AGE_BUCKET_COUNT; i++) {
+                __atomic_add_fetch(&parent->complete_age_sizes[i],
+                                   node->complete_age_sizes[i] * factor, __ATOMIC_RELAXED);
+            }
+        }
+        if (options->estimate_budget > 0) {
+            estimate_strata_add_directory(&thread_args->scan_root->estimate_strata,
+                                          node->depth, inclusion_factor(node),
+                                          estimate_value(options, node));
+            double variance = node->estimate_variance;
+            if (factor > 1) {
+                variance = estimate_sampled_variance(estimate_value(options, node), variance,
+                                                     factor);
+            }
+            if (variance > 0) {
+                estimate_atomic_add(&parent->estimate_variance, variance);
+            }
+        }
+        time_t parent_time = __atomic_load_n(&parent->last_modification_time,
+                                             __ATOMIC_RELAXED);
+        while (node->last_modification_time > parent_time &&
+               !__atomic_compare_exchange_n(&parent->last_modification_time,
+                                            &parent_time, node->last_modification_time,
+                                            true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+        // The output writer might free the node from here on
+        __atomic_store_n(&node->finalized, true, __ATOMIC_RELEASE);
+        // The thread completing the last child finalizes the parent
+        if (__atomic_sub_fetch(&parent->pending_children, 1, __ATOMIC_ACQ_REL) != 0) {
+            return;
+        }
+        node = parent;
+    }
 }
 
 /**
@@ -273,8 +1201,10 @@ void* run_disk_usage_thread(void* arg_ptr) {
     while (!(*thread_args->all_threads_complete)) {
         if (stack_is_empty(thread_args->tasks)) {
             // This thread is now idle
-            if (*thread_args->idle_threads == (thread_args->thread_count - 1)) {
-                // All threads are idle, all tasks are complete
+            if (*thread_args->idle_threads + *thread_args->parked_threads ==
+                thread_args->thread_count - 1) {
+                // All threads are idle, all tasks are complete. Parked threads
+                // hold no task, and see that the scan is complete once they get in
                 *(thread_args->all_threads_complete) = true;
                 while (*thread_args->idle_threads) {
                     (*thread_args->idle_threads)--;
@@ -292,35 +1222,82 @@ void* run_disk_usage_thread(void* arg_ptr) {
             //pthread_mutex_unlock(thread_args->tasks_mutex);
         }
         else {
-            StackEntry task = stack_pop(thread_args->tasks);
+            // Wait until fewer workers are scanning before taking a task, so a
+            // parked worker never holds a directory the others could scan
+            if (thread_args->tuner || thread_args->gentle) {
+                (*thread_args->parked_threads)++;
+                pthread_mutex_unlock(thread_args->tasks_mutex);
+                enter_thread_limits(thread_args);
+                pthread_mutex_lock(thread_args->tasks_mutex);
+                (*thread_args->parked_threads)--;
+                if (*thread_args->all_threads_complete ||
+                    stack_is_empty(thread_args->tasks)) {
+                    leave_thread_limits(thread_args);
+                    continue;
+                }
+            }
+            StackEntry task = thread_args->use_cache ? stack_pop_priority(thread_args->tasks) :
+                                                       stack_pop(thread_args->tasks);
             pthread_mutex_unlock(thread_args->tasks_mutex);
+            if (task.root != thread_args->scan_root) {
+                switch_scan_root(thread_args, task.root);
+            }
 
-#ifdef PROFILE_TIME // Time the threads
-            thread_args->total_size_bytes += total_disk_usage_task_time(
-                task_path, &new_tasks, &thread_args->time_spent_in_task);
-
-    #ifdef SINGLE_TASK_OPTIMIZATION
-            while (new_tasks.size == 1) {
-                task_path = stack_pop(&new_tasks);
-                thread_args->total_size_bytes += total_disk_usage_task_time(
-                    task_path, &new_tasks, &thread_args->time_spent_in_task);
-            }
-    #endif
-#else // No timing
-            thread_args->total_size_bytes += total_disk_usage_task(task.path, &new_tasks);
-    #ifdef SINGLE_TASK_OPTIMIZATION
-            while (new_tasks.size == 1) {
-                task = stack_pop(&new_tasks);
-                thread_args->total_size_bytes += total_disk_usage_task(task.path,
-                                                                       &new_tasks);
-            }
-    #endif
+            size_t dirs_done = 1;
+            size_t entry_count = 0;
+            size_t size = 0;
+            if (thread_args->build_file_nodes) {
+                if (scan_stopped(thread_args)) {
+                    // The queued directories are drained without being scanned
+                    skip_disk_usage_task(task, thread_args);
+                }
+                else {
+                    size = thread_args->disk_usage_task(task, &new_tasks, &entry_count,
+                                                        thread_args);
+                }
+#ifdef SINGLE_TASK_OPTIMIZATION
+                while (new_tasks.size == 1 && !scan_stopped(thread_args)) {
+                    task = stack_pop(&new_tasks);
+                    size += thread_args->disk_usage_task(task, &new_tasks, &entry_count,
+                                                         thread_args);
+                    dirs_done++;
+                }
+#endif
+            }
+            else {
+                size = thread_args->disk_usage_task(task, &new_tasks, &entry_count,
+                                                    thread_args);
+#ifdef SINGLE_TASK_OPTIMIZATION
+                while (new_tasks.size == 1) {
+                    task = stack_pop(&new_tasks);
+                    size += thread_args->disk_usage_task(task, &new_tasks, &entry_count,
+                                                         thread_args);
+                    dirs_done++;
+                }
 #endif
+                thread_args->total_size_bytes += size;
+                __atomic_add_fetch(&task.root->total_size, size, __ATOMIC_RELAXED);
+            }
+            progress_add_entries(thread_args->progress, entry_count, size);
+            if (thread_args->tuner) {
+                thread_tuner_add_entries(thread_args->tuner, entry_count);
+            }
+            leave_thread_limits(thread_args);
+            // Every task run above was pushed by a task as well, except for the first
+            progress_add_dirs(thread_args->progress, new_tasks.size + dirs_done - 1,
+                              dirs_done);
 
             pthread_mutex_lock(thread_args->tasks_mutex);
 
             int new_task_count = new_tasks.size - 1;
-            stack_append(thread_args->tasks, &new_tasks);
+            if (thread_args->use_cache) {
+                for (size_t i = 0; i < new_tasks.size; i++) {
+                    stack_push_priority(thread_args->tasks, new_tasks.elems[i]);
+                }
+            }
+            else {
+                stack_append(thread_args->tasks, &new_tasks);
+            }
             new_tasks.size = 0;
             // Resume the idle semaphore here (if there are enough new tasks)
             while (*thread_args->idle_threads && new_task_count) {
@@ -332,6 +1309,10 @@ void* run_disk_usage_thread(void* arg_ptr) {
     }
     pthread_mutex_unlock(thread_args->tasks_mutex);
     stack_free(&new_tasks);
+    if (thread_args->options->size_histogram && thread_args->scan_root) {
+        size_histogram_merge_atomic(&thread_args->scan_root->size_histogram,
+                                    &thread_args->size_histogram);
+    }
 
 #ifdef PROFILE_TIME
     // Get end time
@@ -352,8 +1333,34 @@ void* run_disk_usage_thread(void* arg_ptr) {
  * using the threadcount in options
  * 
  * @param options options file from cmd args
+ * @return false if the deadline expired before every directory was scanned
  */
-void disk_usage(Options options) {
+bool disk_usage(Options options) {
+    return scan_arguments(options, STDOUT_FILENO, NULL, NULL);
+}
+
+/**
+ * Scan the files provided in options without printing anything,
+ * keeping the tree of every argument
+ * 
+ * @param options options file from cmd args
+ * @param argument_trees if not NULL, an array with a slot per argument, set to the
+ * tree of every argument. Slots of arguments which could not be read or were counted
+ * by an earlier argument are left untouched
+ * @return a root node whose children are the trees of the arguments,
+ * named by the argument paths
+ */
+FileNode* disk_usage_tree(Options options, FileNode** argument_trees) {
+    FileNode* tree = NULL;
+    scan_arguments(options, -1, &tree, argument_trees);
+    return tree;
+}
+
+// Scan and print the arguments to output_fd, -1 to print nothing. With tree,
+// the trees of the arguments are kept and returned in it, like in the cache file.
+// argument_trees, if not NULL, gets the tree of every argument by its index
+static bool scan_arguments(Options options, int output_fd, FileNode** tree,
+                           FileNode** argument_trees) {
 #ifdef PROFILE_TIME
     struct timespec before, after;
     long elapsed_nsecs;
@@ -364,79 +1371,376 @@ void disk_usage(Options options) {
     pthread_mutex_t idle_mutex;
     sem_t idle_sem;
 
-    char default_working_dir[512];
-    if (getcwd(default_working_dir, 512) == NULL) {
-        perror("getcwd");
-        exit(EXIT_FAILURE);
+    // Directories still queued when the deadline expires are skipped
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &deadline);
+    deadline.tv_sec += options.deadline;
+    size_t skipped_dirs = 0;
+    Progress progress;
+    progress_start(&progress, options.progress, options.thread_count);
+    // Stay out of the way of the other processes on the host
+    Gentle gentle;
+    if (options.gentle_ops > 0) {
+        if (!gentle_set_idle_io_priority()) {
+            perror("rdu: ioprio_set");
+        }
+        gentle_init(&gentle, options.thread_count, options.gentle_ops);
+    }
+    // With -j auto, the amount of scanning workers is tuned during the scan
+    ThreadTuner tuner;
+    if (options.auto_threads) {
+        thread_tuner_init(&tuner, options.thread_count, available_cpu_count());
+    }
+    // The entry counts of the previous scan decide which directories are scanned first
+    FileNode* cache_root = NULL;
+    if (options.use_cache_location && access(options.use_cache_location, R_OK) == 0) {
+        cache_root = file_tree_load(options.use_cache_location);
+        if (cache_root == NULL) {
+            fprintf(stderr, "rdu: %s: not a cache file, it is not used\n",
+                    options.use_cache_location);
+        }
+    }
+    // The tree of every argument is kept, and saved once every argument is done
+    FileNode* new_cache_root = options.create_cache_location || tree ? file_node_new() :
+                                                                       NULL;
+    // A visitor is told about every directory once final, so only the
+    // arguments are kept for it
+    bool keep_file_tree = new_cache_root != NULL && options.visitor == NULL;
+
+    // Aggregate totals per directory and print them once final, if more
+    // than the total of every argument is printed
+    bool prints_tree = output_is_record_format(options.output_format) ||
+                            options.show_regular_files || options.max_depth > 0 ||
+                            options.top_count > 0 || options.apparent_size ||
+                            options.show_slack || options.count_inodes ||
+                            options.by_user || options.by_group || options.by_ext ||
+                            options.track_modification_time || options.age_histogram ||
+                            options.older_than != 0 || options.newer_than != 0 ||
+                            options.size_histogram || options.estimate_budget > 0 ||
+                            options.deadline != 0 ||
+                            !pattern_matcher_is_empty(&options.patterns);
+    // --gentle and the cache scan the tree too, but print the same as without them
+    bool build_file_nodes = prints_tree || options.gentle_ops > 0 ||
+                            options.use_cache_location || options.create_cache_location ||
+                            tree != NULL;
+    // The largest entries are collected per thread and merged after every argument
+    TopHeap top_heap = top_heap_new(options.top_count, top_heap_key_from_options(&options));
+    // The owner totals are merged the same way
+    OwnerMap user_map = owner_map_new();
+    OwnerMap group_map = owner_map_new();
+    ExtMap ext_map = ext_map_new();
+    // Shared by every thread, only read during the scan
+    ExtMap ext_filter = ext_map_new();
+    if (options.ext_list) {
+        ext_filter = ext_map_from_list(options.ext_list);
+    }
+    if (output_fd == -1 || !prints_tree) {
+        // Only the records of the arguments are formatted, and dropped without output
+        options.max_depth = 0;
+        options.show_regular_files = false;
+    }
+    if (!prints_entries(&options) || output_fd == -1) {
+        options.ordered_output = false;
+    }
+    Output output;
+    output_init(&output, output_fd, &options);
+    output.keep_nodes = new_cache_root != NULL;
+    OutputBuffer main_output_buffer = output_buffer_new(&output);
+    output_buffer_add_header(&main_output_buffer);
+    // Queued before the threads start, which flush their records as they go
+    output_buffer_flush(&main_output_buffer);
+
+    // Overlapping arguments are found before the scan, so they are only counted once
+    size_t root_count;
+    ScanRoot* roots = scan_roots_new(options.files, &root_count);
+    for (size_t i = 0; i < root_count; i++) {
+        if (!roots[i].exists) {
+            report_scan_error(&options, roots[i].path, roots[i].error);
+        }
     }
 
     pthread_mutex_init(&tasks_mutex, NULL);
     pthread_mutex_init(&idle_mutex, NULL);
     sem_init(&idle_sem, 0, 0);
-    char** current_file = options.files;
-    while (*current_file != NULL) {
-        bool all_threads_complete = false;
-        size_t idle_threads = 0;
-        //size_t total_size = total_disk_usage(*current_file);
+    bool all_threads_complete = false;
+    size_t idle_threads = 0;
+    size_t parked_threads = 0;
+    bool has_tasks = false;
 
-        pthread_t tid[options.thread_count];
-        ThreadArgs thread_args[options.thread_count];
+    // Every argument is queued before the threads start, so small arguments
+    // are scanned alongside large ones. Pushed in reverse, so the first
+    // argument is popped first
+    for (size_t i = root_count; i-- > 0;) {
+        ScanRoot* root = &roots[i];
+        if (!root->exists || root->skipped) {
+            continue;
+        }
+        // Stat calls in inode order save seeks on spinning disks
+        root->inode_order = options.inode_order == INODE_ORDER_ALWAYS ||
+                            (options.inode_order == INODE_ORDER_AUTO &&
+                             is_rotational_device(root->st_info.st_dev));
+        root->cache_node = cache_root ? file_node_find_argument(cache_root, root->path,
+                                                                root->st_info.st_ino) :
+                                        NULL;
+        if (build_file_nodes) {
+            bool counted = matches_age_filter(&options, root->st_info.st_mtime);
+            root->node = file_node_new();
+            file_node_init_entry(root->node, &options, &root->st_info, counted);
+            if (S_ISREG(root->st_info.st_mode) && root->node->complete_entry_count > 0) {
+                size_histogram_add(&root->size_histogram, root->node->complete_size,
+                                   root->node->complete_apparent_size);
+            }
+            if (counted) {
+                owner_maps_add(&options, &user_map, &group_map, &root->st_info);
+            }
+        }
+        else {
+            root->total_size = root->st_info.st_blocks * ST_NBLOCKSIZE;
+        }
+        if (!S_ISDIR(root->st_info.st_mode)) {
+            continue;
+        }
+        // The single thread solution has no progress counters, inode order or exclusions
+        if (!build_file_nodes && options.thread_count == 1 &&
+            options.progress == PROGRESS_NONE && !root->inode_order &&
+            root->excluded_count == 0) {
+            int dir_fd = openat(root->dir_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dir_fd == -1) {
+                report_scan_error(&options, root->path, errno);
+                continue;
+            }
+            root->total_size += total_disk_usage_task_st(dir_fd);
+            continue;
+        }
+        StackEntry stack_task = { 0 };
+        // Paths are relative to the argument directory
+        stack_task.path = checked_malloc(2, sizeof(char));
+        strcpy(stack_task.path, ".");
+        stack_task.node = root->node;
+        stack_task.cache_node = root->cache_node;
+        stack_task.priority = root->cache_node ? root->cache_node->complete_entry_count : 0;
+        stack_task.root = root;
+        if (cache_root) {
+            stack_push_priority(&tasks, stack_task);
+        }
+        else {
+            stack_push(&tasks, stack_task);
+        }
+        has_tasks = true;
+    }
 
+    pthread_t tid[options.thread_count];
+    ThreadArgs thread_args[options.thread_count];
+    for (size_t i = 0; i < options.thread_count; i++) {
+        thread_args[i].tasks = &tasks;
+        thread_args[i].tasks_mutex = &tasks_mutex;
+        thread_args[i].idle_mutex = &idle_mutex;
+        thread_args[i].idle_sem = &idle_sem;
+        thread_args[i].all_threads_complete = &all_threads_complete;
+        thread_args[i].idle_threads = &idle_threads;
+        thread_args[i].parked_threads = &parked_threads;
+        thread_args[i].thread_count = options.thread_count;
+        thread_args[i].total_size_bytes = 0;
+        thread_args[i].time_spent_in_task = 0;
+        thread_args[i].keep_file_tree = keep_file_tree;
+        thread_args[i].use_cache = cache_root != NULL;
+        thread_args[i].cache_index = cache_index_new();
+        thread_args[i].build_file_nodes = build_file_nodes;
+        thread_args[i].options = &options;
+        // Set from the argument of the first task
+        thread_args[i].scan_root = NULL;
+        thread_args[i].root_path = NULL;
+        thread_args[i].scanned_dirs = NULL;
+        thread_args[i].disk_usage_task = NULL;
+        // Every thread reuses its own buffers for reading directories in inode order
+        thread_args[i].inode_batch = dirent_batch_new();
+        thread_args[i].dirent_buffer = dirent_buffer_new();
+        thread_args[i].path_buffer = NULL;
+        thread_args[i].path_buffer_size = 0;
+        thread_args[i].top_heap = top_heap_new(options.top_count,
+                                               top_heap_key_from_options(&options));
+        thread_args[i].user_map = owner_map_new();
+        thread_args[i].group_map = owner_map_new();
+        thread_args[i].ext_map = ext_map_new();
+        size_histogram_clear(&thread_args[i].size_histogram);
+        thread_args[i].ext_filter = options.ext_list ? &ext_filter : NULL;
+        thread_args[i].deadline = options.deadline != 0 ? &deadline : NULL;
+        thread_args[i].skipped_dirs = &skipped_dirs;
+        thread_args[i].progress = progress_counters(&progress, i);
+        thread_args[i].gentle = options.gentle_ops > 0 ? &gentle : NULL;
+        thread_args[i].tuner = options.auto_threads ? &tuner : NULL;
+        thread_args[i].random_state = estimate_random_seed(
+            ((uint64_t) options.scan_time << 16) + i);
+        thread_args[i].visitor_batch = visitor_batch_new(options.visitor, i);
+    }
+    // The threads are started once, and scan every argument. The threads
+    // of a pool are already running, and only get the arguments
+    if (has_tasks) {
         for (size_t i = 0; i < options.thread_count; i++) {
-            thread_args[i].tasks = &tasks;
-            thread_args[i].tasks_mutex = &tasks_mutex;
-            thread_args[i].idle_mutex = &idle_mutex;
-            thread_args[i].idle_sem = &idle_sem;
-            thread_args[i].all_threads_complete = &all_threads_complete;
-            thread_args[i].idle_threads = &idle_threads;
-            thread_args[i].thread_count = options.thread_count;
-            thread_args[i].total_size_bytes = 0;
-            thread_args[i].time_spent_in_task = 0;
-        }
-
-        // Handle first file manually
-        bool current_file_is_dir = false;
-        size_t total_size = get_file_disk_usage(*current_file, &current_file_is_dir);
-
-        if (current_file_is_dir) { // Single file, handle manually
-            // Change into the dir to save on path length
-            if (chdir(*current_file) == -1) {
-                perror("chrdir");
-            }
-            if (options.thread_count == 1) { // Custom solution for one thread
-                int dir_fd = open("./", O_RDONLY | O_DIRECTORY);
-                total_size += total_disk_usage_task_st(dir_fd);
-                //total_size += total_disk_usage_task_st(dir_fd);
+            if (build_file_nodes) {
+                thread_args[i].output_buffer = output_buffer_new(&output);
             }
-            else {
-                char* current_file_path = malloc(512);
-                strcpy(current_file_path, "./");
-                StackEntry stack_task;
-                stack_task.path = current_file_path;
-                stack_push(&tasks, stack_task);
-
-                for (size_t i = 0; i < options.thread_count; i++) {
-                    pthread_create(&tid[i], NULL, run_disk_usage_thread,
-                                   (void*) &thread_args[i]);
-                }
+            if (options.pool == NULL) {
+                pthread_create(&tid[i], NULL, run_disk_usage_thread,
+                               (void*) &thread_args[i]);
+            }
+        }
+        if (options.pool) {
+            scan_pool_run(options.pool, run_disk_usage_thread, thread_args,
+                          sizeof(ThreadArgs), options.thread_count);
+        }
+    }
 
-                for (size_t i = 0; i < options.thread_count; i++) {
-                    pthread_join(tid[i], NULL);
+    if (build_file_nodes) {
+        // Print the arguments in order while the threads are scanning
+        for (size_t i = 0; i < root_count; i++) {
+            ScanRoot* root = &roots[i];
+            if (root->node == NULL) {
+                continue;
+            }
+            if (S_ISDIR(root->st_info.st_mode)) {
+                if (options.ordered_output) {
+                    // Flush the previous argument, so the records stay in argument order
+                    output_buffer_flush(&main_output_buffer);
+                    output_ordered_start(&output, root->node);
+                    output_ordered_wait(&output);
                 }
+            }
+            else if (!options.by_ext && prints_entries(&options)) {
+                FileNode* node = root->node;
+                OutputRecord record = { 0 };
+                record.path = root->path;
+                record.path_length = strlen(root->path);
+                record.is_dir = false;
+                record.size = node->complete_size;
+                record.apparent_size = node->complete_apparent_size;
+                record.sparse_size = node->complete_sparse_size;
+                record.slack_size = node->complete_slack_size;
+                record.entry_count = node->complete_entry_count;
+                record.modification_time = node->last_modification_time;
+                record.age_sizes = node->complete_age_sizes;
+                output_buffer_add_record(&main_output_buffer, &record);
+            }
+        }
+    }
 
-                for (size_t i = 0; i < options.thread_count; i++) {
-                    total_size += thread_args[i].total_size_bytes;
-                }
+    if (has_tasks) {
+        if (options.pool) {
+            scan_pool_wait(options.pool);
+        }
+        for (size_t i = 0; i < options.thread_count; i++) {
+            if (options.pool == NULL) {
+                pthread_join(tid[i], NULL);
             }
-            // Change back into previous working dir to allow for more relative paths
-            if (chdir(default_working_dir) == -1) {
-                perror("chrdir");
+            if (build_file_nodes) {
+                output_buffer_free(&thread_args[i].output_buffer);
+            }
+        }
+    }
+    progress_stop(&progress);
+    for (size_t i = 0; i < options.thread_count; i++) {
+        free(thread_args[i].path_buffer);
+        top_heap_merge(&top_heap, &thread_args[i].top_heap);
+        owner_map_merge(&user_map, &thread_args[i].user_map);
+        owner_map_merge(&group_map, &thread_args[i].group_map);
+        ext_map_merge(&ext_map, &thread_args[i].ext_map);
+    }
+
+    // The totals and reports of every argument, in argument order
+    for (size_t i = 0; i < root_count; i++) {
+        ScanRoot* root = &roots[i];
+        if (root->skipped) {
+            continue;
+        }
+        if (!build_file_nodes) {
+            OutputRecord record = { 0 };
+            record.path = root->path;
+            record.path_length = strlen(root->path);
+            record.is_dir = root->exists && S_ISDIR(root->st_info.st_mode);
+            record.size = root->total_size;
+            output_buffer_add_record(&main_output_buffer, &record);
+            continue;
+        }
+        FileNode* node = root->node;
+        if (node == NULL) {
+            continue;
+        }
+        if (!S_ISDIR(root->st_info.st_mode) && options.by_ext &&
+            node->complete_entry_count > 0) {
+            // A file argument is classified like the files found by the threads
+            const char* name = strrchr(root->path, '/');
+            ext_map_add_file(&thread_args[0], name ? name + 1 : root->path,
+                             node->complete_size, node->complete_apparent_size);
+            ext_map_merge(&ext_map, &thread_args[0].ext_map);
+        }
+        if (options.size_histogram) {
+            print_size_histogram(&main_output_buffer, &root->size_histogram, root->path);
+        }
+        if (options.estimate_budget > 0) {
+            print_estimate(&options, &main_output_buffer, node, root);
+        }
+        if (new_cache_root) {
+            // Found by the argument in the next scan
+            file_node_set_name(node, root->path);
+            file_tree_attach_child(new_cache_root, node);
+            if (argument_trees) {
+                // The names are cut short, so long paths are told apart by their index
+                argument_trees[i] = node;
             }
         }
+        else {
+            file_node_free_all(node);
+        }
+    }
+    for (size_t i = 0; i < options.thread_count; i++) {
+        top_heap_free(&thread_args[i].top_heap);
+        owner_map_free(&thread_args[i].user_map);
+        owner_map_free(&thread_args[i].group_map);
+        ext_map_free(&thread_args[i].ext_map);
+        cache_index_free(&thread_args[i].cache_index);
+        dirent_batch_free(&thread_args[i].inode_batch);
+        dirent_buffer_free(&thread_args[i].dirent_buffer);
+        visitor_batch_free(&thread_args[i].visitor_batch);
+    }
+    scan_roots_free(roots, root_count);
 
-        printf("%zu    %s\n", total_size / options.block_size, *current_file);
-        current_file++;
+    if (options.top_count > 0) {
+        // Print the largest entries of every argument, largest first
+        top_heap_sort(&top_heap);
+        for (size_t i = 0; i < top_heap.size; i++) {
+            output_buffer_add_record(&main_output_buffer, &top_heap.records[i]);
+        }
     }
+    top_heap_free(&top_heap);
+    // Print the owner and extension totals of every argument
+    if (options.by_user) {
+        print_owner_summaries(&options, &main_output_buffer, &user_map, false);
+    }
+    if (options.by_group) {
+        print_owner_summaries(&options, &main_output_buffer, &group_map, true);
+    }
+    if (options.by_ext) {
+        print_ext_summaries(&options, &main_output_buffer, &ext_map);
+    }
+    owner_map_free(&user_map);
+    owner_map_free(&group_map);
+    ext_map_free(&ext_map);
+    ext_map_free(&ext_filter);
+    if (options.create_cache_location) {
+        file_tree_save(new_cache_root, options.create_cache_location);
+    }
+    if (tree) {
+        *tree = new_cache_root;
+    }
+    else if (new_cache_root) {
+        file_node_free_all(new_cache_root);
+    }
+    if (cache_root) {
+        file_node_free_all(cache_root);
+    }
+
+    output_buffer_free(&main_output_buffer);
+    output_destroy(&output);
 
     pthread_mutex_destroy(&tasks_mutex);
     pthread_mutex_destroy(&idle_mutex);
@@ -451,4 +1755,10 @@ void disk_usage(Options options) {
                     (after.tv_nsec - before.tv_nsec);
     printf("Complete program took %ld ms \n", elapsed_nsecs / 1000000);
 #endif
-}
\ No newline at end of file
+    if (skipped_dirs > 0 && options.deadline != 0) {
+        fprintf(stderr,
+                "rdu: the deadline of %lds expired, %zu directories were not scanned\n",
+                (long) options.deadline, skipped_dirs);
+    }
+    return skipped_dirs == 0;
+}
@@ -6,7 +6,10 @@
  * @file disk_usage.h
  * @author William Sandström
  */
-#define _GNU_SOURCE
+#pragma once
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
 #include <sys/types.h>
 #include <pthread.h>
 #include <stdio.h>
@@ -25,17 +28,45 @@
 #include <unistd.h>
 #include <time.h>
 #include <linux/fs.h>
+#include <pwd.h>
+#include <grp.h>
 
 #include "util/helpers.h"
 #include "args.h"
 #include "util/stack.h"
+#include "output.h"
+#include "file_node.h"
+#include "top_heap.h"
+#include "owner_map.h"
+#include "ext_map.h"
+#include "size_histogram.h"
+#include "estimate.h"
+#include "dirent_batch.h"
+#include "cache_index.h"
+#include "scan_root.h"
 
 #define ST_NBLOCKSIZE 512 // Always 512 on linux
 
 #define SINGLE_TASK_OPTIMIZATION
-#define DIRENT_BUFFER_SIZE 4096
+#define DIRENT_BUFFER_SIZE 4096 // Stack buffer of the recursive single thread scan
 //#define PROFILE_TIME
 
+// Features of the directory scan, every combination is compiled into its own function
+enum DiskUsageTaskFeature {
+    TASK_INODE_ORDER = 1, // Read the whole directory first, sorted by inode
+    TASK_EXCLUDES = 2, // Skip the directories of earlier arguments
+    TASK_TIME = 4, // Sum up the time spent in the task, with PROFILE_TIME
+    TASK_TREE = 8, // Aggregate the totals into FileNodes, for records and reports
+    TASK_FILTER = 16, // Match the names to the patterns and the times to the age filters
+    TASK_FEATURE_COMBINATIONS = 32,
+};
+
+struct ThreadArgs;
+
+// The scan of one directory, specialized for the features of an argument and the options
+typedef size_t (*DiskUsageTask)(StackEntry task, Stack* new_tasks, size_t* entry_count,
+                                struct ThreadArgs* thread_args);
+
 struct ThreadArgs {
     Stack* tasks;
     size_t total_size_bytes;
@@ -44,27 +75,45 @@ struct ThreadArgs {
     pthread_mutex_t* idle_mutex;
     sem_t* idle_sem;
     size_t* idle_threads;
+    size_t* parked_threads; // Waiting for -j auto or --gentle to let them in, without a task
     bool* all_threads_complete;
     long int time_spent_in_task;
 
     FileNode* file_tree_root;
     bool keep_file_tree;
     bool track_modification_time;
-    bool use_cache;
+    bool use_cache; // Tasks are popped by their size in the cache, the tasks are a max-heap
     FileNode* file_cache_root;
+    CacheIndex cache_index; // Finds the cache nodes of subdirectories
     //bool error_encountered;
-};
 
-struct linux_dirent64 {
-    unsigned long d_ino; /* 64-bit inode number */
-    long d_off; /* 64-bit offset to next structure */
-    unsigned short d_reclen; /* Size of this dirent */
-    unsigned char d_type; /* File type */
-    char d_name[]; /* Filename (null-terminated) */
+    // Per-directory aggregation, used for record output
+    bool build_file_nodes; // Aggregate totals per directory in FileNodes
+    Options* options;
+    ScanRoot* scan_root; // Command-line argument of the current task
+    char* root_path; // Path of the command-line argument, used for printing
+    OutputBuffer output_buffer;
+    char* path_buffer; // Reused buffer for building printed paths
+    size_t path_buffer_size;
+    TopHeap top_heap; // Largest entries found by this thread, for --top
+    OwnerMap user_map; // Totals per user found by this thread, for --by-user
+    OwnerMap group_map; // Totals per group found by this thread, for --by-group
+    ExtMap ext_map; // Totals per extension found by this thread, for --by-ext
+    ExtMap* ext_filter; // Extensions to classify files into, NULL for every extension
+    SizeHistogram size_histogram; // File sizes found by this thread in the current argument
+    size_t* scanned_dirs; // Directories scanned for the current argument, for --estimate
+    uint64_t random_state; // Decides which subdirectories are sampled, for --estimate
+    const struct timespec* deadline; // Stop taking new directories after this, NULL for no limit
+    size_t* skipped_dirs; // Directories which were not scanned before the deadline
+    ProgressCounters* progress; // Counters of this thread for --progress, NULL otherwise
+    Gentle* gentle; // Shared rate and worker limits for --gentle, NULL otherwise
+    ThreadTuner* tuner; // Shared worker limit for -j auto, NULL otherwise
+    DirentBatch inode_batch; // Reads directories in inode order, when the argument is
+    DirentBuffer dirent_buffer; // getdents64 buffer, grown for wide directories
+    DiskUsageTask disk_usage_task; // Scan specialized for the current argument
+    VisitorBatch visitor_batch; // Entries of the current directory for the visitor of librdu
 };
 
-typedef struct linux_dirent64 ldirent;
-
 typedef struct ThreadArgs ThreadArgs;
 
 /**
@@ -89,8 +138,22 @@ size_t total_disk_usage(char* path);
  * using the threadcount in options
  * 
  * @param options options file from cmd args
+ * @return false if the deadline expired before every directory was scanned
+ */
+bool disk_usage(Options options);
+
+/**
+ * Scan the files provided in options without printing anything,
+ * keeping the tree of every argument
+ * 
+ * @param options options file from cmd args
+ * @param argument_trees if not NULL, an array with a slot per argument, set to the
+ * tree of every argument. Slots of arguments which could not be read or were counted
+ * by an earlier argument are left untouched
+ * @return a root node whose children are the trees of the arguments,
+ * named by the argument paths
  */
-void disk_usage(Options options);
+FileNode* disk_usage_tree(Options options, FileNode** argument_trees);
 
 /**
  * Thread function which takes disk usage
@@ -107,25 +170,42 @@ void* run_disk_usage_thread(void* arg_ptr);
  * Determine the disk usage of the files in directory
  * If a containing file is a directory, add the path to new_tasks
  * 
- * @param path path of directory
+ * @param task path of directory relative to its argument, and the argument
  * @param new_tasks stack of new files to be checked
+ * @param entry_count incremented for every entry in the directory
+ * @param thread_args arguments of the running thread, with its buffers
  * 
  * @return disk usage in bytes
  */
-size_t total_disk_usage_task(char* path, Stack* new_tasks);
+size_t total_disk_usage_task(StackEntry task, Stack* new_tasks, size_t* entry_count,
+                             ThreadArgs* thread_args);
 
 /**
- * Determine the disk usage of the files in directory
- * If a containing file is a directory, add the path to new_tasks
- * Sum up the time spent in the task
+ * Determine the disk usage of the files in directory,
+ * aggregating the totals into the FileNode of the task.
+ * If a containing file is a directory, add a child node and
+ * add the path to new_tasks. Once every child directory of a node
+ * is complete, the node is final and its record is printed
  * 
- * @param path path of directory
+ * @param task path relative to its argument, and node of directory
  * @param new_tasks stack of new files to be checked
- * @param time_spent sum of time of all tasks run on this thread
+ * @param entry_count incremented for every entry in the directory
+ * @param thread_args arguments of the running thread
  * 
- * @return disk usage in bytes
+ * @return disk usage of the entries in bytes, counted or not
  */
-size_t total_disk_usage_task_time(char* path, Stack* new_tasks, long int* time_spent);
+size_t total_disk_usage_task_tree(StackEntry task, Stack* new_tasks, size_t* entry_count,
+                                  ThreadArgs* thread_args);
+
+/**
+ * Mark the totals of a node as final, printing its record and adding
+ * the totals to the parent. If this was the last pending child of the
+ * parent, the parent is finalized as well
+ * 
+ * @param node node with final totals
+ * @param thread_args arguments of the running thread
+ */
+void file_node_finalize(FileNode* node, ThreadArgs* thread_args);
 
 /**
  * Return the disk usage of a file 
@@ -157,6 +237,4 @@ size_t get_file_disk_usage_fd(int dirfd, char* path, bool* file_is_dir);
  * 
  * @return disk usage in bytes
  */
-size_t total_disk_usage_task_st(int dir_fd);
-
-size_t total_disk_usage_task_st_getdents(int dir_fd);
\ No newline at end of file
+size_t total_disk_usage_task_st(int dir_fd);
\ No newline at end of file
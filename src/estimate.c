@@ -0,0 +1,184 @@
+/**
+ * Sampling helpers for --estimate, which scans a random part of a
+ * large tree and scales it up to an estimate of the complete size.
+ * Directories are scanned fully until a budget is used up, after
+ * which every directory is only scanned with probability about
+ * 1/factor. The factor of a depth only grows with the directories
+ * scanned at it and above, so the subtree the threads happen to start
+ * with does not use up the budget of the shallow directories. The
+ * factor is not compounded down the tree either, a subtree already
+ * sampled samples its subdirectories less, so that deep directories
+ * are not left to a handful of huge weights.
+ * Sampled subtrees are scaled by their factor (Horvitz-Thompson),
+ * and the variance of the estimate is summed up the same way.
+ * The sampled siblings alone underestimate the variance when they
+ * miss the few huge subtrees, so the skipped siblings are also
+ * assumed to vary like every scanned directory at their depth
+ *
+ * @file estimate.c
+ * @author William Sandström
+ */
+#include "estimate.h"
+
+/**
+ * Seed a random state, different seeds give different samples
+ */
+uint64_t estimate_random_seed(uint64_t seed) {
+    // splitmix64, so that close seeds give unrelated states
+    uint64_t z = seed + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    // xorshift needs a state other than zero
+    return z ? z : 1;
+}
+
+/**
+ * Return a uniformly random integer below bound and advance the state
+ *
+ * @param state random state of the calling thread
+ * @param bound exclusive upper limit, over 0
+ */
+uint64_t estimate_random_below(uint64_t* state, uint64_t bound) {
+    // xorshift64*
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    // The bias of the modulo is negligible for the small factors used here
+    return (x * 0x2545f4914f6cdd1dull) % bound;
+}
+
+/**
+ * Return the inverse probability of scanning a subdirectory, 1 to always
+ * scan it. Grows by one for every budget of directories already scanned,
+ * so the amount of scanned directories stays a few times the budget
+ *
+ * @param scanned_dirs amount of directories scanned so far
+ * @param budget amount of directories to scan fully
+ */
+size_t estimate_sample_factor(size_t scanned_dirs, size_t budget) {
+    return 1 + scanned_dirs / budget;
+}
+
+/**
+ * Return the factor a directory samples its subdirectories with, so that
+ * their inclusion factor reaches the current sample factor and not more
+ *
+ * @param sample_factor estimate_sample_factor of the scan so far
+ * @param inclusion_factor inverse probability of scanning the directory,
+ * the product of the factors of it and its parents
+ */
+size_t estimate_subdirectory_factor(size_t sample_factor, size_t inclusion_factor) {
+    size_t factor = sample_factor / inclusion_factor;
+    return factor > 1 ? factor : 1;
+}
+
+/**
+ * Return the variance a sampled subtree adds to the estimate of its parent.
+ * The subtree was scanned with probability 1/factor, its estimate is
+ * scaled by factor and its own variance by factor as well
+ *
+ * @param value estimated total of the subtree, not yet scaled by factor
+ * @param variance estimated variance of value
+ * @param factor inverse probability of scanning the subtree
+ */
+double estimate_sampled_variance(double value, double variance, size_t factor) {
+    // Unbiased for Bernoulli sampling with p = 1/factor:
+    // (1 - p) / p^2 * value^2 + variance / p
+    double f = factor;
+    return (f * f - f) * value * value + f * variance;
+}
+
+/**
+ * Count a directory which is being scanned. Thread safe
+ *
+ * @param depth depth of the directory below the argument
+ */
+void estimate_strata_add_scanned(EstimateStrata* strata, size_t depth) {
+    size_t index = depth < ESTIMATE_DEPTH_COUNT ? depth : ESTIMATE_DEPTH_COUNT - 1;
+    __atomic_add_fetch(&strata->scanned_dirs[index], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Return the amount of directories scanned at a depth and above it
+ */
+size_t estimate_strata_scanned(EstimateStrata* strata, size_t depth) {
+    size_t index = depth < ESTIMATE_DEPTH_COUNT ? depth : ESTIMATE_DEPTH_COUNT - 1;
+    size_t scanned_dirs = 0;
+    for (size_t i = 0; i <= index; i++) {
+        scanned_dirs += __atomic_load_n(&strata->scanned_dirs[i], __ATOMIC_RELAXED);
+    }
+    return scanned_dirs;
+}
+
+/**
+ * Add the total of a scanned directory to the statistics of its depth.
+ * Thread safe
+ *
+ * @param depth depth of the directory below the argument
+ * @param inclusion_factor inverse probability of scanning the directory
+ * @param value estimated total of the directory, not scaled by its factor
+ */
+void estimate_strata_add_directory(EstimateStrata* strata, size_t depth,
+                                   size_t inclusion_factor, double value) {
+    size_t index = depth < ESTIMATE_DEPTH_COUNT ? depth : ESTIMATE_DEPTH_COUNT - 1;
+    estimate_atomic_add(&strata->weights[index], inclusion_factor);
+    estimate_atomic_add(&strata->squared_totals[index], inclusion_factor * value * value);
+}
+
+/**
+ * Add the subdirectories of a directory which sampled them. Thread safe
+ *
+ * @param depth depth of the subdirectories below the argument
+ * @param inclusion_factor inverse probability of scanning the directory
+ * @param factor inverse probability of scanning each subdirectory
+ * @param subdirectory_count subdirectories, scanned or skipped
+ */
+void estimate_strata_add_sampled(EstimateStrata* strata, size_t depth,
+                                 size_t inclusion_factor, size_t factor,
+                                 size_t subdirectory_count) {
+    size_t index = depth < ESTIMATE_DEPTH_COUNT ? depth : ESTIMATE_DEPTH_COUNT - 1;
+    // Bernoulli sampling adds (factor - 1) * y^2 per subdirectory, which
+    // the factors of the parents scale up like the sampled variances
+    estimate_atomic_add(&strata->skipped_weights[index],
+                        (double) (factor - 1) * subdirectory_count * inclusion_factor);
+}
+
+/**
+ * Return the variance of the sampling, if the subdirectories of every
+ * sampled directory vary like the scanned directories at their depth.
+ * Depths without scanned directories use the closest one above
+ */
+double estimate_pooled_variance(const EstimateStrata* strata) {
+    double variance = 0;
+    double mean_square = 0;
+    for (size_t i = 0; i < ESTIMATE_DEPTH_COUNT; i++) {
+        if (strata->weights[i] > 0) {
+            mean_square = strata->squared_totals[i] / strata->weights[i];
+        }
+        variance += strata->skipped_weights[i] * mean_square;
+    }
+    return variance;
+}
+
+/**
+ * Return the half-width of the 95% confidence interval of an estimate
+ */
+double estimate_margin(double variance) {
+    return ESTIMATE_CONFIDENCE_Z * sqrt(variance);
+}
+
+/**
+ * Add to a double shared between threads
+ */
+void estimate_atomic_add(double* target, double value) {
+    double expected;
+    double desired;
+    __atomic_load(target, &expected, __ATOMIC_RELAXED);
+    do {
+        desired = expected + value;
+    } while (!__atomic_compare_exchange(target, &expected, &desired, true, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED));
+}
@@ -0,0 +1,142 @@
+/**
+ * Sampling helpers for --estimate, which scans a random part of a
+ * large tree and scales it up to an estimate of the complete size.
+ * Directories are scanned fully until a budget is used up, after
+ * which every directory is only scanned with probability about
+ * 1/factor. The factor of a depth only grows with the directories
+ * scanned at it and above, so the subtree the threads happen to start
+ * with does not use up the budget of the shallow directories. The
+ * factor is not compounded down the tree either, a subtree already
+ * sampled samples its subdirectories less, so that deep directories
+ * are not left to a handful of huge weights.
+ * Sampled subtrees are scaled by their factor (Horvitz-Thompson),
+ * and the variance of the estimate is summed up the same way.
+ * The sampled siblings alone underestimate the variance when they
+ * miss the few huge subtrees, so the skipped siblings are also
+ * assumed to vary like every scanned directory at their depth
+ *
+ * @file estimate.h
+ * @author William Sandström
+ */
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+// Amount of directories to scan fully if --estimate has no budget
+#define ESTIMATE_DEFAULT_BUDGET 10000
+// Two-sided 95% confidence interval of a normal distribution
+#define ESTIMATE_CONFIDENCE_Z 1.96
+// Depths with their own variance statistics, deeper directories share the last
+#define ESTIMATE_DEPTH_COUNT 64
+
+typedef struct EstimateStrata EstimateStrata;
+
+// Variance statistics of an argument per depth, updated atomically during the scan
+struct EstimateStrata {
+    size_t scanned_dirs[ESTIMATE_DEPTH_COUNT];
+    // Scanned directories and their squared totals, each weighted by its
+    // inclusion factor, so they stand for every directory at the depth
+    double weights[ESTIMATE_DEPTH_COUNT];
+    double squared_totals[ESTIMATE_DEPTH_COUNT];
+    // (factor - 1) * subdirectories * inclusion factor of the sampling parents
+    double skipped_weights[ESTIMATE_DEPTH_COUNT];
+};
+
+/**
+ * Seed a random state, different seeds give different samples
+ */
+uint64_t estimate_random_seed(uint64_t seed);
+
+/**
+ * Return a uniformly random integer below bound and advance the state
+ *
+ * @param state random state of the calling thread
+ * @param bound exclusive upper limit, over 0
+ */
+uint64_t estimate_random_below(uint64_t* state, uint64_t bound);
+
+/**
+ * Return the inverse probability of scanning a subdirectory, 1 to always
+ * scan it. Grows by one for every budget of directories already scanned,
+ * so the amount of scanned directories stays a few times the budget
+ *
+ * @param scanned_dirs amount of directories scanned so far
+ * @param budget amount of directories to scan fully
+ */
+size_t estimate_sample_factor(size_t scanned_dirs, size_t budget);
+
+/**
+ * Return the factor a directory samples its subdirectories with, so that
+ * their inclusion factor reaches the current sample factor and not more
+ *
+ * @param sample_factor estimate_sample_factor of the scan so far
+ * @param inclusion_factor inverse probability of scanning the directory,
+ * the product of the factors of it and its parents
+ */
+size_t estimate_subdirectory_factor(size_t sample_factor, size_t inclusion_factor);
+
+/**
+ * Return the variance a sampled subtree adds to the estimate of its parent.
+ * The subtree was scanned with probability 1/factor, its estimate is
+ * scaled by factor and its own variance by factor as well
+ *
+ * @param value estimated total of the subtree, not yet scaled by factor
+ * @param variance estimated variance of value
+ * @param factor inverse probability of scanning the subtree
+ */
+double estimate_sampled_variance(double value, double variance, size_t factor);
+
+/**
+ * Count a directory which is being scanned. Thread safe
+ *
+ * @param depth depth of the directory below the argument
+ */
+void estimate_strata_add_scanned(EstimateStrata* strata, size_t depth);
+
+/**
+ * Return the amount of directories scanned at a depth and above it
+ */
+size_t estimate_strata_scanned(EstimateStrata* strata, size_t depth);
+
+/**
+ * Add the total of a scanned directory to the statistics of its depth.
+ * Thread safe
+ *
+ * @param depth depth of the directory below the argument
+ * @param inclusion_factor inverse probability of scanning the directory
+ * @param value estimated total of the directory, not scaled by its factor
+ */
+void estimate_strata_add_directory(EstimateStrata* strata, size_t depth,
+                                   size_t inclusion_factor, double value);
+
+/**
+ * Add the subdirectories of a directory which sampled them. Thread safe
+ *
+ * @param depth depth of the subdirectories below the argument
+ * @param inclusion_factor inverse probability of scanning the directory
+ * @param factor inverse probability of scanning each subdirectory
+ * @param subdirectory_count subdirectories, scanned or skipped
+ */
+void estimate_strata_add_sampled(EstimateStrata* strata, size_t depth,
+                                 size_t inclusion_factor, size_t factor,
+                                 size_t subdirectory_count);
+
+/**
+ * Return the variance of the sampling, if the subdirectories of every
+ * sampled directory vary like the scanned directories at their depth.
+ * Depths without scanned directories use the closest one above
+ */
+double estimate_pooled_variance(const EstimateStrata* strata);
+
+/**
+ * Return the half-width of the 95% confidence interval of an estimate
+ */
+double estimate_margin(double variance);
+
+/**
+ * Add to a double shared between threads
+ */
+void estimate_atomic_add(double* target, double value);
@@ -0,0 +1,204 @@
+/**
+ * Hash map from file extensions to their total usage,
+ * used to aggregate usage per file type during the scan.
+ * Every thread fills its own map, which are merged at the end
+ *
+ * @file ext_map.c
+ * @author William Sandström
+ */
+#include "ext_map.h"
+
+static uint64_t ext_hash(const char* ext, size_t ext_length);
+static ExtUsage* ext_map_find_slot(ExtUsage* entries, size_t capacity, const char* ext,
+                                   size_t ext_length, uint64_t hash);
+static ExtUsage* ext_map_insert(ExtMap* map, const char* ext, size_t ext_length);
+static void ext_map_grow(ExtMap* map);
+
+/**
+ * Create a new empty extension map. Nothing is allocated until the first add
+ */
+ExtMap ext_map_new() {
+    ExtMap map;
+    map.size = 0;
+    map.capacity = 0;
+    map.entries = NULL;
+    return map;
+}
+
+/**
+ * Free the memory of an extension map and its keys
+ */
+void ext_map_free(ExtMap* map) {
+    for (size_t i = 0; i < map->capacity; i++) {
+        free(map->entries[i].ext);
+    }
+    free(map->entries);
+    map->entries = NULL;
+    map->size = 0;
+    map->capacity = 0;
+}
+
+/**
+ * Create a map of the extensions in a comma separated list, ex "log,tar.gz".
+ * Used as the set of extensions to classify files into
+ */
+ExtMap ext_map_from_list(const char* list) {
+    ExtMap map = ext_map_new();
+    while (*list != '\0') {
+        const char* end = strchrnul(list, ',');
+        const char* ext = list;
+        // Accept both .log and log
+        if (*ext == '.') {
+            ext++;
+        }
+        if (end > ext) {
+            ext_map_insert(&map, ext, end - ext);
+        }
+        list = *end == ',' ? end + 1 : end;
+    }
+    return map;
+}
+
+/**
+ * Add the usage of a single file to the total of its extension
+ *
+ * @param map map to add to
+ * @param ext extension without the leading dot, not null terminated
+ * @param ext_length length of ext
+ * @param size disk usage in bytes
+ * @param apparent_size apparent size in bytes
+ */
+void ext_map_add(ExtMap* map, const char* ext, size_t ext_length, size_t size,
+                 size_t apparent_size) {
+    ExtUsage* usage = ext_map_insert(map, ext, ext_length);
+    usage->size += size;
+    usage->apparent_size += apparent_size;
+    usage->entry_count++;
+}
+
+/**
+ * Return the totals of an extension, or NULL if it has none
+ */
+ExtUsage* ext_map_get(ExtMap* map, const char* ext, size_t ext_length) {
+    if (map->capacity == 0) {
+        return NULL;
+    }
+    ExtUsage* usage = ext_map_find_slot(map->entries, map->capacity, ext, ext_length,
+                                        ext_hash(ext, ext_length));
+    return usage->ext ? usage : NULL;
+}
+
+/**
+ * Add every total of src into dest. src is empty afterwards
+ */
+void ext_map_merge(ExtMap* dest, ExtMap* src) {
+    for (size_t i = 0; i < src->capacity; i++) {
+        ExtUsage* src_usage = &src->entries[i];
+        if (src_usage->ext == NULL) {
+            continue;
+        }
+        ExtUsage* dest_usage = ext_map_insert(dest, src_usage->ext, src_usage->ext_length);
+        dest_usage->size += src_usage->size;
+        dest_usage->apparent_size += src_usage->apparent_size;
+        dest_usage->entry_count += src_usage->entry_count;
+    }
+    ext_map_free(src);
+}
+
+/**
+ * Return the extension of a file name, without the leading dot.
+ * With a set of extensions, the longest suffix in the set is returned,
+ * ex tar.gz for archive.tar.gz. Otherwise the part after the last dot
+ *
+ * @param name file name
+ * @param extensions set of extensions to match, NULL to accept any
+ * @param ext_length output length of the extension
+ * @return start of the extension in name, or NULL if it has none
+ */
+const char* ext_map_classify(const char* name, ExtMap* extensions, size_t* ext_length) {
+    // A leading dot marks a hidden file, not an extension
+    if (name[0] == '\0') {
+        return NULL;
+    }
+    const char* dot = strchr(name + 1, '.');
+    if (dot == NULL) {
+        return NULL;
+    }
+    size_t name_length = strlen(name);
+    if (extensions == NULL) {
+        const char* ext = strrchr(dot, '.') + 1;
+        *ext_length = name + name_length - ext;
+        return *ext_length > 0 ? ext : NULL;
+    }
+    // The first dot gives the longest suffix
+    for (; dot != NULL; dot = strchr(dot + 1, '.')) {
+        const char* ext = dot + 1;
+        size_t length = name + name_length - ext;
+        if (length > 0 && ext_map_get(extensions, ext, length)) {
+            *ext_length = length;
+            return ext;
+        }
+    }
+    return NULL;
+}
+
+// FNV-1a, extensions are short so this is cheap
+static uint64_t ext_hash(const char* ext, size_t ext_length) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < ext_length; i++) {
+        hash ^= (unsigned char) ext[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Return the slot of ext, or the empty slot where it would be inserted
+static ExtUsage* ext_map_find_slot(ExtUsage* entries, size_t capacity, const char* ext,
+                                   size_t ext_length, uint64_t hash) {
+    size_t index = hash & (capacity - 1);
+    while (entries[index].ext &&
+           (entries[index].hash != hash || entries[index].ext_length != ext_length ||
+            memcmp(entries[index].ext, ext, ext_length) != 0)) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &entries[index];
+}
+
+// Return the totals of ext, adding empty totals if it has none
+static ExtUsage* ext_map_insert(ExtMap* map, const char* ext, size_t ext_length) {
+    if (map->capacity == 0) {
+        ext_map_grow(map);
+    }
+    uint64_t hash = ext_hash(ext, ext_length);
+    ExtUsage* usage = ext_map_find_slot(map->entries, map->capacity, ext, ext_length, hash);
+    if (usage->ext == NULL) {
+        // Keep the load factor below 3/4
+        if ((map->size + 1) * 4 > map->capacity * 3) {
+            ext_map_grow(map);
+            usage = ext_map_find_slot(map->entries, map->capacity, ext, ext_length, hash);
+        }
+        usage->ext = checked_malloc(ext_length + 1, sizeof(char));
+        memcpy(usage->ext, ext, ext_length);
+        usage->ext[ext_length] = '\0';
+        usage->ext_length = ext_length;
+        usage->hash = hash;
+        map->size++;
+    }
+    return usage;
+}
+
+// Double the capacity and rehash every total
+static void ext_map_grow(ExtMap* map) {
+    size_t new_capacity = map->capacity > 0 ? map->capacity * 2 : EXT_MAP_INITIAL_CAPACITY;
+    ExtUsage* new_entries = checked_calloc(new_capacity, sizeof(ExtUsage));
+    for (size_t i = 0; i < map->capacity; i++) {
+        ExtUsage* usage = &map->entries[i];
+        if (usage->ext) {
+            *ext_map_find_slot(new_entries, new_capacity, usage->ext, usage->ext_length,
+                               usage->hash) = *usage;
+        }
+    }
+    free(map->entries);
+    map->entries = new_entries;
+    map->capacity = new_capacity;
+}
@@ -0,0 +1,91 @@
+/**
+ * Hash map from file extensions to their total usage,
+ * used to aggregate usage per file type during the scan.
+ * Every thread fills its own map, which are merged at the end
+ *
+ * @file ext_map.h
+ * @author William Sandström
+ */
+#pragma once
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/helpers.h"
+
+#define EXT_MAP_INITIAL_CAPACITY 64
+
+typedef struct ExtUsage ExtUsage;
+typedef struct ExtMap ExtMap;
+
+// Totals of a single extension
+struct ExtUsage {
+    char* ext; // Owned copy of the extension without the leading dot, NULL if unused
+    size_t ext_length;
+    uint64_t hash;
+    size_t size; // Disk usage in bytes
+    size_t apparent_size; // Apparent size in bytes
+    size_t entry_count;
+};
+
+// Open addressing hash map with linear probing, the keys are interned
+struct ExtMap {
+    size_t size;
+    size_t capacity; // A power of two, 0 until the first add
+    ExtUsage* entries;
+};
+
+/**
+ * Create a new empty extension map. Nothing is allocated until the first add
+ */
+ExtMap ext_map_new();
+
+/**
+ * Free the memory of an extension map and its keys
+ */
+void ext_map_free(ExtMap* map);
+
+/**
+ * Create a map of the extensions in a comma separated list, ex "log,tar.gz".
+ * Used as the set of extensions to classify files into
+ */
+ExtMap ext_map_from_list(const char* list);
+
+/**
+ * Add the usage of a single file to the total of its extension
+ *
+ * @param map map to add to
+ * @param ext extension without the leading dot, not null terminated
+ * @param ext_length length of ext
+ * @param size disk usage in bytes
+ * @param apparent_size apparent size in bytes
+ */
+void ext_map_add(ExtMap* map, const char* ext, size_t ext_length, size_t size,
+                 size_t apparent_size);
+
+/**
+ * Return the totals of an extension, or NULL if it has none
+ */
+ExtUsage* ext_map_get(ExtMap* map, const char* ext, size_t ext_length);
+
+/**
+ * Add every total of src into dest. src is empty afterwards
+ */
+void ext_map_merge(ExtMap* dest, ExtMap* src);
+
+/**
+ * Return the extension of a file name, without the leading dot.
+ * With a set of extensions, the longest suffix in the set is returned,
+ * ex tar.gz for archive.tar.gz. Otherwise the part after the last dot
+ *
+ * @param name file name
+ * @param extensions set of extensions to match, NULL to accept any
+ * @param ext_length output length of the extension
+ * @return start of the extension in name, or NULL if it has none
+ */
+const char* ext_map_classify(const char* name, ExtMap* extensions, size_t* ext_length);
@@ -21,9 +21,64 @@ void file_node_free_all(FileNode* node) {
     free(node);
 }
 
+// Free every child of this node, but not the node itself
+void file_node_free_children(FileNode* node) {
+    // Iterate over the siblings to not recurse once per child in wide directories
+    FileNode* child = node->first_child;
+    while (child) {
+        FileNode* next = child->next_sibling;
+        if (child->first_child) {
+            file_node_free_children(child);
+        }
+        free(child);
+        child = next;
+    }
+    node->first_child = NULL;
+    node->last_child = NULL;
+}
+
+// Write the path of the node into buffer, starting from root_path at the root node
+// The buffer is grown if needed. Returns the length of the path
+size_t file_node_get_path(FileNode* node, const char* root_path, char** buffer,
+                          size_t* buffer_size) {
+    size_t root_length = strlen(root_path);
+    bool root_has_slash = root_length > 0 && root_path[root_length - 1] == '/';
+    // Determine the length first, every component adds a slash and the name
+    size_t length = root_length;
+    for (FileNode* current = node; current->parent; current = current->parent) {
+        length += strlen(current->name) + 1;
+    }
+    if (root_has_slash && node->parent) {
+        length--;
+    }
+    if (length + 1 > *buffer_size) {
+        *buffer_size = (length + 1) * 2;
+        *buffer = checked_realloc(*buffer, *buffer_size, sizeof(char));
+    }
+
+    // Fill the path from the back
+    char* path = *buffer;
+    size_t end = length;
+    path[end] = '\0';
+    for (FileNode* current = node; current->parent; current = current->parent) {
+        size_t name_length = strlen(current->name);
+        end -= name_length;
+        memcpy(path + end, current->name, name_length);
+        if (end > root_length || !root_has_slash) {
+            path[--end] = '/';
+        }
+    }
+    memcpy(path, root_path, root_length);
+    return length;
+}
+
 // Add a child to the parent node.
 FileNode* file_tree_add_child(FileNode* parent) {
-    FileNode* node = file_node_new();
+    return file_tree_attach_child(parent, file_node_new());
+}
+
+// Add an existing node without a parent as the last child of the parent node
+FileNode* file_tree_attach_child(FileNode* parent, FileNode* node) {
     if (parent->first_child == NULL) {
         parent->first_child = node;
         parent->last_child = node;
@@ -37,12 +92,37 @@ FileNode* file_tree_add_child(FileNode* parent) {
     return node;
 }
 
+// Remove a node and its subtree from its parent, without freeing it
+void file_tree_detach_child(FileNode* node) {
+    FileNode* parent = node->parent;
+    if (node->previous_sibling) {
+        node->previous_sibling->next_sibling = node->next_sibling;
+    }
+    else if (parent) {
+        parent->first_child = node->next_sibling;
+    }
+    if (node->next_sibling) {
+        node->next_sibling->previous_sibling = node->previous_sibling;
+    }
+    else if (parent) {
+        parent->last_child = node->previous_sibling;
+    }
+    node->parent = NULL;
+    node->next_sibling = NULL;
+    node->previous_sibling = NULL;
+}
+
 // Save the file tree to file (used as cache)
 void file_tree_save(FileNode* root, char* filename) {
     size_t tree_size = file_tree_count_nodes(root);
     FileNode* linear_mem = file_tree_linearize(root, tree_size);
 
     FILE* f = fopen(filename, "wb");
+    if (f == NULL) {
+        perror(filename);
+        free(linear_mem);
+        return;
+    }
     fwrite(linear_mem, sizeof(FileNode), tree_size + 1, f);
     fclose(f);
     free(linear_mem);
@@ -157,6 +237,11 @@ FileNode* file_tree_load(char* filename) {
     // Load tree from file into linear mem
     FileNode* linear_mem = load_file(filename, &file_bytes);
     size_t tree_node_count = file_bytes / sizeof(FileNode);
+    if (tree_node_count < 2 || file_bytes % sizeof(FileNode) != 0) {
+        // Empty, or saved by a version with a different FileNode
+        free(linear_mem);
+        return NULL;
+    }
     // Remap linear mem into dynamic tree
     FileNode* root = file_tree_remap_tree(linear_mem, tree_node_count);
     free(linear_mem);
@@ -197,7 +282,30 @@ FileNode* file_tree_find(FileNode* node, ino_t inode) {
     return NULL;
 }
 
-// Set the name of the file node
+// Set the name of the file node, truncated to fit
 void file_node_set_name(FileNode* node, char* name) {
-    strcpy(node->name, name);
+    snprintf(node->name, sizeof(node->name), "%s", name);
+}
+
+// Find the child of a node with a specific name, NULL if there is none
+FileNode* file_node_find_child(FileNode* node, const char* name) {
+    for (FileNode* child = node->first_child; child; child = child->next_sibling) {
+        if (strcmp(child->name, name) == 0) {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+// Find the child of a node saved for a scan argument, by its path truncated like the
+// names are and its inode, NULL if there is none
+FileNode* file_node_find_argument(FileNode* node, const char* path, ino_t inode) {
+    for (FileNode* child = node->first_child; child; child = child->next_sibling) {
+        // Long paths only differ after the truncated name, the inode tells them apart
+        if (child->inode == inode &&
+            strncmp(child->name, path, sizeof(child->name) - 1) == 0) {
+            return child;
+        }
+    }
+    return NULL;
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include "util/file_helpers.h"
 #include "util/string_helpers.h"
@@ -11,6 +12,9 @@
 typedef struct FileTree FileTree;
 typedef struct FileNode FileNode;
 
+// Modification age buckets: 1 day, 7 days, 30 days, 1 year and older
+#define AGE_BUCKET_COUNT 5
+
 struct FileNode {
     // Data
     char name[256];
@@ -19,6 +23,25 @@ struct FileNode {
     size_t complete_size; // Includes every child size
     size_t depth; // Depth of node from root
     time_t last_access_time; // Last access time
+    size_t apparent_size; // Apparent size (st_size) of this individual file
+    size_t complete_apparent_size; // Apparent size including every child
+    size_t complete_sparse_size; // Apparent size above the allocated size, of sparse files
+    size_t complete_slack_size; // Allocated size above the apparent size, unused block space
+    size_t complete_entry_count; // Amount of entries below and including this node
+    time_t last_modification_time; // Latest modification time below and including this node
+    size_t complete_age_sizes[AGE_BUCKET_COUNT]; // Size per modification age, with children
+    size_t sample_factor; // Inverse probability of scanning this subtree, 0 if always scanned
+    double estimate_variance; // Variance of the totals from sampled subtrees, for --estimate
+    size_t pending_children; // Child directories whose totals are not final yet
+    bool scanned; // Every child has been added
+    bool finalized; // Every child is final, the totals will not change
+    bool incomplete; // Some directory below was not scanned before the deadline
+    int watch_descriptor; // inotify watch of the directory with --watch, 0 if not watched
+    // Ordered output, the records printed before this node and after its children
+    char* preceding_output;
+    size_t preceding_output_size;
+    char* trailing_output;
+    size_t trailing_output_size;
     // Tree information
     FileNode* parent;
     // Children are stored as a linked list
@@ -35,16 +58,37 @@ FileNode* file_node_new();
 // Free the entire tree below, starting with this root node
 void file_node_free_all(FileNode* node);
 
-// Set the name of the file node
+// Free every child of this node, but not the node itself
+void file_node_free_children(FileNode* node);
+
+// Set the name of the file node, truncated to fit
 void file_node_set_name(FileNode* node, char* name);
 
+// Write the path of the node into buffer, starting from root_path at the root node
+// The buffer is grown if needed. Returns the length of the path
+size_t file_node_get_path(FileNode* node, const char* root_path, char** buffer,
+                          size_t* buffer_size);
+
 // Add a child to a file node
 FileNode* file_tree_add_child(FileNode* parent);
 
-// Save the file tree to file (used as cache)
+// Add an existing node without a parent as the last child of a file node
+FileNode* file_tree_attach_child(FileNode* parent, FileNode* node);
+
+// Remove a node and its subtree from its parent, without freeing it
+void file_tree_detach_child(FileNode* node);
+
+// Find the child of a node with a specific name, NULL if there is none
+FileNode* file_node_find_child(FileNode* node, const char* name);
+
+// Find the child of a node saved for a scan argument, by its path truncated like the
+// names are and its inode, NULL if there is none
+FileNode* file_node_find_argument(FileNode* node, const char* path, ino_t inode);
+
+// Load the file tree from file (used as cache), NULL if the file is not a saved tree
 FileNode* file_tree_load(char* filename);
 
-// Load the file tree from file (used as cache)
+// Save the file tree to file (used as cache)
 void file_tree_save(FileNode* root, char* filename);
 
 // Count the amount of nodes in the tree, ie all decendents and neighbours of node
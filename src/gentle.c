@@ -0,0 +1,128 @@
+/**
+ * Low-impact scanning for --gentle, for hosts where the scan should
+ * not hurt the latency of the real workload. The scan gets the idle
+ * IO class, the stat calls of every worker share a rate limit, and
+ * the amount of concurrently scanning workers is halved whenever the
+ * measured stat latency rises above a target, and grows back by one
+ * at a time once it recovers. Everything is lock-free
+ *
+ * @file gentle.c
+ * @author William Sandström
+ */
+#include "gentle.h"
+
+// Not exported by glibc, from linux/ioprio.h
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_WHO_PROCESS 1
+
+static void sleep_nsecs(uint64_t nsecs);
+
+/**
+ * Initialize the shared state of the workers
+ *
+ * @param gentle state to initialize
+ * @param max_threads amount of worker threads
+ * @param ops_per_sec maximum stat calls per second of every worker together, 0 for no limit
+ */
+void gentle_init(Gentle* gentle, size_t max_threads, size_t ops_per_sec) {
+    thread_limit_init(&gentle->threads, max_threads, max_threads);
+    gentle->op_interval_nsecs = ops_per_sec > 0 ? 1000000000ull / ops_per_sec : 0;
+    gentle->next_op_time = 0;
+    gentle->target_latency_nsecs = GENTLE_TARGET_LATENCY_NSECS;
+    gentle->last_adjust_time = 0;
+}
+
+/**
+ * Give the calling process the idle IO class, so that its
+ * IO only runs when no other process needs the disk
+ *
+ * @return false if the IO priority could not be set
+ */
+bool gentle_set_idle_io_priority() {
+    // Threads created afterwards inherit the IO priority
+    return syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                   IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) == 0;
+}
+
+/**
+ * Wait until the rate limit allows another stat call
+ */
+void gentle_wait_for_op(Gentle* gentle) {
+    if (gentle->op_interval_nsecs == 0) {
+        return;
+    }
+    uint64_t wait_nsecs = gentle_reserve_op(gentle, gentle_now());
+    if (wait_nsecs > 0) {
+        sleep_nsecs(wait_nsecs);
+    }
+}
+
+/**
+ * Reserve the time of the next stat call
+ *
+ * @param gentle shared state
+ * @param now current time in nanoseconds, from CLOCK_MONOTONIC
+ * @return nanoseconds to wait before the stat call
+ */
+uint64_t gentle_reserve_op(Gentle* gentle, uint64_t now) {
+    // A token bucket kept as the time of the next allowed call. Unused
+    // time up to the burst length can be caught up with at full speed
+    uint64_t earliest = now > GENTLE_BURST_NSECS ? now - GENTLE_BURST_NSECS : 0;
+    uint64_t next = __atomic_load_n(&gentle->next_op_time, __ATOMIC_RELAXED);
+    uint64_t op_time;
+    do {
+        op_time = next > earliest ? next : earliest;
+    } while (!__atomic_compare_exchange_n(&gentle->next_op_time, &next,
+                                          op_time + gentle->op_interval_nsecs, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return op_time > now ? op_time - now : 0;
+}
+
+/**
+ * Add the measured latency of the stat calls of a directory,
+ * lowering or raising the worker limit if needed
+ *
+ * @param gentle shared state
+ * @param total_nsecs time spent in the stat calls
+ * @param op_count amount of stat calls
+ * @param now current time in nanoseconds, from CLOCK_MONOTONIC
+ */
+void gentle_add_latency(Gentle* gentle, uint64_t total_nsecs, size_t op_count, uint64_t now) {
+    if (op_count == 0) {
+        return;
+    }
+    uint64_t last_adjust = __atomic_load_n(&gentle->last_adjust_time, __ATOMIC_RELAXED);
+    // Give the previous change time to show up in the latency
+    if (now < last_adjust + GENTLE_ADJUST_INTERVAL_NSECS ||
+        !__atomic_compare_exchange_n(&gentle->last_adjust_time, &last_adjust, now, false,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        return;
+    }
+    uint64_t latency = total_nsecs / op_count;
+    size_t limit = thread_limit_get(&gentle->threads);
+    if (latency > gentle->target_latency_nsecs) {
+        // Back off quickly, the disk is busy
+        thread_limit_set(&gentle->threads, limit / 2);
+    }
+    else if (latency < gentle->target_latency_nsecs / 2) {
+        thread_limit_set(&gentle->threads, limit + 1);
+    }
+}
+
+/**
+ * Return the current time in nanoseconds, from CLOCK_MONOTONIC
+ */
+uint64_t gentle_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+// Sleep for a duration, without caring about interruptions
+static void sleep_nsecs(uint64_t nsecs) {
+    struct timespec duration;
+    duration.tv_sec = nsecs / 1000000000ull;
+    duration.tv_nsec = nsecs % 1000000000ull;
+    nanosleep(&duration, NULL);
+}
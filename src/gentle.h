@@ -0,0 +1,88 @@
+/**
+ * Low-impact scanning for --gentle, for hosts where the scan should
+ * not hurt the latency of the real workload. The scan gets the idle
+ * IO class, the stat calls of every worker share a rate limit, and
+ * the amount of concurrently scanning workers is halved whenever the
+ * measured stat latency rises above a target, and grows back by one
+ * at a time once it recovers. Everything is lock-free
+ *
+ * @file gentle.h
+ * @author William Sandström
+ */
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "thread_limit.h"
+
+// Stat calls per second if --gentle has no rate
+#define GENTLE_DEFAULT_OPS 10000
+// The rate limit allows bursts of this long at full speed
+#define GENTLE_BURST_NSECS 100000000ull
+// Average stat latency above which fewer workers are used
+#define GENTLE_TARGET_LATENCY_NSECS 1000000ull
+// Minimum time between two changes of the worker limit
+#define GENTLE_ADJUST_INTERVAL_NSECS 100000000ull
+
+typedef struct Gentle Gentle;
+
+// Shared state of the workers, only accessed with atomics
+struct Gentle {
+    ThreadLimit threads; // Lowered while the stat latency is high
+    uint64_t op_interval_nsecs; // Time between two stat calls, 0 for no rate limit
+    uint64_t next_op_time; // Time the next stat call is allowed, from CLOCK_MONOTONIC
+    uint64_t target_latency_nsecs;
+    uint64_t last_adjust_time;
+};
+
+/**
+ * Initialize the shared state of the workers
+ *
+ * @param gentle state to initialize
+ * @param max_threads amount of worker threads
+ * @param ops_per_sec maximum stat calls per second of every worker together, 0 for no limit
+ */
+void gentle_init(Gentle* gentle, size_t max_threads, size_t ops_per_sec);
+
+/**
+ * Give the calling process the idle IO class, so that its
+ * IO only runs when no other process needs the disk
+ *
+ * @return false if the IO priority could not be set
+ */
+bool gentle_set_idle_io_priority();
+
+/**
+ * Wait until the rate limit allows another stat call
+ */
+void gentle_wait_for_op(Gentle* gentle);
+
+/**
+ * Reserve the time of the next stat call
+ *
+ * @param gentle shared state
+ * @param now current time in nanoseconds, from CLOCK_MONOTONIC
+ * @return nanoseconds to wait before the stat call
+ */
+uint64_t gentle_reserve_op(Gentle* gentle, uint64_t now);
+
+/**
+ * Add the measured latency of the stat calls of a directory,
+ * lowering or raising the worker limit if needed
+ *
+ * @param gentle shared state
+ * @param total_nsecs time spent in the stat calls
+ * @param op_count amount of stat calls
+ * @param now current time in nanoseconds, from CLOCK_MONOTONIC
+ */
+void gentle_add_latency(Gentle* gentle, uint64_t total_nsecs, size_t op_count, uint64_t now);
+
+/**
+ * Return the current time in nanoseconds, from CLOCK_MONOTONIC
+ */
+uint64_t gentle_now();
@@ -0,0 +1,468 @@
+/**
+ * Public C API of librdu, the scanning engine of rdu as a library.
+ * Every scanner has a coordinator thread which runs the scans started
+ * on it, with the worker threads of its scan pool
+ *
+ * @file librdu.c
+ * @author William Sandström
+ */
+#include "librdu.h"
+// The public header is self-contained, the engine is only known here
+#include "args.h"
+#include "disk_usage.h"
+#include "file_node.h"
+#include "scan_pool.h"
+
+typedef struct ScanError ScanError;
+
+enum ScanState {
+    SCAN_IDLE, // No scan was started
+    SCAN_QUEUED, // Started, the coordinator has not taken it yet
+    SCAN_RUNNING,
+    SCAN_DONE, // The results can be read
+};
+
+typedef enum ScanState ScanState;
+
+// Entry which could not be read
+struct ScanError {
+    char* path;
+    int error;
+};
+
+struct RduScanner {
+    ScanPool pool;
+    pthread_t coordinator;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond; // Wakes the coordinator for a scan, and waiters once it is done
+    ScanState state;
+    bool stopping; // The coordinator returns
+    bool cancelled; // Read by the workers, set atomically
+
+    // The scan, owned by the scanner
+    char** paths;
+    size_t path_count;
+    Options options;
+    RduVisitor visitor;
+
+    // Results of the scan, the errors are added by the workers under error_mutex
+    FileNode* tree;
+    FileNode** roots;
+    pthread_mutex_t error_mutex;
+    ScanError* errors;
+    size_t error_count;
+    size_t error_capacity;
+};
+
+static void* run_coordinator_thread(void* arg_ptr);
+static void collect_scan_error(void* context, const char* path, int error);
+static void free_scan(RduScanner* scanner);
+static bool valid_patterns(const char* const* patterns);
+
+/**
+ * Version of the library the program runs with, LIBRDU_VERSION when it was built
+ */
+int rdu_version(void) {
+    return LIBRDU_VERSION;
+}
+
+/**
+ * Name of a status, ex "cancelled"
+ */
+const char* rdu_status_string(RduStatus status) {
+    switch (status) {
+        case RDU_OK:
+            return "ok";
+        case RDU_CANCELLED:
+            return "cancelled";
+        case RDU_ERROR_BUSY:
+            return "a scan is already running";
+        case RDU_ERROR_INVALID:
+            return "invalid argument";
+    }
+    return "unknown status";
+}
+
+/**
+ * Set the default options, which count every entry
+ *
+ * @param options options to initialize
+ */
+void rdu_scan_options_init(RduScanOptions* options) {
+    memset(options, 0, sizeof(RduScanOptions));
+    options->inode_order = RDU_INODE_ORDER_AUTO;
+}
+
+/**
+ * Create a scanner and start its threads
+ *
+ * @param thread_count amount of scanning threads, 0 for one per available CPU
+ * @return the scanner, NULL if the threads could not be started
+ */
+RduScanner* rdu_scanner_new(size_t thread_count) {
+    RduScanner* scanner = checked_calloc(1, sizeof(RduScanner));
+    if (thread_count == 0) {
+        thread_count = available_cpu_count();
+    }
+    if (!scan_pool_init(&scanner->pool, thread_count)) {
+        free(scanner);
+        return NULL;
+    }
+    pthread_mutex_init(&scanner->mutex, NULL);
+    pthread_cond_init(&scanner->cond, NULL);
+    pthread_mutex_init(&scanner->error_mutex, NULL);
+    scanner->state = SCAN_IDLE;
+    scanner->options.patterns = pattern_matcher_new();
+    if (pthread_create(&scanner->coordinator, NULL, run_coordinator_thread, scanner) != 0) {
+        scan_pool_free(&scanner->pool);
+        pattern_matcher_free(&scanner->options.patterns);
+        pthread_mutex_destroy(&scanner->mutex);
+        pthread_cond_destroy(&scanner->cond);
+        pthread_mutex_destroy(&scanner->error_mutex);
+        free(scanner);
+        return NULL;
+    }
+    return scanner;
+}
+
+/**
+ * Amount of scanning threads, thread_index of the visitor is below it
+ */
+size_t rdu_scanner_thread_count(const RduScanner* scanner) {
+    return scanner->pool.thread_count;
+}
+
+/**
+ * Cancel and wait for the running scan, stop the threads and free the
+ * scanner with its results
+ */
+void rdu_scanner_free(RduScanner* scanner) {
+    if (scanner == NULL) {
+        return;
+    }
+    rdu_scan_cancel(scanner);
+    pthread_mutex_lock(&scanner->mutex);
+    while (scanner->state == SCAN_QUEUED || scanner->state == SCAN_RUNNING) {
+        pthread_cond_wait(&scanner->cond, &scanner->mutex);
+    }
+    scanner->stopping = true;
+    pthread_cond_broadcast(&scanner->cond);
+    pthread_mutex_unlock(&scanner->mutex);
+    pthread_join(scanner->coordinator, NULL);
+
+    scan_pool_free(&scanner->pool);
+    free_scan(scanner);
+    pattern_matcher_free(&scanner->options.patterns);
+    pthread_mutex_destroy(&scanner->mutex);
+    pthread_cond_destroy(&scanner->cond);
+    pthread_mutex_destroy(&scanner->error_mutex);
+    free(scanner);
+}
+
+/**
+ * Start scanning paths in the background. The results of the previous
+ * scan are freed. Like rdu, a directory given twice or inside an earlier
+ * path is only counted by the first one
+ *
+ * @param scanner scanner without a running scan
+ * @param paths NULL terminated paths, copied before the function returns
+ * @param options options of the scan, NULL for the defaults
+ * @return RDU_OK, RDU_ERROR_BUSY if a scan is running, or RDU_ERROR_INVALID
+ * if a pattern contains '/'
+ */
+RduStatus rdu_scan_start(RduScanner* scanner, const char* const* paths,
+                         const RduScanOptions* options) {
+    if (scanner == NULL || paths == NULL) {
+        return RDU_ERROR_INVALID;
+    }
+    RduScanOptions default_options;
+    if (options == NULL) {
+        rdu_scan_options_init(&default_options);
+        options = &default_options;
+    }
+    if (options->inode_order > RDU_INODE_ORDER_NEVER || !valid_patterns(options->excludes) ||
+        !valid_patterns(options->includes)) {
+        return RDU_ERROR_INVALID;
+    }
+    pthread_mutex_lock(&scanner->mutex);
+    if (scanner->state == SCAN_QUEUED || scanner->state == SCAN_RUNNING) {
+        pthread_mutex_unlock(&scanner->mutex);
+        return RDU_ERROR_BUSY;
+    }
+    free_scan(scanner);
+
+    size_t path_count = 0;
+    while (paths[path_count]) {
+        path_count++;
+    }
+    scanner->paths = checked_malloc(path_count + 1, sizeof(char*));
+    for (size_t i = 0; i < path_count; i++) {
+        scanner->paths[i] = checked_malloc(strlen(paths[i]) + 1, sizeof(char));
+        strcpy(scanner->paths[i], paths[i]);
+    }
+    scanner->paths[path_count] = NULL;
+    scanner->path_count = path_count;
+
+    // Every tree is kept and nothing is printed, like the scans of the daemon
+    Options* scan_options = &scanner->options;
+    pattern_matcher_free(&scan_options->patterns);
+    memset(scan_options, 0, sizeof(Options));
+    scan_options->files = scanner->paths;
+    scan_options->block_size = 1024;
+    scan_options->max_depth = -1;
+    scan_options->thread_count = scanner->pool.thread_count;
+    scan_options->scan_time = time(NULL);
+    scan_options->older_than = options->older_than;
+    scan_options->newer_than = options->newer_than;
+    scan_options->inode_order = options->inode_order == RDU_INODE_ORDER_ALWAYS ?
+                                    INODE_ORDER_ALWAYS :
+                                options->inode_order == RDU_INODE_ORDER_NEVER ?
+                                    INODE_ORDER_NEVER :
+                                    INODE_ORDER_AUTO;
+    scan_options->patterns = pattern_matcher_new();
+    for (size_t i = 0; options->excludes && options->excludes[i]; i++) {
+        pattern_matcher_add(&scan_options->patterns, options->excludes[i], false);
+    }
+    for (size_t i = 0; options->includes && options->includes[i]; i++) {
+        pattern_matcher_add(&scan_options->patterns, options->includes[i], true);
+    }
+    scan_options->error_handler = collect_scan_error;
+    scan_options->error_context = scanner;
+    scan_options->cancelled = &scanner->cancelled;
+    scan_options->pool = &scanner->pool;
+    if (options->visitor) {
+        scanner->visitor = *options->visitor;
+        scan_options->visitor = &scanner->visitor;
+    }
+
+    __atomic_store_n(&scanner->cancelled, false, __ATOMIC_RELAXED);
+    scanner->state = SCAN_QUEUED;
+    pthread_cond_broadcast(&scanner->cond);
+    pthread_mutex_unlock(&scanner->mutex);
+    return RDU_OK;
+}
+
+/**
+ * Wait until the scan is done
+ *
+ * @return RDU_OK, RDU_CANCELLED if it was cancelled, or RDU_ERROR_INVALID
+ * if no scan was started
+ */
+RduStatus rdu_scan_wait(RduScanner* scanner) {
+    if (scanner == NULL) {
+        return RDU_ERROR_INVALID;
+    }
+    pthread_mutex_lock(&scanner->mutex);
+    while (scanner->state == SCAN_QUEUED || scanner->state == SCAN_RUNNING) {
+        pthread_cond_wait(&scanner->cond, &scanner->mutex);
+    }
+    RduStatus status = RDU_OK;
+    if (scanner->state == SCAN_IDLE) {
+        status = RDU_ERROR_INVALID;
+    }
+    else if (__atomic_load_n(&scanner->cancelled, __ATOMIC_RELAXED)) {
+        status = RDU_CANCELLED;
+    }
+    pthread_mutex_unlock(&scanner->mutex);
+    return status;
+}
+
+/**
+ * Stop the scan from taking new directories, without waiting for it.
+ * The directories being scanned finish, so rdu_scan_wait returns shortly
+ * after. Safe to call from any thread, does nothing without a running scan
+ */
+void rdu_scan_cancel(RduScanner* scanner) {
+    if (scanner == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&scanner->mutex);
+    if (scanner->state == SCAN_QUEUED || scanner->state == SCAN_RUNNING) {
+        __atomic_store_n(&scanner->cancelled, true, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&scanner->mutex);
+}
+
+/**
+ * Amount of paths of the finished scan, the same as given to rdu_scan_start
+ */
+size_t rdu_scan_root_count(const RduScanner* scanner) {
+    return scanner->roots ? scanner->path_count : 0;
+}
+
+/**
+ * Result of a path of the finished scan
+ *
+ * @param index index of the path in the paths given to rdu_scan_start
+ * @return the node of the path, NULL if it could not be read or was counted by
+ * an earlier path
+ */
+const RduNode* rdu_scan_root(const RduScanner* scanner, size_t index) {
+    if (scanner->roots == NULL || index >= scanner->path_count) {
+        return NULL;
+    }
+    return (const RduNode*) scanner->roots[index];
+}
+
+/**
+ * Amount of entries which could not be read during the finished scan
+ */
+size_t rdu_scan_error_count(const RduScanner* scanner) {
+    return scanner->roots ? scanner->error_count : 0;
+}
+
+/**
+ * Path of an entry which could not be read
+ *
+ * @param index index of the error, below rdu_scan_error_count
+ */
+const char* rdu_scan_error_path(const RduScanner* scanner, size_t index) {
+    return index < rdu_scan_error_count(scanner) ? scanner->errors[index].path : NULL;
+}
+
+/**
+ * errno of an entry which could not be read
+ *
+ * @param index index of the error, below rdu_scan_error_count
+ */
+int rdu_scan_error_code(const RduScanner* scanner, size_t index) {
+    return index < rdu_scan_error_count(scanner) ? scanner->errors[index].error : 0;
+}
+
+/**
+ * Name of a node, the path given to the scan for the root nodes. Names
+ * longer than 255 bytes are cut short
+ */
+const char* rdu_node_name(const RduNode* node) {
+    return ((const FileNode*) node)->name;
+}
+
+/**
+ * Disk usage of a node and every entry below it, in bytes
+ */
+size_t rdu_node_size(const RduNode* node) {
+    return ((const FileNode*) node)->complete_size;
+}
+
+/**
+ * Apparent size of a node and every entry below it, in bytes
+ */
+size_t rdu_node_apparent_size(const RduNode* node) {
+    return ((const FileNode*) node)->complete_apparent_size;
+}
+
+/**
+ * Amount of entries below and including a node
+ */
+size_t rdu_node_entry_count(const RduNode* node) {
+    return ((const FileNode*) node)->complete_entry_count;
+}
+
+/**
+ * Latest modification time below and including a node
+ */
+time_t rdu_node_modification_time(const RduNode* node) {
+    return ((const FileNode*) node)->last_modification_time;
+}
+
+/**
+ * Was a directory below the node left out, because the scan was cancelled?
+ */
+bool rdu_node_incomplete(const RduNode* node) {
+    return ((const FileNode*) node)->incomplete;
+}
+
+/**
+ * First subdirectory of a node, NULL if it has none
+ */
+const RduNode* rdu_node_first_child(const RduNode* node) {
+    return (const RduNode*) ((const FileNode*) node)->first_child;
+}
+
+/**
+ * Next subdirectory of the parent of a node, NULL after the last one
+ */
+const RduNode* rdu_node_next_sibling(const RduNode* node) {
+    return (const RduNode*) ((const FileNode*) node)->next_sibling;
+}
+
+// Run every scan started on the scanner, until it is freed
+static void* run_coordinator_thread(void* arg_ptr) {
+    RduScanner* scanner = (RduScanner*) arg_ptr;
+    pthread_mutex_lock(&scanner->mutex);
+    while (true) {
+        while (!scanner->stopping && scanner->state != SCAN_QUEUED) {
+            pthread_cond_wait(&scanner->cond, &scanner->mutex);
+        }
+        if (scanner->stopping) {
+            break;
+        }
+        scanner->state = SCAN_RUNNING;
+        pthread_mutex_unlock(&scanner->mutex);
+
+        // The tree of every path, by its index. Paths which could not be read or
+        // were counted by an earlier path have none
+        FileNode** roots = checked_calloc(scanner->path_count + 1, sizeof(FileNode*));
+        FileNode* tree = disk_usage_tree(scanner->options, roots);
+
+        pthread_mutex_lock(&scanner->mutex);
+        scanner->tree = tree;
+        scanner->roots = roots;
+        scanner->state = SCAN_DONE;
+        pthread_cond_broadcast(&scanner->cond);
+    }
+    pthread_mutex_unlock(&scanner->mutex);
+    return NULL;
+}
+
+// Error handler of the scans, called by the workers
+static void collect_scan_error(void* context, const char* path, int error) {
+    RduScanner* scanner = (RduScanner*) context;
+    char* path_copy = checked_malloc(strlen(path) + 1, sizeof(char));
+    strcpy(path_copy, path);
+    pthread_mutex_lock(&scanner->error_mutex);
+    if (scanner->error_count == scanner->error_capacity) {
+        scanner->error_capacity = scanner->error_capacity ? scanner->error_capacity * 2 : 16;
+        scanner->errors = checked_realloc(scanner->errors, scanner->error_capacity,
+                                          sizeof(ScanError));
+    }
+    scanner->errors[scanner->error_count].path = path_copy;
+    scanner->errors[scanner->error_count].error = error;
+    scanner->error_count++;
+    pthread_mutex_unlock(&scanner->error_mutex);
+}
+
+// Free the paths and results of the previous scan
+static void free_scan(RduScanner* scanner) {
+    if (scanner->paths) {
+        for (size_t i = 0; i < scanner->path_count; i++) {
+            free(scanner->paths[i]);
+        }
+        free(scanner->paths);
+        scanner->paths = NULL;
+        scanner->path_count = 0;
+    }
+    if (scanner->tree) {
+        file_node_free_all(scanner->tree);
+        scanner->tree = NULL;
+    }
+    free(scanner->roots);
+    scanner->roots = NULL;
+    for (size_t i = 0; i < scanner->error_count; i++) {
+        free(scanner->errors[i].path);
+    }
+    free(scanner->errors);
+    scanner->errors = NULL;
+    scanner->error_count = 0;
+    scanner->error_capacity = 0;
+}
+
+// Does no pattern of a NULL terminated list, which may be NULL, contain '/'?
+static bool valid_patterns(const char* const* patterns) {
+    for (size_t i = 0; patterns && patterns[i]; i++) {
+        if (!pattern_matcher_is_valid_pattern(patterns[i])) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,249 @@
+/**
+ * Public C API of librdu, the scanning engine of rdu as a library.
+ * A scanner owns a pool of worker threads which is reused by every scan
+ * started on it. A scan runs in the background from rdu_scan_start until
+ * rdu_scan_wait returns, and its results stay readable until the next
+ * scan or rdu_scanner_free. Unreadable entries are collected with the
+ * results instead of printed, and nothing in the library exits or writes
+ * to stdout or stderr, except when memory runs out.
+ *
+ * This header is self-contained. New functions and new fields at the end
+ * of RduScanOptions can be added, existing ones keep their meaning.
+ *
+ * @file librdu.h
+ * @author William Sandström
+ */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RDU_API __attribute__((visibility("default")))
+
+// Increased whenever functions or RduScanOptions fields are added
+#define LIBRDU_VERSION 2
+
+typedef struct RduScanner RduScanner;
+// Directory of the results, or a path given to the scan which is not a directory
+typedef struct RduNode RduNode;
+typedef struct RduScanOptions RduScanOptions;
+typedef struct RduEntry RduEntry;
+typedef struct RduDirectory RduDirectory;
+typedef struct RduVisitor RduVisitor;
+
+typedef enum RduStatus {
+    RDU_OK = 0,
+    RDU_CANCELLED, // The scan was cancelled, the totals are missing some directories
+    RDU_ERROR_BUSY, // A scan is already running on the scanner
+    RDU_ERROR_INVALID, // Invalid argument, or no scan was started
+} RduStatus;
+
+// When the entries of a directory are stat:ed in inode order
+typedef enum RduInodeOrder {
+    RDU_INODE_ORDER_AUTO = 0, // On spinning disks only
+    RDU_INODE_ORDER_ALWAYS,
+    RDU_INODE_ORDER_NEVER,
+} RduInodeOrder;
+
+// Entry of a scanned directory, valid until the visitor returns
+struct RduEntry {
+    const char* name;
+    unsigned char type; // d_type of the entry, DT_UNKNOWN if the file system does not have it
+    bool counted; // Passes the age filters and include patterns, so it is in the totals
+    uint64_t inode;
+    uint32_t mode;
+    uint32_t uid;
+    uint32_t gid;
+    uint64_t link_count;
+    size_t size; // Disk usage in bytes
+    size_t apparent_size;
+    time_t modification_time;
+};
+
+// Directory whose totals are final, valid until the visitor returns
+struct RduDirectory {
+    const char* path; // Starts with the path given to the scan
+    size_t depth; // 0 for the paths given to the scan
+    size_t size; // Disk usage of the directory and every entry below it, in bytes
+    size_t apparent_size;
+    size_t entry_count; // Entries below and including the directory
+    time_t modification_time; // Latest modification time below and including the directory
+    bool incomplete; // A directory below was left out, because the scan was cancelled
+};
+
+// Callbacks run by the scanning threads during a scan. A thread only calls
+// the visitor for its own directories, and never for two at once, so state
+// kept per thread_index needs no locks. Either callback can be NULL
+struct RduVisitor {
+    // Entries of a directory, in batches of at most a few thousand entries.
+    // Most directories are one batch, large ones are split into several.
+    // Excluded entries are left out
+    void (*entries)(void* context, size_t thread_index, const char* directory_path,
+                    size_t depth, const RduEntry* entries, size_t count);
+    // A directory is final, after every batch of its entries and every subdirectory
+    void (*directory)(void* context, size_t thread_index, const RduDirectory* directory);
+    void* context; // Passed to the callbacks
+};
+
+// Set with rdu_scan_options_init before changing fields, so new fields get their defaults
+struct RduScanOptions {
+    // NULL terminated glob patterns of names, like --exclude. Patterns cannot contain '/'
+    const char* const* excludes;
+    // NULL terminated glob patterns of counted files, like --include. Directories are
+    // always descended into and counted
+    const char* const* includes;
+    time_t older_than; // Only count entries modified before this time, 0 to count all
+    time_t newer_than; // Only count entries modified after this time, 0 to count all
+    RduInodeOrder inode_order;
+    // Called during the scan, NULL for none. Copied by rdu_scan_start. With a visitor,
+    // only the totals of the scanned paths are kept, without their subdirectories
+    const RduVisitor* visitor;
+};
+
+/**
+ * Version of the library the program runs with, LIBRDU_VERSION when it was built
+ */
+RDU_API int rdu_version(void);
+
+/**
+ * Name of a status, ex "cancelled"
+ */
+RDU_API const char* rdu_status_string(RduStatus status);
+
+/**
+ * Set the default options, which count every entry
+ *
+ * @param options options to initialize
+ */
+RDU_API void rdu_scan_options_init(RduScanOptions* options);
+
+/**
+ * Create a scanner and start its threads
+ *
+ * @param thread_count amount of scanning threads, 0 for one per available CPU
+ * @return the scanner, NULL if the threads could not be started
+ */
+RDU_API RduScanner* rdu_scanner_new(size_t thread_count);
+
+/**
+ * Amount of scanning threads, thread_index of the visitor is below it
+ */
+RDU_API size_t rdu_scanner_thread_count(const RduScanner* scanner);
+
+/**
+ * Cancel and wait for the running scan, stop the threads and free the
+ * scanner with its results
+ */
+RDU_API void rdu_scanner_free(RduScanner* scanner);
+
+/**
+ * Start scanning paths in the background. The results of the previous
+ * scan are freed. Like rdu, a directory given twice or inside an earlier
+ * path is only counted by the first one
+ *
+ * @param scanner scanner without a running scan
+ * @param paths NULL terminated paths, copied before the function returns
+ * @param options options of the scan, NULL for the defaults
+ * @return RDU_OK, RDU_ERROR_BUSY if a scan is running, or RDU_ERROR_INVALID
+ * if a pattern contains '/'
+ */
+RDU_API RduStatus rdu_scan_start(RduScanner* scanner, const char* const* paths,
+                                 const RduScanOptions* options);
+
+/**
+ * Wait until the scan is done
+ *
+ * @return RDU_OK, RDU_CANCELLED if it was cancelled, or RDU_ERROR_INVALID
+ * if no scan was started
+ */
+RDU_API RduStatus rdu_scan_wait(RduScanner* scanner);
+
+/**
+ * Stop the scan from taking new directories, without waiting for it.
+ * The directories being scanned finish, so rdu_scan_wait returns shortly
+ * after. Safe to call from any thread, does nothing without a running scan
+ */
+RDU_API void rdu_scan_cancel(RduScanner* scanner);
+
+/**
+ * Amount of paths of the finished scan, the same as given to rdu_scan_start
+ */
+RDU_API size_t rdu_scan_root_count(const RduScanner* scanner);
+
+/**
+ * Result of a path of the finished scan
+ *
+ * @param index index of the path in the paths given to rdu_scan_start
+ * @return the node of the path, NULL if it could not be read or was counted by
+ * an earlier path
+ */
+RDU_API const RduNode* rdu_scan_root(const RduScanner* scanner, size_t index);
+
+/**
+ * Amount of entries which could not be read during the finished scan
+ */
+RDU_API size_t rdu_scan_error_count(const RduScanner* scanner);
+
+/**
+ * Path of an entry which could not be read
+ *
+ * @param index index of the error, below rdu_scan_error_count
+ */
+RDU_API const char* rdu_scan_error_path(const RduScanner* scanner, size_t index);
+
+/**
+ * errno of an entry which could not be read
+ *
+ * @param index index of the error, below rdu_scan_error_count
+ */
+RDU_API int rdu_scan_error_code(const RduScanner* scanner, size_t index);
+
+/**
+ * Name of a node, the path given to the scan for the root nodes. Names
+ * longer than 255 bytes are cut short
+ */
+RDU_API const char* rdu_node_name(const RduNode* node);
+
+/**
+ * Disk usage of a node and every entry below it, in bytes
+ */
+RDU_API size_t rdu_node_size(const RduNode* node);
+
+/**
+ * Apparent size of a node and every entry below it, in bytes
+ */
+RDU_API size_t rdu_node_apparent_size(const RduNode* node);
+
+/**
+ * Amount of entries below and including a node
+ */
+RDU_API size_t rdu_node_entry_count(const RduNode* node);
+
+/**
+ * Latest modification time below and including a node
+ */
+RDU_API time_t rdu_node_modification_time(const RduNode* node);
+
+/**
+ * Was a directory below the node left out, because the scan was cancelled?
+ */
+RDU_API bool rdu_node_incomplete(const RduNode* node);
+
+/**
+ * First subdirectory of a node, NULL if it has none
+ */
+RDU_API const RduNode* rdu_node_first_child(const RduNode* node);
+
+/**
+ * Next subdirectory of the parent of a node, NULL after the last one
+ */
+RDU_API const RduNode* rdu_node_next_sibling(const RduNode* node);
+
+#ifdef __cplusplus
+}
+#endif
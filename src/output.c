@@ -0,0 +1,1167 @@
+/**
+ * This file implements buffered output of disk usage
+ * records in the text and machine-readable formats.
+ * Records are formatted into per-thread buffers, which are
+ * handed to a writer thread and written in large chunks
+ *
+ * @file output.c
+ * @author William Sandström
+ */
+#include "output.h"
+
+static const char hex_digits[] = "0123456789abcdef";
+static const char human_suffixes[] = "KMGTPE";
+
+static size_t utf8_sequence_length(const unsigned char* str, size_t remaining);
+static size_t output_format_text_size(Output* output, char* dest, uint64_t bytes);
+static size_t output_format_text_value(Output* output, char* dest, uint64_t value);
+static size_t output_format_text_time(char* dest, time_t time);
+static void* run_output_writer_thread(void* arg_ptr);
+static bool output_ordered_advance(Output* output);
+static void output_ordered_emit(Output* output, char** segment, size_t* segment_size);
+static void output_write_chunk(Output* output, OutputChunk* chunk);
+static void output_write_all(int fd, const char* data, size_t size);
+static void output_recycle_chunk(Output* output, OutputChunk* chunk);
+static OutputChunk* output_chunk_new(Output* output, size_t min_capacity);
+static void output_chunk_free(OutputChunk* chunk);
+static void output_buffer_reserve(OutputBuffer* buffer, size_t bytes);
+
+/**
+ * Initialize the shared output and start the writer thread
+ *
+ * @param output output to initialize
+ * @param fd file descriptor to write to, -1 to drop the records without a writer thread
+ * @param options options from cmd args
+ */
+void output_init(Output* output, int fd, Options* options) {
+    memset(output, 0, sizeof(Output));
+    output->fd = fd;
+    output->format = options->output_format;
+    output->include_time = options->track_modification_time;
+    output->human_readable = options->human_readable;
+    output->block_size = options->block_size;
+    output->apparent_size = options->apparent_size;
+    output->show_slack = options->show_slack;
+    output->count_inodes = options->count_inodes;
+    output->age_histogram = options->age_histogram;
+    output->histogram_report = options->size_histogram;
+    output->estimate_report = options->estimate_budget > 0;
+    output->summary_report = options->by_user || options->by_group || options->by_ext;
+    output->ordered = options->ordered_output;
+    output->keep_nodes = options->create_cache_location != NULL;
+
+    // Pipes get the pages mapped in with vmsplice instead of copied with write
+    struct stat st_info;
+    if (fstat(fd, &st_info) == 0 && S_ISFIFO(st_info.st_mode)) {
+        // A larger pipe means fewer wakeups, this is allowed to fail
+        fcntl(fd, F_SETPIPE_SZ, OUTPUT_CHUNK_SIZE * 2);
+        long pipe_size = fcntl(fd, F_GETPIPE_SZ);
+        if (pipe_size > 0) {
+            output->use_vmsplice = true;
+            output->pipe_pages = pipe_size / sysconf(_SC_PAGESIZE);
+        }
+    }
+
+    pthread_mutex_init(&output->queue_mutex, NULL);
+    pthread_cond_init(&output->writer_cond, NULL);
+    pthread_cond_init(&output->done_cond, NULL);
+    if (fd == -1) {
+        return;
+    }
+    pthread_create(&output->writer_thread, NULL, run_output_writer_thread,
+                   (void*) output);
+}
+
+/**
+ * Write everything which is queued, then stop the
+ * writer thread and free the output
+ */
+void output_destroy(Output* output) {
+    if (output->fd != -1) {
+        pthread_mutex_lock(&output->queue_mutex);
+        output->stopping = true;
+        pthread_cond_signal(&output->writer_cond);
+        pthread_mutex_unlock(&output->queue_mutex);
+        pthread_join(output->writer_thread, NULL);
+    }
+
+    // The in-flight pages stay referenced by the pipe after unmapping
+    OutputChunk* chunk_lists[] = { output->free_chunks, output->in_flight_head };
+    for (size_t i = 0; i < 2; i++) {
+        OutputChunk* chunk = chunk_lists[i];
+        while (chunk) {
+            OutputChunk* next = chunk->next;
+            output_chunk_free(chunk);
+            chunk = next;
+        }
+    }
+    pthread_mutex_destroy(&output->queue_mutex);
+    pthread_cond_destroy(&output->writer_cond);
+    pthread_cond_destroy(&output->done_cond);
+}
+
+/**
+ * Is the output a machine-readable record format?
+ */
+bool output_is_record_format(OutputFormat format) {
+    return format != FORMAT_TEXT;
+}
+
+/**
+ * Print the directories of the tree below root in du order,
+ * as they become final. Only used in ordered mode.
+ * The workers move their records into the preceding_output
+ * and trailing_output of the nodes instead of flushing them
+ */
+void output_ordered_start(Output* output, FileNode* root) {
+    pthread_mutex_lock(&output->queue_mutex);
+    output->ordered_node = root;
+    output->ordered_next_child = NULL;
+    output->ordered_started_children = false;
+    output->ordered_root = root;
+    pthread_cond_signal(&output->writer_cond);
+    pthread_mutex_unlock(&output->queue_mutex);
+}
+
+/**
+ * Wait until the writer thread has printed the entire tree
+ * passed to output_ordered_start
+ */
+void output_ordered_wait(Output* output) {
+    pthread_mutex_lock(&output->queue_mutex);
+    pthread_cond_signal(&output->writer_cond);
+    while (output->ordered_root) {
+        pthread_cond_wait(&output->done_cond, &output->queue_mutex);
+    }
+    pthread_mutex_unlock(&output->queue_mutex);
+}
+
+/**
+ * Create a new output buffer writing into output
+ */
+OutputBuffer output_buffer_new(Output* output) {
+    OutputBuffer buffer;
+    buffer.output = output;
+    buffer.chunk = output_chunk_new(output, OUTPUT_CHUNK_SIZE);
+    return buffer;
+}
+
+/**
+ * Flush and free the memory of an output buffer
+ */
+void output_buffer_free(OutputBuffer* buffer) {
+    output_buffer_flush(buffer);
+    output_recycle_chunk(buffer->output, buffer->chunk);
+    buffer->chunk = NULL;
+}
+
+/**
+ * Hand the buffer contents to the writer thread
+ */
+void output_buffer_flush(OutputBuffer* buffer) {
+    if (buffer->chunk->size == 0) {
+        return;
+    }
+    Output* output = buffer->output;
+    if (output->fd == -1) {
+        buffer->chunk->size = 0;
+        return;
+    }
+    OutputChunk* chunk = buffer->chunk;
+    pthread_mutex_lock(&output->queue_mutex);
+    while (output->queued_chunks >= OUTPUT_MAX_QUEUED_CHUNKS) {
+        // The writer can not keep up, wait instead of queueing unbounded memory
+        pthread_cond_wait(&output->done_cond, &output->queue_mutex);
+    }
+    if (output->queue_tail) {
+        output->queue_tail->next = chunk;
+    }
+    else {
+        output->queue_head = chunk;
+    }
+    output->queue_tail = chunk;
+    output->queued_chunks++;
+    pthread_cond_signal(&output->writer_cond);
+    pthread_mutex_unlock(&output->queue_mutex);
+
+    buffer->chunk = output_chunk_new(output, OUTPUT_CHUNK_SIZE);
+}
+
+/**
+ * Move the buffer contents to the end of a separately
+ * allocated segment, used for ordered output
+ */
+void output_buffer_move_to(OutputBuffer* buffer, char** segment, size_t* segment_size) {
+    OutputChunk* chunk = buffer->chunk;
+    if (chunk->size == 0) {
+        return;
+    }
+    *segment = checked_realloc(*segment, *segment_size + chunk->size, sizeof(char));
+    memcpy(*segment + *segment_size, chunk->data, chunk->size);
+    *segment_size += chunk->size;
+    chunk->size = 0;
+}
+
+/**
+ * Write the header line of the format, if it has one
+ */
+void output_buffer_add_header(OutputBuffer* buffer) {
+    if (buffer->output->format != FORMAT_CSV) {
+        return;
+    }
+    char header[256];
+    if (buffer->output->summary_report) {
+        strcpy(header, "type,id,name,size,apparent_size,entries\r\n");
+    }
+    else if (buffer->output->histogram_report) {
+        strcpy(header, "path,min_size,max_size,files,size,apparent_size\r\n");
+    }
+    else if (buffer->output->estimate_report) {
+        strcpy(header, "path,size,low,high,scanned_dirs\r\n");
+    }
+    else {
+        // The optional columns are in the same order as in the records
+        strcpy(header, "path,type,size,apparent_size,sparse_size,slack_size,entries,depth");
+        if (buffer->output->age_histogram) {
+            strcat(header, ",age_1d,age_7d,age_30d,age_1y,age_older");
+        }
+        if (buffer->output->include_time) {
+            strcat(header, ",mtime");
+        }
+        strcat(header, "\r\n");
+    }
+    size_t length = strlen(header);
+    output_buffer_reserve(buffer, length);
+    memcpy(buffer->chunk->data + buffer->chunk->size, header, length);
+    buffer->chunk->size += length;
+}
+
+void output_buffer_add_record(OutputBuffer* buffer, OutputRecord* record) {
+    Output* output = buffer->output;
+    // Worst case is a fully escaped JSON path, plus the numeric fields
+    output_buffer_reserve(buffer, record->path_length * 6 + 512);
+    OutputChunk* chunk = buffer->chunk;
+    char* dest = chunk->data + chunk->size;
+    char* start = dest;
+    const char* type = record->is_dir ? "dir" : "file";
+
+    switch (output->format) {
+        case FORMAT_NDJSON:
+            memcpy(dest, "{\"path\":", 8);
+            dest += 8;
+            dest += output_escape_json(dest, record->path, record->path_length);
+            memcpy(dest, ",\"type\":\"", 9);
+            dest += 9;
+            memcpy(dest, type, strlen(type));
+            dest += strlen(type);
+            memcpy(dest, "\",\"size\":", 9);
+            dest += 9;
+            dest += output_format_uint(dest, record->size);
+            memcpy(dest, ",\"apparent_size\":", 17);
+            dest += 17;
+            dest += output_format_uint(dest, record->apparent_size);
+            memcpy(dest, ",\"sparse_size\":", 15);
+            dest += 15;
+            dest += output_format_uint(dest, record->sparse_size);
+            memcpy(dest, ",\"slack_size\":", 14);
+            dest += 14;
+            dest += output_format_uint(dest, record->slack_size);
+            memcpy(dest, ",\"entries\":", 11);
+            dest += 11;
+            dest += output_format_uint(dest, record->entry_count);
+            memcpy(dest, ",\"depth\":", 9);
+            dest += 9;
+            dest += output_format_uint(dest, record->depth);
+            if (output->age_histogram) {
+                memcpy(dest, ",\"age_sizes\":[", 14);
+                dest += 14;
+                for (size_t i = 0; i < AGE_BUCKET_COUNT; i++) {
+                    if (i > 0) {
+                        *dest++ = ',';
+                    }
+                    dest += output_format_uint(dest, record->age_sizes[i]);
+                }
+                *dest++ = ']';
+            }
+            if (output->include_time) {
+                memcpy(dest, ",\"mtime\":", 9);
+                dest += 9;
+                dest += output_format_uint(dest, record->modification_time);
+            }
+            memcpy(dest, "}\n", 2);
+            dest += 2;
+            break;
+        case FORMAT_CSV:
+            dest += output_escape_csv(dest, record->path, record->path_length);
+            *dest++ = ',';
+            memcpy(dest, type, strlen(type));
+            dest += strlen(type);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->size);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->apparent_size);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->sparse_size);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->slack_size);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->entry_count);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->depth);
+            if (output->age_histogram) {
+                for (size_t i = 0; i < AGE_BUCKET_COUNT; i++) {
+                    *dest++ = ',';
+                    dest += output_format_uint(dest, record->age_sizes[i]);
+                }
+            }
+            if (output->include_time) {
+                *dest++ = ',';
+                dest += output_format_uint(dest, record->modification_time);
+            }
+            memcpy(dest, "\r\n", 2);
+            dest += 2;
+            break;
+        case FORMAT_TSV0:
+            // The path is the last field, so tabs inside it stay unambiguous
+            dest += output_format_uint(dest, record->size);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->apparent_size);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->sparse_size);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->slack_size);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->entry_count);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->depth);
+            *dest++ = '\t';
+            memcpy(dest, type, strlen(type));
+            dest += strlen(type);
+            *dest++ = '\t';
+            if (output->age_histogram) {
+                for (size_t i = 0; i < AGE_BUCKET_COUNT; i++) {
+                    dest += output_format_uint(dest, record->age_sizes[i]);
+                    *dest++ = '\t';
+                }
+            }
+            if (output->include_time) {
+                dest += output_format_uint(dest, record->modification_time);
+                *dest++ = '\t';
+            }
+            memcpy(dest, record->path, record->path_length);
+            dest += record->path_length;
+            *dest++ = '\0';
+            break;
+        case FORMAT_TEXT:
+            if (output->count_inodes) {
+                // Counts are not scaled by the block size
+                dest += output->human_readable ?
+                            output_format_human(dest, record->entry_count) :
+                            output_format_uint(dest, record->entry_count);
+            }
+            else if (output->show_slack) {
+                dest += output_format_text_size(output, dest, record->size);
+                *dest++ = '\t';
+                dest += output_format_text_size(output, dest, record->apparent_size);
+                *dest++ = '\t';
+                dest += output_format_text_size(output, dest, record->sparse_size);
+                *dest++ = '\t';
+                dest += output_format_text_size(output, dest, record->slack_size);
+            }
+            else {
+                dest += output_format_text_size(output, dest,
+                                                output->apparent_size ?
+                                                    record->apparent_size :
+                                                    record->size);
+            }
+            if (output->age_histogram) {
+                for (size_t i = 0; i < AGE_BUCKET_COUNT; i++) {
+                    *dest++ = '\t';
+                    dest += output_format_text_size(output, dest, record->age_sizes[i]);
+                }
+            }
+            if (output->include_time) {
+                *dest++ = '\t';
+                dest += output_format_text_time(dest, record->modification_time);
+            }
+            *dest++ = '\t';
+            memcpy(dest, record->path, record->path_length);
+            dest += record->path_length;
+            *dest++ = '\n';
+            break;
+    }
+    chunk->size += dest - start;
+
+    // Ordered output is moved into the file nodes instead
+    if (!output->ordered && chunk->size >= OUTPUT_BUFFER_FLUSH_SIZE) {
+        output_buffer_flush(buffer);
+    }
+}
+
+/**
+ * Format the total of a user, group or extension into the buffer
+ */
+void output_buffer_add_summary_record(OutputBuffer* buffer, OutputSummaryRecord* record) {
+    Output* output = buffer->output;
+    size_t name_length = strlen(record->name);
+    output_buffer_reserve(buffer, name_length * 6 + 256);
+    OutputChunk* chunk = buffer->chunk;
+    char* dest = chunk->data + chunk->size;
+    char* start = dest;
+    const char* type = record->type;
+
+    switch (output->format) {
+        case FORMAT_NDJSON:
+            memcpy(dest, "{\"type\":\"", 9);
+            dest += 9;
+            memcpy(dest, type, strlen(type));
+            dest += strlen(type);
+            *dest++ = '"';
+            if (record->has_id) {
+                memcpy(dest, ",\"id\":", 6);
+                dest += 6;
+                dest += output_format_uint(dest, record->id);
+            }
+            memcpy(dest, ",\"name\":", 8);
+            dest += 8;
+            dest += output_escape_json(dest, record->name, name_length);
+            memcpy(dest, ",\"size\":", 8);
+            dest += 8;
+            dest += output_format_uint(dest, record->size);
+            memcpy(dest, ",\"apparent_size\":", 17);
+            dest += 17;
+            dest += output_format_uint(dest, record->apparent_size);
+            memcpy(dest, ",\"entries\":", 11);
+            dest += 11;
+            dest += output_format_uint(dest, record->entry_count);
+            memcpy(dest, "}\n", 2);
+            dest += 2;
+            break;
+        case FORMAT_CSV:
+            memcpy(dest, type, strlen(type));
+            dest += strlen(type);
+            *dest++ = ',';
+            if (record->has_id) {
+                dest += output_format_uint(dest, record->id);
+            }
+            *dest++ = ',';
+            dest += output_escape_csv(dest, record->name, name_length);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->size);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->apparent_size);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->entry_count);
+            memcpy(dest, "\r\n", 2);
+            dest += 2;
+            break;
+        case FORMAT_TSV0:
+            // The name is the last field, like the path of other records
+            dest += output_format_uint(dest, record->size);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->apparent_size);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->entry_count);
+            *dest++ = '\t';
+            memcpy(dest, type, strlen(type));
+            dest += strlen(type);
+            *dest++ = '\t';
+            if (record->has_id) {
+                dest += output_format_uint(dest, record->id);
+            }
+            *dest++ = '\t';
+            memcpy(dest, record->name, name_length);
+            dest += name_length;
+            *dest++ = '\0';
+            break;
+        case FORMAT_TEXT:
+            if (output->count_inodes) {
+                dest += output->human_readable ?
+                            output_format_human(dest, record->entry_count) :
+                            output_format_uint(dest, record->entry_count);
+            }
+            else {
+                dest += output_format_text_size(output, dest,
+                                                output->apparent_size ?
+                                                    record->apparent_size :
+                                                    record->size);
+            }
+            *dest++ = '\t';
+            memcpy(dest, type, strlen(type));
+            dest += strlen(type);
+            *dest++ = '\t';
+            memcpy(dest, record->name, name_length);
+            dest += name_length;
+            *dest++ = '\n';
+            break;
+    }
+    chunk->size += dest - start;
+
+    if (!output->ordered && chunk->size >= OUTPUT_BUFFER_FLUSH_SIZE) {
+        output_buffer_flush(buffer);
+    }
+}
+
+/**
+ * Format a bucket of a size histogram into the buffer
+ */
+void output_buffer_add_histogram_record(OutputBuffer* buffer, OutputHistogramRecord* record) {
+    Output* output = buffer->output;
+    output_buffer_reserve(buffer, record->path_length * 6 + 256);
+    OutputChunk* chunk = buffer->chunk;
+    char* dest = chunk->data + chunk->size;
+    char* start = dest;
+
+    switch (output->format) {
+        case FORMAT_NDJSON:
+            memcpy(dest, "{\"path\":", 8);
+            dest += 8;
+            dest += output_escape_json(dest, record->path, record->path_length);
+            memcpy(dest, ",\"type\":\"size_bucket\",\"min_size\":", 33);
+            dest += 33;
+            dest += output_format_uint(dest, record->min_size);
+            memcpy(dest, ",\"max_size\":", 12);
+            dest += 12;
+            dest += output_format_uint(dest, record->max_size);
+            memcpy(dest, ",\"files\":", 9);
+            dest += 9;
+            dest += output_format_uint(dest, record->file_count);
+            memcpy(dest, ",\"size\":", 8);
+            dest += 8;
+            dest += output_format_uint(dest, record->size);
+            memcpy(dest, ",\"apparent_size\":", 17);
+            dest += 17;
+            dest += output_format_uint(dest, record->apparent_size);
+            memcpy(dest, "}\n", 2);
+            dest += 2;
+            break;
+        case FORMAT_CSV:
+            dest += output_escape_csv(dest, record->path, record->path_length);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->min_size);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->max_size);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->file_count);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->size);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->apparent_size);
+            memcpy(dest, "\r\n", 2);
+            dest += 2;
+            break;
+        case FORMAT_TSV0:
+            dest += output_format_uint(dest, record->min_size);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->max_size);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->file_count);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->size);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->apparent_size);
+            *dest++ = '\t';
+            memcpy(dest, record->path, record->path_length);
+            dest += record->path_length;
+            *dest++ = '\0';
+            break;
+        case FORMAT_TEXT:
+            // The bucket as a half-open range, ex 4.0K-8.0K
+            dest += output_format_human(dest, record->min_size);
+            if (record->max_size > record->min_size) {
+                *dest++ = '-';
+                if (record->max_size < SIZE_MAX) {
+                    dest += output_format_human(dest, record->max_size + 1);
+                }
+            }
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->file_count);
+            *dest++ = '\t';
+            dest += output_format_text_size(output, dest,
+                                            output->apparent_size ? record->apparent_size :
+                                                                    record->size);
+            *dest++ = '\t';
+            memcpy(dest, record->path, record->path_length);
+            dest += record->path_length;
+            *dest++ = '\n';
+            break;
+    }
+    chunk->size += dest - start;
+
+    if (!output->ordered && chunk->size >= OUTPUT_BUFFER_FLUSH_SIZE) {
+        output_buffer_flush(buffer);
+    }
+}
+
+/**
+ * Format the estimated total of an argument into the buffer
+ */
+void output_buffer_add_estimate_record(OutputBuffer* buffer, OutputEstimateRecord* record) {
+    Output* output = buffer->output;
+    output_buffer_reserve(buffer, record->path_length * 6 + 256);
+    OutputChunk* chunk = buffer->chunk;
+    char* dest = chunk->data + chunk->size;
+    char* start = dest;
+
+    switch (output->format) {
+        case FORMAT_NDJSON:
+            memcpy(dest, "{\"path\":", 8);
+            dest += 8;
+            dest += output_escape_json(dest, record->path, record->path_length);
+            memcpy(dest, ",\"type\":\"estimate\",\"size\":", 26);
+            dest += 26;
+            dest += output_format_uint(dest, record->size);
+            memcpy(dest, ",\"low\":", 7);
+            dest += 7;
+            dest += output_format_uint(dest, record->low);
+            memcpy(dest, ",\"high\":", 8);
+            dest += 8;
+            dest += output_format_uint(dest, record->high);
+            memcpy(dest, ",\"scanned_dirs\":", 16);
+            dest += 16;
+            dest += output_format_uint(dest, record->scanned_dirs);
+            memcpy(dest, "}\n", 2);
+            dest += 2;
+            break;
+        case FORMAT_CSV:
+            dest += output_escape_csv(dest, record->path, record->path_length);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->size);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->low);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->high);
+            *dest++ = ',';
+            dest += output_format_uint(dest, record->scanned_dirs);
+            memcpy(dest, "\r\n", 2);
+            dest += 2;
+            break;
+        case FORMAT_TSV0:
+            dest += output_format_uint(dest, record->size);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->low);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->high);
+            *dest++ = '\t';
+            dest += output_format_uint(dest, record->scanned_dirs);
+            *dest++ = '\t';
+            memcpy(dest, record->path, record->path_length);
+            dest += record->path_length;
+            *dest++ = '\0';
+            break;
+        case FORMAT_TEXT:
+            // The estimate, then the confidence interval as a range, ex 41G 39G-43G
+            dest += output_format_text_value(output, dest, record->size);
+            *dest++ = '\t';
+            dest += output_format_text_value(output, dest, record->low);
+            *dest++ = '-';
+            dest += output_format_text_value(output, dest, record->high);
+            *dest++ = '\t';
+            memcpy(dest, record->path, record->path_length);
+            dest += record->path_length;
+            *dest++ = '\n';
+            break;
+    }
+    chunk->size += dest - start;
+
+    if (!output->ordered && chunk->size >= OUTPUT_BUFFER_FLUSH_SIZE) {
+        output_buffer_flush(buffer);
+    }
+}
+
+/**
+ * Write an unsigned integer as decimal into dest
+ * dest must fit at least 20 characters
+ *
+ * @return amount of characters written
+ */
+size_t output_format_uint(char* dest, uint64_t value) {
+    char digits[20];
+    size_t length = 0;
+    do {
+        digits[length++] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+    for (size_t i = 0; i < length; i++) {
+        dest[i] = digits[length - i - 1];
+    }
+    return length;
+}
+
+/**
+ * Write a size in human readable form into dest, like du -h,
+ * ex 512, 4.0K, 15M. Values are rounded up
+ * dest must fit at least 8 characters
+ *
+ * @return amount of characters written
+ */
+size_t output_format_human(char* dest, uint64_t bytes) {
+    if (bytes < 1024) {
+        return output_format_uint(dest, bytes);
+    }
+    size_t unit = 0;
+    uint64_t divisor = 1024;
+    while (true) {
+        uint64_t whole = bytes / divisor;
+        uint64_t remainder = bytes % divisor;
+        size_t length;
+        if (whole < 10) {
+            // One decimal, remainder * 10 fits since the divisor is at most 2^60
+            uint64_t tenths = whole * 10 + (remainder * 10 + divisor - 1) / divisor;
+            if (tenths < 100) {
+                dest[0] = '0' + tenths / 10;
+                dest[1] = '.';
+                dest[2] = '0' + tenths % 10;
+                length = 3;
+            }
+            else {
+                memcpy(dest, "10", 2);
+                length = 2;
+            }
+        }
+        else {
+            uint64_t rounded = whole + (remainder > 0);
+            if (rounded >= 1024 && unit < sizeof(human_suffixes) - 2) {
+                // Rounding up reached the next unit
+                unit++;
+                divisor *= 1024;
+                continue;
+            }
+            length = output_format_uint(dest, rounded);
+        }
+        dest[length] = human_suffixes[unit];
+        return length + 1;
+    }
+}
+
+/**
+ * Write a JSON string (including quotes) into dest
+ * dest must fit at least 6 * length + 2 characters
+ * Bytes which are not valid UTF-8 are escaped as \udcXX,
+ * which can be reversed with surrogateescape decoding
+ *
+ * @return amount of characters written
+ */
+size_t output_escape_json(char* dest, const char* str, size_t length) {
+    const unsigned char* src = (const unsigned char*) str;
+    char* start = dest;
+    *dest++ = '"';
+    size_t i = 0;
+    while (i < length) {
+        unsigned char c = src[i];
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') {
+            *dest++ = c;
+            i++;
+            continue;
+        }
+        switch (c) {
+            case '"':
+            case '\\':
+                *dest++ = '\\';
+                *dest++ = c;
+                i++;
+                continue;
+            case '\n':
+                *dest++ = '\\';
+                *dest++ = 'n';
+                i++;
+                continue;
+            case '\t':
+                *dest++ = '\\';
+                *dest++ = 't';
+                i++;
+                continue;
+            case '\r':
+                *dest++ = '\\';
+                *dest++ = 'r';
+                i++;
+                continue;
+        }
+        if (c < 0x20) {
+            memcpy(dest, "\\u00", 4);
+            dest[4] = hex_digits[c >> 4];
+            dest[5] = hex_digits[c & 0xf];
+            dest += 6;
+            i++;
+            continue;
+        }
+        size_t sequence_length = utf8_sequence_length(src + i, length - i);
+        if (sequence_length) {
+            memcpy(dest, src + i, sequence_length);
+            dest += sequence_length;
+            i += sequence_length;
+        }
+        else {
+            memcpy(dest, "\\udc", 4);
+            dest[4] = hex_digits[c >> 4];
+            dest[5] = hex_digits[c & 0xf];
+            dest += 6;
+            i++;
+        }
+    }
+    *dest++ = '"';
+    return dest - start;
+}
+
+/**
+ * Write a CSV field into dest, quoted only if needed
+ * dest must fit at least 2 * length + 2 characters
+ *
+ * @return amount of characters written
+ */
+size_t output_escape_csv(char* dest, const char* str, size_t length) {
+    bool needs_quotes = false;
+    for (size_t i = 0; i < length; i++) {
+        char c = str[i];
+        if (c == '"' || c == ',' || c == '\n' || c == '\r') {
+            needs_quotes = true;
+            break;
+        }
+    }
+    if (!needs_quotes) {
+        memcpy(dest, str, length);
+        return length;
+    }
+    char* start = dest;
+    *dest++ = '"';
+    for (size_t i = 0; i < length; i++) {
+        if (str[i] == '"') {
+            *dest++ = '"';
+        }
+        *dest++ = str[i];
+    }
+    *dest++ = '"';
+    return dest - start;
+}
+
+// Write a text size, either human readable or scaled by the block size
+static size_t output_format_text_size(Output* output, char* dest, uint64_t bytes) {
+    if (output->human_readable) {
+        return output_format_human(dest, bytes);
+    }
+    // Round up like du
+    return output_format_uint(dest, (bytes + output->block_size - 1) / output->block_size);
+}
+
+// Write a text size, or an entry count with --inodes
+static size_t output_format_text_value(Output* output, char* dest, uint64_t value) {
+    if (output->count_inodes) {
+        // Counts are not scaled by the block size
+        return output->human_readable ? output_format_human(dest, value) :
+                                        output_format_uint(dest, value);
+    }
+    return output_format_text_size(output, dest, value);
+}
+
+// Write a modification time like du --time, ex 2024-03-01 14:05
+static size_t output_format_text_time(char* dest, time_t time) {
+    struct tm local_time;
+    if (localtime_r(&time, &local_time) == NULL) {
+        return output_format_uint(dest, time);
+    }
+    return strftime(dest, 64, "%Y-%m-%d %H:%M", &local_time);
+}
+
+// Return the length of the valid UTF-8 multibyte sequence at str, or 0 if invalid
+static size_t utf8_sequence_length(const unsigned char* str, size_t remaining) {
+    unsigned char c = str[0];
+    size_t length;
+    unsigned char min_second = 0x80;
+    unsigned char max_second = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf) {
+        length = 2;
+    }
+    else if (c >= 0xe0 && c <= 0xef) {
+        length = 3;
+        if (c == 0xe0) {
+            min_second = 0xa0; // Overlong encoding
+        }
+        else if (c == 0xed) {
+            max_second = 0x9f; // UTF-16 surrogates
+        }
+    }
+    else if (c >= 0xf0 && c <= 0xf4) {
+        length = 4;
+        if (c == 0xf0) {
+            min_second = 0x90; // Overlong encoding
+        }
+        else if (c == 0xf4) {
+            max_second = 0x8f; // Above U+10FFFF
+        }
+    }
+    else {
+        return 0;
+    }
+    if (length > remaining || str[1] < min_second || str[1] > max_second) {
+        return 0;
+    }
+    for (size_t i = 2; i < length; i++) {
+        if (str[i] < 0x80 || str[i] > 0xbf) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+
+// Writer thread, writes the queued chunks and the ordered output
+static void* run_output_writer_thread(void* arg_ptr) {
+    Output* output = (Output*) arg_ptr;
+    pthread_mutex_lock(&output->queue_mutex);
+    while (true) {
+        if (output->queue_head) {
+            OutputChunk* chunk = output->queue_head;
+            output->queue_head = chunk->next;
+            if (output->queue_head == NULL) {
+                output->queue_tail = NULL;
+            }
+            output->queued_chunks--;
+            pthread_cond_broadcast(&output->done_cond);
+            pthread_mutex_unlock(&output->queue_mutex);
+            output_write_chunk(output, chunk);
+            pthread_mutex_lock(&output->queue_mutex);
+        }
+        else if (output->ordered_root) {
+            pthread_mutex_unlock(&output->queue_mutex);
+            bool complete = output_ordered_advance(output);
+            // Write what is available, so readers are not kept waiting
+            if (output->ordered_chunk && output->ordered_chunk->size) {
+                output_write_chunk(output, output->ordered_chunk);
+                output->ordered_chunk = NULL;
+            }
+            pthread_mutex_lock(&output->queue_mutex);
+            if (complete) {
+                output->ordered_root = NULL;
+                pthread_cond_broadcast(&output->done_cond);
+            }
+            else if (output->queue_head == NULL) {
+                // Workers do not signal completed directories, poll for them instead
+                struct timespec timeout;
+                clock_gettime(CLOCK_REALTIME, &timeout);
+                timeout.tv_nsec += OUTPUT_ORDERED_POLL_NSECS;
+                if (timeout.tv_nsec >= 1000000000) {
+                    timeout.tv_sec++;
+                    timeout.tv_nsec -= 1000000000;
+                }
+                pthread_cond_timedwait(&output->writer_cond, &output->queue_mutex,
+                                       &timeout);
+            }
+        }
+        else if (output->stopping) {
+            break;
+        }
+        else {
+            pthread_cond_wait(&output->writer_cond, &output->queue_mutex);
+        }
+    }
+    pthread_mutex_unlock(&output->queue_mutex);
+    return NULL;
+}
+
+// Print as much of the ordered tree as possible, in du order:
+// the records before every child, the child subtree and then the records after.
+// Returns true once the entire tree has been printed
+static bool output_ordered_advance(Output* output) {
+    while (true) {
+        FileNode* node = output->ordered_node;
+        if (!__atomic_load_n(&node->scanned, __ATOMIC_ACQUIRE)) {
+            // The children are not known yet
+            return false;
+        }
+        FileNode* child = output->ordered_started_children ? output->ordered_next_child :
+                                                             node->first_child;
+        if (child) {
+            output_ordered_emit(output, &child->preceding_output,
+                                &child->preceding_output_size);
+            output->ordered_node = child;
+            output->ordered_started_children = false;
+            continue;
+        }
+        if (!__atomic_load_n(&node->finalized, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        output_ordered_emit(output, &node->trailing_output, &node->trailing_output_size);
+        if (node == output->ordered_root) {
+            // The root node is freed by the caller
+            return true;
+        }
+        // Every child was printed, the workers are done with this node
+        FileNode* parent = node->parent;
+        output->ordered_next_child = node->next_sibling;
+        output->ordered_started_children = true;
+        output->ordered_node = parent;
+        if (output->keep_nodes) {
+            continue;
+        }
+        parent->first_child = node->next_sibling;
+        if (node->next_sibling) {
+            node->next_sibling->previous_sibling = NULL;
+        }
+        else {
+            parent->last_child = NULL;
+        }
+        free(node);
+    }
+}
+
+// Add an ordered output segment to the current writer chunk and free it
+static void output_ordered_emit(Output* output, char** segment, size_t* segment_size) {
+    if (*segment == NULL) {
+        return;
+    }
+    OutputChunk* chunk = output->ordered_chunk;
+    if (chunk && chunk->size + *segment_size > chunk->capacity) {
+        output_write_chunk(output, chunk);
+        chunk = NULL;
+    }
+    if (chunk == NULL) {
+        chunk = output_chunk_new(output, *segment_size);
+    }
+    memcpy(chunk->data + chunk->size, *segment, *segment_size);
+    chunk->size += *segment_size;
+    if (chunk->size >= OUTPUT_BUFFER_FLUSH_SIZE) {
+        output_write_chunk(output, chunk);
+        chunk = NULL;
+    }
+    output->ordered_chunk = chunk;
+    free(*segment);
+    *segment = NULL;
+    *segment_size = 0;
+}
+
+// Write a chunk to the output. Spliced chunks are only reused once the pipe
+// has been filled after them, as the reader might still be reading the pages
+static void output_write_chunk(Output* output, OutputChunk* chunk) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t spliced_bytes = 0;
+    while (output->use_vmsplice && spliced_bytes < chunk->size) {
+        struct iovec iov;
+        iov.iov_base = chunk->data + spliced_bytes;
+        iov.iov_len = chunk->size - spliced_bytes;
+        ssize_t spliced = vmsplice(output->fd, &iov, 1, 0);
+        if (spliced == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Splicing is not supported here, fall back to write
+            output->use_vmsplice = false;
+            break;
+        }
+        // Every pipe buffer holds at most one page
+        output->pages_spliced += (spliced + page_size - 1) / page_size;
+        spliced_bytes += spliced;
+    }
+    if (spliced_bytes < chunk->size) {
+        output_write_all(output->fd, chunk->data + spliced_bytes,
+                         chunk->size - spliced_bytes);
+    }
+
+    if (spliced_bytes > 0) {
+        chunk->release_page = output->pages_spliced + output->pipe_pages;
+        chunk->next = NULL;
+        if (output->in_flight_tail) {
+            output->in_flight_tail->next = chunk;
+        }
+        else {
+            output->in_flight_head = chunk;
+        }
+        output->in_flight_tail = chunk;
+    }
+    else {
+        output_recycle_chunk(output, chunk);
+    }
+    while (output->in_flight_head &&
+           output->in_flight_head->release_page <= output->pages_spliced) {
+        OutputChunk* released = output->in_flight_head;
+        output->in_flight_head = released->next;
+        if (output->in_flight_head == NULL) {
+            output->in_flight_tail = NULL;
+        }
+        output_recycle_chunk(output, released);
+    }
+}
+
+// Write the complete data to fd, retrying on partial writes
+static void output_write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror_and_exit("write");
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+// Put a chunk in the free list for reuse, oversized chunks are freed
+static void output_recycle_chunk(Output* output, OutputChunk* chunk) {
+    if (chunk->capacity != OUTPUT_CHUNK_SIZE) {
+        output_chunk_free(chunk);
+        return;
+    }
+    chunk->size = 0;
+    pthread_mutex_lock(&output->queue_mutex);
+    chunk->next = output->free_chunks;
+    output->free_chunks = chunk;
+    pthread_mutex_unlock(&output->queue_mutex);
+}
+
+// Get a chunk with room for at least min_capacity bytes, reusing free chunks
+static OutputChunk* output_chunk_new(Output* output, size_t min_capacity) {
+    if (min_capacity <= OUTPUT_CHUNK_SIZE) {
+        pthread_mutex_lock(&output->queue_mutex);
+        OutputChunk* chunk = output->free_chunks;
+        if (chunk) {
+            output->free_chunks = chunk->next;
+        }
+        pthread_mutex_unlock(&output->queue_mutex);
+        if (chunk) {
+            chunk->next = NULL;
+            return chunk;
+        }
+        min_capacity = OUTPUT_CHUNK_SIZE;
+    }
+    OutputChunk* chunk = checked_malloc(1, sizeof(OutputChunk));
+    // Chunks get their own mapping, so spliced pages never hold other allocations
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    chunk->capacity = (min_capacity + page_size - 1) / page_size * page_size;
+    chunk->data = mmap(NULL, chunk->capacity, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (chunk->data == MAP_FAILED) {
+        perror_and_exit("mmap");
+    }
+    chunk->size = 0;
+    chunk->release_page = 0;
+    chunk->next = NULL;
+    return chunk;
+}
+
+// Unmap and free a chunk
+static void output_chunk_free(OutputChunk* chunk) {
+    munmap(chunk->data, chunk->capacity);
+    free(chunk);
+}
+
+// Make sure there is room for bytes more characters, flushing or growing the buffer
+static void output_buffer_reserve(OutputBuffer* buffer, size_t bytes) {
+    OutputChunk* chunk = buffer->chunk;
+    if (chunk->size + bytes <= chunk->capacity) {
+        return;
+    }
+    Output* output = buffer->output;
+    if (!output->ordered) {
+        output_buffer_flush(buffer);
+        if (bytes <= buffer->chunk->capacity) {
+            return;
+        }
+        chunk = buffer->chunk;
+    }
+    OutputChunk* larger = output_chunk_new(output, (chunk->size + bytes) * 2);
+    memcpy(larger->data, chunk->data, chunk->size);
+    larger->size = chunk->size;
+    output_recycle_chunk(output, chunk);
+    buffer->chunk = larger;
+}
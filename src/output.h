@@ -0,0 +1,269 @@
+/**
+ * This file implements buffered output of disk usage
+ * records in the text and machine-readable formats.
+ * Records are formatted into per-thread buffers, which are
+ * handed to a writer thread and written in large chunks
+ *
+ * @file output.h
+ * @author William Sandström
+ */
+#pragma once
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "args.h"
+#include "file_node.h"
+#include "util/helpers.h"
+
+// Buffers are handed to the writer thread once they pass this size
+#define OUTPUT_BUFFER_FLUSH_SIZE (256 * 1024)
+// Size of newly allocated chunks, leaves room for the record passing the flush size
+#define OUTPUT_CHUNK_SIZE (OUTPUT_BUFFER_FLUSH_SIZE * 2)
+// Workers wait for the writer thread if this many chunks are queued
+#define OUTPUT_MAX_QUEUED_CHUNKS 64
+// How often the writer thread checks for newly completed directories in ordered mode
+#define OUTPUT_ORDERED_POLL_NSECS 5000000
+
+typedef struct Output Output;
+typedef struct OutputChunk OutputChunk;
+typedef struct OutputBuffer OutputBuffer;
+typedef struct OutputRecord OutputRecord;
+typedef struct OutputSummaryRecord OutputSummaryRecord;
+typedef struct OutputHistogramRecord OutputHistogramRecord;
+typedef struct OutputEstimateRecord OutputEstimateRecord;
+
+// Page aligned block of formatted records
+struct OutputChunk {
+    char* data;
+    size_t size;
+    size_t capacity;
+    size_t release_page; // vmsplice: pipe pages after which the chunk can be reused
+    OutputChunk* next;
+};
+
+// Shared output destination and writer thread
+struct Output {
+    int fd;
+    OutputFormat format;
+    bool include_time; // Add the modification time to every record
+    bool human_readable; // Print text sizes like 1.5M
+    size_t block_size; // Scale text sizes by this
+    bool apparent_size; // Print the apparent size as the text size
+    bool show_slack; // Print the allocated, apparent, sparse and slack size in text
+    bool count_inodes; // Print the entry count as the text size
+    bool age_histogram; // Add the size per modification age to every record
+    bool summary_report; // Only summary totals are printed, which have their own CSV header
+    bool histogram_report; // Only size histograms are printed, which have their own CSV header
+    bool estimate_report; // Only estimates are printed, which have their own CSV header
+    bool ordered; // Print in du order instead of as soon as possible
+    bool keep_nodes; // Leave the printed nodes in the tree, to be saved to the cache
+
+    // Writer thread
+    pthread_t writer_thread;
+    pthread_mutex_t queue_mutex;
+    pthread_cond_t writer_cond; // Wakes the writer thread
+    pthread_cond_t done_cond; // Wakes threads waiting for queue space or ordered output
+    OutputChunk* queue_head;
+    OutputChunk* queue_tail;
+    size_t queued_chunks;
+    OutputChunk* free_chunks;
+    bool stopping;
+
+    // Only used by the writer thread
+    bool use_vmsplice; // Output is a pipe, map the pages instead of copying them
+    size_t pipe_pages; // Capacity of the pipe in pages
+    size_t pages_spliced;
+    OutputChunk* in_flight_head; // Spliced chunks which the reader might not have read yet
+    OutputChunk* in_flight_tail;
+
+    // Ordered mode, the writer thread walks the tree in du order
+    // and prints every directory once it and its preceding siblings are final
+    FileNode* ordered_root;
+    FileNode* ordered_node;
+    FileNode* ordered_next_child;
+    bool ordered_started_children;
+    OutputChunk* ordered_chunk;
+};
+
+// Per-thread buffer of formatted records
+struct OutputBuffer {
+    Output* output;
+    OutputChunk* chunk;
+};
+
+// A single directory or file with its final totals
+struct OutputRecord {
+    const char* path;
+    size_t path_length;
+    bool is_dir;
+    size_t size; // Disk usage in bytes
+    size_t apparent_size; // Apparent size in bytes
+    size_t sparse_size; // Apparent size above the allocated size of sparse files
+    size_t slack_size; // Allocated size above the apparent size
+    size_t entry_count; // Amount of entries, including itself
+    size_t depth; // Depth from the command-line argument
+    time_t modification_time; // Latest modification time
+    const size_t* age_sizes; // Size per modification age, AGE_BUCKET_COUNT values
+};
+
+// Total usage of a single user, group or extension
+struct OutputSummaryRecord {
+    const char* type; // user, group or ext
+    bool has_id;
+    uint32_t id; // User or group id
+    const char* name; // User, group or extension name
+    size_t size; // Disk usage in bytes
+    size_t apparent_size; // Apparent size in bytes
+    size_t entry_count; // Amount of entries owned
+};
+
+// A single size bucket of the file size histogram of a command-line argument
+struct OutputHistogramRecord {
+    const char* path;
+    size_t path_length;
+    size_t min_size; // Smallest apparent size in the bucket
+    size_t max_size; // Largest apparent size in the bucket
+    size_t file_count;
+    size_t size; // Disk usage of the files in bytes
+    size_t apparent_size; // Apparent size of the files in bytes
+};
+
+// Estimated total of a command-line argument, from a sample of its directories
+struct OutputEstimateRecord {
+    const char* path;
+    size_t path_length;
+    size_t size; // Estimated size, apparent size or entry count
+    size_t low; // Lower bound of the 95% confidence interval
+    size_t high; // Upper bound of the 95% confidence interval
+    size_t scanned_dirs; // Amount of directories which were actually scanned
+};
+
+/**
+ * Initialize the shared output and start the writer thread
+ *
+ * @param output output to initialize
+ * @param fd file descriptor to write to, -1 to drop the records without a writer thread
+ * @param options options from cmd args
+ */
+void output_init(Output* output, int fd, Options* options);
+
+/**
+ * Write everything which is queued, then stop the
+ * writer thread and free the output
+ */
+void output_destroy(Output* output);
+
+/**
+ * Is the output a machine-readable record format?
+ */
+bool output_is_record_format(OutputFormat format);
+
+/**
+ * Print the directories of the tree below root in du order,
+ * as they become final. Only used in ordered mode.
+ * The workers move their records into the preceding_output
+ * and trailing_output of the nodes instead of flushing them
+ */
+void output_ordered_start(Output* output, FileNode* root);
+
+/**
+ * Wait until the writer thread has printed the entire tree
+ * passed to output_ordered_start
+ */
+void output_ordered_wait(Output* output);
+
+/**
+ * Create a new output buffer writing into output
+ */
+OutputBuffer output_buffer_new(Output* output);
+
+/**
+ * Flush and free the memory of an output buffer
+ */
+void output_buffer_free(OutputBuffer* buffer);
+
+/**
+ * Write the header line of the format, if it has one
+ */
+void output_buffer_add_header(OutputBuffer* buffer);
+
+/**
+ * Format a record into the buffer. In unordered mode, the
+ * buffer is handed to the writer thread once it is large enough
+ */
+void output_buffer_add_record(OutputBuffer* buffer, OutputRecord* record);
+
+/**
+ * Format the total of a user, group or extension into the buffer
+ */
+void output_buffer_add_summary_record(OutputBuffer* buffer, OutputSummaryRecord* record);
+
+/**
+ * Format a bucket of a size histogram into the buffer
+ */
+void output_buffer_add_histogram_record(OutputBuffer* buffer, OutputHistogramRecord* record);
+
+/**
+ * Format the estimated total of an argument into the buffer
+ */
+void output_buffer_add_estimate_record(OutputBuffer* buffer, OutputEstimateRecord* record);
+
+/**
+ * Hand the buffer contents to the writer thread
+ */
+void output_buffer_flush(OutputBuffer* buffer);
+
+/**
+ * Move the buffer contents to the end of a separately
+ * allocated segment, used for ordered output
+ */
+void output_buffer_move_to(OutputBuffer* buffer, char** segment, size_t* segment_size);
+
+/**
+ * Write an unsigned integer as decimal into dest
+ * dest must fit at least 20 characters
+ *
+ * @return amount of characters written
+ */
+size_t output_format_uint(char* dest, uint64_t value);
+
+/**
+ * Write a size in human readable form into dest, like du -h,
+ * ex 512, 4.0K, 15M. Values are rounded up
+ * dest must fit at least 8 characters
+ *
+ * @return amount of characters written
+ */
+size_t output_format_human(char* dest, uint64_t bytes);
+
+/**
+ * Write a JSON string (including quotes) into dest
+ * dest must fit at least 6 * length + 2 characters
+ * Bytes which are not valid UTF-8 are escaped as \udcXX,
+ * which can be reversed with surrogateescape decoding
+ *
+ * @return amount of characters written
+ */
+size_t output_escape_json(char* dest, const char* str, size_t length);
+
+/**
+ * Write a CSV field into dest, quoted only if needed
+ * dest must fit at least 2 * length + 2 characters
+ *
+ * @return amount of characters written
+ */
+size_t output_escape_csv(char* dest, const char* str, size_t length);
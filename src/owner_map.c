@@ -0,0 +1,140 @@
+/**
+ * Hash map from user or group ids to their total usage,
+ * used to aggregate usage per owner during the scan.
+ * Every thread fills its own map, which are merged at the end
+ *
+ * @file owner_map.c
+ * @author William Sandström
+ */
+#include "owner_map.h"
+
+static OwnerUsage* owner_map_find_slot(OwnerUsage* entries, size_t capacity, uint32_t id);
+static OwnerUsage* owner_map_insert(OwnerMap* map, uint32_t id);
+static void owner_map_grow(OwnerMap* map);
+
+/**
+ * Create a new empty owner map. Nothing is allocated until the first add
+ */
+OwnerMap owner_map_new() {
+    OwnerMap map;
+    map.size = 0;
+    map.capacity = 0;
+    map.entries = NULL;
+    return map;
+}
+
+/**
+ * Free the memory of an owner map
+ */
+void owner_map_free(OwnerMap* map) {
+    free(map->entries);
+    map->entries = NULL;
+    map->size = 0;
+    map->capacity = 0;
+}
+
+/**
+ * Add the usage of a single entry to the total of its owner
+ *
+ * @param map map to add to
+ * @param id user or group id of the entry
+ * @param size disk usage in bytes
+ * @param apparent_size apparent size in bytes
+ */
+void owner_map_add(OwnerMap* map, uint32_t id, size_t size, size_t apparent_size) {
+    OwnerUsage* usage = owner_map_insert(map, id);
+    usage->size += size;
+    usage->apparent_size += apparent_size;
+    usage->entry_count++;
+}
+
+/**
+ * Return the totals of an owner, or NULL if it has none
+ */
+OwnerUsage* owner_map_get(OwnerMap* map, uint32_t id) {
+    if (map->capacity == 0) {
+        return NULL;
+    }
+    OwnerUsage* usage = owner_map_find_slot(map->entries, map->capacity, id);
+    return usage->used ? usage : NULL;
+}
+
+/**
+ * Add every total of src into dest. src is empty afterwards
+ */
+void owner_map_merge(OwnerMap* dest, OwnerMap* src) {
+    for (size_t i = 0; i < src->capacity; i++) {
+        OwnerUsage* src_usage = &src->entries[i];
+        if (!src_usage->used) {
+            continue;
+        }
+        OwnerUsage* dest_usage = owner_map_insert(dest, src_usage->id);
+        dest_usage->size += src_usage->size;
+        dest_usage->apparent_size += src_usage->apparent_size;
+        dest_usage->entry_count += src_usage->entry_count;
+    }
+    owner_map_free(src);
+}
+
+/**
+ * Return an allocated array of the totals in the map
+ *
+ * @param map map to read
+ * @param count output amount of totals in the array
+ */
+OwnerUsage* owner_map_to_array(OwnerMap* map, size_t* count) {
+    OwnerUsage* array = checked_malloc(map->size > 0 ? map->size : 1, sizeof(OwnerUsage));
+    size_t index = 0;
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (map->entries[i].used) {
+            array[index++] = map->entries[i];
+        }
+    }
+    *count = index;
+    return array;
+}
+
+// Return the slot of id, or the empty slot where it would be inserted
+static OwnerUsage* owner_map_find_slot(OwnerUsage* entries, size_t capacity, uint32_t id) {
+    // Ids are often sequential, so mix the bits before masking
+    uint32_t hash = id * 2654435769u;
+    size_t index = (hash ^ (hash >> 16)) & (capacity - 1);
+    while (entries[index].used && entries[index].id != id) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &entries[index];
+}
+
+// Return the totals of id, adding empty totals if it has none
+static OwnerUsage* owner_map_insert(OwnerMap* map, uint32_t id) {
+    if (map->capacity == 0) {
+        owner_map_grow(map);
+    }
+    OwnerUsage* usage = owner_map_find_slot(map->entries, map->capacity, id);
+    if (!usage->used) {
+        // Keep the load factor below 3/4
+        if ((map->size + 1) * 4 > map->capacity * 3) {
+            owner_map_grow(map);
+            usage = owner_map_find_slot(map->entries, map->capacity, id);
+        }
+        usage->used = true;
+        usage->id = id;
+        map->size++;
+    }
+    return usage;
+}
+
+// Double the capacity and rehash every total
+static void owner_map_grow(OwnerMap* map) {
+    size_t new_capacity = map->capacity > 0 ? map->capacity * 2 : OWNER_MAP_INITIAL_CAPACITY;
+    OwnerUsage* new_entries = checked_calloc(new_capacity, sizeof(OwnerUsage));
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (map->entries[i].used) {
+            *owner_map_find_slot(new_entries, new_capacity, map->entries[i].id) =
+                map->entries[i];
+        }
+    }
+    free(map->entries);
+    map->entries = new_entries;
+    map->capacity = new_capacity;
+}
@@ -0,0 +1,76 @@
+/**
+ * Hash map from user or group ids to their total usage,
+ * used to aggregate usage per owner during the scan.
+ * Every thread fills its own map, which are merged at the end
+ *
+ * @file owner_map.h
+ * @author William Sandström
+ */
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "util/helpers.h"
+
+#define OWNER_MAP_INITIAL_CAPACITY 16
+
+typedef struct OwnerUsage OwnerUsage;
+typedef struct OwnerMap OwnerMap;
+
+// Totals of a single user or group
+struct OwnerUsage {
+    uint32_t id;
+    bool used; // Is this slot of the map taken
+    size_t size; // Disk usage in bytes
+    size_t apparent_size; // Apparent size in bytes
+    size_t entry_count;
+};
+
+// Open addressing hash map with linear probing
+struct OwnerMap {
+    size_t size;
+    size_t capacity; // A power of two, 0 until the first add
+    OwnerUsage* entries;
+};
+
+/**
+ * Create a new empty owner map. Nothing is allocated until the first add
+ */
+OwnerMap owner_map_new();
+
+/**
+ * Free the memory of an owner map
+ */
+void owner_map_free(OwnerMap* map);
+
+/**
+ * Add the usage of a single entry to the total of its owner
+ *
+ * @param map map to add to
+ * @param id user or group id of the entry
+ * @param size disk usage in bytes
+ * @param apparent_size apparent size in bytes
+ */
+void owner_map_add(OwnerMap* map, uint32_t id, size_t size, size_t apparent_size);
+
+/**
+ * Return the totals of an owner, or NULL if it has none
+ */
+OwnerUsage* owner_map_get(OwnerMap* map, uint32_t id);
+
+/**
+ * Add every total of src into dest. src is empty afterwards
+ */
+void owner_map_merge(OwnerMap* dest, OwnerMap* src);
+
+/**
+ * Return an allocated array of the totals in the map
+ *
+ * @param map map to read
+ * @param count output amount of totals in the array
+ */
+OwnerUsage* owner_map_to_array(OwnerMap* map, size_t* count);
@@ -0,0 +1,263 @@
+/**
+ * Matching of file names against the --exclude and --include
+ * glob patterns. Patterns are compiled once into literal names,
+ * which are looked up in a hash set, suffix patterns like *.o,
+ * and general globs, which are the only ones using fnmatch
+ *
+ * @file pattern_matcher.c
+ * @author William Sandström
+ */
+#include "pattern_matcher.h"
+
+static void pattern_list_free(PatternList* list);
+static bool pattern_list_is_empty(PatternList* list);
+static void pattern_list_add(PatternList* list, const char* pattern);
+static bool pattern_list_matches(PatternList* list, const char* name, size_t length);
+static bool pattern_list_has_literal(PatternList* list, const char* name, size_t length);
+static void pattern_list_add_literal(PatternList* list, const char* name, size_t length);
+static PatternLiteral* pattern_literal_find_slot(PatternLiteral* literals, size_t capacity,
+                                                 const char* name, size_t length,
+                                                 uint64_t hash);
+static uint64_t pattern_hash(const char* name, size_t length);
+static bool has_wildcards(const char* pattern);
+
+/**
+ * Create a new matcher without any patterns
+ */
+PatternMatcher pattern_matcher_new() {
+    PatternMatcher matcher;
+    memset(&matcher, 0, sizeof(PatternMatcher));
+    return matcher;
+}
+
+/**
+ * Free the memory of a matcher and its patterns
+ */
+void pattern_matcher_free(PatternMatcher* matcher) {
+    pattern_list_free(&matcher->excludes);
+    pattern_list_free(&matcher->includes);
+}
+
+/**
+ * Compile a glob pattern into the matcher
+ *
+ * @param matcher matcher to add to
+ * @param pattern glob pattern matched against file names, ex node_modules or *.log
+ * @param include add to the include patterns instead of the exclude patterns
+ */
+void pattern_matcher_add(PatternMatcher* matcher, const char* pattern, bool include) {
+    pattern_list_add(include ? &matcher->includes : &matcher->excludes, pattern);
+}
+
+/**
+ * Can a pattern match anything? Patterns are matched against single
+ * names, so a pattern containing '/' never matches
+ */
+bool pattern_matcher_is_valid_pattern(const char* pattern) {
+    return strchr(pattern, '/') == NULL;
+}
+
+/**
+ * Add every line of a file as an exclude pattern.
+ * Empty lines and lines starting with # are skipped
+ *
+ * @return false if the file could not be read, or if a pattern is not
+ * valid, with errno set to EINVAL
+ */
+bool pattern_matcher_add_file(PatternMatcher* matcher, const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        return false;
+    }
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t length;
+    while ((length = getline(&line, &line_size, file)) != -1) {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+        if (length > 0 && line[0] != '#') {
+            if (!pattern_matcher_is_valid_pattern(line)) {
+                free(line);
+                fclose(file);
+                errno = EINVAL;
+                return false;
+            }
+            pattern_matcher_add(matcher, line, false);
+        }
+    }
+    free(line);
+    fclose(file);
+    return true;
+}
+
+/**
+ * Does the matcher have any patterns?
+ */
+bool pattern_matcher_is_empty(PatternMatcher* matcher) {
+    return pattern_list_is_empty(&matcher->excludes) &&
+           pattern_list_is_empty(&matcher->includes);
+}
+
+/**
+ * Should an entry with this name be skipped?
+ * Excluded directories are not descended into
+ *
+ * @param matcher compiled patterns
+ * @param name file name
+ * @param length length of the file name
+ */
+bool pattern_matcher_excludes(PatternMatcher* matcher, const char* name, size_t length) {
+    return pattern_list_matches(&matcher->excludes, name, length);
+}
+
+/**
+ * Should a file with this name be counted? True if there are no
+ * include patterns, otherwise only if any of them match.
+ * Only used for files, directories are always descended into and counted
+ *
+ * @param matcher compiled patterns
+ * @param name file name
+ * @param length length of the file name
+ */
+bool pattern_matcher_includes(PatternMatcher* matcher, const char* name, size_t length) {
+    return pattern_list_is_empty(&matcher->includes) ||
+           pattern_list_matches(&matcher->includes, name, length);
+}
+
+// Free the memory of a pattern list
+static void pattern_list_free(PatternList* list) {
+    for (size_t i = 0; i < list->literal_capacity; i++) {
+        free(list->literals[i].name);
+    }
+    free(list->literals);
+    for (size_t i = 0; i < list->suffix_count; i++) {
+        free(list->suffixes[i]);
+    }
+    free(list->suffixes);
+    free(list->suffix_lengths);
+    for (size_t i = 0; i < list->glob_count; i++) {
+        free(list->globs[i]);
+    }
+    free(list->globs);
+    memset(list, 0, sizeof(PatternList));
+}
+
+// Does the list have any patterns?
+static bool pattern_list_is_empty(PatternList* list) {
+    return list->literal_count == 0 && list->suffix_count == 0 && list->glob_count == 0;
+}
+
+// Compile a pattern into the cheapest kind of matching which is exact
+static void pattern_list_add(PatternList* list, const char* pattern) {
+    if (!has_wildcards(pattern)) {
+        pattern_list_add_literal(list, pattern, strlen(pattern));
+    }
+    else if (pattern[0] == '*' && !has_wildcards(pattern + 1)) {
+        list->suffixes = checked_realloc(list->suffixes, list->suffix_count + 1,
+                                         sizeof(char*));
+        list->suffix_lengths = checked_realloc(list->suffix_lengths,
+                                               list->suffix_count + 1, sizeof(size_t));
+        list->suffixes[list->suffix_count] = strdup(pattern + 1);
+        list->suffix_lengths[list->suffix_count] = strlen(pattern + 1);
+        list->suffix_count++;
+    }
+    else {
+        list->globs = checked_realloc(list->globs, list->glob_count + 1, sizeof(char*));
+        list->globs[list->glob_count] = strdup(pattern);
+        list->glob_count++;
+    }
+}
+
+// Does any pattern of the list match the name?
+static bool pattern_list_matches(PatternList* list, const char* name, size_t length) {
+    if (pattern_list_has_literal(list, name, length)) {
+        return true;
+    }
+    for (size_t i = 0; i < list->suffix_count; i++) {
+        size_t suffix_length = list->suffix_lengths[i];
+        if (length >= suffix_length &&
+            memcmp(name + length - suffix_length, list->suffixes[i], suffix_length) == 0) {
+            return true;
+        }
+    }
+    for (size_t i = 0; i < list->glob_count; i++) {
+        if (fnmatch(list->globs[i], name, 0) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Is the name one of the literal patterns?
+static bool pattern_list_has_literal(PatternList* list, const char* name, size_t length) {
+    // Most names can be rejected by their length, without hashing them
+    if (!(list->literal_lengths & (1ull << (length < 63 ? length : 63)))) {
+        return false;
+    }
+    PatternLiteral* literal = pattern_literal_find_slot(list->literals,
+                                                        list->literal_capacity, name,
+                                                        length, pattern_hash(name, length));
+    return literal->name != NULL;
+}
+
+// Add a literal pattern to the hash set, growing it if needed
+static void pattern_list_add_literal(PatternList* list, const char* name, size_t length) {
+    // Keep the load factor below 1/2, lookups of missing names are the common case
+    if ((list->literal_count + 1) * 2 > list->literal_capacity) {
+        size_t new_capacity = list->literal_capacity > 0 ? list->literal_capacity * 2 :
+                                                           PATTERN_SET_INITIAL_CAPACITY;
+        PatternLiteral* new_literals = checked_calloc(new_capacity, sizeof(PatternLiteral));
+        for (size_t i = 0; i < list->literal_capacity; i++) {
+            PatternLiteral* literal = &list->literals[i];
+            if (literal->name) {
+                *pattern_literal_find_slot(new_literals, new_capacity, literal->name,
+                                           literal->length, literal->hash) = *literal;
+            }
+        }
+        free(list->literals);
+        list->literals = new_literals;
+        list->literal_capacity = new_capacity;
+    }
+    uint64_t hash = pattern_hash(name, length);
+    PatternLiteral* literal = pattern_literal_find_slot(list->literals, list->literal_capacity,
+                                                       name, length, hash);
+    if (literal->name) {
+        return; // Duplicate pattern
+    }
+    literal->name = checked_malloc(length + 1, sizeof(char));
+    memcpy(literal->name, name, length);
+    literal->name[length] = '\0';
+    literal->length = length;
+    literal->hash = hash;
+    list->literal_count++;
+    list->literal_lengths |= 1ull << (length < 63 ? length : 63);
+}
+
+// Return the slot of name, or the empty slot where it would be inserted
+static PatternLiteral* pattern_literal_find_slot(PatternLiteral* literals, size_t capacity,
+                                                 const char* name, size_t length,
+                                                 uint64_t hash) {
+    size_t index = hash & (capacity - 1);
+    while (literals[index].name &&
+           (literals[index].hash != hash || literals[index].length != length ||
+            memcmp(literals[index].name, name, length) != 0)) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &literals[index];
+}
+
+// FNV-1a, file names are short so this is cheap
+static uint64_t pattern_hash(const char* name, size_t length) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char) name[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Does the pattern need fnmatch, or can it be compared literally?
+static bool has_wildcards(const char* pattern) {
+    return strpbrk(pattern, "*?[\\") != NULL;
+}
@@ -0,0 +1,112 @@
+/**
+ * Matching of file names against the --exclude and --include
+ * glob patterns. Patterns are compiled once into literal names,
+ * which are looked up in a hash set, suffix patterns like *.o,
+ * and general globs, which are the only ones using fnmatch
+ *
+ * @file pattern_matcher.h
+ * @author William Sandström
+ */
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+
+#include "util/helpers.h"
+
+#define PATTERN_SET_INITIAL_CAPACITY 16
+
+typedef struct PatternLiteral PatternLiteral;
+typedef struct PatternList PatternList;
+typedef struct PatternMatcher PatternMatcher;
+
+// Literal name in the hash set of a pattern list
+struct PatternLiteral {
+    char* name; // NULL if the slot is unused
+    size_t length;
+    uint64_t hash;
+};
+
+// Compiled list of patterns, matching a name if any of them match
+struct PatternList {
+    // Patterns without wildcards, open addressing hash set
+    PatternLiteral* literals;
+    size_t literal_count;
+    size_t literal_capacity;
+    uint64_t literal_lengths; // Bit n is set if there is a literal of length n, or 63 and over
+    // Patterns which are * followed by a literal, ex *.o
+    char** suffixes;
+    size_t* suffix_lengths;
+    size_t suffix_count;
+    // Every other pattern, matched with fnmatch
+    char** globs;
+    size_t glob_count;
+};
+
+struct PatternMatcher {
+    PatternList excludes;
+    PatternList includes;
+};
+
+/**
+ * Create a new matcher without any patterns
+ */
+PatternMatcher pattern_matcher_new();
+
+/**
+ * Free the memory of a matcher and its patterns
+ */
+void pattern_matcher_free(PatternMatcher* matcher);
+
+/**
+ * Compile a glob pattern into the matcher
+ *
+ * @param matcher matcher to add to
+ * @param pattern glob pattern matched against file names, ex node_modules or *.log
+ * @param include add to the include patterns instead of the exclude patterns
+ */
+void pattern_matcher_add(PatternMatcher* matcher, const char* pattern, bool include);
+
+/**
+ * Can a pattern match anything? Patterns are matched against single
+ * names, so a pattern containing '/' never matches
+ */
+bool pattern_matcher_is_valid_pattern(const char* pattern);
+
+/**
+ * Add every line of a file as an exclude pattern.
+ * Empty lines and lines starting with # are skipped
+ *
+ * @return false if the file could not be read, or if a pattern is not
+ * valid, with errno set to EINVAL
+ */
+bool pattern_matcher_add_file(PatternMatcher* matcher, const char* filename);
+
+/**
+ * Does the matcher have any patterns?
+ */
+bool pattern_matcher_is_empty(PatternMatcher* matcher);
+
+/**
+ * Should an entry with this name be skipped?
+ * Excluded directories are not descended into
+ *
+ * @param matcher compiled patterns
+ * @param name file name
+ * @param length length of the file name
+ */
+bool pattern_matcher_excludes(PatternMatcher* matcher, const char* name, size_t length);
+
+/**
+ * Should a file with this name be counted? True if there are no
+ * include patterns, otherwise only if any of them match.
+ * Only used for files, directories are always descended into and counted
+ *
+ * @param matcher compiled patterns
+ * @param name file name
+ * @param length length of the file name
+ */
+bool pattern_matcher_includes(PatternMatcher* matcher, const char* name, size_t length);
@@ -0,0 +1,152 @@
+/**
+ * Live progress of a scan, printed to stderr by a reporter thread.
+ * Every worker thread only writes its own counters, with relaxed
+ * atomic stores, and the reporter sums them up a few times per second.
+ * The workers never wait for the reporter
+ *
+ * @file progress.c
+ * @author William Sandström
+ */
+#include "progress.h"
+
+static void* run_progress_reporter_thread(void* arg_ptr);
+static void progress_print(Progress* progress, bool final);
+static double elapsed_seconds(struct timespec* start, struct timespec* end);
+
+/**
+ * Start the reporter thread, printing to stderr
+ *
+ * @param progress progress to initialize
+ * @param format how to print the progress, nothing is started for PROGRESS_NONE
+ * @param thread_count amount of worker threads with counters
+ */
+void progress_start(Progress* progress, ProgressFormat format, size_t thread_count) {
+    memset(progress, 0, sizeof(Progress));
+    progress->format = format;
+    if (format == PROGRESS_NONE) {
+        return;
+    }
+    progress->thread_count = thread_count;
+    if (posix_memalign((void**) &progress->counters, sizeof(ProgressCounters),
+                       thread_count * sizeof(ProgressCounters)) != 0) {
+        perror_and_exit("Progress counter allocation");
+    }
+    memset(progress->counters, 0, thread_count * sizeof(ProgressCounters));
+    clock_gettime(CLOCK_MONOTONIC, &progress->start_time);
+    progress->last_time = progress->start_time;
+    pthread_mutex_init(&progress->mutex, NULL);
+    pthread_cond_init(&progress->cond, NULL);
+    pthread_create(&progress->reporter_thread, NULL, run_progress_reporter_thread,
+                   (void*) progress);
+}
+
+/**
+ * Stop the reporter thread, print the final progress and free the counters
+ */
+void progress_stop(Progress* progress) {
+    if (progress->format == PROGRESS_NONE) {
+        return;
+    }
+    pthread_mutex_lock(&progress->mutex);
+    progress->stopping = true;
+    pthread_cond_signal(&progress->cond);
+    pthread_mutex_unlock(&progress->mutex);
+    pthread_join(progress->reporter_thread, NULL);
+    progress_print(progress, true);
+
+    pthread_mutex_destroy(&progress->mutex);
+    pthread_cond_destroy(&progress->cond);
+    free(progress->counters);
+    progress->counters = NULL;
+}
+
+/**
+ * Return the counters of a worker thread, or NULL if progress is not printed
+ */
+ProgressCounters* progress_counters(Progress* progress, size_t thread_index) {
+    return progress->counters ? &progress->counters[thread_index] : NULL;
+}
+
+// Print the progress until stopped
+static void* run_progress_reporter_thread(void* arg_ptr) {
+    Progress* progress = (Progress*) arg_ptr;
+    long interval_nsecs = progress->format == PROGRESS_TEXT ?
+                              PROGRESS_TEXT_INTERVAL_NSECS :
+                              PROGRESS_NDJSON_INTERVAL_NSECS;
+    struct timespec wake_time;
+    clock_gettime(CLOCK_REALTIME, &wake_time);
+
+    pthread_mutex_lock(&progress->mutex);
+    while (!progress->stopping) {
+        wake_time.tv_nsec += interval_nsecs;
+        wake_time.tv_sec += wake_time.tv_nsec / 1000000000;
+        wake_time.tv_nsec %= 1000000000;
+        while (!progress->stopping &&
+               pthread_cond_timedwait(&progress->cond, &progress->mutex, &wake_time) == 0) {
+        }
+        if (!progress->stopping) {
+            progress_print(progress, false);
+        }
+    }
+    pthread_mutex_unlock(&progress->mutex);
+    return NULL;
+}
+
+// Sum up the counters of every worker and print them
+static void progress_print(Progress* progress, bool final) {
+    ProgressCounters total = { 0 };
+    for (size_t i = 0; i < progress->thread_count; i++) {
+        ProgressCounters* counters = &progress->counters[i];
+        total.entries += __atomic_load_n(&counters->entries, __ATOMIC_RELAXED);
+        total.bytes += __atomic_load_n(&counters->bytes, __ATOMIC_RELAXED);
+        total.dirs_found += __atomic_load_n(&counters->dirs_found, __ATOMIC_RELAXED);
+        total.dirs_done += __atomic_load_n(&counters->dirs_done, __ATOMIC_RELAXED);
+    }
+    // The counters are read one by one, so the sums can be slightly out of step
+    size_t dirs_queued = total.dirs_found > total.dirs_done ?
+                             total.dirs_found - total.dirs_done :
+                             0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = elapsed_seconds(&progress->start_time, &now);
+    // The current throughput, or the average of the whole scan at the end
+    struct timespec* since = final ? &progress->start_time : &progress->last_time;
+    ProgressCounters previous = { 0 };
+    if (!final) {
+        previous = progress->last_total;
+    }
+    double interval = elapsed_seconds(since, &now);
+    double entries_per_sec = interval > 0 ? (total.entries - previous.entries) / interval : 0;
+    double bytes_per_sec = interval > 0 ? (total.bytes - previous.bytes) / interval : 0;
+    progress->last_total = total;
+    progress->last_time = now;
+
+    if (progress->format == PROGRESS_NDJSON) {
+        fprintf(stderr,
+                "{\"type\":\"progress\",\"elapsed\":%.3f,\"entries\":%zu,\"bytes\":%zu,"
+                "\"dirs_done\":%zu,\"dirs_queued\":%zu,\"entries_per_sec\":%.0f,"
+                "\"bytes_per_sec\":%.0f,\"final\":%s}\n",
+                elapsed, total.entries, total.bytes, total.dirs_done, dirs_queued,
+                entries_per_sec, bytes_per_sec, final ? "true" : "false");
+    }
+    else if (final) {
+        // Clear the line, the results are printed to stdout
+        if (progress->line_printed) {
+            fprintf(stderr, "\r\033[K");
+        }
+    }
+    else {
+        progress->line_printed = true;
+        fprintf(stderr,
+                "\r\033[K%.1fs: %zu entries, %.1f MiB, %zu dirs done, %zu queued, "
+                "%.0f entries/s, %.1f MiB/s",
+                elapsed, total.entries, total.bytes / (1024.0 * 1024.0), total.dirs_done,
+                dirs_queued, entries_per_sec, bytes_per_sec / (1024.0 * 1024.0));
+    }
+    fflush(stderr);
+}
+
+// Seconds between two times
+static double elapsed_seconds(struct timespec* start, struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,112 @@
+/**
+ * Live progress of a scan, printed to stderr by a reporter thread.
+ * Every worker thread only writes its own counters, with relaxed
+ * atomic stores, and the reporter sums them up a few times per second.
+ * The workers never wait for the reporter
+ *
+ * @file progress.h
+ * @author William Sandström
+ */
+#pragma once
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "util/helpers.h"
+
+// How often the progress is printed
+#define PROGRESS_TEXT_INTERVAL_NSECS 250000000
+#define PROGRESS_NDJSON_INTERVAL_NSECS 1000000000
+
+typedef struct ProgressCounters ProgressCounters;
+typedef struct Progress Progress;
+
+// How --progress is printed
+enum ProgressFormat {
+    PROGRESS_NONE,
+    PROGRESS_TEXT, // A single line which is updated in place
+    PROGRESS_NDJSON, // One JSON object per line
+};
+
+typedef enum ProgressFormat ProgressFormat;
+
+// Counters of a single worker thread, on their own cache line so that
+// the workers do not slow each other down
+struct ProgressCounters {
+    size_t entries;
+    size_t bytes; // Disk usage of the entries
+    size_t dirs_found; // Directories queued or scanned
+    size_t dirs_done; // Directories scanned
+} __attribute__((aligned(64)));
+
+struct Progress {
+    ProgressFormat format;
+    ProgressCounters* counters; // One per worker thread
+    size_t thread_count;
+    struct timespec start_time;
+    // Last printed totals, the throughput is measured since then
+    ProgressCounters last_total;
+    struct timespec last_time;
+    bool line_printed; // The text line needs to be cleared at the end
+    // Reporter thread
+    pthread_t reporter_thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond; // Wakes the reporter thread early when stopping
+    bool stopping;
+};
+
+/**
+ * Start the reporter thread, printing to stderr
+ *
+ * @param progress progress to initialize
+ * @param format how to print the progress, nothing is started for PROGRESS_NONE
+ * @param thread_count amount of worker threads with counters
+ */
+void progress_start(Progress* progress, ProgressFormat format, size_t thread_count);
+
+/**
+ * Stop the reporter thread, print the final progress and free the counters
+ */
+void progress_stop(Progress* progress);
+
+/**
+ * Return the counters of a worker thread, or NULL if progress is not printed
+ */
+ProgressCounters* progress_counters(Progress* progress, size_t thread_index);
+
+/**
+ * Add scanned entries to the counters of the calling worker thread.
+ * Only the owning thread writes the counters, so this is a plain add
+ *
+ * @param counters counters of the calling thread, NULL to do nothing
+ * @param entries amount of entries
+ * @param bytes disk usage of the entries
+ */
+static inline void progress_add_entries(ProgressCounters* counters, size_t entries,
+                                        size_t bytes) {
+    if (counters) {
+        __atomic_store_n(&counters->entries, counters->entries + entries, __ATOMIC_RELAXED);
+        __atomic_store_n(&counters->bytes, counters->bytes + bytes, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Add found and scanned directories to the counters of the calling worker thread
+ *
+ * @param counters counters of the calling thread, NULL to do nothing
+ * @param dirs_found amount of directories which were queued
+ * @param dirs_done amount of directories which were scanned
+ */
+static inline void progress_add_dirs(ProgressCounters* counters, size_t dirs_found,
+                                     size_t dirs_done) {
+    if (counters) {
+        __atomic_store_n(&counters->dirs_found, counters->dirs_found + dirs_found,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&counters->dirs_done, counters->dirs_done + dirs_done,
+                         __ATOMIC_RELAXED);
+    }
+}
@@ -52,13 +52,25 @@ Todo:
 
 #include "args.h"
 #include "disk_usage.h"
+#include "daemon.h"
 
 int main(int argc, char* argv[]) {
     Options options = parse_arguments(argc, argv);
 
-    disk_usage(options);
+    int status;
+    if (options.daemon) {
+        status = daemon_run(&options);
+    }
+    else if (options.query) {
+        status = daemon_query(&options);
+    }
+    else {
+        // A scan cut short by --deadline fails like du does on unreadable directories
+        status = disk_usage(options) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
     free(options.files);
+    pattern_matcher_free(&options.patterns);
 
-    return 0;
+    return status;
 }
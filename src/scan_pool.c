@@ -0,0 +1,132 @@
+/**
+ * Persistent worker threads which run the scanning threads of one scan
+ * after another, so repeated scans do not start and join a thread per
+ * worker every time. Every thread of a job gets its own argument, and
+ * the threads sleep between jobs
+ *
+ * @file scan_pool.c
+ * @author William Sandström
+ */
+#include "scan_pool.h"
+
+static void* run_scan_pool_thread(void* arg_ptr);
+
+/**
+ * Start the threads of a pool
+ *
+ * @param pool pool to initialize
+ * @param thread_count amount of threads, the most a job can use
+ * @return false if the threads could not be started, the pool is not initialized then
+ */
+bool scan_pool_init(ScanPool* pool, size_t thread_count) {
+    pool->threads = checked_malloc(thread_count, sizeof(pthread_t));
+    pool->thread_infos = checked_malloc(thread_count, sizeof(ScanPoolThread));
+    pool->thread_count = 0;
+    pool->function = NULL;
+    pool->args = NULL;
+    pool->arg_size = 0;
+    pool->job_threads = 0;
+    pool->job_generation = 0;
+    pool->running_threads = 0;
+    pool->stopping = false;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+    for (size_t i = 0; i < thread_count; i++) {
+        pool->thread_infos[i].pool = pool;
+        pool->thread_infos[i].index = i;
+        if (pthread_create(&pool->threads[i], NULL, run_scan_pool_thread,
+                           &pool->thread_infos[i]) != 0) {
+            scan_pool_free(pool);
+            return false;
+        }
+        pool->thread_count++;
+    }
+    return true;
+}
+
+/**
+ * Stop and join the threads of a pool, which must not be running a job
+ */
+void scan_pool_free(ScanPool* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->start_cond);
+    pthread_mutex_unlock(&pool->mutex);
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->start_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    free(pool->threads);
+    free(pool->thread_infos);
+    pool->threads = NULL;
+    pool->thread_infos = NULL;
+    pool->thread_count = 0;
+}
+
+/**
+ * Run a function on some threads of the pool without waiting for it
+ *
+ * @param pool pool which is not running a job
+ * @param function function run by every thread of the job
+ * @param args array of one argument per thread
+ * @param arg_size size of every argument in args
+ * @param thread_count amount of threads of the job, at most the threads of the pool
+ */
+void scan_pool_run(ScanPool* pool, ScanPoolFunction function, void* args, size_t arg_size,
+                   size_t thread_count) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->function = function;
+    pool->args = args;
+    pool->arg_size = arg_size;
+    pool->job_threads = thread_count < pool->thread_count ? thread_count : pool->thread_count;
+    pool->running_threads = pool->job_threads;
+    pool->job_generation++;
+    pthread_cond_broadcast(&pool->start_cond);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+/**
+ * Wait until every thread of the job started by scan_pool_run has returned
+ */
+void scan_pool_wait(ScanPool* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->running_threads > 0) {
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// Run every job the thread takes part in, until the pool is freed
+static void* run_scan_pool_thread(void* arg_ptr) {
+    ScanPoolThread* thread = (ScanPoolThread*) arg_ptr;
+    ScanPool* pool = thread->pool;
+    size_t seen_generation = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (true) {
+        while (!pool->stopping && pool->job_generation == seen_generation) {
+            pthread_cond_wait(&pool->start_cond, &pool->mutex);
+        }
+        if (pool->stopping) {
+            break;
+        }
+        seen_generation = pool->job_generation;
+        if (thread->index >= pool->job_threads) {
+            continue;
+        }
+        ScanPoolFunction function = pool->function;
+        void* arg = pool->args + thread->index * pool->arg_size;
+        pthread_mutex_unlock(&pool->mutex);
+        function(arg);
+        pthread_mutex_lock(&pool->mutex);
+        pool->running_threads--;
+        if (pool->running_threads == 0) {
+            pthread_cond_broadcast(&pool->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
@@ -0,0 +1,74 @@
+/**
+ * Persistent worker threads which run the scanning threads of one scan
+ * after another, so repeated scans do not start and join a thread per
+ * worker every time. Every thread of a job gets its own argument, and
+ * the threads sleep between jobs
+ *
+ * @file scan_pool.h
+ * @author William Sandström
+ */
+#pragma once
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util/helpers.h"
+
+typedef struct ScanPool ScanPool;
+typedef struct ScanPoolThread ScanPoolThread;
+typedef void* (*ScanPoolFunction)(void* arg);
+
+// Index of a thread in its pool, passed to the thread function
+struct ScanPoolThread {
+    ScanPool* pool;
+    size_t index;
+};
+
+struct ScanPool {
+    pthread_t* threads;
+    ScanPoolThread* thread_infos;
+    size_t thread_count;
+    pthread_mutex_t mutex;
+    pthread_cond_t start_cond; // Wakes the threads for a new job, or to stop
+    pthread_cond_t done_cond; // Wakes scan_pool_wait once the job is done
+    // Current job, thread i runs function(args + i * arg_size)
+    ScanPoolFunction function;
+    char* args;
+    size_t arg_size;
+    size_t job_threads; // Threads taking part in the job, the rest sleep through it
+    size_t job_generation; // Increased per job, so every thread runs a job once
+    size_t running_threads; // Threads still running the job
+    bool stopping;
+};
+
+/**
+ * Start the threads of a pool
+ *
+ * @param pool pool to initialize
+ * @param thread_count amount of threads, the most a job can use
+ * @return false if the threads could not be started, the pool is not initialized then
+ */
+bool scan_pool_init(ScanPool* pool, size_t thread_count);
+
+/**
+ * Stop and join the threads of a pool, which must not be running a job
+ */
+void scan_pool_free(ScanPool* pool);
+
+/**
+ * Run a function on some threads of the pool without waiting for it
+ *
+ * @param pool pool which is not running a job
+ * @param function function run by every thread of the job
+ * @param args array of one argument per thread
+ * @param arg_size size of every argument in args
+ * @param thread_count amount of threads of the job, at most the threads of the pool
+ */
+void scan_pool_run(ScanPool* pool, ScanPoolFunction function, void* args, size_t arg_size,
+                   size_t thread_count);
+
+/**
+ * Wait until every thread of the job started by scan_pool_run has returned
+ */
+void scan_pool_wait(ScanPool* pool);
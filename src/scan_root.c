@@ -0,0 +1,158 @@
+/**
+ * The command-line arguments of a scan. Every argument is scanned by
+ * the same worker pool. Directories given twice, or inside another
+ * argument, are found by (dev, ino) and only counted by the first
+ * argument that reaches them, like du
+ *
+ * @file scan_root.c
+ * @author William Sandström
+ */
+#include "scan_root.h"
+
+static size_t find_ancestors(int dir_fd, DevIno** ancestors);
+static bool contains_dev_ino(DevIno* list, size_t count, dev_t device, ino_t inode);
+
+/**
+ * Stat every argument and find the directories which are given twice
+ * or are inside another argument. An argument inside an earlier one is
+ * skipped, and an earlier argument inside a later one is excluded from it
+ *
+ * @param files NULL terminated list of arguments
+ * @param count set to the amount of arguments
+ *
+ * @return an array of count roots, in argument order
+ */
+ScanRoot* scan_roots_new(char** files, size_t* count) {
+    *count = 0;
+    while (files[*count]) {
+        (*count)++;
+    }
+    ScanRoot* roots = checked_calloc(*count, sizeof(ScanRoot));
+    size_t dir_count = 0;
+    for (size_t i = 0; i < *count; i++) {
+        roots[i].path = files[i];
+        roots[i].exists = lstat(files[i], &roots[i].st_info) == 0;
+        roots[i].dir_fd = -1;
+        if (roots[i].exists && S_ISDIR(roots[i].st_info.st_mode)) {
+            // Anchors the scan, so it does not depend on the working directory
+            roots[i].dir_fd = open(files[i], O_PATH | O_DIRECTORY | O_CLOEXEC);
+            roots[i].exists = roots[i].dir_fd != -1;
+            dir_count += roots[i].exists;
+        }
+        if (!roots[i].exists) {
+            roots[i].error = errno;
+        }
+    }
+    if (dir_count < 2) {
+        return roots;
+    }
+
+    // The directories from every argument up to /, including the argument
+    DevIno** ancestors = checked_calloc(*count, sizeof(DevIno*));
+    size_t* ancestor_counts = checked_calloc(*count, sizeof(size_t));
+    for (size_t i = 0; i < *count; i++) {
+        if (roots[i].dir_fd != -1) {
+            ancestor_counts[i] = find_ancestors(roots[i].dir_fd, &ancestors[i]);
+        }
+    }
+    for (size_t i = 0; i < *count; i++) {
+        for (size_t j = 0; j < i && !roots[i].skipped; j++) {
+            if (!roots[j].skipped && ancestor_counts[j] > 0 &&
+                contains_dev_ino(ancestors[i], ancestor_counts[i], roots[j].st_info.st_dev,
+                                 roots[j].st_info.st_ino)) {
+                // Counted while scanning the earlier argument
+                roots[i].skipped = true;
+            }
+        }
+    }
+    for (size_t i = 0; i < *count; i++) {
+        if (roots[i].skipped || ancestor_counts[i] == 0) {
+            continue;
+        }
+        for (size_t k = i + 1; k < *count; k++) {
+            // The first ancestor is the argument itself, which would be skipped instead
+            if (!roots[k].skipped && ancestor_counts[k] > 0 && ancestor_counts[i] > 1 &&
+                contains_dev_ino(ancestors[i] + 1, ancestor_counts[i] - 1,
+                                 roots[k].st_info.st_dev, roots[k].st_info.st_ino)) {
+                roots[k].excluded = checked_realloc(roots[k].excluded,
+                                                    roots[k].excluded_count + 1,
+                                                    sizeof(DevIno));
+                roots[k].excluded[roots[k].excluded_count].device = roots[i].st_info.st_dev;
+                roots[k].excluded[roots[k].excluded_count].inode = roots[i].st_info.st_ino;
+                roots[k].excluded_count++;
+            }
+        }
+    }
+    for (size_t i = 0; i < *count; i++) {
+        free(ancestors[i]);
+    }
+    free(ancestors);
+    free(ancestor_counts);
+    return roots;
+}
+
+/**
+ * Free an array of roots, but not their file nodes
+ */
+void scan_roots_free(ScanRoot* roots, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(roots[i].excluded);
+        if (roots[i].dir_fd != -1) {
+            close(roots[i].dir_fd);
+        }
+    }
+    free(roots);
+}
+
+/**
+ * Is the directory the argument of an earlier root, which is
+ * counted there instead?
+ *
+ * @param root root being scanned
+ * @param device st_dev of the directory
+ * @param inode st_ino of the directory
+ */
+bool scan_root_excludes(ScanRoot* root, dev_t device, ino_t inode) {
+    return contains_dev_ino(root->excluded, root->excluded_count, device, inode);
+}
+
+// Find the directory and every parent directory up to /, by following ..
+// so that mount points and symlinks resolve like in the kernel
+static size_t find_ancestors(int root_fd, DevIno** ancestors) {
+    size_t count = 0;
+    size_t capacity = 16;
+    *ancestors = checked_malloc(capacity, sizeof(DevIno));
+    int dir_fd = openat(root_fd, ".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    struct stat st_info;
+    while (dir_fd != -1 && fstat(dir_fd, &st_info) == 0) {
+        if (count > 0 && (*ancestors)[count - 1].device == st_info.st_dev &&
+            (*ancestors)[count - 1].inode == st_info.st_ino) {
+            // The parent of / is itself
+            break;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            *ancestors = checked_realloc(*ancestors, capacity, sizeof(DevIno));
+        }
+        (*ancestors)[count].device = st_info.st_dev;
+        (*ancestors)[count].inode = st_info.st_ino;
+        count++;
+        int parent_fd = openat(dir_fd, "..", O_PATH | O_DIRECTORY | O_CLOEXEC);
+        close(dir_fd);
+        dir_fd = parent_fd;
+    }
+    if (dir_fd != -1) {
+        close(dir_fd);
+    }
+    return count;
+}
+
+// Is (device, inode) in the list?
+static bool contains_dev_ino(DevIno* list, size_t count, dev_t device, ino_t inode) {
+    for (size_t i = 0; i < count; i++) {
+        if (list[i].inode == inode && list[i].device == device) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,80 @@
+/**
+ * The command-line arguments of a scan. Every argument is scanned by
+ * the same worker pool. Directories given twice, or inside another
+ * argument, are found by (dev, ino) and only counted by the first
+ * argument that reaches them, like du
+ *
+ * @file scan_root.h
+ * @author William Sandström
+ */
+#pragma once
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "estimate.h"
+#include "file_node.h"
+#include "size_histogram.h"
+#include "util/helpers.h"
+
+typedef struct DevIno DevIno;
+typedef struct ScanRoot ScanRoot;
+
+struct DevIno {
+    dev_t device;
+    ino_t inode;
+};
+
+struct ScanRoot {
+    char* path; // The argument, printed paths start with it
+    struct stat st_info; // lstat of the argument
+    bool exists; // lstat succeeded
+    int error; // errno of the failed lstat or open when it does not exist, reported by the scan
+    int dir_fd; // The argument directory, every path of its scan is opened relative to it
+    bool skipped; // Already counted by an earlier argument, not scanned or printed
+    DevIno* excluded; // Directories of earlier arguments below this one, not counted again
+    size_t excluded_count;
+    // Filled in during the scan
+    FileNode* node; // Totals of the argument, when building file nodes
+    FileNode* cache_node; // The argument in the previous scan, NULL if unknown
+    size_t total_size; // Disk usage without file nodes, updated atomically
+    size_t scanned_dirs; // Directories scanned for --estimate, updated atomically
+    EstimateStrata estimate_strata; // Variance statistics per depth for --estimate
+    SizeHistogram size_histogram; // Merged from the threads, for --size-histogram
+    bool inode_order; // The argument is on a spinning disk, or --inode-order=always
+};
+
+/**
+ * Stat every argument and find the directories which are given twice
+ * or are inside another argument. An argument inside an earlier one is
+ * skipped, and an earlier argument inside a later one is excluded from it
+ *
+ * @param files NULL terminated list of arguments
+ * @param count set to the amount of arguments
+ *
+ * @return an array of count roots, in argument order
+ */
+ScanRoot* scan_roots_new(char** files, size_t* count);
+
+/**
+ * Free an array of roots and close their directories, but not their file nodes
+ */
+void scan_roots_free(ScanRoot* roots, size_t count);
+
+/**
+ * Is the directory the argument of an earlier root, which is
+ * counted there instead?
+ *
+ * @param root root being scanned
+ * @param device st_dev of the directory
+ * @param inode st_ino of the directory
+ */
+bool scan_root_excludes(ScanRoot* root, dev_t device, ino_t inode);
@@ -0,0 +1,85 @@
+/**
+ * Distribution of file sizes in power of two buckets,
+ * used to answer questions like how many files are below 4KiB.
+ * Every thread fills its own histogram, which are merged at the end
+ *
+ * @file size_histogram.c
+ * @author William Sandström
+ */
+#include "size_histogram.h"
+
+/**
+ * Reset every bucket of the histogram to zero
+ */
+void size_histogram_clear(SizeHistogram* histogram) {
+    memset(histogram, 0, sizeof(SizeHistogram));
+}
+
+/**
+ * Add a file to the bucket of its apparent size
+ *
+ * @param histogram histogram to add to
+ * @param size disk usage in bytes
+ * @param apparent_size apparent size in bytes, which decides the bucket
+ */
+void size_histogram_add(SizeHistogram* histogram, size_t size, size_t apparent_size) {
+    size_t bucket = size_histogram_bucket(apparent_size);
+    histogram->file_counts[bucket]++;
+    histogram->sizes[bucket] += size;
+    histogram->apparent_sizes[bucket] += apparent_size;
+}
+
+/**
+ * Add every bucket of src into dest. src is cleared afterwards
+ */
+void size_histogram_merge(SizeHistogram* dest, SizeHistogram* src) {
+    for (size_t i = 0; i < SIZE_HISTOGRAM_BUCKETS; i++) {
+        dest->file_counts[i] += src->file_counts[i];
+        dest->sizes[i] += src->sizes[i];
+        dest->apparent_sizes[i] += src->apparent_sizes[i];
+    }
+    size_histogram_clear(src);
+}
+
+/**
+ * Same as size_histogram_merge, for a dest shared between threads
+ */
+void size_histogram_merge_atomic(SizeHistogram* dest, SizeHistogram* src) {
+    for (size_t i = 0; i < SIZE_HISTOGRAM_BUCKETS; i++) {
+        if (src->file_counts[i] == 0) {
+            continue;
+        }
+        __atomic_add_fetch(&dest->file_counts[i], src->file_counts[i], __ATOMIC_RELAXED);
+        __atomic_add_fetch(&dest->sizes[i], src->sizes[i], __ATOMIC_RELAXED);
+        __atomic_add_fetch(&dest->apparent_sizes[i], src->apparent_sizes[i], __ATOMIC_RELAXED);
+    }
+    size_histogram_clear(src);
+}
+
+/**
+ * Return the bucket of an apparent size
+ */
+size_t size_histogram_bucket(size_t apparent_size) {
+    if (apparent_size == 0) {
+        return 0;
+    }
+    // The amount of significant bits
+    return 64 - __builtin_clzll(apparent_size);
+}
+
+/**
+ * Return the smallest apparent size in a bucket
+ */
+size_t size_histogram_bucket_min(size_t bucket) {
+    return bucket == 0 ? 0 : (size_t) 1 << (bucket - 1);
+}
+
+/**
+ * Return the largest apparent size in a bucket
+ */
+size_t size_histogram_bucket_max(size_t bucket) {
+    if (bucket == 0) {
+        return 0;
+    }
+    return bucket == 64 ? SIZE_MAX : ((size_t) 1 << bucket) - 1;
+}
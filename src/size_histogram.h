@@ -0,0 +1,64 @@
+/**
+ * Distribution of file sizes in power of two buckets,
+ * used to answer questions like how many files are below 4KiB.
+ * Every thread fills its own histogram, which are merged at the end
+ *
+ * @file size_histogram.h
+ * @author William Sandström
+ */
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Bucket 0 holds empty files, bucket i files of 2^(i-1) to 2^i - 1 bytes
+#define SIZE_HISTOGRAM_BUCKETS 65
+
+typedef struct SizeHistogram SizeHistogram;
+
+struct SizeHistogram {
+    size_t file_counts[SIZE_HISTOGRAM_BUCKETS];
+    size_t sizes[SIZE_HISTOGRAM_BUCKETS]; // Disk usage in bytes
+    size_t apparent_sizes[SIZE_HISTOGRAM_BUCKETS]; // Apparent size in bytes
+};
+
+/**
+ * Reset every bucket of the histogram to zero
+ */
+void size_histogram_clear(SizeHistogram* histogram);
+
+/**
+ * Add a file to the bucket of its apparent size
+ *
+ * @param histogram histogram to add to
+ * @param size disk usage in bytes
+ * @param apparent_size apparent size in bytes, which decides the bucket
+ */
+void size_histogram_add(SizeHistogram* histogram, size_t size, size_t apparent_size);
+
+/**
+ * Add every bucket of src into dest. src is cleared afterwards
+ */
+void size_histogram_merge(SizeHistogram* dest, SizeHistogram* src);
+
+/**
+ * Same as size_histogram_merge, for a dest shared between threads
+ */
+void size_histogram_merge_atomic(SizeHistogram* dest, SizeHistogram* src);
+
+/**
+ * Return the bucket of an apparent size
+ */
+size_t size_histogram_bucket(size_t apparent_size);
+
+/**
+ * Return the smallest apparent size in a bucket
+ */
+size_t size_histogram_bucket_min(size_t bucket);
+
+/**
+ * Return the largest apparent size in a bucket
+ */
+size_t size_histogram_bucket_max(size_t bucket);
@@ -0,0 +1,82 @@
+/**
+ * Limit on the amount of worker threads scanning at once, used to
+ * shrink and grow the active worker set during a scan without
+ * stopping threads. Workers over the limit are parked, sleeping
+ * until the limit allows them in again. Everything is lock-free
+ *
+ * @file thread_limit.c
+ * @author William Sandström
+ */
+#include "thread_limit.h"
+
+/**
+ * Initialize a limit
+ *
+ * @param thread_limit limit to initialize
+ * @param max_threads amount of worker threads, the limit is never above this
+ * @param limit initial amount of workers allowed to scan at once
+ */
+void thread_limit_init(ThreadLimit* thread_limit, size_t max_threads, size_t limit) {
+    thread_limit->max_threads = max_threads;
+    thread_limit->active_threads = 0;
+    thread_limit_set(thread_limit, limit);
+}
+
+/**
+ * Wait until the calling worker may scan, which is when less than
+ * the limit of workers are scanning. Paired with thread_limit_leave
+ */
+void thread_limit_enter(ThreadLimit* thread_limit) {
+    // The worker takes its task after getting in, so parked workers hold no task
+    size_t active = __atomic_load_n(&thread_limit->active_threads, __ATOMIC_RELAXED);
+    while (true) {
+        if (active < __atomic_load_n(&thread_limit->limit, __ATOMIC_RELAXED)) {
+            if (__atomic_compare_exchange_n(&thread_limit->active_threads, &active,
+                                            active + 1, true, __ATOMIC_ACQUIRE,
+                                            __ATOMIC_RELAXED)) {
+                return;
+            }
+        }
+        else {
+            struct timespec park_time = { 0, THREAD_LIMIT_PARK_NSECS };
+            nanosleep(&park_time, NULL);
+            active = __atomic_load_n(&thread_limit->active_threads, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * Stop scanning, letting a parked worker in
+ */
+void thread_limit_leave(ThreadLimit* thread_limit) {
+    __atomic_sub_fetch(&thread_limit->active_threads, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Return the amount of workers allowed to scan at once
+ */
+size_t thread_limit_get(ThreadLimit* thread_limit) {
+    return __atomic_load_n(&thread_limit->limit, __ATOMIC_RELAXED);
+}
+
+/**
+ * Change the amount of workers allowed to scan at once,
+ * clamped between 1 and the amount of worker threads
+ */
+void thread_limit_set(ThreadLimit* thread_limit, size_t limit) {
+    if (limit < 1) {
+        limit = 1;
+    }
+    if (limit > thread_limit->max_threads) {
+        limit = thread_limit->max_threads;
+    }
+    __atomic_store_n(&thread_limit->limit, limit, __ATOMIC_RELAXED);
+}
+
+/**
+ * Are as many workers scanning as the limit allows?
+ */
+bool thread_limit_is_saturated(ThreadLimit* thread_limit) {
+    return __atomic_load_n(&thread_limit->active_threads, __ATOMIC_RELAXED) >=
+           thread_limit_get(thread_limit);
+}
@@ -0,0 +1,63 @@
+/**
+ * Limit on the amount of worker threads scanning at once, used to
+ * shrink and grow the active worker set during a scan without
+ * stopping threads. Workers over the limit are parked, sleeping
+ * until the limit allows them in again. Everything is lock-free
+ *
+ * @file thread_limit.h
+ * @author William Sandström
+ */
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// How long a parked worker sleeps before checking the limit again
+#define THREAD_LIMIT_PARK_NSECS 10000000
+
+typedef struct ThreadLimit ThreadLimit;
+
+// Only accessed with atomics
+struct ThreadLimit {
+    size_t max_threads; // Amount of worker threads
+    size_t limit; // Amount of workers allowed to scan at once
+    size_t active_threads; // Amount of workers scanning right now
+};
+
+/**
+ * Initialize a limit
+ *
+ * @param thread_limit limit to initialize
+ * @param max_threads amount of worker threads, the limit is never above this
+ * @param limit initial amount of workers allowed to scan at once
+ */
+void thread_limit_init(ThreadLimit* thread_limit, size_t max_threads, size_t limit);
+
+/**
+ * Wait until the calling worker may scan, which is when less than
+ * the limit of workers are scanning. Paired with thread_limit_leave
+ */
+void thread_limit_enter(ThreadLimit* thread_limit);
+
+/**
+ * Stop scanning, letting a parked worker in
+ */
+void thread_limit_leave(ThreadLimit* thread_limit);
+
+/**
+ * Return the amount of workers allowed to scan at once
+ */
+size_t thread_limit_get(ThreadLimit* thread_limit);
+
+/**
+ * Change the amount of workers allowed to scan at once,
+ * clamped between 1 and the amount of worker threads
+ */
+void thread_limit_set(ThreadLimit* thread_limit, size_t limit);
+
+/**
+ * Are as many workers scanning as the limit allows?
+ */
+bool thread_limit_is_saturated(ThreadLimit* thread_limit);
@@ -0,0 +1,96 @@
+/**
+ * Adaptive thread count for -j auto. More threads than CPUs are
+ * started, since slow file systems like NFS are limited by latency
+ * rather than CPU, but only some of them scan at once. The limit is
+ * tuned during the scan by hill climbing on the measured throughput:
+ * it keeps moving in the same direction while the throughput improves,
+ * and turns around once it gets worse. Surplus workers are parked
+ *
+ * @file thread_tuner.c
+ * @author William Sandström
+ */
+#include "thread_tuner.h"
+
+static void thread_tuner_measure(ThreadTuner* tuner, size_t entries, uint64_t elapsed_nsecs);
+
+/**
+ * Initialize the tuner
+ *
+ * @param tuner tuner to initialize
+ * @param max_threads amount of started worker threads
+ * @param initial_threads amount of workers scanning at the start, ex the CPU count
+ */
+void thread_tuner_init(ThreadTuner* tuner, size_t max_threads, size_t initial_threads) {
+    thread_limit_init(&tuner->threads, max_threads, initial_threads);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    tuner->entries = 0;
+    tuner->last_update_time = (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+    tuner->last_entries = 0;
+    tuner->last_rate = 0;
+    tuner->direction = 1;
+}
+
+/**
+ * Return the amount of threads to start for -j auto
+ *
+ * @param cpu_count amount of CPUs available to the process
+ */
+size_t thread_tuner_max_threads(size_t cpu_count) {
+    size_t max_threads = cpu_count * THREAD_TUNER_THREADS_PER_CPU;
+    return max_threads < THREAD_TUNER_MAX_THREADS ? max_threads : THREAD_TUNER_MAX_THREADS;
+}
+
+/**
+ * Add the entries of a finished directory, and tune the limit if
+ * the interval has passed since the last measurement
+ *
+ * @param tuner shared tuner
+ * @param entries amount of entries scanned
+ */
+void thread_tuner_add_entries(ThreadTuner* tuner, size_t entries) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    thread_tuner_update(tuner, entries, (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec);
+}
+
+/**
+ * Same as thread_tuner_add_entries, at a specific time
+ *
+ * @param tuner shared tuner
+ * @param entries amount of entries scanned
+ * @param now current time in nanoseconds, from CLOCK_MONOTONIC
+ */
+void thread_tuner_update(ThreadTuner* tuner, size_t entries, uint64_t now) {
+    size_t total = __atomic_add_fetch(&tuner->entries, entries, __ATOMIC_RELAXED);
+    uint64_t last_update = __atomic_load_n(&tuner->last_update_time, __ATOMIC_RELAXED);
+    // Only the worker which moves the time forward measures
+    if (now < last_update + THREAD_TUNER_INTERVAL_NSECS ||
+        !__atomic_compare_exchange_n(&tuner->last_update_time, &last_update, now, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+    thread_tuner_measure(tuner, total, now - last_update);
+}
+
+// Compare the throughput with the previous interval and move the limit
+static void thread_tuner_measure(ThreadTuner* tuner, size_t entries, uint64_t elapsed_nsecs) {
+    double rate = (entries - tuner->last_entries) / (elapsed_nsecs / 1e9);
+    tuner->last_entries = entries;
+    if (tuner->last_rate > 0 && rate < tuner->last_rate * (1 - THREAD_TUNER_TOLERANCE)) {
+        // The last change made it worse
+        tuner->direction = -tuner->direction;
+    }
+    tuner->last_rate = rate;
+
+    size_t limit = thread_limit_get(&tuner->threads);
+    // Larger steps with more threads, so that slow file systems get there quickly
+    size_t step = limit >= 4 ? limit / 4 : 1;
+    if (tuner->direction < 0) {
+        thread_limit_set(&tuner->threads, limit > step ? limit - step : 1);
+    }
+    else if (thread_limit_is_saturated(&tuner->threads)) {
+        // More workers only help if every allowed worker has something to do
+        thread_limit_set(&tuner->threads, limit + step);
+    }
+}
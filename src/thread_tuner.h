@@ -0,0 +1,73 @@
+/**
+ * Adaptive thread count for -j auto. More threads than CPUs are
+ * started, since slow file systems like NFS are limited by latency
+ * rather than CPU, but only some of them scan at once. The limit is
+ * tuned during the scan by hill climbing on the measured throughput:
+ * it keeps moving in the same direction while the throughput improves,
+ * and turns around once it gets worse. Surplus workers are parked
+ *
+ * @file thread_tuner.h
+ * @author William Sandström
+ */
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "thread_limit.h"
+
+// Threads started per available CPU with -j auto
+#define THREAD_TUNER_THREADS_PER_CPU 8
+#define THREAD_TUNER_MAX_THREADS 64
+// How often the throughput is measured and the limit changed
+#define THREAD_TUNER_INTERVAL_NSECS 50000000ull
+// Throughput changes below this fraction count as noise
+#define THREAD_TUNER_TOLERANCE 0.05
+
+typedef struct ThreadTuner ThreadTuner;
+
+struct ThreadTuner {
+    ThreadLimit threads;
+    size_t entries; // Entries scanned by every worker, updated atomically
+    uint64_t last_update_time; // Time of the last measurement, from CLOCK_MONOTONIC
+    // Only used by the worker doing the measurement
+    size_t last_entries;
+    double last_rate; // Entries per second of the previous interval, 0 before the first
+    int direction; // 1 while adding workers, -1 while removing them
+};
+
+/**
+ * Initialize the tuner
+ *
+ * @param tuner tuner to initialize
+ * @param max_threads amount of started worker threads
+ * @param initial_threads amount of workers scanning at the start, ex the CPU count
+ */
+void thread_tuner_init(ThreadTuner* tuner, size_t max_threads, size_t initial_threads);
+
+/**
+ * Return the amount of threads to start for -j auto
+ *
+ * @param cpu_count amount of CPUs available to the process
+ */
+size_t thread_tuner_max_threads(size_t cpu_count);
+
+/**
+ * Add the entries of a finished directory, and tune the limit if
+ * the interval has passed since the last measurement
+ *
+ * @param tuner shared tuner
+ * @param entries amount of entries scanned
+ */
+void thread_tuner_add_entries(ThreadTuner* tuner, size_t entries);
+
+/**
+ * Same as thread_tuner_add_entries, at a specific time
+ *
+ * @param tuner shared tuner
+ * @param entries amount of entries scanned
+ * @param now current time in nanoseconds, from CLOCK_MONOTONIC
+ */
+void thread_tuner_update(ThreadTuner* tuner, size_t entries, uint64_t now);
@@ -0,0 +1,171 @@
+/**
+ * Bounded min-heap of the largest records seen,
+ * used to find the N largest files or directories
+ * without keeping or sorting every entry
+ *
+ * @file top_heap.c
+ * @author William Sandström
+ */
+#include "top_heap.h"
+
+static void top_heap_sift_down(TopHeap* heap, size_t index);
+static void top_heap_sift_up(TopHeap* heap, size_t index);
+static void top_heap_insert(TopHeap* heap, OutputRecord record);
+static int compare_records_descending(const void* a, const void* b, void* heap);
+
+/**
+ * Create a new heap keeping at most max_size records
+ * 
+ * @param max_size amount of records to keep
+ * @param key record field to rank by
+ */
+TopHeap top_heap_new(size_t max_size, TopHeapKey key) {
+    TopHeap heap;
+    heap.size = 0;
+    heap.max_size = max_size;
+    heap.key = key;
+    heap.records = max_size > 0 ? checked_malloc(max_size, sizeof(OutputRecord)) : NULL;
+    return heap;
+}
+
+/**
+ * Free the memory of a heap and its record paths
+ */
+void top_heap_free(TopHeap* heap) {
+    for (size_t i = 0; i < heap->size; i++) {
+        free((char*) heap->records[i].path);
+    }
+    free(heap->records);
+    heap->records = NULL;
+    heap->size = 0;
+}
+
+/**
+ * Would a record with this key be kept?
+ * Used to skip building the path of small entries
+ */
+bool top_heap_accepts(TopHeap* heap, size_t key) {
+    return heap->size < heap->max_size || key > top_heap_key(heap, &heap->records[0]);
+}
+
+/**
+ * Return the value a record is ranked by in this heap
+ */
+size_t top_heap_key(TopHeap* heap, OutputRecord* record) {
+    switch (heap->key) {
+        case TOP_KEY_APPARENT_SIZE:
+            return record->apparent_size;
+        case TOP_KEY_ENTRY_COUNT:
+            return record->entry_count;
+        default:
+            return record->size;
+    }
+}
+
+/**
+ * Add a copy of the record, if it is among the largest.
+ * The smallest record is replaced if the heap is full
+ */
+void top_heap_push(TopHeap* heap, OutputRecord* record) {
+    if (!top_heap_accepts(heap, top_heap_key(heap, record))) {
+        return;
+    }
+    OutputRecord copy = *record;
+    char* path = checked_malloc(record->path_length + 1, sizeof(char));
+    memcpy(path, record->path, record->path_length);
+    path[record->path_length] = '\0';
+    copy.path = path;
+    top_heap_insert(heap, copy);
+}
+
+/**
+ * Move every record of src into dest, keeping the largest.
+ * src is empty afterwards
+ */
+void top_heap_merge(TopHeap* dest, TopHeap* src) {
+    for (size_t i = 0; i < src->size; i++) {
+        if (top_heap_accepts(dest, top_heap_key(dest, &src->records[i]))) {
+            top_heap_insert(dest, src->records[i]);
+        }
+        else {
+            free((char*) src->records[i].path);
+        }
+    }
+    src->size = 0;
+}
+
+/**
+ * Sort the records from largest to smallest. This breaks the heap
+ * order, so no more records can be pushed afterwards
+ */
+void top_heap_sort(TopHeap* heap) {
+    qsort_r(heap->records, heap->size, sizeof(OutputRecord), compare_records_descending,
+            heap);
+}
+
+// Insert a record which is known to be accepted, taking ownership of the path
+static void top_heap_insert(TopHeap* heap, OutputRecord record) {
+    if (heap->size < heap->max_size) {
+        heap->records[heap->size] = record;
+        heap->size++;
+        top_heap_sift_up(heap, heap->size - 1);
+    }
+    else {
+        // Replace the smallest record
+        free((char*) heap->records[0].path);
+        heap->records[0] = record;
+        top_heap_sift_down(heap, 0);
+    }
+}
+
+// Move a record up until its parent is smaller
+static void top_heap_sift_up(TopHeap* heap, size_t index) {
+    OutputRecord* records = heap->records;
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (top_heap_key(heap, &records[parent]) <= top_heap_key(heap, &records[index])) {
+            break;
+        }
+        OutputRecord temp = records[parent];
+        records[parent] = records[index];
+        records[index] = temp;
+        index = parent;
+    }
+}
+
+// Move a record down until both children are larger
+static void top_heap_sift_down(TopHeap* heap, size_t index) {
+    OutputRecord* records = heap->records;
+    while (true) {
+        size_t smallest = index;
+        size_t left = index * 2 + 1;
+        size_t right = left + 1;
+        if (left < heap->size &&
+            top_heap_key(heap, &records[left]) < top_heap_key(heap, &records[smallest])) {
+            smallest = left;
+        }
+        if (right < heap->size &&
+            top_heap_key(heap, &records[right]) < top_heap_key(heap, &records[smallest])) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        OutputRecord temp = records[smallest];
+        records[smallest] = records[index];
+        records[index] = temp;
+        index = smallest;
+    }
+}
+
+// Order by the key of the heap, largest first, with the path as a tiebreaker
+static int compare_records_descending(const void* a, const void* b, void* heap) {
+    OutputRecord* record_a = (OutputRecord*) a;
+    OutputRecord* record_b = (OutputRecord*) b;
+    size_t key_a = top_heap_key(heap, record_a);
+    size_t key_b = top_heap_key(heap, record_b);
+    if (key_a != key_b) {
+        return key_a < key_b ? 1 : -1;
+    }
+    return strcmp(record_a->path, record_b->path);
+}
@@ -0,0 +1,78 @@
+/**
+ * Bounded min-heap of the largest records seen,
+ * used to find the N largest files or directories
+ * without keeping or sorting every entry
+ *
+ * @file top_heap.h
+ * @author William Sandström
+ */
+#pragma once
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "output.h"
+#include "util/helpers.h"
+
+// The record field which is ranked
+enum TopHeapKey {
+    TOP_KEY_SIZE,
+    TOP_KEY_APPARENT_SIZE,
+    TOP_KEY_ENTRY_COUNT,
+};
+
+struct TopHeap {
+    size_t size;
+    size_t max_size;
+    enum TopHeapKey key;
+    OutputRecord* records; // Min-heap on the key, the record paths are owned by the heap
+};
+
+typedef enum TopHeapKey TopHeapKey;
+typedef struct TopHeap TopHeap;
+
+/**
+ * Create a new heap keeping at most max_size records
+ * 
+ * @param max_size amount of records to keep
+ * @param key record field to rank by
+ */
+TopHeap top_heap_new(size_t max_size, TopHeapKey key);
+
+/**
+ * Free the memory of a heap and its record paths
+ */
+void top_heap_free(TopHeap* heap);
+
+/**
+ * Would a record with this key be kept?
+ * Used to skip building the path of small entries
+ */
+bool top_heap_accepts(TopHeap* heap, size_t key);
+
+/**
+ * Return the value a record is ranked by in this heap
+ */
+size_t top_heap_key(TopHeap* heap, OutputRecord* record);
+
+/**
+ * Add a copy of the record, if it is among the largest.
+ * The smallest record is replaced if the heap is full
+ */
+void top_heap_push(TopHeap* heap, OutputRecord* record);
+
+/**
+ * Move every record of src into dest, keeping the largest.
+ * src is empty afterwards
+ */
+void top_heap_merge(TopHeap* dest, TopHeap* src);
+
+/**
+ * Sort the records from largest to smallest. This breaks the heap
+ * order, so no more records can be pushed afterwards
+ */
+void top_heap_sort(TopHeap* heap);
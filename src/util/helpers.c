@@ -7,6 +7,12 @@
  */
 #include "helpers.h"
 
+#include <sched.h>
+#include <unistd.h>
+#include <sys/sysmacros.h>
+
+static double cgroup_cpu_quota();
+
 /**
  * Convert C string to unsigned (size_t) integer
  * Prints error_message if string is not a number
@@ -72,4 +78,88 @@ void perror_and_exit(char* error_message) {
     fprintf(stderr, "rdu: %s: %s\n", error_message, strerror(errno));
     perror(error_message);
     exit(EXIT_FAILURE);
-}
\ No newline at end of file
+}
+
+// ================ System information ================
+
+/**
+ * Return the amount of CPUs this process can use, which is the
+ * smaller of the CPUs in the affinity mask and the cgroup CPU quota
+ */
+size_t available_cpu_count() {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t count = online > 0 ? online : 1;
+    cpu_set_t cpu_set;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &cpu_set) == 0 && CPU_COUNT(&cpu_set) > 0) {
+        count = CPU_COUNT(&cpu_set);
+    }
+    double quota = cgroup_cpu_quota();
+    if (quota > 0 && quota < count) {
+        // A quota of 1.5 CPUs can keep 2 threads busy part of the time
+        count = quota > 1 ? (size_t) (quota + 0.999) : 1;
+    }
+    return count;
+}
+
+// Return the CPU quota of the cgroup in CPUs, or 0 if there is none
+static double cgroup_cpu_quota() {
+    long quota = -1;
+    long period = 0;
+    // cgroup v2, "max 100000" without a quota
+    FILE* file = fopen("/sys/fs/cgroup/cpu.max", "r");
+    if (file) {
+        char quota_str[32];
+        if (fscanf(file, "%31s %ld", quota_str, &period) == 2 &&
+            strcmp(quota_str, "max") != 0) {
+            quota = atol(quota_str);
+        }
+        fclose(file);
+    }
+    else {
+        // cgroup v1, -1 without a quota
+        file = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r");
+        if (file) {
+            if (fscanf(file, "%ld", &quota) != 1) {
+                quota = -1;
+            }
+            fclose(file);
+        }
+        file = fopen("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r");
+        if (file) {
+            if (fscanf(file, "%ld", &period) != 1) {
+                period = 0;
+            }
+            fclose(file);
+        }
+    }
+    if (quota <= 0 || period <= 0) {
+        return 0;
+    }
+    return (double) quota / period;
+}
+
+/**
+ * Is the block device a spinning disk, according to sysfs?
+ * False for devices without a queue in sysfs, like NFS and tmpfs
+ *
+ * @param device st_dev of a file on the device
+ */
+bool is_rotational_device(dev_t device) {
+    char path[128];
+    // Partitions have no queue of their own, it belongs to the parent disk
+    const char* formats[] = { "/sys/dev/block/%u:%u/queue/rotational",
+                              "/sys/dev/block/%u:%u/../queue/rotational" };
+    for (size_t i = 0; i < 2; i++) {
+        snprintf(path, sizeof(path), formats[i], major(device), minor(device));
+        FILE* file = fopen(path, "r");
+        if (file) {
+            int rotational = 0;
+            if (fscanf(file, "%d", &rotational) != 1) {
+                rotational = 0;
+            }
+            fclose(file);
+            return rotational == 1;
+        }
+    }
+    return false;
+}
@@ -6,11 +6,15 @@
  * @author William Sandström
  */
 #pragma once
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <errno.h>
+#include <sys/types.h>
 
 /**
  * Convert C string to unsigned (size_t) integer
@@ -44,6 +48,20 @@ void stderr_and_exit(char* error_message);
  */
 void perror_and_exit(char* error_message);
 
+/**
+ * Return the amount of CPUs this process can use, which is the
+ * smaller of the CPUs in the affinity mask and the cgroup CPU quota
+ */
+size_t available_cpu_count();
+
+/**
+ * Is the block device a spinning disk, according to sysfs?
+ * False for devices without a queue in sysfs, like NFS and tmpfs
+ *
+ * @param device st_dev of a file on the device
+ */
+bool is_rotational_device(dev_t device);
+
 /**
  * Combine two paths with a / inbetween
  * Same as sprintf(buffer, "%s/%s", path1, path2)
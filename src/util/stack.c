@@ -75,4 +75,50 @@ void stack_append(Stack* stack1, Stack* stack2) {
 
     memcpy(stack1->elems + stack1->size, stack2->elems, stack2->size * sizeof(StackEntry));
     stack1->size = new_size;
-}
\ No newline at end of file
+}
+
+/**
+ * Push an entry to a stack kept as a max-heap on the priority,
+ * instead of in LIFO order
+ */
+void stack_push_priority(Stack* stack, StackEntry elem) {
+    stack_push(stack, elem);
+    // Sift up
+    size_t i = stack->size - 1;
+    while (i > 0 && stack->elems[(i - 1) / 2].priority < elem.priority) {
+        stack->elems[i] = stack->elems[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    stack->elems[i] = elem;
+}
+
+/**
+ * Pop the entry with the highest priority from a stack
+ * kept as a max-heap with stack_push_priority
+ */
+StackEntry stack_pop_priority(Stack* stack) {
+    StackEntry top = stack->elems[0];
+    StackEntry last = stack_pop(stack);
+    if (stack->size == 0) {
+        return top;
+    }
+    // Sift down the last entry from the top
+    size_t i = 0;
+    while (true) {
+        size_t child = i * 2 + 1;
+        if (child >= stack->size) {
+            break;
+        }
+        if (child + 1 < stack->size &&
+            stack->elems[child + 1].priority > stack->elems[child].priority) {
+            child++;
+        }
+        if (stack->elems[child].priority <= last.priority) {
+            break;
+        }
+        stack->elems[i] = stack->elems[child];
+        i = child;
+    }
+    stack->elems[i] = last;
+    return top;
+}
@@ -18,6 +18,9 @@
 struct StackEntry {
     char* path;
     FileNode* node;
+    FileNode* cache_node; // Node of the directory in the previous scan, NULL if unknown
+    size_t priority; // Entries below the directory in the previous scan
+    struct ScanRoot* root; // Command-line argument the directory is in
 };
 
 typedef struct StackEntry StackEntry;
@@ -67,4 +70,16 @@ StackEntry stack_pop(Stack* stack);
 /**
  * Add stack2 to the end of stack1 using memcpy
  */
-void stack_append(Stack* stack1, Stack* stack2);
\ No newline at end of file
+void stack_append(Stack* stack1, Stack* stack2);
+
+/**
+ * Push an entry to a stack kept as a max-heap on the priority,
+ * instead of in LIFO order
+ */
+void stack_push_priority(Stack* stack, StackEntry elem);
+
+/**
+ * Pop the entry with the highest priority from a stack
+ * kept as a max-heap with stack_push_priority
+ */
+StackEntry stack_pop_priority(Stack* stack);
@@ -0,0 +1,50 @@
+/**
+ * Batches of directory entries for the RduVisitor of a librdu scan.
+ * Every scanning thread fills its own batch while it reads a directory,
+ * and hands it to the visitor once the entries of a read are done or the
+ * batch is full. The names point into the read buffer, so nothing is
+ * copied, and a scan without a visitor only pays for a NULL check
+ *
+ * @file visitor.c
+ * @author William Sandström
+ */
+#include "visitor.h"
+
+/**
+ * Create the batch of a scanning thread
+ *
+ * @param visitor visitor of the scan, NULL for none
+ * @param thread_index index of the thread, passed to the visitor
+ */
+VisitorBatch visitor_batch_new(const RduVisitor* visitor, size_t thread_index) {
+    VisitorBatch batch = { 0 };
+    batch.thread_index = thread_index;
+    if (visitor && visitor->entries) {
+        batch.visitor = visitor;
+        batch.entries = checked_malloc(VISITOR_BATCH_SIZE, sizeof(RduEntry));
+    }
+    return batch;
+}
+
+/**
+ * Free the memory of a batch, which must be flushed
+ */
+void visitor_batch_free(VisitorBatch* batch) {
+    free(batch->entries);
+    free(batch->path);
+    batch->entries = NULL;
+    batch->path = NULL;
+    batch->path_size = 0;
+}
+
+/**
+ * Hand the entries of the batch to the visitor and empty it
+ */
+void visitor_batch_flush(VisitorBatch* batch) {
+    if (batch->count == 0) {
+        return;
+    }
+    batch->visitor->entries(batch->visitor->context, batch->thread_index, batch->path,
+                            batch->depth, batch->entries, batch->count);
+    batch->count = 0;
+}
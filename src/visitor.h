@@ -0,0 +1,80 @@
+/**
+ * Batches of directory entries for the RduVisitor of a librdu scan.
+ * Every scanning thread fills its own batch while it reads a directory,
+ * and hands it to the visitor once the entries of a read are done or the
+ * batch is full. The names point into the read buffer, so nothing is
+ * copied, and a scan without a visitor only pays for a NULL check
+ *
+ * @file visitor.h
+ * @author William Sandström
+ */
+#pragma once
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "librdu.h"
+#include "util/helpers.h"
+
+// Most entries fit in one batch, only very wide directories are split
+#define VISITOR_BATCH_SIZE 4096
+
+typedef struct VisitorBatch VisitorBatch;
+
+struct VisitorBatch {
+    const RduVisitor* visitor; // NULL if the scan has no visitor for entries
+    size_t thread_index; // Passed to the visitor
+    RduEntry* entries;
+    size_t count;
+    char* path; // Directory of the entries
+    size_t path_size;
+    size_t depth;
+};
+
+/**
+ * Create the batch of a scanning thread
+ *
+ * @param visitor visitor of the scan, NULL for none
+ * @param thread_index index of the thread, passed to the visitor
+ */
+VisitorBatch visitor_batch_new(const RduVisitor* visitor, size_t thread_index);
+
+/**
+ * Free the memory of a batch, which must be flushed
+ */
+void visitor_batch_free(VisitorBatch* batch);
+
+/**
+ * Hand the entries of the batch to the visitor and empty it
+ */
+void visitor_batch_flush(VisitorBatch* batch);
+
+/**
+ * Add an entry of the current directory to the batch, flushing it once full.
+ * The name has to stay valid until the batch is flushed
+ *
+ * @param batch batch of the thread
+ * @param name name of the entry
+ * @param type d_type of the entry
+ * @param st_info stat of the entry
+ * @param counted the entry is in the totals
+ */
+static inline void visitor_batch_add(VisitorBatch* batch, const char* name, unsigned char type,
+                                     const struct stat* st_info, bool counted) {
+    RduEntry* entry = &batch->entries[batch->count];
+    entry->name = name;
+    entry->type = type;
+    entry->counted = counted;
+    entry->inode = st_info->st_ino;
+    entry->mode = st_info->st_mode;
+    entry->uid = st_info->st_uid;
+    entry->gid = st_info->st_gid;
+    entry->link_count = st_info->st_nlink;
+    entry->size = st_info->st_blocks * 512; // st_blocks is in 512 byte units
+    entry->apparent_size = st_info->st_size;
+    entry->modification_time = st_info->st_mtime;
+    batch->count++;
+    if (batch->count == VISITOR_BATCH_SIZE) {
+        visitor_batch_flush(batch);
+    }
+}
@@ -0,0 +1,662 @@
+/**
+ * Live maintenance of the trees of the daemon with inotify, for --watch
+ *
+ * @file watch.c
+ * @author William Sandström
+ */
+#include "watch.h"
+
+static size_t read_watch_limit();
+static void read_events(TreeWatch* tree_watch);
+static void apply_events(Watcher* watcher, size_t index);
+static void move_directory(Watcher* watcher, size_t index, WatchEvent* from, WatchEvent* to);
+static void recount_directory(Watcher* watcher, size_t index, FileNode* node);
+static FileNode* scan_child(Watcher* watcher, size_t index, FileNode* parent,
+                            const char* name);
+static void attach_subtree(FileNode* parent, FileNode* node);
+static void remove_subtree(Watcher* watcher, size_t index, FileNode* node);
+static void unwatch_subtree(Watcher* watcher, size_t index, FileNode* node);
+static void mark_dirty(TreeWatch* tree_watch, int wd);
+static WatchSlot* find_slot(TreeWatch* tree_watch, int wd);
+static bool is_counted(Options* options, const char* name, struct stat* st_info);
+static void add_entry(EntryTotals* totals, struct stat* st_info);
+static EntryTotals node_totals(FileNode* node);
+static void add_to_ancestors(FileNode* node, EntryTotals* added, EntryTotals* removed);
+
+/**
+ * Start watching every directory of the trees of the daemon
+ *
+ * @param watcher watcher to initialize
+ * @param server daemon whose trees are kept up to date
+ * @return false if inotify is not available
+ */
+bool watcher_init(Watcher* watcher, Daemon* server) {
+    memset(watcher, 0, sizeof(Watcher));
+    watcher->server = server;
+    watcher->trees = checked_calloc(server->tree_count, sizeof(TreeWatch));
+    watcher->watch_limit = read_watch_limit() * WATCH_LIMIT_SHARE;
+    watcher->stop_fd = eventfd(0, EFD_CLOEXEC);
+    for (size_t i = 0; i < server->tree_count; i++) {
+        watcher->trees[i].fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (watcher->trees[i].fd == -1 || watcher->stop_fd == -1) {
+            int error = errno;
+            for (size_t j = 0; j < i; j++) {
+                close(watcher->trees[j].fd);
+            }
+            if (watcher->stop_fd != -1) {
+                close(watcher->stop_fd);
+            }
+            free(watcher->trees);
+            errno = error;
+            return false;
+        }
+    }
+    // Set before the watches are added, so the daemon moves them along with its trees
+    server->watcher = watcher;
+    for (size_t i = 0; i < server->tree_count; i++) {
+        if (server->trees[i].node) {
+            watcher_add_subtree(watcher, i, server->trees[i].node, false);
+        }
+    }
+    if (watcher->limit_reached) {
+        fprintf(stderr, "rdu: watching %zu directories, the rest are rescanned every %lds\n",
+                watcher->watch_count, (long) server->options->refresh_interval);
+    }
+    return true;
+}
+
+/**
+ * Remove every watch and free the watcher
+ */
+void watcher_free(Watcher* watcher) {
+    for (size_t i = 0; i < watcher->server->tree_count; i++) {
+        TreeWatch* tree_watch = &watcher->trees[i];
+        watcher_remove_tree(watcher, i);
+        // Closing the instance removes the watches in the kernel
+        close(tree_watch->fd);
+        free(tree_watch->slots);
+        free(tree_watch->events);
+        free(tree_watch->dirty_wds);
+    }
+    free(watcher->trees);
+    free(watcher->path_buffer);
+    close(watcher->stop_fd);
+    watcher->server->watcher = NULL;
+}
+
+/**
+ * Watch the directories of a subtree, shallowest first, until the limit of
+ * watches is reached. Called by the thread which changes the trees
+ *
+ * @param watcher watcher of the tree
+ * @param index index of the tree in the daemon
+ * @param node root of the subtree
+ * @param mark_changed count the watched directories again in the next batch,
+ * to catch entries added between the scan of the subtree and its watches
+ */
+void watcher_add_subtree(Watcher* watcher, size_t index, FileNode* node, bool mark_changed) {
+    TreeWatch* tree_watch = &watcher->trees[index];
+    DaemonTree* tree = &watcher->server->trees[index];
+    // Breadth first, so the shallow directories are watched if the limit is reached
+    size_t queue_capacity = 64;
+    FileNode** queue = checked_malloc(queue_capacity, sizeof(FileNode*));
+    size_t queue_start = 0;
+    size_t queue_end = 0;
+    queue[queue_end++] = node;
+    size_t batch_count = 0;
+    while (queue_start < queue_end) {
+        FileNode* current = queue[queue_start++];
+        if (watcher->watch_count >= watcher->watch_limit) {
+            watcher->limit_reached = true;
+            break;
+        }
+        file_node_get_path(current, tree->path, &watcher->path_buffer,
+                           &watcher->path_buffer_size);
+        int wd = inotify_add_watch(tree_watch->fd, watcher->path_buffer, WATCH_EVENT_MASK);
+        if (wd == -1) {
+            if (errno == ENOSPC) {
+                watcher->limit_reached = true;
+                break;
+            }
+            // Removed since the scan, the event of its parent removes it from the tree
+            continue;
+        }
+        WatchSlot* slot = find_slot(tree_watch, wd);
+        if (slot && slot->node) {
+            // The same directory twice in the tree, through a bind mount
+            continue;
+        }
+        if ((size_t) wd >= tree_watch->slot_count) {
+            size_t slot_count = tree_watch->slot_count ? tree_watch->slot_count : 64;
+            while (slot_count <= (size_t) wd) {
+                slot_count *= 2;
+            }
+            tree_watch->slots = checked_realloc(tree_watch->slots, slot_count,
+                                                sizeof(WatchSlot));
+            memset(tree_watch->slots + tree_watch->slot_count, 0,
+                   (slot_count - tree_watch->slot_count) * sizeof(WatchSlot));
+            tree_watch->slot_count = slot_count;
+        }
+        tree_watch->slots[wd].node = current;
+        current->watch_descriptor = wd;
+        watcher->watch_count++;
+        if (mark_changed) {
+            mark_dirty(tree_watch, wd);
+        }
+
+        for (FileNode* child = current->first_child; child; child = child->next_sibling) {
+            if (queue_end == queue_capacity) {
+                // Only the unvisited part is kept
+                memmove(queue, queue + queue_start, (queue_end - queue_start) * sizeof(FileNode*));
+                queue_end -= queue_start;
+                queue_start = 0;
+                if (queue_end == queue_capacity) {
+                    queue_capacity *= 2;
+                    queue = checked_realloc(queue, queue_capacity, sizeof(FileNode*));
+                }
+            }
+            queue[queue_end++] = child;
+        }
+        // The events of the watched directories queue up during a long registration
+        if (++batch_count == WATCH_REGISTER_BATCH) {
+            batch_count = 0;
+            read_events(tree_watch);
+        }
+    }
+    free(queue);
+}
+
+/**
+ * Remove the watches of every directory of a tree, before it is replaced
+ */
+void watcher_remove_tree(Watcher* watcher, size_t index) {
+    TreeWatch* tree_watch = &watcher->trees[index];
+    for (size_t wd = 0; wd < tree_watch->slot_count; wd++) {
+        WatchSlot* slot = &tree_watch->slots[wd];
+        if (slot->node) {
+            inotify_rm_watch(tree_watch->fd, wd);
+            slot->node->watch_descriptor = 0;
+            slot->node = NULL;
+            watcher->watch_count--;
+        }
+        slot->dirty = false;
+    }
+    tree_watch->dirty_count = 0;
+    tree_watch->event_count = 0;
+}
+
+/**
+ * Read the queued events of every tree and apply them, without blocking
+ */
+void watcher_process_events(Watcher* watcher) {
+    for (size_t i = 0; i < watcher->server->tree_count; i++) {
+        TreeWatch* tree_watch = &watcher->trees[i];
+        read_events(tree_watch);
+        apply_events(watcher, i);
+        if (tree_watch->overflowed) {
+            tree_watch->overflowed = false;
+            daemon_refresh(watcher->server, i);
+            continue;
+        }
+        // Recounting can scan and watch new directories, which are counted again too
+        for (size_t j = 0; j < tree_watch->dirty_count; j++) {
+            WatchSlot* slot = &tree_watch->slots[tree_watch->dirty_wds[j]];
+            slot->dirty = false;
+            if (slot->node) {
+                recount_directory(watcher, i, slot->node);
+            }
+        }
+        tree_watch->dirty_count = 0;
+    }
+}
+
+/**
+ * Rescan the subtrees which could not be watched, and try to watch them again
+ */
+void watcher_refresh_unwatched(Watcher* watcher) {
+    Daemon* server = watcher->server;
+    watcher->limit_reached = false;
+    for (size_t i = 0; i < server->tree_count; i++) {
+        FileNode* root = server->trees[i].node;
+        if (root == NULL || root->watch_descriptor == 0) {
+            daemon_refresh(server, i);
+            continue;
+        }
+        // The highest unwatched directories, every directory below them is unwatched too
+        size_t unwatched_count = 0;
+        size_t unwatched_capacity = 16;
+        FileNode** unwatched = checked_malloc(unwatched_capacity, sizeof(FileNode*));
+        FileNode* node = root;
+        while (node) {
+            FileNode* next = NULL;
+            if (node->watch_descriptor != 0) {
+                next = node->first_child;
+            }
+            else {
+                if (unwatched_count == unwatched_capacity) {
+                    unwatched_capacity *= 2;
+                    unwatched = checked_realloc(unwatched, unwatched_capacity,
+                                                sizeof(FileNode*));
+                }
+                unwatched[unwatched_count++] = node;
+            }
+            while (next == NULL && node != root) {
+                next = node->next_sibling;
+                node = node->parent;
+            }
+            node = next;
+        }
+
+        for (size_t j = 0; j < unwatched_count; j++) {
+            FileNode* parent = unwatched[j]->parent;
+            char name[sizeof(unwatched[j]->name)];
+            strcpy(name, unwatched[j]->name);
+            FileNode* scanned = scan_child(watcher, i, parent, name);
+            pthread_rwlock_wrlock(&server->lock);
+            remove_subtree(watcher, i, unwatched[j]);
+            if (scanned) {
+                attach_subtree(parent, scanned);
+            }
+            pthread_rwlock_unlock(&server->lock);
+            if (scanned) {
+                watcher_add_subtree(watcher, i, scanned, true);
+            }
+        }
+        free(unwatched);
+    }
+    // The dirty directories of the new watches are counted right away
+    watcher_process_events(watcher);
+}
+
+/**
+ * Apply events as they arrive, and refresh the directories which could not
+ * be watched every refresh interval, until watcher_stop
+ */
+void watcher_run(Watcher* watcher) {
+    Daemon* server = watcher->server;
+    size_t fd_count = server->tree_count + 1;
+    struct pollfd* fds = checked_calloc(fd_count, sizeof(struct pollfd));
+    fds[0].fd = watcher->stop_fd;
+    fds[0].events = POLLIN;
+    for (size_t i = 0; i < server->tree_count; i++) {
+        fds[i + 1].fd = watcher->trees[i].fd;
+        fds[i + 1].events = POLLIN;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    time_t next_refresh = now.tv_sec + server->options->refresh_interval;
+    while (true) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long timeout_msecs = next_refresh > now.tv_sec ? (next_refresh - now.tv_sec) * 1000 : 0;
+        int ready = poll(fds, fd_count, timeout_msecs);
+        if (ready == -1 && errno != EINTR) {
+            perror("rdu: poll");
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            break;
+        }
+        if (ready > 0) {
+            // A burst of changes, like an extracted archive, is applied at once
+            struct timespec delay = { 0, WATCH_BATCH_DELAY_MSECS * 1000000L };
+            nanosleep(&delay, NULL);
+            watcher_process_events(watcher);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec >= next_refresh) {
+            watcher_refresh_unwatched(watcher);
+            next_refresh = now.tv_sec + server->options->refresh_interval;
+        }
+    }
+    free(fds);
+}
+
+/**
+ * Make watcher_run return, safe to call from any thread
+ */
+void watcher_stop(Watcher* watcher) {
+    uint64_t value = 1;
+    if (write(watcher->stop_fd, &value, sizeof(value)) == -1) {
+        perror("rdu: eventfd");
+    }
+}
+
+// The inotify watches of the user, shared with every other program
+static size_t read_watch_limit() {
+    size_t limit = WATCH_DEFAULT_USER_WATCHES;
+    FILE* file = fopen("/proc/sys/fs/inotify/max_user_watches", "r");
+    if (file) {
+        if (fscanf(file, "%zu", &limit) != 1) {
+            limit = WATCH_DEFAULT_USER_WATCHES;
+        }
+        fclose(file);
+    }
+    return limit;
+}
+
+// Read every queued event into the batch, without blocking
+static void read_events(TreeWatch* tree_watch) {
+    char buffer[WATCH_READ_BUFFER_SIZE]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+    while ((length = read(tree_watch->fd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t offset = 0; offset < length;) {
+            struct inotify_event* event = (struct inotify_event*) (buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                tree_watch->overflowed = true;
+                continue;
+            }
+            if (tree_watch->event_count == tree_watch->event_capacity) {
+                tree_watch->event_capacity = tree_watch->event_capacity ?
+                                                 tree_watch->event_capacity * 2 :
+                                                 64;
+                tree_watch->events = checked_realloc(
+                    tree_watch->events, tree_watch->event_capacity, sizeof(WatchEvent));
+            }
+            WatchEvent* watch_event = &tree_watch->events[tree_watch->event_count++];
+            watch_event->wd = event->wd;
+            watch_event->mask = event->mask;
+            watch_event->cookie = event->cookie;
+            snprintf(watch_event->name, sizeof(watch_event->name), "%s",
+                     event->len > 0 ? event->name : "");
+        }
+    }
+}
+
+// Relink the moved directories and collect the changed ones
+static void apply_events(Watcher* watcher, size_t index) {
+    TreeWatch* tree_watch = &watcher->trees[index];
+    pthread_rwlock_wrlock(&watcher->server->lock);
+    for (size_t i = 0; i < tree_watch->event_count; i++) {
+        WatchEvent* event = &tree_watch->events[i];
+        WatchSlot* slot = find_slot(tree_watch, event->wd);
+        if (slot == NULL || slot->node == NULL) {
+            continue;
+        }
+        if (event->mask & IN_IGNORED) {
+            // The directory is gone, the event of its parent removes the node
+            slot->node->watch_descriptor = 0;
+            slot->node = NULL;
+            watcher->watch_count--;
+            continue;
+        }
+        if ((event->mask & IN_MOVED_TO) && (event->mask & IN_ISDIR)) {
+            // The other half of the move comes right before it
+            for (size_t j = i; j-- > 0;) {
+                WatchEvent* from = &tree_watch->events[j];
+                if ((from->mask & IN_MOVED_FROM) && from->cookie == event->cookie) {
+                    move_directory(watcher, index, from, event);
+                    break;
+                }
+            }
+        }
+        mark_dirty(tree_watch, event->wd);
+    }
+    pthread_rwlock_unlock(&watcher->server->lock);
+    tree_watch->event_count = 0;
+}
+
+// Move a directory and its subtree to its new parent and name. The
+// watches follow the directories, so nothing below it is rescanned
+static void move_directory(Watcher* watcher, size_t index, WatchEvent* from, WatchEvent* to) {
+    TreeWatch* tree_watch = &watcher->trees[index];
+    WatchSlot* from_slot = find_slot(tree_watch, from->wd);
+    WatchSlot* to_slot = find_slot(tree_watch, to->wd);
+    if (from_slot == NULL || from_slot->node == NULL || to_slot->node == NULL) {
+        return;
+    }
+    FileNode* node = file_node_find_child(from_slot->node, from->name);
+    if (node == NULL) {
+        return;
+    }
+    // A directory renamed over an empty one replaces it
+    FileNode* replaced = file_node_find_child(to_slot->node, to->name);
+    if (replaced && replaced != node) {
+        remove_subtree(watcher, index, replaced);
+    }
+    EntryTotals totals = node_totals(node);
+    EntryTotals none = { 0 };
+    add_to_ancestors(node->parent, &none, &totals);
+    file_tree_detach_child(node);
+    file_node_set_name(node, to->name);
+    node->depth = to_slot->node->depth + 1;
+    attach_subtree(to_slot->node, node);
+}
+
+// Count the entries of a directory again, without its subdirectories, and
+// bring its children up to date with the subdirectories which exist now
+static void recount_directory(Watcher* watcher, size_t index, FileNode* node) {
+    Daemon* server = watcher->server;
+    Options* options = server->options;
+    file_node_get_path(node, server->trees[index].path, &watcher->path_buffer,
+                       &watcher->path_buffer_size);
+    int dir_fd = open(watcher->path_buffer, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd == -1) {
+        // Removed, the event of its parent removes the node
+        return;
+    }
+    struct stat st_info;
+    EntryTotals totals = { 0 };
+    if (fstat(dir_fd, &st_info) == 0 && (node->parent == NULL ||
+                                         is_counted(options, node->name, &st_info))) {
+        add_entry(&totals, &st_info);
+    }
+    DIR* dir = fdopendir(dir_fd);
+    if (dir == NULL) {
+        close(dir_fd);
+        return;
+    }
+
+    // New subdirectories are scanned before the lock is taken
+    size_t added_count = 0;
+    size_t added_capacity = 0;
+    FileNode** added = NULL;
+    bool match_patterns = !pattern_matcher_is_empty(&options->patterns);
+    CacheIndex children = cache_index_new();
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        if (is_dot_dir(entry->d_name)) {
+            continue;
+        }
+        if (match_patterns &&
+            pattern_matcher_excludes(&options->patterns, entry->d_name, strlen(entry->d_name))) {
+            continue;
+        }
+        if (fstatat(dir_fd, entry->d_name, &st_info, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+        if (!S_ISDIR(st_info.st_mode)) {
+            if (is_counted(options, entry->d_name, &st_info)) {
+                add_entry(&totals, &st_info);
+            }
+            continue;
+        }
+        FileNode* child = cache_index_find_child(&children, node, entry->d_name);
+        if (child && child->inode == st_info.st_ino) {
+            continue;
+        }
+        FileNode* scanned = scan_child(watcher, index, node, entry->d_name);
+        if (scanned) {
+            if (added_count == added_capacity) {
+                added_capacity = added_capacity ? added_capacity * 2 : 8;
+                added = checked_realloc(added, added_capacity, sizeof(FileNode*));
+            }
+            added[added_count++] = scanned;
+        }
+    }
+    cache_index_free(&children);
+
+    pthread_rwlock_wrlock(&server->lock);
+    // Children which were removed, moved away or replaced by another directory
+    FileNode* child = node->first_child;
+    while (child) {
+        FileNode* next = child->next_sibling;
+        bool exists = fstatat(dir_fd, child->name, &st_info, AT_SYMLINK_NOFOLLOW) == 0 &&
+                      S_ISDIR(st_info.st_mode) && st_info.st_ino == child->inode;
+        if (!exists) {
+            remove_subtree(watcher, index, child);
+        }
+        child = next;
+    }
+    // The entries of the directory itself are whatever is not in its children
+    EntryTotals previous = node_totals(node);
+    for (child = node->first_child; child; child = child->next_sibling) {
+        EntryTotals child_totals = node_totals(child);
+        previous.size -= child_totals.size;
+        previous.apparent_size -= child_totals.apparent_size;
+        previous.sparse_size -= child_totals.sparse_size;
+        previous.slack_size -= child_totals.slack_size;
+        previous.entry_count -= child_totals.entry_count;
+    }
+    add_to_ancestors(node, &totals, &previous);
+    for (size_t i = 0; i < added_count; i++) {
+        attach_subtree(node, added[i]);
+    }
+    pthread_rwlock_unlock(&server->lock);
+    closedir(dir);
+
+    for (size_t i = 0; i < added_count; i++) {
+        watcher_add_subtree(watcher, index, added[i], true);
+    }
+    free(added);
+}
+
+// Scan a new subdirectory into a subtree without a parent
+static FileNode* scan_child(Watcher* watcher, size_t index, FileNode* parent,
+                            const char* name) {
+    size_t path_length = file_node_get_path(parent, watcher->server->trees[index].path,
+                                            &watcher->path_buffer,
+                                            &watcher->path_buffer_size);
+    char* path = checked_malloc(path_length + strlen(name) + 2, sizeof(char));
+    sprintf(path, "%s/%s", watcher->path_buffer, name);
+    FileNode* node = daemon_scan_tree(watcher->server->options, path);
+    free(path);
+    if (node) {
+        file_node_set_name(node, (char*) name);
+        node->depth = parent->depth + 1;
+    }
+    return node;
+}
+
+// Add a subtree without a parent as a child, with its totals
+static void attach_subtree(FileNode* parent, FileNode* node) {
+    EntryTotals totals = node_totals(node);
+    EntryTotals none = { 0 };
+    file_tree_attach_child(parent, node);
+    add_to_ancestors(parent, &totals, &none);
+}
+
+// Remove a subtree, its totals and its watches
+static void remove_subtree(Watcher* watcher, size_t index, FileNode* node) {
+    EntryTotals totals = node_totals(node);
+    EntryTotals none = { 0 };
+    if (node->parent) {
+        add_to_ancestors(node->parent, &none, &totals);
+    }
+    unwatch_subtree(watcher, index, node);
+    file_tree_detach_child(node);
+    file_node_free_all(node);
+}
+
+// Remove the watches of the directories of a subtree
+static void unwatch_subtree(Watcher* watcher, size_t index, FileNode* node) {
+    TreeWatch* tree_watch = &watcher->trees[index];
+    FileNode* current = node;
+    while (current) {
+        WatchSlot* slot = find_slot(tree_watch, current->watch_descriptor);
+        if (slot && slot->node == current) {
+            inotify_rm_watch(tree_watch->fd, current->watch_descriptor);
+            slot->node = NULL;
+            watcher->watch_count--;
+        }
+        current->watch_descriptor = 0;
+        // Depth first through the subtree
+        FileNode* next = current->first_child;
+        while (next == NULL && current != node) {
+            next = current->next_sibling;
+            current = current->parent;
+        }
+        current = next;
+    }
+}
+
+// Add a directory to the changed directories of the batch, once
+static void mark_dirty(TreeWatch* tree_watch, int wd) {
+    WatchSlot* slot = find_slot(tree_watch, wd);
+    if (slot == NULL || slot->dirty) {
+        return;
+    }
+    slot->dirty = true;
+    if (tree_watch->dirty_count == tree_watch->dirty_capacity) {
+        tree_watch->dirty_capacity = tree_watch->dirty_capacity ?
+                                         tree_watch->dirty_capacity * 2 :
+                                         64;
+        tree_watch->dirty_wds = checked_realloc(tree_watch->dirty_wds,
+                                                tree_watch->dirty_capacity, sizeof(int));
+    }
+    tree_watch->dirty_wds[tree_watch->dirty_count++] = wd;
+}
+
+// Slot of a watch descriptor, NULL if it was never added
+static WatchSlot* find_slot(TreeWatch* tree_watch, int wd) {
+    if (wd <= 0 || (size_t) wd >= tree_watch->slot_count) {
+        return NULL;
+    }
+    return &tree_watch->slots[wd];
+}
+
+// Does an entry count towards the totals, like in the scan?
+static bool is_counted(Options* options, const char* name, struct stat* st_info) {
+    bool matches_age = (options->older_than == 0 || st_info->st_mtime < options->older_than) &&
+                       (options->newer_than == 0 || st_info->st_mtime > options->newer_than);
+    return matches_age &&
+           (pattern_matcher_is_empty(&options->patterns) || S_ISDIR(st_info->st_mode) ||
+            pattern_matcher_includes(&options->patterns, name, strlen(name)));
+}
+
+// Add the sizes of one entry
+static void add_entry(EntryTotals* totals, struct stat* st_info) {
+    size_t size = st_info->st_blocks * ST_NBLOCKSIZE;
+    totals->size += size;
+    totals->apparent_size += st_info->st_size;
+    if (S_ISREG(st_info->st_mode)) {
+        if ((size_t) st_info->st_size > size) {
+            totals->sparse_size += st_info->st_size - size;
+        }
+        else {
+            totals->slack_size += size - st_info->st_size;
+        }
+    }
+    totals->entry_count++;
+    if (st_info->st_mtime > totals->modification_time) {
+        totals->modification_time = st_info->st_mtime;
+    }
+}
+
+// Totals of a node, including its subtree
+static EntryTotals node_totals(FileNode* node) {
+    EntryTotals totals;
+    totals.size = node->complete_size;
+    totals.apparent_size = node->complete_apparent_size;
+    totals.sparse_size = node->complete_sparse_size;
+    totals.slack_size = node->complete_slack_size;
+    totals.entry_count = node->complete_entry_count;
+    totals.modification_time = node->last_modification_time;
+    return totals;
+}
+
+// Add and remove totals from a node and every ancestor. The latest
+// modification time only moves forward, like during the scan
+static void add_to_ancestors(FileNode* node, EntryTotals* added, EntryTotals* removed) {
+    for (; node; node = node->parent) {
+        node->complete_size += added->size - removed->size;
+        node->complete_apparent_size += added->apparent_size - removed->apparent_size;
+        node->complete_sparse_size += added->sparse_size - removed->sparse_size;
+        node->complete_slack_size += added->slack_size - removed->slack_size;
+        node->complete_entry_count += added->entry_count - removed->entry_count;
+        if (added->modification_time > node->last_modification_time) {
+            node->last_modification_time = added->modification_time;
+        }
+    }
+}
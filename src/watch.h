@@ -0,0 +1,161 @@
+/**
+ * Live maintenance of the trees of the daemon with inotify, for --watch.
+ * Every directory of the trees is watched, and the events are applied
+ * to the nodes in batches instead of rescanning the arguments:
+ *      a directory moved inside a tree is relinked with its subtree
+ *      every other event marks its directory as changed, and each changed
+ *      directory is counted again once per batch, without its subdirectories
+ *      new subdirectories are scanned and watched
+ * Once the watches of the user run out, the directories which could not be
+ * watched are rescanned every refresh interval instead. A lost queue of
+ * events rescans the whole tree.
+ *
+ * @file watch.h
+ * @author William Sandström
+ */
+#pragma once
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "daemon.h"
+#include "disk_usage.h"
+#include "file_node.h"
+#include "util/helpers.h"
+
+// Events of a watched directory which change the totals of its entries
+#define WATCH_EVENT_MASK                                                                  \
+    (IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR |       \
+     IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+// Watches added before the queued events are read, so the queue does not overflow
+#define WATCH_REGISTER_BATCH 4096
+// Events arriving this long after the first are applied in the same batch
+#define WATCH_BATCH_DELAY_MSECS 50
+// Share of the inotify watches of the user taken at most, the rest is left to other programs
+#define WATCH_LIMIT_SHARE 0.75
+// Used when /proc/sys/fs/inotify/max_user_watches cannot be read
+#define WATCH_DEFAULT_USER_WATCHES 8192
+// Size of the buffer every read of events goes into
+#define WATCH_READ_BUFFER_SIZE (64 * 1024)
+
+typedef struct EntryTotals EntryTotals;
+typedef struct WatchSlot WatchSlot;
+typedef struct WatchEvent WatchEvent;
+typedef struct TreeWatch TreeWatch;
+typedef struct Watcher Watcher;
+
+// Totals of some entries of a tree, added to or removed from their ancestors
+struct EntryTotals {
+    size_t size;
+    size_t apparent_size;
+    size_t sparse_size;
+    size_t slack_size;
+    size_t entry_count;
+    time_t modification_time;
+};
+
+// Directory of a watch descriptor
+struct WatchSlot {
+    FileNode* node; // NULL once the watch is removed
+    bool dirty; // In the changed directories of the batch
+};
+
+// Event read from inotify, applied once the batch is complete
+struct WatchEvent {
+    int wd;
+    uint32_t mask;
+    uint32_t cookie; // Pairs the two events of a move
+    char name[256];
+};
+
+// inotify instance of one tree of the daemon. The trees have their own
+// instances, so a directory in two nested arguments has a watch in each
+struct TreeWatch {
+    int fd;
+    WatchSlot* slots; // Indexed by watch descriptor, which are never reused
+    size_t slot_count;
+    WatchEvent* events; // Events of the current batch
+    size_t event_count;
+    size_t event_capacity;
+    int* dirty_wds; // Changed directories of the current batch
+    size_t dirty_count;
+    size_t dirty_capacity;
+    bool overflowed; // Events were lost, the tree is rescanned
+};
+
+struct Watcher {
+    Daemon* server;
+    TreeWatch* trees; // One per tree of the daemon
+    int stop_fd; // eventfd which wakes watcher_run to stop it
+    size_t watch_count; // Watches of every tree
+    size_t watch_limit;
+    bool limit_reached; // Some directories are rescanned instead of watched
+    char* path_buffer;
+    size_t path_buffer_size;
+};
+
+/**
+ * Start watching every directory of the trees of the daemon
+ *
+ * @param watcher watcher to initialize
+ * @param server daemon whose trees are kept up to date
+ * @return false if inotify is not available
+ */
+bool watcher_init(Watcher* watcher, Daemon* server);
+
+/**
+ * Remove every watch and free the watcher
+ */
+void watcher_free(Watcher* watcher);
+
+/**
+ * Watch the directories of a subtree, shallowest first, until the limit of
+ * watches is reached. Called by the thread which changes the trees
+ *
+ * @param watcher watcher of the tree
+ * @param index index of the tree in the daemon
+ * @param node root of the subtree
+ * @param mark_changed count the watched directories again in the next batch,
+ * to catch entries added between the scan of the subtree and its watches
+ */
+void watcher_add_subtree(Watcher* watcher, size_t index, FileNode* node, bool mark_changed);
+
+/**
+ * Remove the watches of every directory of a tree, before it is replaced
+ */
+void watcher_remove_tree(Watcher* watcher, size_t index);
+
+/**
+ * Read the queued events of every tree and apply them, without blocking
+ */
+void watcher_process_events(Watcher* watcher);
+
+/**
+ * Rescan the subtrees which could not be watched, and try to watch them again
+ */
+void watcher_refresh_unwatched(Watcher* watcher);
+
+/**
+ * Apply events as they arrive, and refresh the directories which could not
+ * be watched every refresh interval, until watcher_stop
+ */
+void watcher_run(Watcher* watcher);
+
+/**
+ * Make watcher_run return, safe to call from any thread
+ */
+void watcher_stop(Watcher* watcher);
@@ -0,0 +1,45 @@
+#!/usr/bin/env bash
+# Benchmark of the growing getdents64 buffers against a fixed 4 KiB buffer,
+# on a wide tree of a few large directories and a narrow tree of many small ones
+# The getdents64 calls are counted with strace, if it is installed
+cd $(dirname $0)
+
+# Make sure required arguments are passed
+if [ "$#" -lt 1 ]; then
+    echo "Usage: ./dirent_buffer_benchmark.sh <dir> [thread_count]"
+    exit 1
+fi
+
+directory=$1/rdu-dirent-buffer-tree
+thread_count=${2:-4}
+adaptive=./../build/release/rdu
+fixed=./../build/release-fixed-dirent/rdu
+
+# Generate a tree with dir_count directories of files_per_dir files each
+generate_tree() {
+    local tree=$1 dir_count=$2 files_per_dir=$3
+    if [ -d "$tree" ]; then
+        return
+    fi
+    echo "[TEST] Generating $dir_count directories with $files_per_dir files each in '$tree'"
+    for d in $(seq $dir_count); do
+        mkdir -p "$tree/dir$d"
+        (cd "$tree/dir$d" && seq -f "file-%.0f" $files_per_dir | xargs touch)
+    done
+}
+
+generate_tree "$directory/wide" 4 250000
+generate_tree "$directory/narrow" 20000 5
+
+for tree in wide narrow; do
+    if command -v strace >/dev/null; then
+        for exe in $fixed $adaptive; do
+            calls=$(strace -f -c -e trace=getdents64 $exe -j $thread_count -s "$directory/$tree" \
+                    2>&1 >/dev/null | awk '/getdents64/ { print $4 }')
+            echo "[TEST] $tree: $exe made $calls getdents64 calls"
+        done
+    fi
+    hyperfine --warmup 2 --export-markdown ../build/dirent_buffer_bench_$tree.md \
+        --parameter-list exe $fixed,$adaptive \
+        "{exe} -j $thread_count -s $directory/$tree"
+done
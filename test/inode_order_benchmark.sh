@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+# Cold-cache benchmark of --inode-order on a generated tree
+# The page, dentry and inode caches are dropped before every run, which needs root
+# The tree should be on the disk being measured, ideally a spinning disk
+cd $(dirname $0)
+
+# Make sure required arguments are passed
+if [ "$#" -lt 1 ]; then
+    echo "Usage: ./inode_order_benchmark.sh <dir> [dir_count] [files_per_dir] [thread_count]"
+    exit 1
+fi
+
+directory=$1/rdu-inode-order-tree
+dir_count=${2:-200}
+files_per_dir=${3:-500}
+thread_count=${4:-4}
+
+if [ ! -d "$directory" ]; then
+    echo "[TEST] Generating $dir_count directories with $files_per_dir files each in '$directory'"
+    # Files are created in a random order, so that the inode numbers
+    # do not follow the order of the directory hashes
+    for d in $(seq $dir_count); do
+        mkdir -p "$directory/dir$d"
+        for f in $(seq $files_per_dir | shuf); do
+            echo "$d $f" > "$directory/dir$d/file$f"
+        done
+    done
+fi
+
+echo "[TEST] Comparing getdents64 order with inode order on a cold cache"
+hyperfine --warmup 1 --export-markdown ../build/inode_order_bench.md \
+    --prepare "sync; echo 3 > /proc/sys/vm/drop_caches" \
+    --parameter-list order never,always \
+    "./../build/release/rdu -j $thread_count --inode-order={order} -s $directory"
@@ -21,6 +21,14 @@ do
         echo "du: ${du_result}, rdu: ${rdu_result}"
         failed_test=true
     fi
+    # Stat:ed in inode order, but printed in the order of du
+    if diff -q <(build/debug/rdu -j 2 -a -B1 --inode-order=always $path 2> /dev/null) \
+               <(du -a -l -B1 $path 2> /dev/null) > /dev/null; then
+        echo -e "[TEST] '${path}' order: ${GREEN} OK ${CLEAR}"
+    else
+        echo -e "[TEST] '${path}' order: ${RED} FAIL${CLEAR}"
+        failed_test=true
+    fi
 done
 
 if [ "$failed_test" = true ] ; then
@@ -6,11 +6,13 @@
 
 void test_arg_parsing();
 void test_min_size_parsing();
+void test_age_parsing();
 
 void test_arg_parsing() {
     printf("[UNIT-TEST] Running argument parsing tests...\n");
 
     test_min_size_parsing();
+    test_age_parsing();
 
     printf("[UNIT-TEST] Passed argument parsing tests!\n");
 }
@@ -79,4 +81,47 @@ void test_min_size_parsing() {
     assert(fcmp(percentage, 0.033));
     // Percentage over 100% not allowed
     assert(!try_parse_min_size_str("101.2%", &bytes, &percentage));
-}
\ No newline at end of file
+}
+
+void test_age_parsing() {
+    time_t seconds = 0;
+    // Days without a suffix
+    assert(try_parse_age_str("90", &seconds));
+    assert(seconds == 90 * 24 * 60 * 60);
+    assert(try_parse_age_str("90d", &seconds));
+    assert(seconds == 90 * 24 * 60 * 60);
+
+    assert(try_parse_age_str("30s", &seconds));
+    assert(seconds == 30);
+    assert(try_parse_age_str("5m", &seconds));
+    assert(seconds == 5 * 60);
+    assert(try_parse_age_str("12h", &seconds));
+    assert(seconds == 12 * 60 * 60);
+    assert(try_parse_age_str("2w", &seconds));
+    assert(seconds == 14 * 24 * 60 * 60);
+    assert(try_parse_age_str("1y", &seconds));
+    assert(seconds == 365 * 24 * 60 * 60);
+    assert(try_parse_age_str("0", &seconds));
+    assert(seconds == 0);
+
+    seconds = 1;
+    assert(!try_parse_age_str("", &seconds));
+    assert(!try_parse_age_str("d", &seconds));
+    assert(!try_parse_age_str("-1d", &seconds));
+    assert(!try_parse_age_str("1dd", &seconds));
+    assert(!try_parse_age_str("1x", &seconds));
+    // Unchanged
+    assert(seconds == 1);
+
+    // Durations are the same, but in seconds without a suffix
+    assert(try_parse_duration_str("30", &seconds));
+    assert(seconds == 30);
+    assert(try_parse_duration_str("30s", &seconds));
+    assert(seconds == 30);
+    assert(try_parse_duration_str("2m", &seconds));
+    assert(seconds == 2 * 60);
+    assert(try_parse_duration_str("1d", &seconds));
+    assert(seconds == 24 * 60 * 60);
+    assert(!try_parse_duration_str("30x", &seconds));
+    assert(!try_parse_duration_str("", &seconds));
+}
@@ -0,0 +1,51 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/cache_index.h"
+
+void test_cache_index();
+void test_cache_index_find_child();
+
+void test_cache_index() {
+    printf("[UNIT-TEST] Running cache index tests...\n");
+
+    test_cache_index_find_child();
+
+    printf("[UNIT-TEST] Passed cache index tests!\n");
+}
+
+void test_cache_index_find_child() {
+    FileNode* root = file_node_new();
+    FileNode* small = file_tree_add_child(root);
+    file_node_set_name(small, "small");
+    FileNode* large = file_tree_add_child(root);
+    file_node_set_name(large, "large");
+    char name[32];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "dir%d", i);
+        FileNode* child = file_tree_add_child(large);
+        file_node_set_name(child, name);
+        child->complete_entry_count = i;
+    }
+
+    CacheIndex index = cache_index_new();
+    // Few children are searched linearly
+    assert(cache_index_find_child(&index, root, "large") == large);
+    assert(index.linear);
+    assert(cache_index_find_child(&index, root, "missing") == NULL);
+    // Many children are hashed
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "dir%d", i);
+        FileNode* child = cache_index_find_child(&index, large, name);
+        assert(child && child->complete_entry_count == (size_t) i);
+    }
+    assert(!index.linear);
+    assert(cache_index_find_child(&index, large, "dir1000") == NULL);
+    // Switching back to another parent
+    assert(cache_index_find_child(&index, root, "small") == small);
+    assert(cache_index_find_child(&index, small, "dir1") == NULL);
+
+    cache_index_free(&index);
+    file_node_free_all(root);
+}
@@ -0,0 +1,288 @@
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../../src/args.h"
+#include "../../src/daemon.h"
+#include "test_helpers.h"
+
+void test_daemon();
+void test_daemon_answer();
+void test_daemon_messages();
+void test_daemon_socket_path();
+void test_daemon_stop();
+void test_daemon_clients();
+pid_t daemon_test_start(char* dir_path, char* socket_path);
+void daemon_test_stop(pid_t pid, char* socket_path);
+int daemon_test_connect(const char* socket_path);
+char* daemon_test_answer(Daemon* server, const char* request);
+
+void test_daemon() {
+    printf("[UNIT-TEST] Running daemon tests...\n");
+
+    test_daemon_answer();
+    test_daemon_messages();
+    test_daemon_socket_path();
+    test_daemon_stop();
+    test_daemon_clients();
+
+    printf("[UNIT-TEST] Passed daemon tests!\n");
+}
+
+char* daemon_test_answer(Daemon* server, const char* request) {
+    size_t response_size;
+    char* response = daemon_answer(server, request, strlen(request), &response_size);
+    assert(strlen(response) == response_size);
+    return response;
+}
+
+void test_daemon_answer() {
+    char dir_template[] = "/tmp/rdu-daemon-test-XXXXXX";
+    assert(mkdtemp(dir_template) != NULL);
+    char* dir_path = realpath(dir_template, NULL);
+    char large_path[128], small_path[128], large_file[128], small_file[128];
+    snprintf(large_path, sizeof(large_path), "%s/large", dir_path);
+    snprintf(small_path, sizeof(small_path), "%s/small", dir_path);
+    snprintf(large_file, sizeof(large_file), "%s/large/file", dir_path);
+    snprintf(small_file, sizeof(small_file), "%s/small/file", dir_path);
+    assert(mkdir(large_path, 0755) == 0);
+    assert(mkdir(small_path, 0755) == 0);
+    test_helpers_write_file(large_file, 65536);
+    test_helpers_write_file(small_file, 10);
+
+    char* files[] = { dir_path, NULL };
+    Options options = test_helpers_options(files, 2, 1024);
+    Daemon server;
+    assert(daemon_init(&server, &options));
+    assert(server.tree_count == 1);
+
+    // Every entry below the argument, and the argument itself
+    char request[256];
+    snprintf(request, sizeof(request), "size\t%s", dir_path);
+    char* response = daemon_test_answer(&server, request);
+    size_t size, apparent_size, entry_count;
+    char path[128];
+    assert(sscanf(response, "ok\n%zu\t%zu\t%zu\t%127s", &size, &apparent_size, &entry_count,
+                  path) == 4);
+    assert(entry_count == 5);
+    assert(apparent_size >= 65546);
+    assert(strcmp(path, dir_path) == 0);
+    free(response);
+
+    // Largest first
+    snprintf(request, sizeof(request), "children\t%s/", dir_path);
+    response = daemon_test_answer(&server, request);
+    char* large_line = strstr(response, large_path);
+    char* small_line = strstr(response, small_path);
+    assert(strncmp(response, "ok\n", 3) == 0);
+    assert(large_line != NULL && small_line != NULL && large_line < small_line);
+    free(response);
+
+    snprintf(request, sizeof(request), "top\t1\t%s", dir_path);
+    response = daemon_test_answer(&server, request);
+    assert(sscanf(response, "ok\n%zu\t%zu\t%zu\t%127s", &size, &apparent_size, &entry_count,
+                  path) == 4);
+    assert(strcmp(path, large_path) == 0);
+    assert(entry_count == 2);
+    assert(strchr(strchr(response, '\n') + 1, '\n')[1] == '\0');
+    free(response);
+
+    snprintf(request, sizeof(request), "size\t%s/missing", dir_path);
+    response = daemon_test_answer(&server, request);
+    assert(strncmp(response, "error\t", 6) == 0);
+    free(response);
+    response = daemon_test_answer(&server, "size\t/");
+    assert(strncmp(response, "error\t", 6) == 0);
+    free(response);
+    response = daemon_test_answer(&server, "largest\t/tmp");
+    assert(strncmp(response, "error\t", 6) == 0);
+    free(response);
+    response = daemon_test_answer(&server, "top\t0\t/tmp");
+    assert(strncmp(response, "error\t", 6) == 0);
+    free(response);
+
+    // A rescan picks up new entries
+    unlink(small_file);
+    daemon_refresh(&server, 0);
+    snprintf(request, sizeof(request), "size\t%s", small_path);
+    response = daemon_test_answer(&server, request);
+    assert(sscanf(response, "ok\n%zu\t%zu\t%zu\t%127s", &size, &apparent_size, &entry_count,
+                  path) == 4);
+    assert(entry_count == 1);
+    free(response);
+
+    daemon_free(&server);
+    pattern_matcher_free(&options.patterns);
+    unlink(large_file);
+    rmdir(large_path);
+    rmdir(small_path);
+    rmdir(dir_path);
+    free(dir_path);
+}
+
+void test_daemon_messages() {
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    assert(daemon_write_message(fds[0], "size\t/tmp", 9));
+    assert(daemon_write_message(fds[0], "", 0));
+    size_t size;
+    char* message = daemon_read_message(fds[1], &size);
+    assert(size == 9 && strcmp(message, "size\t/tmp") == 0);
+    free(message);
+    message = daemon_read_message(fds[1], &size);
+    assert(size == 0 && message[0] == '\0');
+    free(message);
+
+    // Oversized lengths are rejected before reading the message
+    uint32_t length = htonl(DAEMON_MAX_MESSAGE_SIZE + 1);
+    assert(write(fds[0], &length, sizeof(length)) == sizeof(length));
+    assert(daemon_read_message(fds[1], &size) == NULL);
+
+    // End of the connection
+    close(fds[0]);
+    assert(daemon_read_message(fds[1], &size) == NULL);
+    close(fds[1]);
+}
+
+void test_daemon_socket_path() {
+    char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+    char* saved_runtime_dir = runtime_dir ? strdup(runtime_dir) : NULL;
+
+    setenv("XDG_RUNTIME_DIR", "/run/user/1000", 1);
+    char* path = daemon_default_socket_path();
+    assert(strcmp(path, "/run/user/1000/rdu.sock") == 0);
+    free(path);
+    // Never a shared directory like /tmp
+    unsetenv("XDG_RUNTIME_DIR");
+    path = daemon_default_socket_path();
+    assert(strcmp(path, DAEMON_FALLBACK_SOCKET) == 0);
+    free(path);
+    setenv("XDG_RUNTIME_DIR", "", 1);
+    path = daemon_default_socket_path();
+    assert(strcmp(path, DAEMON_FALLBACK_SOCKET) == 0);
+    free(path);
+
+    if (saved_runtime_dir) {
+        setenv("XDG_RUNTIME_DIR", saved_runtime_dir, 1);
+        free(saved_runtime_dir);
+    }
+    else {
+        unsetenv("XDG_RUNTIME_DIR");
+    }
+}
+
+// Run a daemon on a directory in a child process, once its socket exists
+pid_t daemon_test_start(char* dir_path, char* socket_path) {
+    pid_t pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+        char* files[] = { dir_path, NULL };
+        Options options = test_helpers_options(files, 1, 1024);
+        options.socket_path = socket_path;
+        _exit(daemon_run(&options));
+    }
+    // The socket is bound before the first scan
+    struct stat st_info;
+    for (int i = 0; i < 500 && stat(socket_path, &st_info) != 0; i++) {
+        usleep(10000);
+    }
+    assert(stat(socket_path, &st_info) == 0);
+    return pid;
+}
+
+// Stop a daemon of daemon_test_start with SIGTERM, it should exit successfully
+void daemon_test_stop(pid_t pid, char* socket_path) {
+    assert(kill(pid, SIGTERM) == 0);
+    int status = 0;
+    pid_t exited = 0;
+    for (int i = 0; i < 500 && exited == 0; i++) {
+        exited = waitpid(pid, &status, WNOHANG);
+        if (exited == 0) {
+            usleep(10000);
+        }
+    }
+    if (exited == 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+    }
+    assert(exited == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+    struct stat st_info;
+    assert(stat(socket_path, &st_info) != 0);
+}
+
+// Connect to the socket of a daemon
+int daemon_test_connect(const char* socket_path) {
+    struct sockaddr_un address = { 0 };
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    int socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    assert(socket_fd != -1);
+    assert(connect(socket_fd, (struct sockaddr*) &address, sizeof(address)) == 0);
+    return socket_fd;
+}
+
+void test_daemon_stop() {
+    char dir_template[] = "/tmp/rdu-daemon-test-XXXXXX";
+    assert(mkdtemp(dir_template) != NULL);
+    char socket_path[128];
+    snprintf(socket_path, sizeof(socket_path), "%s/rdu.sock", dir_template);
+
+    // Stopped right after it starts waiting for clients, and while it waits
+    for (int wait_ms = 0; wait_ms <= 100; wait_ms += 50) {
+        pid_t pid = daemon_test_start(dir_template, socket_path);
+        usleep(wait_ms * 1000);
+        daemon_test_stop(pid, socket_path);
+    }
+    rmdir(dir_template);
+}
+
+void test_daemon_clients() {
+    char dir_template[] = "/tmp/rdu-daemon-test-XXXXXX";
+    assert(mkdtemp(dir_template) != NULL);
+    char* dir_path = realpath(dir_template, NULL);
+    char socket_path[128];
+    snprintf(socket_path, sizeof(socket_path), "%s/rdu.sock", dir_path);
+    pid_t pid = daemon_test_start(dir_path, socket_path);
+    char request[256];
+    int request_size = snprintf(request, sizeof(request), "size\t%s", dir_path);
+
+    // A client which keeps its connection open and sends a request now and then
+    // does not keep a second client waiting for the timeout of the first
+    int busy_fd = daemon_test_connect(socket_path);
+    int other_fd = daemon_test_connect(socket_path);
+    struct timespec before, after;
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    for (int i = 0; i < 3; i++) {
+        assert(daemon_write_message(busy_fd, request, request_size));
+        size_t response_size;
+        char* response = daemon_read_message(busy_fd, &response_size);
+        assert(response != NULL && strncmp(response, "ok\n", 3) == 0);
+        free(response);
+        if (i == 1) {
+            assert(daemon_write_message(other_fd, request, request_size));
+            response = daemon_read_message(other_fd, &response_size);
+            assert(response != NULL && strncmp(response, "ok\n", 3) == 0);
+            free(response);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    assert(after.tv_sec - before.tv_sec < DAEMON_CLIENT_TIMEOUT_SECS - 1);
+
+    // An idle client is disconnected after the timeout
+    int idle_fd = daemon_test_connect(socket_path);
+    struct timeval timeout = { DAEMON_CLIENT_TIMEOUT_SECS + 3, 0 };
+    setsockopt(idle_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    char byte;
+    assert(read(idle_fd, &byte, 1) == 0);
+
+    close(busy_fd);
+    close(other_fd);
+    close(idle_fd);
+    daemon_test_stop(pid, socket_path);
+    rmdir(dir_path);
+    free(dir_path);
+}
@@ -0,0 +1,173 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../src/dirent_batch.h"
+
+void test_dirent_batch();
+void test_dirent_batch_read_sorted();
+void test_dirent_batch_read_prefetched();
+void test_dirent_buffer_read();
+
+void test_dirent_batch() {
+    printf("[UNIT-TEST] Running dirent batch tests...\n");
+
+    test_dirent_batch_read_sorted();
+    test_dirent_batch_read_prefetched();
+    test_dirent_buffer_read();
+
+    printf("[UNIT-TEST] Passed dirent batch tests!\n");
+}
+
+void test_dirent_batch_read_sorted() {
+    char dir_path[] = "/tmp/rdu-dirent-test-XXXXXX";
+    assert(mkdtemp(dir_path) != NULL);
+    int dir_fd = open(dir_path, O_RDONLY | O_DIRECTORY);
+    assert(dir_fd != -1);
+    // Enough entries for several getdents64 calls
+    const int file_count = 2000;
+    char name[32];
+    for (int i = 0; i < file_count; i++) {
+        snprintf(name, sizeof(name), "file-with-a-long-name-%d", i);
+        int fd = openat(dir_fd, name, O_CREAT | O_WRONLY, 0644);
+        assert(fd != -1);
+        close(fd);
+    }
+
+    DirentBatch batch = dirent_batch_new();
+    // Reused for a second directory read
+    for (int read = 0; read < 2; read++) {
+        lseek(dir_fd, 0, SEEK_SET);
+        char* entries;
+        long nread = dirent_batch_read_sorted(&batch, dir_fd, &entries);
+        assert(nread > DIRENT_BATCH_READ_SIZE);
+        int entry_count = 0;
+        unsigned long last_inode = 0;
+        for (long bpos = 0; bpos < nread; entry_count++) {
+            ldirent* dir_entry = (ldirent*) (entries + bpos);
+            assert(dir_entry->d_ino >= last_inode);
+            last_inode = dir_entry->d_ino;
+            bpos += dir_entry->d_reclen;
+        }
+        // With . and ..
+        assert(entry_count == file_count + 2);
+        // The whole directory is the first chunk
+        assert(dirent_batch_read_sorted(&batch, dir_fd, &entries) == 0);
+    }
+    dirent_batch_free(&batch);
+    assert(batch.buffer == NULL);
+
+    for (int i = 0; i < file_count; i++) {
+        snprintf(name, sizeof(name), "file-with-a-long-name-%d", i);
+        unlinkat(dir_fd, name, 0);
+    }
+    close(dir_fd);
+    rmdir(dir_path);
+}
+
+void test_dirent_batch_read_prefetched() {
+    char dir_path[] = "/tmp/rdu-dirent-prefetch-test-XXXXXX";
+    assert(mkdtemp(dir_path) != NULL);
+    int dir_fd = open(dir_path, O_RDONLY | O_DIRECTORY);
+    assert(dir_fd != -1);
+    const int file_count = 2000;
+    char name[32];
+    for (int i = 0; i < file_count; i++) {
+        snprintf(name, sizeof(name), "file-with-a-long-name-%d", i);
+        int fd = openat(dir_fd, name, O_CREAT | O_WRONLY, 0644);
+        assert(fd != -1);
+        close(fd);
+    }
+
+    // The order of plain getdents64 reads, which du prints in
+    DirentBuffer buffer = dirent_buffer_new();
+    unsigned long* inodes = checked_malloc(file_count + 2, sizeof(unsigned long));
+    int inode_count = 0;
+    char* entries;
+    long nread;
+    while ((nread = dirent_buffer_read(&buffer, dir_fd, &entries)) > 0) {
+        for (long bpos = 0; bpos < nread; inode_count++) {
+            ldirent* dir_entry = (ldirent*) (entries + bpos);
+            assert(inode_count < file_count + 2);
+            inodes[inode_count] = dir_entry->d_ino;
+            bpos += dir_entry->d_reclen;
+        }
+    }
+    assert(inode_count == file_count + 2);
+    dirent_buffer_free(&buffer);
+
+    DirentBatch batch = dirent_batch_new();
+    for (int read = 0; read < 2; read++) {
+        lseek(dir_fd, 0, SEEK_SET);
+        nread = dirent_batch_read_prefetched(&batch, dir_fd, &entries);
+        assert(nread > DIRENT_BATCH_READ_SIZE);
+        int entry_count = 0;
+        for (long bpos = 0; bpos < nread; entry_count++) {
+            ldirent* dir_entry = (ldirent*) (entries + bpos);
+            assert(dir_entry->d_ino == inodes[entry_count]);
+            bpos += dir_entry->d_reclen;
+        }
+        assert(entry_count == file_count + 2);
+        assert(dirent_batch_read_prefetched(&batch, dir_fd, &entries) == 0);
+    }
+    dirent_batch_free(&batch);
+    free(inodes);
+
+    for (int i = 0; i < file_count; i++) {
+        snprintf(name, sizeof(name), "file-with-a-long-name-%d", i);
+        unlinkat(dir_fd, name, 0);
+    }
+    close(dir_fd);
+    rmdir(dir_path);
+}
+
+void test_dirent_buffer_read() {
+    char dir_path[] = "/tmp/rdu-dirent-buffer-test-XXXXXX";
+    assert(mkdtemp(dir_path) != NULL);
+    int dir_fd = open(dir_path, O_RDONLY | O_DIRECTORY);
+    assert(dir_fd != -1);
+    // More than the first buffer fits
+    const int file_count = 4000;
+    char name[32];
+    for (int i = 0; i < file_count; i++) {
+        snprintf(name, sizeof(name), "file-with-a-long-name-%d", i);
+        int fd = openat(dir_fd, name, O_CREAT | O_WRONLY, 0644);
+        assert(fd != -1);
+        close(fd);
+    }
+
+    DirentBuffer buffer = dirent_buffer_new();
+    size_t read_counts[2];
+    for (int read = 0; read < 2; read++) {
+        lseek(dir_fd, 0, SEEK_SET);
+        int entry_count = 0;
+        size_t read_count = 0;
+        char* entries;
+        long nread;
+        while ((nread = dirent_buffer_read(&buffer, dir_fd, &entries)) > 0) {
+            read_count++;
+            for (long bpos = 0; bpos < nread; entry_count++) {
+                bpos += ((ldirent*) (entries + bpos))->d_reclen;
+            }
+        }
+        assert(nread == 0);
+        // With . and ..
+        assert(entry_count == file_count + 2);
+        read_counts[read] = read_count;
+    }
+    // Grown by the first read of the directory, and kept for the next one
+    assert(buffer.capacity > DIRENT_BUFFER_MIN_SIZE);
+    assert(buffer.capacity <= DIRENT_BUFFER_MAX_SIZE);
+    assert(read_counts[1] < read_counts[0]);
+    dirent_buffer_free(&buffer);
+    assert(buffer.data == NULL);
+
+    for (int i = 0; i < file_count; i++) {
+        snprintf(name, sizeof(name), "file-with-a-long-name-%d", i);
+        unlinkat(dir_fd, name, 0);
+    }
+    close(dir_fd);
+    rmdir(dir_path);
+}
@@ -0,0 +1,182 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../src/disk_usage.h"
+#include "test_helpers.h"
+
+// Nested directories with names of this length, the paths are far longer than 512 bytes
+#define DISK_USAGE_TEST_DEPTH 30
+#define DISK_USAGE_TEST_NAME_LENGTH 31
+
+void test_disk_usage();
+void test_disk_usage_deep_tree();
+void test_disk_usage_internal_tree_output();
+void disk_usage_test_capture(Options options, char* output, size_t output_size);
+size_t disk_usage_test_make_deep_tree(const char* dir_path);
+void disk_usage_test_remove_deep_tree(const char* dir_path);
+
+void test_disk_usage() {
+    printf("[UNIT-TEST] Running disk usage tests...\n");
+
+    test_disk_usage_deep_tree();
+    test_disk_usage_internal_tree_output();
+
+    printf("[UNIT-TEST] Passed disk usage tests!\n");
+}
+
+void test_disk_usage_deep_tree() {
+    char dir_path[] = "/tmp/rdu-disk-usage-test-XXXXXX";
+    assert(mkdtemp(dir_path) != NULL);
+    size_t expected_size = disk_usage_test_make_deep_tree(dir_path);
+
+    char* files[] = { dir_path, NULL };
+    Options options = test_helpers_options(files, 2, 1);
+    options.max_depth = 0;
+
+    // The plain scan, which only prints the total
+    char output[256];
+    disk_usage_test_capture(options, output, sizeof(output));
+    size_t size;
+    assert(sscanf(output, "%zu", &size) == 1);
+    assert(size == expected_size);
+
+    // With -j auto, the workers the tuner keeps out park without a task
+    options.auto_threads = true;
+    options.thread_count = 8;
+    FileNode* auto_tree = disk_usage_tree(options, NULL);
+    assert(auto_tree->first_child->complete_size == expected_size);
+    file_node_free_all(auto_tree);
+    options.auto_threads = false;
+    options.thread_count = 2;
+
+    // The scan which builds the tree
+    FileNode* tree = disk_usage_tree(options, NULL);
+    FileNode* root = tree->first_child;
+    assert(root != NULL);
+    assert(root->complete_size == expected_size);
+    // The argument, and a directory of the chain and a leaf per level
+    assert(root->complete_entry_count == 1 + DISK_USAGE_TEST_DEPTH * 2);
+    // Every directory of the chain has its name kept, however long the path is
+    size_t depth = 0;
+    FileNode* node = root;
+    while (node) {
+        FileNode* chain_child = NULL;
+        for (FileNode* child = node->first_child; child; child = child->next_sibling) {
+            assert(strlen(child->name) == DISK_USAGE_TEST_NAME_LENGTH);
+            if (child->name[0] == 'd') {
+                chain_child = child;
+            }
+        }
+        node = chain_child;
+        depth += node != NULL;
+    }
+    assert(depth == DISK_USAGE_TEST_DEPTH);
+    file_node_free_all(tree);
+    pattern_matcher_free(&options.patterns);
+
+    disk_usage_test_remove_deep_tree(dir_path);
+}
+
+void test_disk_usage_internal_tree_output() {
+    char dir_path[] = "/tmp/rdu-disk-usage-test-XXXXXX";
+    assert(mkdtemp(dir_path) != NULL);
+    disk_usage_test_make_deep_tree(dir_path);
+    char cache_path[] = "/tmp/rdu-disk-usage-cache-XXXXXX";
+    int cache_fd = mkstemp(cache_path);
+    assert(cache_fd != -1);
+    close(cache_fd);
+
+    char* files[] = { dir_path, NULL };
+    Options options = test_helpers_options(files, 2, 1);
+    char plain_output[256];
+    disk_usage_test_capture(options, plain_output, sizeof(plain_output));
+    // Only the total of the argument
+    assert(strchr(plain_output, '\n') == strrchr(plain_output, '\n'));
+
+    // --gentle and the cache build the tree internally, and print the same
+    char output[256];
+    options.gentle_ops = 1000000;
+    disk_usage_test_capture(options, output, sizeof(output));
+    assert(strcmp(output, plain_output) == 0);
+    options.gentle_ops = 0;
+    options.create_cache_location = cache_path;
+    disk_usage_test_capture(options, output, sizeof(output));
+    assert(strcmp(output, plain_output) == 0);
+    options.create_cache_location = NULL;
+    options.use_cache_location = cache_path;
+    disk_usage_test_capture(options, output, sizeof(output));
+    assert(strcmp(output, plain_output) == 0);
+    pattern_matcher_free(&options.patterns);
+
+    unlink(cache_path);
+    disk_usage_test_remove_deep_tree(dir_path);
+}
+
+// Run disk_usage, and read what it printed into output
+void disk_usage_test_capture(Options options, char* output, size_t output_size) {
+    char output_path[] = "/tmp/rdu-disk-usage-output-XXXXXX";
+    int output_fd = mkstemp(output_path);
+    assert(output_fd != -1);
+    fflush(stdout);
+    int stdout_fd = dup(STDOUT_FILENO);
+    dup2(output_fd, STDOUT_FILENO);
+    disk_usage(options);
+    dup2(stdout_fd, STDOUT_FILENO);
+    close(stdout_fd);
+    ssize_t length = pread(output_fd, output, output_size - 1, 0);
+    assert(length > 0);
+    output[length] = '\0';
+    close(output_fd);
+    unlink(output_path);
+}
+
+// Create a chain of nested directories with a leaf directory next to every
+// one of them, so that paths are both reused and copied. Returns the disk usage
+size_t disk_usage_test_make_deep_tree(const char* dir_path) {
+    char path[4096];
+    strcpy(path, dir_path);
+    struct stat st_info;
+    assert(stat(path, &st_info) == 0);
+    size_t size = st_info.st_blocks * 512;
+    for (int depth = 0; depth < DISK_USAGE_TEST_DEPTH; depth++) {
+        size_t length = strlen(path);
+        // The leaf, then the next directory of the chain
+        for (int leaf = 1; leaf >= 0; leaf--) {
+            path[length] = '/';
+            memset(path + length + 1, leaf ? 'l' : 'd', DISK_USAGE_TEST_NAME_LENGTH);
+            path[length + 1 + DISK_USAGE_TEST_NAME_LENGTH] = '\0';
+            assert(mkdir(path, 0755) == 0);
+            assert(stat(path, &st_info) == 0);
+            size += st_info.st_blocks * 512;
+        }
+    }
+    assert(strlen(path) > 512);
+    return size;
+}
+
+// Remove the tree of disk_usage_test_make_deep_tree
+void disk_usage_test_remove_deep_tree(const char* dir_path) {
+    char path[4096];
+    strcpy(path, dir_path);
+    for (int depth = 0; depth < DISK_USAGE_TEST_DEPTH; depth++) {
+        size_t length = strlen(path);
+        path[length] = '/';
+        memset(path + length + 1, 'd', DISK_USAGE_TEST_NAME_LENGTH);
+        path[length + 1 + DISK_USAGE_TEST_NAME_LENGTH] = '\0';
+    }
+    size_t dir_length = strlen(dir_path);
+    for (int depth = DISK_USAGE_TEST_DEPTH; depth > 0; depth--) {
+        size_t length = strlen(path);
+        // The leaf next to the deepest directory left
+        memset(path + length - DISK_USAGE_TEST_NAME_LENGTH, 'l', DISK_USAGE_TEST_NAME_LENGTH);
+        assert(rmdir(path) == 0);
+        memset(path + length - DISK_USAGE_TEST_NAME_LENGTH, 'd', DISK_USAGE_TEST_NAME_LENGTH);
+        assert(rmdir(path) == 0);
+        path[length - DISK_USAGE_TEST_NAME_LENGTH - 1] = '\0';
+    }
+    assert(strlen(path) == dir_length);
+    assert(rmdir(path) == 0);
+}
@@ -0,0 +1,222 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../../src/disk_usage.h"
+#include "../../src/estimate.h"
+#include "test_helpers.h"
+
+void test_estimate();
+void test_estimate_random();
+void test_estimate_sample_factor();
+void test_estimate_variance();
+void test_estimate_strata();
+void test_estimate_coverage();
+void estimate_test_make_tree(const char* root, size_t dir_count);
+void estimate_test_scan(Options options, size_t* size, size_t* low, size_t* high);
+
+void test_estimate() {
+    printf("[UNIT-TEST] Running estimate tests...\n");
+
+    test_estimate_random();
+    test_estimate_sample_factor();
+    test_estimate_variance();
+    test_estimate_strata();
+    test_estimate_coverage();
+
+    printf("[UNIT-TEST] Passed estimate tests!\n");
+}
+
+void test_estimate_random() {
+    uint64_t state = estimate_random_seed(0);
+    assert(state != 0);
+    assert(estimate_random_seed(1) != state);
+    size_t counts[4] = { 0 };
+    for (int i = 0; i < 40000; i++) {
+        uint64_t value = estimate_random_below(&state, 4);
+        assert(value < 4);
+        counts[value]++;
+    }
+    for (int i = 0; i < 4; i++) {
+        assert(counts[i] > 9000 && counts[i] < 11000);
+    }
+    assert(estimate_random_below(&state, 1) == 0);
+}
+
+void test_estimate_sample_factor() {
+    assert(estimate_sample_factor(0, 1000) == 1);
+    assert(estimate_sample_factor(999, 1000) == 1);
+    assert(estimate_sample_factor(1000, 1000) == 2);
+    assert(estimate_sample_factor(5500, 1000) == 6);
+    // Sampled subtrees only sample their subdirectories up to the factor
+    assert(estimate_subdirectory_factor(6, 1) == 6);
+    assert(estimate_subdirectory_factor(6, 2) == 3);
+    assert(estimate_subdirectory_factor(6, 4) == 1);
+    assert(estimate_subdirectory_factor(1, 1) == 1);
+}
+
+void test_estimate_variance() {
+    // Always scanned subtrees only pass on their own variance
+    assert(estimate_sampled_variance(100, 0, 1) == 0);
+    assert(estimate_sampled_variance(100, 25, 1) == 25);
+    // (f^2 - f) * value^2 + f * variance
+    assert(estimate_sampled_variance(10, 0, 2) == 200);
+    assert(estimate_sampled_variance(10, 5, 4) == 1220);
+    assert(fabs(estimate_margin(100) - 19.6) < 1e-9);
+
+    // Sample subtrees of known sizes, the estimate should be close to the
+    // true total and the variance estimate close to the actual variance
+    uint64_t state = estimate_random_seed(42);
+    const size_t factor = 4;
+    const int runs = 2000;
+    double true_total = 0;
+    for (int i = 1; i <= 200; i++) {
+        true_total += i;
+    }
+    double estimate_sum = 0;
+    double squared_error_sum = 0;
+    double variance_sum = 0;
+    for (int run = 0; run < runs; run++) {
+        double estimate = 0;
+        double variance = 0;
+        for (int i = 1; i <= 200; i++) {
+            if (estimate_random_below(&state, factor) == 0) {
+                estimate += (double) i * factor;
+                variance += estimate_sampled_variance(i, 0, factor);
+            }
+        }
+        estimate_sum += estimate;
+        squared_error_sum += (estimate - true_total) * (estimate - true_total);
+        variance_sum += variance;
+    }
+    assert(fabs(estimate_sum / runs - true_total) < true_total * 0.01);
+    double actual_variance = squared_error_sum / runs;
+    assert(fabs(variance_sum / runs - actual_variance) < actual_variance * 0.1);
+}
+
+void test_estimate_strata() {
+    EstimateStrata strata = { 0 };
+    estimate_strata_add_scanned(&strata, 0);
+    estimate_strata_add_scanned(&strata, 1);
+    estimate_strata_add_scanned(&strata, 1);
+    estimate_strata_add_scanned(&strata, 2);
+    estimate_strata_add_scanned(&strata, 1000);
+    assert(estimate_strata_scanned(&strata, 0) == 1);
+    assert(estimate_strata_scanned(&strata, 1) == 3);
+    assert(estimate_strata_scanned(&strata, ESTIMATE_DEPTH_COUNT) == 5);
+
+    // Nothing sampled, no variance
+    estimate_strata_add_directory(&strata, 1, 1, 10);
+    estimate_strata_add_directory(&strata, 1, 1, 30);
+    assert(estimate_pooled_variance(&strata) == 0);
+    // 4 subdirectories at depth 2 sampled with factor 3, by a parent scanned
+    // with factor 2: (3 - 1) * 4 * 2 * mean square of depth 1 (500), as
+    // depth 2 has no scanned directories yet
+    estimate_strata_add_sampled(&strata, 2, 2, 3, 4);
+    assert(fabs(estimate_pooled_variance(&strata) - 8000) < 1e-6);
+    // Once it has, they are used: weights 1 and 3, mean square (1 + 3 * 100) / 4
+    estimate_strata_add_directory(&strata, 2, 1, 1);
+    estimate_strata_add_directory(&strata, 2, 3, 10);
+    assert(fabs(estimate_pooled_variance(&strata) - 16 * 301 / 4.0) < 1e-6);
+}
+
+// Directories with a random parent, each with one sparse file. Sizes are
+// spread over 1K-1G, so a few files hold most of the total
+void estimate_test_make_tree(const char* root, size_t dir_count) {
+    char** paths = checked_malloc(dir_count, sizeof(char*));
+    size_t* depths = checked_malloc(dir_count, sizeof(size_t));
+    paths[0] = strdup(root);
+    depths[0] = 0;
+    uint64_t state = estimate_random_seed(7);
+    char path[4096];
+    for (size_t i = 0; i < dir_count; i++) {
+        if (i > 0) {
+            size_t parent;
+            do {
+                parent = estimate_random_below(&state, i);
+            } while (depths[parent] >= 6);
+            snprintf(path, sizeof(path), "%s/d%zu", paths[parent], i);
+            assert(mkdir(path, 0755) == 0);
+            paths[i] = strdup(path);
+            depths[i] = depths[parent] + 1;
+        }
+        snprintf(path, sizeof(path), "%s/file", paths[i]);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        assert(fd != -1);
+        assert(ftruncate(fd, (off_t) 1024 << estimate_random_below(&state, 21)) == 0);
+        close(fd);
+    }
+    for (size_t i = 0; i < dir_count; i++) {
+        free(paths[i]);
+    }
+    free(paths);
+    free(depths);
+}
+
+// Run disk_usage with its output in a file, and read the estimate of the argument
+void estimate_test_scan(Options options, size_t* size, size_t* low, size_t* high) {
+    char output_path[] = "/tmp/rdu-estimate-output-XXXXXX";
+    int output_fd = mkstemp(output_path);
+    assert(output_fd != -1);
+    fflush(stdout);
+    int stdout_fd = dup(STDOUT_FILENO);
+    dup2(output_fd, STDOUT_FILENO);
+    disk_usage(options);
+    dup2(stdout_fd, STDOUT_FILENO);
+    close(stdout_fd);
+
+    char output[4096] = { 0 };
+    assert(pread(output_fd, output, sizeof(output) - 1, 0) > 0);
+    close(output_fd);
+    unlink(output_path);
+    char* record = strstr(output, "\"type\":\"estimate\"");
+    assert(record != NULL);
+    assert(sscanf(record, "\"type\":\"estimate\",\"size\":%zu,\"low\":%zu,\"high\":%zu",
+                  size, low, high) == 3);
+}
+
+void test_estimate_coverage() {
+    char dir_template[] = "/tmp/rdu-estimate-test-XXXXXX";
+    assert(mkdtemp(dir_template) != NULL);
+    estimate_test_make_tree(dir_template, 500);
+
+    char* files[] = { dir_template, NULL };
+    // One thread, so the sampling only depends on the seed and the directory order
+    Options options = test_helpers_options(files, 1, 1);
+    options.apparent_size = true;
+    options.max_depth = 0;
+    options.output_format = FORMAT_NDJSON;
+    // A budget above the directory count scans every directory
+    options.estimate_budget = 1000;
+    size_t true_size, low, high;
+    estimate_test_scan(options, &true_size, &low, &high);
+    assert(low == true_size && high == true_size);
+
+    // The scan time seeds the sampling. The interval should hold the true
+    // total in about 95% of the scans, far fewer means it is too narrow.
+    // Narrow intervals which trusted the sampled siblings alone held it in 55-60%
+    options.estimate_budget = 20;
+    const int runs = 100;
+    int covered = 0;
+    for (int seed = 0; seed < runs; seed++) {
+        options.scan_time = seed;
+        size_t size;
+        estimate_test_scan(options, &size, &low, &high);
+        assert(low <= size && size <= high);
+        if (low <= true_size && true_size <= high) {
+            covered++;
+        }
+    }
+    assert(covered >= runs * 80 / 100);
+
+    pattern_matcher_free(&options.patterns);
+    char command[512];
+    snprintf(command, sizeof(command), "rm -r %s", dir_template);
+    assert(system(command) == 0);
+}
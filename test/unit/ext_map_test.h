@@ -0,0 +1,74 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/ext_map.h"
+
+void test_ext_map();
+void test_ext_map_add();
+void test_ext_map_classify();
+
+void test_ext_map() {
+    printf("[UNIT-TEST] Running extension map tests...\n");
+
+    test_ext_map_add();
+    test_ext_map_classify();
+
+    printf("[UNIT-TEST] Passed extension map tests!\n");
+}
+
+void test_ext_map_add() {
+    ExtMap map1 = ext_map_new();
+    ExtMap map2 = ext_map_new();
+    assert(ext_map_get(&map1, "log", 3) == NULL);
+
+    // Enough extensions to grow the map a few times
+    char ext[16];
+    for (int i = 0; i < 500; i++) {
+        int length = snprintf(ext, sizeof(ext), "e%d", i);
+        ext_map_add(&map1, ext, length, 4096, 10);
+    }
+    ext_map_add(&map1, "log", 3, 100, 50);
+    // Only the first 3 characters are the extension
+    ext_map_add(&map2, "log.1", 3, 200, 150);
+    assert(map1.size == 501);
+
+    ext_map_merge(&map1, &map2);
+    assert(map2.size == 0);
+    assert(map1.size == 501);
+    ExtUsage* usage = ext_map_get(&map1, "log", 3);
+    assert(usage != NULL);
+    assert(strcmp(usage->ext, "log") == 0);
+    assert(usage->size == 300);
+    assert(usage->apparent_size == 200);
+    assert(usage->entry_count == 2);
+    assert(ext_map_get(&map1, "e499", 4)->size == 4096);
+
+    ext_map_free(&map1);
+    ext_map_free(&map2);
+}
+
+void test_ext_map_classify() {
+    size_t length;
+    const char* ext = ext_map_classify("archive.tar.gz", NULL, &length);
+    assert(length == 2 && strncmp(ext, "gz", length) == 0);
+    // Hidden files and names ending in a dot have no extension
+    assert(ext_map_classify(".bashrc", NULL, &length) == NULL);
+    assert(ext_map_classify("Makefile", NULL, &length) == NULL);
+    assert(ext_map_classify("name.", NULL, &length) == NULL);
+    ext = ext_map_classify(".config.json", NULL, &length);
+    assert(length == 4 && strncmp(ext, "json", length) == 0);
+
+    // The longest listed suffix wins
+    ExtMap extensions = ext_map_from_list("gz,.tar.gz,log,");
+    assert(extensions.size == 3);
+    ext = ext_map_classify("archive.tar.gz", &extensions, &length);
+    assert(length == 6 && strncmp(ext, "tar.gz", length) == 0);
+    ext = ext_map_classify("dump.gz", &extensions, &length);
+    assert(length == 2 && strncmp(ext, "gz", length) == 0);
+    ext = ext_map_classify("app.log", &extensions, &length);
+    assert(length == 3 && strncmp(ext, "log", length) == 0);
+    assert(ext_map_classify("app.log.1", &extensions, &length) == NULL);
+    assert(ext_map_classify("data.parquet", &extensions, &length) == NULL);
+    ext_map_free(&extensions);
+}
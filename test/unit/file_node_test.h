@@ -7,6 +7,9 @@
 void test_file_node_simple();
 void test_file_node_saving();
 void test_file_node_find();
+void test_file_node_find_argument();
+void test_file_node_path();
+void test_file_node_detach();
 void test_file_node_validate_tree(FileNode* root, FileNode* child1, FileNode* child2,
                                   FileNode* child21);
 
@@ -16,6 +19,9 @@ void test_file_node() {
     test_file_node_simple();
     test_file_node_saving();
     test_file_node_find();
+    test_file_node_find_argument();
+    test_file_node_path();
+    test_file_node_detach();
 
     printf("[UNIT-TEST] Passed file node/tree tests!\n");
 }
@@ -96,4 +102,84 @@ void test_file_node_find() {
     assert(found_node == NULL);
 
     file_node_free_all(root);
-}
\ No newline at end of file
+}
+
+void test_file_node_find_argument() {
+    // Two argument paths which only differ after the saved name is truncated
+    char first_path[300];
+    char second_path[300];
+    memset(first_path, 'a', sizeof(first_path) - 1);
+    first_path[sizeof(first_path) - 1] = '\0';
+    strcpy(second_path, first_path);
+    second_path[sizeof(second_path) - 2] = 'b';
+
+    FileNode* root = file_node_new();
+    FileNode* short_child = file_tree_add_child(root);
+    file_node_set_name(short_child, "/short");
+    short_child->inode = 1;
+    FileNode* first = file_tree_add_child(root);
+    file_node_set_name(first, first_path);
+    first->inode = 2;
+    FileNode* second = file_tree_add_child(root);
+    file_node_set_name(second, second_path);
+    second->inode = 3;
+
+    assert(file_node_find_argument(root, "/short", 1) == short_child);
+    assert(file_node_find_argument(root, "/short/a", 1) == NULL);
+    assert(file_node_find_argument(root, "/short", 2) == NULL);
+    assert(file_node_find_argument(root, first_path, 2) == first);
+    assert(file_node_find_argument(root, second_path, 3) == second);
+    assert(file_node_find_argument(root, second_path, 4) == NULL);
+
+    file_node_free_all(root);
+}
+
+void test_file_node_path() {
+    FileNode* root = file_node_new();
+    FileNode* child = file_tree_add_child(root);
+    file_node_set_name(child, "child");
+    FileNode* grandchild = file_tree_add_child(child);
+    file_node_set_name(grandchild, "grandchild");
+
+    char* buffer = NULL;
+    size_t buffer_size = 0;
+    size_t length = file_node_get_path(grandchild, "root", &buffer, &buffer_size);
+    assert(length == strlen("root/child/grandchild"));
+    assert(strcmp(buffer, "root/child/grandchild") == 0);
+
+    // Root is printed as passed
+    file_node_get_path(root, "root/", &buffer, &buffer_size);
+    assert(strcmp(buffer, "root/") == 0);
+
+    // Trailing slashes of the root are not repeated
+    file_node_get_path(child, "/", &buffer, &buffer_size);
+    assert(strcmp(buffer, "/child") == 0);
+    file_node_get_path(grandchild, "root/", &buffer, &buffer_size);
+    assert(strcmp(buffer, "root/child/grandchild") == 0);
+
+    free(buffer);
+    file_node_free_all(root);
+}
+void test_file_node_detach() {
+    FileNode* root = file_node_new();
+    FileNode* child1 = file_tree_add_child(root);
+    FileNode* child2 = file_tree_add_child(root);
+    FileNode* child3 = file_tree_add_child(root);
+
+    // Middle, last and only child
+    file_tree_detach_child(child2);
+    assert(child2->parent == NULL && child2->next_sibling == NULL &&
+           child2->previous_sibling == NULL);
+    assert(child1->next_sibling == child3 && child3->previous_sibling == child1);
+    file_tree_detach_child(child3);
+    assert(root->last_child == child1 && child1->next_sibling == NULL);
+    file_tree_detach_child(child1);
+    assert(root->first_child == NULL && root->last_child == NULL);
+
+    // Reattached elsewhere
+    file_tree_attach_child(child1, child2);
+    assert(child1->first_child == child2 && child2->parent == child1);
+    file_node_free_all(root);
+    file_node_free_all(child1);
+    file_node_free_all(child3);
+}
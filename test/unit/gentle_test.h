@@ -0,0 +1,72 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../../src/gentle.h"
+
+void test_gentle();
+void test_gentle_rate_limit();
+void test_gentle_thread_limit();
+
+void test_gentle() {
+    printf("[UNIT-TEST] Running gentle scanning tests...\n");
+
+    test_gentle_rate_limit();
+    test_gentle_thread_limit();
+
+    printf("[UNIT-TEST] Passed gentle scanning tests!\n");
+}
+
+void test_gentle_rate_limit() {
+    Gentle gentle;
+    // 1000 calls per second, one every millisecond
+    gentle_init(&gentle, 4, 1000);
+    assert(gentle.op_interval_nsecs == 1000000);
+    uint64_t now = 10000000000ull;
+    // A full burst is allowed without waiting
+    size_t burst = GENTLE_BURST_NSECS / gentle.op_interval_nsecs;
+    for (size_t i = 0; i < burst; i++) {
+        assert(gentle_reserve_op(&gentle, now) == 0);
+    }
+    // Then every call waits for its own interval
+    assert(gentle_reserve_op(&gentle, now) == 0);
+    assert(gentle_reserve_op(&gentle, now) == 1000000);
+    assert(gentle_reserve_op(&gentle, now) == 2000000);
+    // Time passing refills the bucket, but only up to the burst
+    now += 10 * GENTLE_BURST_NSECS;
+    assert(gentle_reserve_op(&gentle, now) == 0);
+}
+
+void test_gentle_thread_limit() {
+    Gentle gentle;
+    gentle_init(&gentle, 8, 1000);
+    uint64_t now = 10000000000ull;
+    uint64_t slow = GENTLE_TARGET_LATENCY_NSECS * 2;
+    uint64_t fast = GENTLE_TARGET_LATENCY_NSECS / 4;
+
+    gentle_add_latency(&gentle, slow * 10, 10, now);
+    assert(gentle.threads.limit == 4);
+    // Too soon after the last change
+    gentle_add_latency(&gentle, slow * 10, 10, now + 1);
+    assert(gentle.threads.limit == 4);
+    now += GENTLE_ADJUST_INTERVAL_NSECS;
+    gentle_add_latency(&gentle, slow, 1, now);
+    assert(gentle.threads.limit == 2);
+    now += GENTLE_ADJUST_INTERVAL_NSECS;
+    gentle_add_latency(&gentle, slow, 1, now);
+    now += GENTLE_ADJUST_INTERVAL_NSECS;
+    gentle_add_latency(&gentle, slow, 1, now);
+    // Never below one worker
+    assert(gentle.threads.limit == 1);
+
+    // Recovers one worker at a time, up to every thread
+    for (int i = 0; i < 20; i++) {
+        now += GENTLE_ADJUST_INTERVAL_NSECS;
+        gentle_add_latency(&gentle, fast * 5, 5, now);
+        assert(gentle.threads.limit == (size_t) (i + 2 < 8 ? i + 2 : 8));
+    }
+    // Directories without stat calls change nothing
+    now += GENTLE_ADJUST_INTERVAL_NSECS;
+    gentle_add_latency(&gentle, 0, 0, now);
+    assert(gentle.threads.limit == 8);
+}
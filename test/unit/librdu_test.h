@@ -0,0 +1,285 @@
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../src/librdu.h"
+#include "test_helpers.h"
+
+void test_librdu();
+void test_librdu_scan();
+void test_librdu_cancel();
+void test_librdu_visitor();
+void test_librdu_deep_path();
+void librdu_test_visit_entries(void* context, size_t thread_index, const char* directory_path,
+                               size_t depth, const RduEntry* entries, size_t count);
+void librdu_test_visit_directory(void* context, size_t thread_index,
+                                 const RduDirectory* directory);
+
+void test_librdu() {
+    printf("[UNIT-TEST] Running librdu tests...\n");
+
+    test_librdu_scan();
+    test_librdu_cancel();
+    test_librdu_visitor();
+    test_librdu_deep_path();
+
+    printf("[UNIT-TEST] Passed librdu tests!\n");
+}
+
+void test_librdu_scan() {
+    char dir_template[] = "/tmp/rdu-librdu-test-XXXXXX";
+    assert(mkdtemp(dir_template) != NULL);
+    char command[512];
+    snprintf(command, sizeof(command), "mkdir -p %s/a/b %s/skip", dir_template, dir_template);
+    assert(system(command) == 0);
+    char file_path[128], log_path[128], missing_path[128];
+    snprintf(file_path, sizeof(file_path), "%s/a/b/file", dir_template);
+    snprintf(log_path, sizeof(log_path), "%s/a/file.log", dir_template);
+    snprintf(missing_path, sizeof(missing_path), "%s/missing", dir_template);
+    test_helpers_write_file(file_path, 10000);
+    test_helpers_write_file(log_path, 300);
+
+    RduScanner* scanner = rdu_scanner_new(2);
+    assert(scanner != NULL);
+    assert(rdu_scan_wait(scanner) == RDU_ERROR_INVALID);
+
+    // The missing path is an error of the scan, not of the call
+    const char* paths[] = { dir_template, missing_path, NULL };
+    assert(rdu_scan_start(scanner, paths, NULL) == RDU_OK);
+    assert(rdu_scan_wait(scanner) == RDU_OK);
+    assert(rdu_scan_root_count(scanner) == 2);
+    const RduNode* root = rdu_scan_root(scanner, 0);
+    assert(strcmp(rdu_node_name(root), dir_template) == 0);
+    assert(rdu_node_entry_count(root) == 6);
+    assert(rdu_node_apparent_size(root) >= 10300);
+    assert(!rdu_node_incomplete(root));
+    assert(rdu_scan_root(scanner, 1) == NULL);
+    assert(rdu_scan_error_count(scanner) == 1);
+    assert(strcmp(rdu_scan_error_path(scanner, 0), missing_path) == 0);
+    assert(rdu_scan_error_code(scanner, 0) == ENOENT);
+    size_t child_count = 0;
+    for (const RduNode* child = rdu_node_first_child(root); child;
+         child = rdu_node_next_sibling(child)) {
+        child_count++;
+    }
+    assert(child_count == 2);
+    size_t apparent_size = rdu_node_apparent_size(root);
+
+    // The scanner is reused with other options, and a nested path is counted once
+    const char* excludes[] = { "skip", "*.log", NULL };
+    RduScanOptions options;
+    rdu_scan_options_init(&options);
+    options.excludes = excludes;
+    char a_path[128];
+    snprintf(a_path, sizeof(a_path), "%s/a", dir_template);
+    const char* nested_paths[] = { dir_template, a_path, NULL };
+    assert(rdu_scan_start(scanner, nested_paths, &options) == RDU_OK);
+    assert(rdu_scan_wait(scanner) == RDU_OK);
+    root = rdu_scan_root(scanner, 0);
+    assert(rdu_node_entry_count(root) == 4);
+    assert(rdu_node_apparent_size(root) < apparent_size - 300);
+    assert(rdu_scan_root(scanner, 1) == NULL);
+    assert(rdu_scan_error_count(scanner) == 0);
+
+    // Include patterns only select files, every directory is still counted
+    const char* includes[] = { "*.log", NULL };
+    rdu_scan_options_init(&options);
+    options.includes = includes;
+    assert(rdu_scan_start(scanner, paths, &options) == RDU_OK);
+    assert(rdu_scan_wait(scanner) == RDU_OK);
+    root = rdu_scan_root(scanner, 0);
+    assert(rdu_node_entry_count(root) == 5);
+    assert(rdu_node_apparent_size(root) == apparent_size - 10000);
+
+    // Patterns match names, so a pattern with '/' is rejected
+    const char* path_includes[] = { "a/file.log", NULL };
+    options.includes = path_includes;
+    assert(rdu_scan_start(scanner, paths, &options) == RDU_ERROR_INVALID);
+
+    rdu_scanner_free(scanner);
+    snprintf(command, sizeof(command), "rm -r %s", dir_template);
+    assert(system(command) == 0);
+}
+
+void test_librdu_cancel() {
+    char dir_template[] = "/tmp/rdu-librdu-test-XXXXXX";
+    assert(mkdtemp(dir_template) != NULL);
+    char command[512];
+    snprintf(command, sizeof(command),
+             "cd %s && mkdir -p $(seq -f 'd%%g/e' 1 2000)", dir_template);
+    assert(system(command) == 0);
+
+    // A single thread has not started the subdirectories when the scan is cancelled
+    RduScanner* scanner = rdu_scanner_new(1);
+    const char* paths[] = { dir_template, NULL };
+    assert(rdu_scan_start(scanner, paths, NULL) == RDU_OK);
+    assert(rdu_scan_start(scanner, paths, NULL) == RDU_ERROR_BUSY);
+    rdu_scan_cancel(scanner);
+    assert(rdu_scan_wait(scanner) == RDU_CANCELLED);
+    const RduNode* root = rdu_scan_root(scanner, 0);
+    assert(rdu_node_incomplete(root));
+    assert(rdu_node_entry_count(root) < 4001);
+
+    // The next scan is complete again
+    assert(rdu_scan_start(scanner, paths, NULL) == RDU_OK);
+    assert(rdu_scan_wait(scanner) == RDU_OK);
+    root = rdu_scan_root(scanner, 0);
+    assert(!rdu_node_incomplete(root));
+    assert(rdu_node_entry_count(root) == 4001);
+    rdu_scanner_free(scanner);
+
+    // Freeing cancels the running scan
+    scanner = rdu_scanner_new(0);
+    assert(rdu_scan_start(scanner, paths, NULL) == RDU_OK);
+    rdu_scanner_free(scanner);
+
+    snprintf(command, sizeof(command), "rm -r %s", dir_template);
+    assert(system(command) == 0);
+}
+
+// Totals of one scanning thread, kept without locks
+struct LibrduTestCounts {
+    size_t entries;
+    size_t apparent_size;
+    size_t directories;
+    size_t root_entry_count;
+};
+
+void librdu_test_visit_entries(void* context, size_t thread_index, const char* directory_path,
+                               size_t depth, const RduEntry* entries, size_t count) {
+    struct LibrduTestCounts* counts = (struct LibrduTestCounts*) context + thread_index;
+    assert(strncmp(directory_path, "/tmp/rdu-librdu-test-", 21) == 0);
+    assert(depth <= 2);
+    for (size_t i = 0; i < count; i++) {
+        assert(entries[i].type == DT_DIR || entries[i].type == DT_REG ||
+               entries[i].type == DT_UNKNOWN);
+        assert(strcmp(entries[i].name, "skip") != 0);
+        counts->entries++;
+        counts->apparent_size += entries[i].apparent_size;
+    }
+}
+
+void librdu_test_visit_directory(void* context, size_t thread_index,
+                                 const RduDirectory* directory) {
+    struct LibrduTestCounts* counts = (struct LibrduTestCounts*) context + thread_index;
+    counts->directories++;
+    if (directory->depth == 0) {
+        counts->root_entry_count = directory->entry_count;
+    }
+}
+
+void test_librdu_visitor() {
+    char dir_template[] = "/tmp/rdu-librdu-test-XXXXXX";
+    assert(mkdtemp(dir_template) != NULL);
+    char command[512];
+    snprintf(command, sizeof(command), "mkdir -p %s/a/b %s/c %s/skip", dir_template,
+             dir_template, dir_template);
+    assert(system(command) == 0);
+    char file_path[128];
+    snprintf(file_path, sizeof(file_path), "%s/a/b/file", dir_template);
+    test_helpers_write_file(file_path, 5000);
+
+    RduScanner* scanner = rdu_scanner_new(3);
+    size_t thread_count = rdu_scanner_thread_count(scanner);
+    assert(thread_count == 3);
+    struct LibrduTestCounts counts[3] = { 0 };
+    RduVisitor visitor = { librdu_test_visit_entries, librdu_test_visit_directory, counts };
+    const char* excludes[] = { "skip", NULL };
+    RduScanOptions options;
+    rdu_scan_options_init(&options);
+    options.excludes = excludes;
+    options.visitor = &visitor;
+    const char* paths[] = { dir_template, NULL };
+    assert(rdu_scan_start(scanner, paths, &options) == RDU_OK);
+    assert(rdu_scan_wait(scanner) == RDU_OK);
+
+    // Every entry below the argument was visited, and every directory once final
+    struct LibrduTestCounts total = { 0 };
+    for (size_t i = 0; i < thread_count; i++) {
+        total.entries += counts[i].entries;
+        total.apparent_size += counts[i].apparent_size;
+        total.directories += counts[i].directories;
+        total.root_entry_count += counts[i].root_entry_count;
+    }
+    const RduNode* root = rdu_scan_root(scanner, 0);
+    assert(total.entries == 4);
+    assert(total.directories == 4);
+    assert(total.root_entry_count == 5);
+    struct stat st_info;
+    assert(stat(dir_template, &st_info) == 0);
+    assert(total.apparent_size + st_info.st_size == rdu_node_apparent_size(root));
+    assert(rdu_node_entry_count(root) == 5);
+    // Only the totals of the argument are kept
+    assert(rdu_node_first_child(root) == NULL);
+
+    rdu_scanner_free(scanner);
+    snprintf(command, sizeof(command), "rm -r %s", dir_template);
+    assert(system(command) == 0);
+}
+
+void test_librdu_deep_path() {
+    char dir_template[] = "/tmp/rdu-librdu-test-XXXXXX";
+    assert(mkdtemp(dir_template) != NULL);
+    // 30 nested directories with 31 byte names, a path of almost 1000 bytes
+    const size_t depth = 30;
+    char deep_path[1024];
+    size_t length = snprintf(deep_path, sizeof(deep_path), "%s", dir_template);
+    for (size_t i = 0; i < depth; i++) {
+        length += snprintf(deep_path + length, sizeof(deep_path) - length,
+                           "/directory-with-a-long-name-%03zu", i);
+    }
+    assert(length > 512);
+    char command[2048];
+    snprintf(command, sizeof(command), "mkdir -p %s", deep_path);
+    assert(system(command) == 0);
+    char file_path[1100];
+    snprintf(file_path, sizeof(file_path), "%s/file", deep_path);
+    test_helpers_write_file(file_path, 3000);
+
+    // The argument, and a path below it longer than 512 bytes
+    RduScanner* scanner = rdu_scanner_new(2);
+    const char* paths[] = { dir_template, NULL };
+    assert(rdu_scan_start(scanner, paths, NULL) == RDU_OK);
+    assert(rdu_scan_wait(scanner) == RDU_OK);
+    const RduNode* node = rdu_scan_root(scanner, 0);
+    assert(rdu_node_entry_count(node) == depth + 2);
+    assert(rdu_node_apparent_size(node) >= 3000);
+    assert(rdu_scan_error_count(scanner) == 0);
+    size_t node_depth = 0;
+    while (rdu_node_first_child(node)) {
+        node = rdu_node_first_child(node);
+        node_depth++;
+    }
+    assert(node_depth == depth);
+    assert(strcmp(rdu_node_name(node), "directory-with-a-long-name-029") == 0);
+
+    // A path given to the scan longer than 512 bytes
+    const char* deep_paths[] = { deep_path, NULL };
+    assert(rdu_scan_start(scanner, deep_paths, NULL) == RDU_OK);
+    assert(rdu_scan_wait(scanner) == RDU_OK);
+    node = rdu_scan_root(scanner, 0);
+    assert(node != NULL);
+    assert(rdu_node_entry_count(node) == 2);
+    assert(rdu_node_apparent_size(node) >= 3000);
+
+    // Two paths whose names are the same once cut short, the first one missing
+    char missing_path[1100];
+    snprintf(missing_path, sizeof(missing_path), "%s/missing", deep_path);
+    const char* similar_paths[] = { missing_path, deep_path, NULL };
+    assert(rdu_scan_start(scanner, similar_paths, NULL) == RDU_OK);
+    assert(rdu_scan_wait(scanner) == RDU_OK);
+    assert(rdu_scan_root(scanner, 0) == NULL);
+    node = rdu_scan_root(scanner, 1);
+    assert(node != NULL);
+    assert(rdu_node_entry_count(node) == 2);
+    assert(rdu_scan_error_count(scanner) == 1);
+
+    rdu_scanner_free(scanner);
+    snprintf(command, sizeof(command), "rm -r %s", dir_template);
+    assert(system(command) == 0);
+}
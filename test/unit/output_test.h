@@ -0,0 +1,160 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../src/disk_usage.h"
+#include "../../src/output.h"
+#include "test_helpers.h"
+
+void test_output();
+void test_output_format_uint();
+void test_output_format_human();
+void test_output_escape_json();
+void test_output_escape_csv();
+void test_output_csv_header_first();
+
+void test_output() {
+    printf("[UNIT-TEST] Running output formatting tests...\n");
+
+    test_output_format_uint();
+    test_output_format_human();
+    test_output_escape_json();
+    test_output_escape_csv();
+    test_output_csv_header_first();
+
+    printf("[UNIT-TEST] Passed output formatting tests!\n");
+}
+
+void test_output_format_uint() {
+    char buffer[32];
+    size_t length = output_format_uint(buffer, 0);
+    assert(length == 1);
+    assert(memcmp(buffer, "0", 1) == 0);
+
+    length = output_format_uint(buffer, 1234567);
+    assert(length == 7);
+    assert(memcmp(buffer, "1234567", 7) == 0);
+
+    length = output_format_uint(buffer, UINT64_MAX);
+    assert(length == 20);
+    assert(memcmp(buffer, "18446744073709551615", 20) == 0);
+}
+
+// Format bytes as human readable and compare against the expected string
+bool human_formats_to(uint64_t bytes, const char* expected) {
+    char buffer[32];
+    size_t length = output_format_human(buffer, bytes);
+    return length == strlen(expected) && memcmp(buffer, expected, length) == 0;
+}
+
+void test_output_format_human() {
+    assert(human_formats_to(0, "0"));
+    assert(human_formats_to(1023, "1023"));
+    assert(human_formats_to(1024, "1.0K"));
+    assert(human_formats_to(4096, "4.0K"));
+    // Values are rounded up like du
+    assert(human_formats_to(1025, "1.1K"));
+    assert(human_formats_to(10 * 1024 - 1, "10K"));
+    assert(human_formats_to(12 * 1024 + 1, "13K"));
+    assert(human_formats_to(1536 * 1024, "1.5M"));
+    // Rounding up into the next unit
+    assert(human_formats_to(1024 * 1024 - 1, "1.0M"));
+    assert(human_formats_to(3ULL * 1024 * 1024 * 1024, "3.0G"));
+    assert(human_formats_to(UINT64_MAX, "16E"));
+}
+
+// Escape str as JSON and compare against the expected string
+bool json_escapes_to(const char* str, const char* expected) {
+    char buffer[256];
+    size_t length = output_escape_json(buffer, str, strlen(str));
+    return length == strlen(expected) && memcmp(buffer, expected, length) == 0;
+}
+
+void test_output_escape_json() {
+    assert(json_escapes_to("plain/path", "\"plain/path\""));
+    // Quotes, backslashes and control characters
+    assert(json_escapes_to("a\"b\\c", "\"a\\\"b\\\\c\""));
+    assert(json_escapes_to("new\nline\ttab", "\"new\\nline\\ttab\""));
+    assert(json_escapes_to("\x01", "\"\\u0001\""));
+    // Valid UTF-8 is kept as is
+    assert(json_escapes_to("h\xc3\xa4r/\xe2\x82\xac", "\"h\xc3\xa4r/\xe2\x82\xac\""));
+    // Invalid UTF-8 is escaped byte by byte
+    assert(json_escapes_to("bad\xff", "\"bad\\udcff\""));
+    assert(json_escapes_to("\xc3", "\"\\udcc3\""));
+    // Overlong encoding of '/'
+    assert(json_escapes_to("\xc0\xaf", "\"\\udcc0\\udcaf\""));
+    // UTF-16 surrogates are not valid UTF-8
+    assert(json_escapes_to("\xed\xa0\x80", "\"\\udced\\udca0\\udc80\""));
+}
+
+// Escape str as CSV and compare against the expected string
+bool csv_escapes_to(const char* str, const char* expected) {
+    char buffer[256];
+    size_t length = output_escape_csv(buffer, str, strlen(str));
+    return length == strlen(expected) && memcmp(buffer, expected, length) == 0;
+}
+
+void test_output_escape_csv() {
+    assert(csv_escapes_to("plain/path", "plain/path"));
+    assert(csv_escapes_to("a,b", "\"a,b\""));
+    assert(csv_escapes_to("say \"hi\"", "\"say \"\"hi\"\"\""));
+    assert(csv_escapes_to("new\nline", "\"new\nline\""));
+    // Tabs need no quoting in CSV
+    assert(csv_escapes_to("a\tb", "a\tb"));
+}
+
+void test_output_csv_header_first() {
+    char dir_path[] = "/tmp/rdu-output-test-XXXXXX";
+    assert(mkdtemp(dir_path) != NULL);
+    // Enough records for the scanning threads to flush their buffers during the scan
+    const int dir_count = 200;
+    const int file_count = 20;
+    char path[256];
+    for (int i = 0; i < dir_count; i++) {
+        snprintf(path, sizeof(path), "%s/directory-%d", dir_path, i);
+        assert(mkdir(path, 0755) == 0);
+        for (int j = 0; j < file_count; j++) {
+            snprintf(path, sizeof(path), "%s/directory-%d/file-%d", dir_path, i, j);
+            int fd = open(path, O_CREAT | O_WRONLY, 0644);
+            assert(fd != -1);
+            close(fd);
+        }
+    }
+
+    char* files[] = { dir_path, NULL };
+    Options options = test_helpers_options(files, 4, 1);
+    options.show_regular_files = true;
+    options.output_format = FORMAT_CSV;
+    options.ordered_output = false;
+    options.patterns = pattern_matcher_new();
+
+    char output_path[] = "/tmp/rdu-output-XXXXXX";
+    int output_fd = mkstemp(output_path);
+    assert(output_fd != -1);
+    fflush(stdout);
+    int stdout_fd = dup(STDOUT_FILENO);
+    dup2(output_fd, STDOUT_FILENO);
+    disk_usage(options);
+    dup2(stdout_fd, STDOUT_FILENO);
+    close(stdout_fd);
+
+    char output[64] = { 0 };
+    assert(pread(output_fd, output, sizeof(output) - 1, 0) > 0);
+    close(output_fd);
+    unlink(output_path);
+    pattern_matcher_free(&options.patterns);
+    // Printed before the threads get any directory
+    assert(strncmp(output, "path,type,size,", strlen("path,type,size,")) == 0);
+
+    for (int i = 0; i < dir_count; i++) {
+        for (int j = 0; j < file_count; j++) {
+            snprintf(path, sizeof(path), "%s/directory-%d/file-%d", dir_path, i, j);
+            unlink(path);
+        }
+        snprintf(path, sizeof(path), "%s/directory-%d", dir_path, i);
+        rmdir(path);
+    }
+    rmdir(dir_path);
+}
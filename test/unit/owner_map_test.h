@@ -0,0 +1,72 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../src/owner_map.h"
+
+void test_owner_map();
+void test_owner_map_add();
+void test_owner_map_merge();
+
+void test_owner_map() {
+    printf("[UNIT-TEST] Running owner map tests...\n");
+
+    test_owner_map_add();
+    test_owner_map_merge();
+
+    printf("[UNIT-TEST] Passed owner map tests!\n");
+}
+
+void test_owner_map_add() {
+    OwnerMap map = owner_map_new();
+    assert(owner_map_get(&map, 0) == NULL);
+
+    // Enough owners to grow the map a few times
+    for (uint32_t id = 0; id < 1000; id++) {
+        owner_map_add(&map, id, 4096, 100);
+        owner_map_add(&map, id, 4096, id);
+    }
+    assert(map.size == 1000);
+    for (uint32_t id = 0; id < 1000; id++) {
+        OwnerUsage* usage = owner_map_get(&map, id);
+        assert(usage != NULL);
+        assert(usage->size == 8192);
+        assert(usage->apparent_size == 100 + id);
+        assert(usage->entry_count == 2);
+    }
+    assert(owner_map_get(&map, 1000) == NULL);
+
+    owner_map_free(&map);
+}
+
+void test_owner_map_merge() {
+    OwnerMap map1 = owner_map_new();
+    OwnerMap map2 = owner_map_new();
+    owner_map_add(&map1, 0, 10, 5);
+    owner_map_add(&map1, 1000, 20, 20);
+    owner_map_add(&map2, 1000, 30, 25);
+    owner_map_add(&map2, 1000, 30, 25);
+    owner_map_add(&map2, 65534, 40, 40);
+
+    owner_map_merge(&map1, &map2);
+    assert(map2.size == 0);
+    assert(map1.size == 3);
+    assert(owner_map_get(&map1, 0)->size == 10);
+    assert(owner_map_get(&map1, 1000)->size == 80);
+    assert(owner_map_get(&map1, 1000)->apparent_size == 70);
+    assert(owner_map_get(&map1, 1000)->entry_count == 3);
+    assert(owner_map_get(&map1, 65534)->entry_count == 1);
+
+    size_t count;
+    OwnerUsage* usages = owner_map_to_array(&map1, &count);
+    assert(count == 3);
+    size_t total_size = 0;
+    for (size_t i = 0; i < count; i++) {
+        total_size += usages[i].size;
+    }
+    assert(total_size == 130);
+    free(usages);
+
+    owner_map_free(&map1);
+    owner_map_free(&map2);
+}
@@ -0,0 +1,114 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../src/pattern_matcher.h"
+
+void test_pattern_matcher();
+void test_pattern_matcher_excludes();
+void test_pattern_matcher_includes();
+void test_pattern_matcher_add_file();
+
+void test_pattern_matcher() {
+    printf("[UNIT-TEST] Running pattern matcher tests...\n");
+
+    test_pattern_matcher_excludes();
+    test_pattern_matcher_includes();
+    test_pattern_matcher_add_file();
+
+    printf("[UNIT-TEST] Passed pattern matcher tests!\n");
+}
+
+#define EXCLUDES(matcher, name) pattern_matcher_excludes(matcher, name, strlen(name))
+#define INCLUDES(matcher, name) pattern_matcher_includes(matcher, name, strlen(name))
+
+void test_pattern_matcher_excludes() {
+    PatternMatcher matcher = pattern_matcher_new();
+    assert(pattern_matcher_is_empty(&matcher));
+    assert(!EXCLUDES(&matcher, "node_modules"));
+
+    // Enough literals to grow the hash set a few times
+    char name[16];
+    for (int i = 0; i < 100; i++) {
+        snprintf(name, sizeof(name), "dir%d", i);
+        pattern_matcher_add(&matcher, name, false);
+    }
+    pattern_matcher_add(&matcher, "node_modules", false);
+    pattern_matcher_add(&matcher, "node_modules", false);
+    pattern_matcher_add(&matcher, "*.o", false);
+    pattern_matcher_add(&matcher, ".snap*", false);
+    pattern_matcher_add(&matcher, "core.[0-9]", false);
+    assert(!pattern_matcher_is_empty(&matcher));
+    assert(matcher.excludes.literal_count == 101);
+    assert(matcher.excludes.suffix_count == 1);
+    assert(matcher.excludes.glob_count == 2);
+
+    assert(EXCLUDES(&matcher, "node_modules"));
+    assert(EXCLUDES(&matcher, "dir99"));
+    assert(!EXCLUDES(&matcher, "dir100"));
+    assert(!EXCLUDES(&matcher, "node_module"));
+    assert(EXCLUDES(&matcher, "main.o"));
+    assert(EXCLUDES(&matcher, ".o"));
+    assert(!EXCLUDES(&matcher, "main.oo"));
+    assert(EXCLUDES(&matcher, ".snapshots"));
+    assert(EXCLUDES(&matcher, "core.7"));
+    assert(!EXCLUDES(&matcher, "core.x"));
+    // Include patterns are separate, no includes means everything is counted
+    assert(INCLUDES(&matcher, "node_modules"));
+
+    pattern_matcher_free(&matcher);
+    assert(pattern_matcher_is_empty(&matcher));
+}
+
+void test_pattern_matcher_includes() {
+    PatternMatcher matcher = pattern_matcher_new();
+    pattern_matcher_add(&matcher, "*.log", true);
+    pattern_matcher_add(&matcher, "Makefile", true);
+    assert(!pattern_matcher_is_empty(&matcher));
+    assert(INCLUDES(&matcher, "server.log"));
+    assert(INCLUDES(&matcher, "Makefile"));
+    assert(!INCLUDES(&matcher, "server.log.1"));
+    assert(!INCLUDES(&matcher, "makefile"));
+    assert(!EXCLUDES(&matcher, "main.c"));
+    pattern_matcher_free(&matcher);
+}
+
+void test_pattern_matcher_add_file() {
+    char filename[] = "/tmp/rdu-pattern-test-XXXXXX";
+    int fd = mkstemp(filename);
+    assert(fd != -1);
+    FILE* file = fdopen(fd, "w");
+    fprintf(file, "# Build output\n*.o\n\nnode_modules\r\n.cache\n");
+    fclose(file);
+
+    PatternMatcher matcher = pattern_matcher_new();
+    assert(pattern_matcher_add_file(&matcher, filename));
+    assert(matcher.excludes.literal_count == 2);
+    assert(matcher.excludes.suffix_count == 1);
+    assert(matcher.excludes.glob_count == 0);
+    assert(EXCLUDES(&matcher, "node_modules"));
+    assert(EXCLUDES(&matcher, ".cache"));
+    assert(EXCLUDES(&matcher, "rdu.o"));
+    assert(!EXCLUDES(&matcher, "# Build output"));
+    unlink(filename);
+    assert(!pattern_matcher_add_file(&matcher, filename));
+    pattern_matcher_free(&matcher);
+
+    // Patterns match names, so a file with a path pattern is rejected
+    assert(pattern_matcher_is_valid_pattern("*.o"));
+    assert(!pattern_matcher_is_valid_pattern("build/*.o"));
+    file = fopen(filename, "w");
+    fprintf(file, "*.o\nbuild/*.o\n");
+    fclose(file);
+    matcher = pattern_matcher_new();
+    errno = 0;
+    assert(!pattern_matcher_add_file(&matcher, filename));
+    assert(errno == EINVAL);
+    pattern_matcher_free(&matcher);
+    unlink(filename);
+}
+
+#undef EXCLUDES
+#undef INCLUDES
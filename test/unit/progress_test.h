@@ -0,0 +1,39 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../../src/progress.h"
+
+void test_progress();
+void test_progress_counters();
+
+void test_progress() {
+    printf("[UNIT-TEST] Running progress tests...\n");
+
+    test_progress_counters();
+
+    printf("[UNIT-TEST] Passed progress tests!\n");
+}
+
+void test_progress_counters() {
+    // Every thread writes its own cache line
+    assert(sizeof(ProgressCounters) % 64 == 0);
+
+    Progress progress;
+    progress_start(&progress, PROGRESS_NONE, 4);
+    assert(progress_counters(&progress, 0) == NULL);
+    // Adding to missing counters does nothing
+    progress_add_entries(progress_counters(&progress, 0), 10, 4096);
+    progress_add_dirs(progress_counters(&progress, 0), 2, 1);
+    progress_stop(&progress);
+
+    ProgressCounters counters = { 0 };
+    progress_add_entries(&counters, 10, 4096);
+    progress_add_entries(&counters, 5, 1024);
+    progress_add_dirs(&counters, 3, 1);
+    progress_add_dirs(&counters, 0, 2);
+    assert(counters.entries == 15);
+    assert(counters.bytes == 5120);
+    assert(counters.dirs_found == 3);
+    assert(counters.dirs_done == 3);
+}
@@ -0,0 +1,40 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "../../src/scan_pool.h"
+
+void test_scan_pool();
+void test_scan_pool_jobs();
+void* scan_pool_test_count(void* arg);
+
+void test_scan_pool() {
+    printf("[UNIT-TEST] Running scan pool tests...\n");
+
+    test_scan_pool_jobs();
+
+    printf("[UNIT-TEST] Passed scan pool tests!\n");
+}
+
+void* scan_pool_test_count(void* arg) {
+    (*(size_t*) arg)++;
+    return NULL;
+}
+
+void test_scan_pool_jobs() {
+    ScanPool pool;
+    assert(scan_pool_init(&pool, 4));
+    assert(pool.thread_count == 4);
+
+    // Every thread of a job runs it once with its own argument
+    size_t counts[4] = { 0 };
+    scan_pool_run(&pool, scan_pool_test_count, counts, sizeof(size_t), 3);
+    scan_pool_wait(&pool);
+    assert(counts[0] == 1 && counts[1] == 1 && counts[2] == 1 && counts[3] == 0);
+
+    // The same threads run the next job
+    scan_pool_run(&pool, scan_pool_test_count, counts, sizeof(size_t), 8);
+    scan_pool_wait(&pool);
+    assert(counts[0] == 2 && counts[1] == 2 && counts[2] == 2 && counts[3] == 1);
+
+    scan_pool_free(&pool);
+}
@@ -0,0 +1,59 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../src/scan_root.h"
+
+void test_scan_root();
+void test_scan_root_overlaps();
+
+void test_scan_root() {
+    printf("[UNIT-TEST] Running scan root tests...\n");
+
+    test_scan_root_overlaps();
+
+    printf("[UNIT-TEST] Passed scan root tests!\n");
+}
+
+void test_scan_root_overlaps() {
+    char dir_path[] = "/tmp/rdu-scan-root-test-XXXXXX";
+    assert(mkdtemp(dir_path) != NULL);
+    char nested_path[64];
+    char other_path[64];
+    snprintf(nested_path, sizeof(nested_path), "%s/nested", dir_path);
+    snprintf(other_path, sizeof(other_path), "%s/other", dir_path);
+    assert(mkdir(nested_path, 0755) == 0);
+    assert(mkdir(other_path, 0755) == 0);
+    char missing_path[64];
+    snprintf(missing_path, sizeof(missing_path), "%s/missing", dir_path);
+
+    // Given twice, and inside an earlier argument
+    char* files[] = { dir_path, nested_path, dir_path, missing_path, NULL };
+    size_t count;
+    ScanRoot* roots = scan_roots_new(files, &count);
+    assert(count == 4);
+    assert(roots[0].exists && !roots[0].skipped);
+    assert(roots[0].excluded_count == 0);
+    assert(roots[1].skipped);
+    assert(roots[2].skipped);
+    assert(!roots[3].exists && !roots[3].skipped);
+    assert(roots[3].error == ENOENT);
+    scan_roots_free(roots, count);
+
+    // Inside a later argument, which leaves it out of its total
+    char* nested_first[] = { nested_path, other_path, dir_path, NULL };
+    roots = scan_roots_new(nested_first, &count);
+    assert(count == 3);
+    assert(!roots[0].skipped && !roots[1].skipped && !roots[2].skipped);
+    assert(roots[2].excluded_count == 2);
+    assert(scan_root_excludes(&roots[2], roots[0].st_info.st_dev, roots[0].st_info.st_ino));
+    assert(scan_root_excludes(&roots[2], roots[1].st_info.st_dev, roots[1].st_info.st_ino));
+    assert(!scan_root_excludes(&roots[2], roots[2].st_info.st_dev, roots[2].st_info.st_ino));
+    assert(roots[0].excluded_count == 0 && roots[1].excluded_count == 0);
+    scan_roots_free(roots, count);
+
+    rmdir(nested_path);
+    rmdir(other_path);
+    rmdir(dir_path);
+}
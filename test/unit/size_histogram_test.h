@@ -0,0 +1,57 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../../src/size_histogram.h"
+
+void test_size_histogram();
+void test_size_histogram_buckets();
+void test_size_histogram_merge();
+
+void test_size_histogram() {
+    printf("[UNIT-TEST] Running size histogram tests...\n");
+
+    test_size_histogram_buckets();
+    test_size_histogram_merge();
+
+    printf("[UNIT-TEST] Passed size histogram tests!\n");
+}
+
+void test_size_histogram_buckets() {
+    assert(size_histogram_bucket(0) == 0);
+    assert(size_histogram_bucket(1) == 1);
+    assert(size_histogram_bucket(4095) == 12);
+    assert(size_histogram_bucket(4096) == 13);
+    assert(size_histogram_bucket(SIZE_MAX) == 64);
+
+    // Every bucket starts right after the previous one
+    for (size_t i = 1; i < SIZE_HISTOGRAM_BUCKETS; i++) {
+        assert(size_histogram_bucket_min(i) == size_histogram_bucket_max(i - 1) + 1);
+        assert(size_histogram_bucket(size_histogram_bucket_min(i)) == i);
+        assert(size_histogram_bucket(size_histogram_bucket_max(i)) == i);
+    }
+    assert(size_histogram_bucket_min(13) == 4096);
+    assert(size_histogram_bucket_max(13) == 8191);
+    assert(size_histogram_bucket_max(64) == SIZE_MAX);
+}
+
+void test_size_histogram_merge() {
+    SizeHistogram histogram1;
+    SizeHistogram histogram2;
+    size_histogram_clear(&histogram1);
+    size_histogram_clear(&histogram2);
+
+    size_histogram_add(&histogram1, 4096, 100);
+    size_histogram_add(&histogram2, 4096, 120);
+    size_histogram_add(&histogram2, 8192, 5000);
+    size_histogram_add(&histogram2, 0, 0);
+
+    size_histogram_merge(&histogram1, &histogram2);
+    assert(histogram1.file_counts[7] == 2);
+    assert(histogram1.sizes[7] == 8192);
+    assert(histogram1.apparent_sizes[7] == 220);
+    assert(histogram1.file_counts[13] == 1);
+    assert(histogram1.file_counts[0] == 1);
+    assert(histogram2.file_counts[7] == 0);
+    assert(histogram2.file_counts[13] == 0);
+}
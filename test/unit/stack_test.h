@@ -7,12 +7,14 @@
 void test_stack();
 void test_stack_push_pop();
 void test_stack_append();
+void test_stack_priority();
 
 void test_stack() {
     printf("[UNIT-TEST] Running stack tests...\n");
 
     test_stack_push_pop();
     test_stack_append();
+    test_stack_priority();
 
     printf("[UNIT-TEST] Passed stack tests!\n");
 }
@@ -100,4 +102,33 @@ void test_stack_append() {
     stack_free(&stack1);
     stack_free(&stack2);
     stack_free(&stack3);
-}
\ No newline at end of file
+}
+
+void test_stack_priority() {
+    // Entries are popped by descending priority, whatever the push order
+    StackEntry entry = { 0 };
+    Stack stack = stack_new(2);
+    size_t priorities[] = { 5, 1, 9, 3, 7, 9, 0, 4 };
+    for (size_t i = 0; i < 8; i++) {
+        entry.priority = priorities[i];
+        stack_push_priority(&stack, entry);
+    }
+    assert(stack.size == 8);
+    size_t expected[] = { 9, 9, 7, 5, 4, 3, 1, 0 };
+    for (size_t i = 0; i < 8; i++) {
+        assert(stack_pop_priority(&stack).priority == expected[i]);
+    }
+    assert(stack_is_empty(&stack));
+
+    // Interleaved pushes and pops
+    entry.priority = 2;
+    stack_push_priority(&stack, entry);
+    entry.priority = 8;
+    stack_push_priority(&stack, entry);
+    assert(stack_pop_priority(&stack).priority == 8);
+    entry.priority = 1;
+    stack_push_priority(&stack, entry);
+    assert(stack_pop_priority(&stack).priority == 2);
+    assert(stack_pop_priority(&stack).priority == 1);
+    stack_free(&stack);
+}
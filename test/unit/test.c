@@ -3,6 +3,25 @@
 #include "stack_test.h"
 #include "file_node_test.h"
 #include "arg_parsing_test.h"
+#include "output_test.h"
+#include "top_heap_test.h"
+#include "owner_map_test.h"
+#include "ext_map_test.h"
+#include "size_histogram_test.h"
+#include "pattern_matcher_test.h"
+#include "estimate_test.h"
+#include "progress_test.h"
+#include "gentle_test.h"
+#include "thread_tuner_test.h"
+#include "dirent_batch_test.h"
+#include "cache_index_test.h"
+#include "scan_root_test.h"
+#include "daemon_test.h"
+#include "watch_test.h"
+#include "scan_pool_test.h"
+#include "visitor_test.h"
+#include "librdu_test.h"
+#include "disk_usage_test.h"
 
 int main() {
     printf("[UNIT-TEST] Running all unit tests...\n");
@@ -10,6 +29,25 @@ int main() {
     test_stack();
     test_file_node();
     test_arg_parsing();
+    test_output();
+    test_top_heap();
+    test_owner_map();
+    test_ext_map();
+    test_size_histogram();
+    test_pattern_matcher();
+    test_estimate();
+    test_progress();
+    test_gentle();
+    test_thread_tuner();
+    test_dirent_batch();
+    test_cache_index();
+    test_scan_root();
+    test_daemon();
+    test_watch();
+    test_scan_pool();
+    test_visitor();
+    test_librdu();
+    test_disk_usage();
 
     printf("[UNIT-TEST] Passed all unit tests!\n");
     return 0;
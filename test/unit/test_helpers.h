@@ -0,0 +1,40 @@
+// Included by several test headers
+#ifndef RDU_TEST_HELPERS_H
+#define RDU_TEST_HELPERS_H
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../../src/args.h"
+#include "../../src/daemon.h"
+
+Options test_helpers_options(char** files, size_t thread_count, size_t block_size);
+void test_helpers_write_file(const char* path, size_t size);
+
+// Options of a scan of files like parse_arguments sets them, printing every directory.
+// The patterns are freed by the test
+Options test_helpers_options(char** files, size_t thread_count, size_t block_size) {
+    Options options = { 0 };
+    options.files = files;
+    options.thread_count = thread_count;
+    options.block_size = block_size;
+    options.max_depth = -1;
+    options.output_format = FORMAT_TEXT;
+    options.scan_time = time(NULL);
+    options.patterns = pattern_matcher_new();
+    options.refresh_interval = DAEMON_DEFAULT_REFRESH;
+    return options;
+}
+
+// Write a file of size bytes
+void test_helpers_write_file(const char* path, size_t size) {
+    FILE* file = fopen(path, "w");
+    assert(file != NULL);
+    for (size_t i = 0; i < size; i++) {
+        fputc('x', file);
+    }
+    fclose(file);
+}
+
+#endif
@@ -0,0 +1,85 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../../src/thread_tuner.h"
+
+void test_thread_tuner();
+void test_thread_limit();
+void test_thread_tuner_hill_climbing();
+
+void test_thread_tuner() {
+    printf("[UNIT-TEST] Running thread tuner tests...\n");
+
+    test_thread_limit();
+    test_thread_tuner_hill_climbing();
+
+    printf("[UNIT-TEST] Passed thread tuner tests!\n");
+}
+
+void test_thread_limit() {
+    ThreadLimit thread_limit;
+    thread_limit_init(&thread_limit, 4, 2);
+    assert(!thread_limit_is_saturated(&thread_limit));
+    thread_limit_enter(&thread_limit);
+    thread_limit_enter(&thread_limit);
+    assert(thread_limit_is_saturated(&thread_limit));
+    thread_limit_leave(&thread_limit);
+    assert(!thread_limit_is_saturated(&thread_limit));
+    thread_limit_leave(&thread_limit);
+    // Clamped between one and the amount of threads
+    thread_limit_set(&thread_limit, 0);
+    assert(thread_limit_get(&thread_limit) == 1);
+    thread_limit_set(&thread_limit, 100);
+    assert(thread_limit_get(&thread_limit) == 4);
+
+    assert(thread_tuner_max_threads(2) == 2 * THREAD_TUNER_THREADS_PER_CPU);
+    assert(thread_tuner_max_threads(1000) == THREAD_TUNER_MAX_THREADS);
+}
+
+void test_thread_tuner_hill_climbing() {
+    ThreadTuner tuner;
+    thread_tuner_init(&tuner, 32, 4);
+    uint64_t now = tuner.last_update_time;
+    // Every allowed worker is scanning
+    for (int i = 0; i < 4; i++) {
+        thread_limit_enter(&tuner.threads);
+    }
+    // Too soon to measure
+    thread_tuner_update(&tuner, 100, now + 1);
+    assert(thread_limit_get(&tuner.threads) == 4);
+    now += THREAD_TUNER_INTERVAL_NSECS;
+    thread_tuner_update(&tuner, 0, now);
+    assert(thread_limit_get(&tuner.threads) == 5);
+    // Only 4 of 5 workers are scanning, so it holds even though it improves
+    now += THREAD_TUNER_INTERVAL_NSECS;
+    thread_tuner_update(&tuner, 200, now);
+    assert(thread_limit_get(&tuner.threads) == 5);
+    // Grows while the throughput improves and every worker is busy
+    thread_limit_enter(&tuner.threads);
+    now += THREAD_TUNER_INTERVAL_NSECS;
+    thread_tuner_update(&tuner, 300, now);
+    assert(thread_limit_get(&tuner.threads) == 6);
+    for (int i = 0; i < 5; i++) {
+        thread_limit_leave(&tuner.threads);
+    }
+
+    // Throughput drops, so it turns around and removes workers
+    now += THREAD_TUNER_INTERVAL_NSECS;
+    thread_tuner_update(&tuner, 100, now);
+    assert(thread_limit_get(&tuner.threads) == 5);
+    // Keeps shrinking while it improves
+    now += THREAD_TUNER_INTERVAL_NSECS;
+    thread_tuner_update(&tuner, 150, now);
+    assert(thread_limit_get(&tuner.threads) == 4);
+    // Small changes are noise and keep the direction
+    now += THREAD_TUNER_INTERVAL_NSECS;
+    thread_tuner_update(&tuner, 148, now);
+    assert(thread_limit_get(&tuner.threads) == 3);
+    // Never below one worker
+    for (int i = 0; i < 10; i++) {
+        now += THREAD_TUNER_INTERVAL_NSECS;
+        thread_tuner_update(&tuner, 150, now);
+    }
+    assert(thread_limit_get(&tuner.threads) == 1);
+}
@@ -0,0 +1,120 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/top_heap.h"
+
+void test_top_heap();
+void test_top_heap_push();
+void test_top_heap_merge();
+void test_top_heap_apparent_size();
+void test_top_heap_entry_count();
+
+void test_top_heap() {
+    printf("[UNIT-TEST] Running top heap tests...\n");
+
+    test_top_heap_push();
+    test_top_heap_merge();
+    test_top_heap_apparent_size();
+    test_top_heap_entry_count();
+
+    printf("[UNIT-TEST] Passed top heap tests!\n");
+}
+
+// Push a record with a path and size into the heap
+void top_heap_push_entry(TopHeap* heap, char* path, size_t size) {
+    OutputRecord record = { 0 };
+    record.path = path;
+    record.path_length = strlen(path);
+    record.size = size;
+    top_heap_push(heap, &record);
+}
+
+void test_top_heap_push() {
+    TopHeap heap = top_heap_new(3, TOP_KEY_SIZE);
+    assert(top_heap_accepts(&heap, 0));
+
+    top_heap_push_entry(&heap, "a", 10);
+    top_heap_push_entry(&heap, "b", 50);
+    top_heap_push_entry(&heap, "c", 30);
+    assert(heap.size == 3);
+    // Full, smaller than the smallest is rejected
+    assert(!top_heap_accepts(&heap, 5));
+    assert(top_heap_accepts(&heap, 20));
+
+    top_heap_push_entry(&heap, "d", 5);
+    top_heap_push_entry(&heap, "e", 40);
+    top_heap_push_entry(&heap, "f", 20);
+    assert(heap.size == 3);
+
+    top_heap_sort(&heap);
+    assert(heap.records[0].size == 50);
+    assert(strcmp(heap.records[0].path, "b") == 0);
+    assert(heap.records[1].size == 40);
+    assert(strcmp(heap.records[1].path, "e") == 0);
+    assert(heap.records[2].size == 30);
+    assert(strcmp(heap.records[2].path, "c") == 0);
+
+    top_heap_free(&heap);
+}
+
+void test_top_heap_merge() {
+    TopHeap heap1 = top_heap_new(2, TOP_KEY_SIZE);
+    TopHeap heap2 = top_heap_new(2, TOP_KEY_SIZE);
+    top_heap_push_entry(&heap1, "a", 1);
+    top_heap_push_entry(&heap1, "b", 4);
+    top_heap_push_entry(&heap2, "c", 3);
+    top_heap_push_entry(&heap2, "d", 2);
+
+    top_heap_merge(&heap1, &heap2);
+    assert(heap2.size == 0);
+    assert(heap1.size == 2);
+
+    top_heap_sort(&heap1);
+    assert(strcmp(heap1.records[0].path, "b") == 0);
+    assert(strcmp(heap1.records[1].path, "c") == 0);
+
+    top_heap_free(&heap1);
+    top_heap_free(&heap2);
+}
+
+void test_top_heap_apparent_size() {
+    TopHeap heap = top_heap_new(1, TOP_KEY_APPARENT_SIZE);
+    OutputRecord sparse = { 0 };
+    sparse.path = "sparse";
+    sparse.path_length = strlen(sparse.path);
+    sparse.size = 0;
+    sparse.apparent_size = 1000;
+    top_heap_push(&heap, &sparse);
+    // Larger on disk, but smaller apparent size
+    top_heap_push_entry(&heap, "full", 100);
+    assert(!top_heap_accepts(&heap, 500));
+
+    top_heap_sort(&heap);
+    assert(heap.size == 1);
+    assert(strcmp(heap.records[0].path, "sparse") == 0);
+
+    top_heap_free(&heap);
+}
+
+void test_top_heap_entry_count() {
+    TopHeap heap = top_heap_new(2, TOP_KEY_ENTRY_COUNT);
+    char* paths[] = { "few", "many", "some" };
+    size_t entry_counts[] = { 3, 40000000, 100 };
+    for (size_t i = 0; i < 3; i++) {
+        OutputRecord record = { 0 };
+        record.path = paths[i];
+        record.path_length = strlen(paths[i]);
+        // Sizes are not ranked
+        record.size = 1000 - i;
+        record.entry_count = entry_counts[i];
+        top_heap_push(&heap, &record);
+    }
+
+    top_heap_sort(&heap);
+    assert(heap.size == 2);
+    assert(strcmp(heap.records[0].path, "many") == 0);
+    assert(strcmp(heap.records[1].path, "some") == 0);
+
+    top_heap_free(&heap);
+}
@@ -0,0 +1,64 @@
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/visitor.h"
+
+void test_visitor();
+void test_visitor_batch();
+void visitor_test_entries(void* context, size_t thread_index, const char* directory_path,
+                          size_t depth, const RduEntry* entries, size_t count);
+
+void test_visitor() {
+    printf("[UNIT-TEST] Running visitor tests...\n");
+
+    test_visitor_batch();
+
+    printf("[UNIT-TEST] Passed visitor tests!\n");
+}
+
+// Counts the batches and entries in the context
+void visitor_test_entries(void* context, size_t thread_index, const char* directory_path,
+                          size_t depth, const RduEntry* entries, size_t count) {
+    size_t* counts = (size_t*) context;
+    assert(thread_index == 3);
+    assert(strcmp(directory_path, "/tmp/dir") == 0);
+    assert(depth == 2);
+    assert(strcmp(entries[0].name, "file") == 0);
+    assert(entries[0].size == 4096 && entries[0].apparent_size == 100);
+    assert(entries[0].counted);
+    counts[0]++;
+    counts[1] += count;
+}
+
+void test_visitor_batch() {
+    size_t counts[2] = { 0 };
+    RduVisitor visitor = { visitor_test_entries, NULL, counts };
+    VisitorBatch batch = visitor_batch_new(&visitor, 3);
+    assert(batch.visitor == &visitor);
+    batch.path = strdup("/tmp/dir");
+    batch.path_size = 9;
+    batch.depth = 2;
+
+    struct stat st_info = { 0 };
+    st_info.st_blocks = 8;
+    st_info.st_size = 100;
+    st_info.st_mode = S_IFREG | 0644;
+    for (size_t i = 0; i < VISITOR_BATCH_SIZE + 10; i++) {
+        visitor_batch_add(&batch, "file", DT_REG, &st_info, true);
+    }
+    // The full batch was handed over, the rest waits for the flush
+    assert(counts[0] == 1 && counts[1] == VISITOR_BATCH_SIZE);
+    visitor_batch_flush(&batch);
+    assert(counts[0] == 2 && counts[1] == VISITOR_BATCH_SIZE + 10);
+    visitor_batch_flush(&batch);
+    assert(counts[0] == 2);
+    visitor_batch_free(&batch);
+
+    // Without an entries callback nothing is batched
+    RduVisitor directory_visitor = { NULL, NULL, NULL };
+    batch = visitor_batch_new(&directory_visitor, 0);
+    assert(batch.visitor == NULL && batch.entries == NULL);
+    visitor_batch_free(&batch);
+}
@@ -0,0 +1,138 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../src/args.h"
+#include "../../src/daemon.h"
+#include "../../src/watch.h"
+#include "test_helpers.h"
+
+void test_watch();
+void test_watch_events();
+void test_watch_limit();
+void watch_test_compare_with_scan(Daemon* server);
+
+void test_watch() {
+    printf("[UNIT-TEST] Running watch tests...\n");
+
+    test_watch_events();
+    test_watch_limit();
+
+    printf("[UNIT-TEST] Passed watch tests!\n");
+}
+
+// The maintained tree has the totals of a new scan
+void watch_test_compare_with_scan(Daemon* server) {
+    FileNode* node = server->trees[0].node;
+    FileNode* scanned = daemon_scan_tree(server->options, server->trees[0].path);
+    assert(node->complete_size == scanned->complete_size);
+    assert(node->complete_apparent_size == scanned->complete_apparent_size);
+    assert(node->complete_entry_count == scanned->complete_entry_count);
+    assert(file_tree_count_nodes(node) == file_tree_count_nodes(scanned));
+    file_node_free_all(scanned);
+}
+
+void test_watch_events() {
+    char dir_template[] = "/tmp/rdu-watch-test-XXXXXX";
+    assert(mkdtemp(dir_template) != NULL);
+    char* dir_path = realpath(dir_template, NULL);
+    char command[512];
+    snprintf(command, sizeof(command), "mkdir -p %s/a/b %s/c", dir_path, dir_path);
+    assert(system(command) == 0);
+    char file_path[128], new_path[128];
+    snprintf(file_path, sizeof(file_path), "%s/a/file", dir_path);
+    snprintf(new_path, sizeof(new_path), "%s/new", dir_path);
+    test_helpers_write_file(file_path, 1000);
+
+    char* files[] = { dir_path, NULL };
+    Options options = test_helpers_options(files, 2, 1024);
+    Daemon server;
+    assert(daemon_init(&server, &options));
+    Watcher watcher;
+    assert(watcher_init(&watcher, &server));
+    assert(server.watcher == &watcher);
+    assert(watcher.watch_count == 4);
+    assert(!watcher.limit_reached);
+
+    // New files and a new subtree
+    test_helpers_write_file(new_path, 5000);
+    snprintf(command, sizeof(command), "mkdir -p %s/c/d/e && echo text > %s/c/d/e/f",
+             dir_path, dir_path);
+    assert(system(command) == 0);
+    watcher_process_events(&watcher);
+    watch_test_compare_with_scan(&server);
+    assert(watcher.watch_count == 6);
+
+    // Moved inside the tree, keeping its watches
+    FileNode* moved = file_node_find_child(server.trees[0].node, "a");
+    snprintf(command, sizeof(command), "mv %s/a %s/c/d/moved", dir_path, dir_path);
+    assert(system(command) == 0);
+    watcher_process_events(&watcher);
+    watch_test_compare_with_scan(&server);
+    FileNode* d = file_node_find_child(file_node_find_child(server.trees[0].node, "c"), "d");
+    assert(file_node_find_child(d, "moved") == moved);
+    assert(watcher.watch_count == 6);
+
+    // Modified and removed
+    test_helpers_write_file(new_path, 100);
+    snprintf(command, sizeof(command), "rm -r %s/c/d/moved", dir_path);
+    assert(system(command) == 0);
+    watcher_process_events(&watcher);
+    watch_test_compare_with_scan(&server);
+    assert(file_node_find_child(d, "moved") == NULL);
+    assert(watcher.watch_count == 4);
+
+    watcher_free(&watcher);
+    assert(server.watcher == NULL);
+    daemon_free(&server);
+    pattern_matcher_free(&options.patterns);
+    snprintf(command, sizeof(command), "rm -r %s", dir_path);
+    assert(system(command) == 0);
+    free(dir_path);
+}
+
+void test_watch_limit() {
+    char dir_template[] = "/tmp/rdu-watch-test-XXXXXX";
+    assert(mkdtemp(dir_template) != NULL);
+    char* dir_path = realpath(dir_template, NULL);
+    char command[512];
+    snprintf(command, sizeof(command), "mkdir -p %s/a/b/c %s/d", dir_path, dir_path);
+    assert(system(command) == 0);
+
+    char* files[] = { dir_path, NULL };
+    Options options = test_helpers_options(files, 2, 1024);
+    Daemon server;
+    assert(daemon_init(&server, &options));
+    Watcher watcher;
+    assert(watcher_init(&watcher, &server));
+
+    // Only the argument and its children are watched, shallowest first
+    watcher_remove_tree(&watcher, 0);
+    assert(watcher.watch_count == 0);
+    watcher.watch_limit = 3;
+    watcher_add_subtree(&watcher, 0, server.trees[0].node, false);
+    assert(watcher.limit_reached);
+    assert(watcher.watch_count == 3);
+    FileNode* b = file_node_find_child(file_node_find_child(server.trees[0].node, "a"), "b");
+    assert(b->watch_descriptor == 0);
+
+    // Changes below the limit are only seen by the refresh
+    char file_path[128];
+    snprintf(file_path, sizeof(file_path), "%s/a/b/file", dir_path);
+    size_t apparent_size = server.trees[0].node->complete_apparent_size;
+    test_helpers_write_file(file_path, 20000);
+    watcher_process_events(&watcher);
+    assert(server.trees[0].node->complete_apparent_size == apparent_size);
+    watcher_refresh_unwatched(&watcher);
+    watch_test_compare_with_scan(&server);
+    assert(server.trees[0].node->complete_apparent_size == apparent_size + 20000);
+    assert(watcher.watch_count == 3);
+
+    watcher_free(&watcher);
+    daemon_free(&server);
+    pattern_matcher_free(&options.patterns);
+    snprintf(command, sizeof(command), "rm -r %s", dir_path);
+    assert(system(command) == 0);
+    free(dir_path);
+}